@@ -21,6 +21,7 @@
 #include <config/functions.h>
 #include <config/state.h>
 #include <config/version.h>
+#include <ctrl/functions.h>
 #include <display/state.h>
 #include <emuenv/state.h>
 #include <gui/functions.h>
@@ -482,6 +483,8 @@ bool init(EmuEnvState &state, const Root &root_paths) {
     }
 
     state.motion.init();
+    // controllers connected later are opened on their SDL device event
+    refresh_controllers(state.ctrl, state);
 
 #if USE_DISCORD
     if (discordrpc::init() && state.cfg.discord_rich_presence) {
@@ -0,0 +1,199 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Software synthesizer behind SceSas. The voices play VAG ADPCM, 16-bit PCM or noise,
+// go through an ADSR envelope and are mixed to a dry and a wet (effect) bus.
+
+constexpr uint32_t SAS_MAX_VOICES = 32;
+constexpr uint32_t SAS_MAX_GRAIN = 2048;
+constexpr uint32_t SAS_MIN_GRAIN = 64;
+
+// 0x1000 plays at the original rate
+constexpr int32_t SAS_PITCH_BASE = 0x1000;
+constexpr int32_t SAS_PITCH_MAX = 0x4000;
+constexpr int32_t SAS_VOLUME_MAX = 0x1000;
+constexpr uint32_t SAS_NOISE_CLOCK_MAX = 0x3F;
+
+constexpr int32_t SAS_ENVELOPE_HEIGHT_MAX = 0x40000000;
+
+enum SasOutputMode : uint32_t {
+    SAS_OUTPUT_STEREO = 0,
+    // dry and wet buses are written as 4 interleaved channels, the effect is left to the caller
+    SAS_OUTPUT_MULTI = 1,
+};
+
+enum SasEnvelopeCurve : uint32_t {
+    SAS_CURVE_LINEAR_INCREASE = 0,
+    SAS_CURVE_LINEAR_DECREASE = 1,
+    SAS_CURVE_LINEAR_BENT = 2,
+    SAS_CURVE_EXPONENT_DECREASE = 3,
+    SAS_CURVE_EXPONENT_INCREASE = 4,
+    SAS_CURVE_DIRECT = 5,
+};
+
+enum SasEnvelopeFlag : uint32_t {
+    SAS_ENVELOPE_ATTACK = 1,
+    SAS_ENVELOPE_DECAY = 2,
+    SAS_ENVELOPE_SUSTAIN = 4,
+    SAS_ENVELOPE_RELEASE = 8,
+};
+
+enum class SasEffectType : int32_t {
+    Off = -1,
+    Room = 0,
+    StudioSmall = 1,
+    StudioMedium = 2,
+    StudioLarge = 3,
+    Hall = 4,
+    Space = 5,
+    Echo = 6,
+    Delay = 7,
+    Pipe = 8,
+};
+
+enum class SasVoiceType {
+    None,
+    Vag,
+    Pcm,
+    Noise,
+};
+
+struct SasEnvelope {
+    enum class Phase {
+        Attack,
+        Decay,
+        Sustain,
+        Release,
+        Off,
+    };
+
+    int32_t attack_rate = 0;
+    int32_t decay_rate = 0;
+    int32_t sustain_rate = 0;
+    int32_t release_rate = 0;
+    SasEnvelopeCurve attack_curve = SAS_CURVE_LINEAR_INCREASE;
+    SasEnvelopeCurve decay_curve = SAS_CURVE_LINEAR_DECREASE;
+    SasEnvelopeCurve sustain_curve = SAS_CURVE_LINEAR_DECREASE;
+    SasEnvelopeCurve release_curve = SAS_CURVE_LINEAR_DECREASE;
+    int32_t sustain_level = 0;
+
+    Phase phase = Phase::Off;
+    int32_t height = 0;
+
+    // Set everything from the two packed SPU style registers
+    void set_simple(uint32_t adsr1, uint32_t adsr2);
+
+    void key_on();
+    void key_off();
+    // Advance by one sample
+    void step();
+};
+
+struct SasVoice {
+    SasVoiceType type = SasVoiceType::None;
+
+    // host view of the guest sample data, the size is in bytes for VAG and in samples for PCM
+    const uint8_t *data = nullptr;
+    uint32_t size = 0;
+    bool loop = false;
+    // PCM: first sample of the loop, VAG: byte offset of the loop start block
+    uint32_t loop_start = 0;
+
+    int32_t pitch = SAS_PITCH_BASE;
+    uint32_t noise_clock = 0;
+    int32_t volume_left = SAS_VOLUME_MAX;
+    int32_t volume_right = SAS_VOLUME_MAX;
+    int32_t wet_volume_left = 0;
+    int32_t wet_volume_right = 0;
+    int32_t distortion = 0;
+
+    SasEnvelope envelope;
+
+    bool playing = false;
+    bool paused = false;
+    bool ended = true;
+
+    uint32_t dry_peak = 0;
+    uint32_t wet_peak = 0;
+
+    // Decoder state
+    uint32_t position = 0;
+    bool source_ended = false;
+    int32_t history[2] = {};
+    std::array<int16_t, 28> block{};
+    uint32_t block_index = 28;
+    uint32_t noise_counter = 0;
+    uint32_t noise_level = 1;
+
+    // Resampler state: the two source samples around the current position and its fraction
+    int16_t carry[2] = {};
+    uint32_t pitch_fraction = 0;
+
+    void key_on();
+    void key_off();
+
+    // Decode the next source samples, zero once the data ended
+    void fetch(int16_t *out, uint32_t count);
+};
+
+struct SasCore {
+    uint32_t grain = 256;
+    uint32_t voice_count = SAS_MAX_VOICES;
+    SasOutputMode output_mode = SAS_OUTPUT_STEREO;
+    uint32_t sample_rate = 48000;
+
+    std::array<SasVoice, SAS_MAX_VOICES> voices;
+
+    SasEffectType effect_type = SasEffectType::Off;
+    bool dry_enabled = true;
+    bool wet_enabled = false;
+    uint32_t effect_delay = 0;
+    uint32_t effect_feedback = 0;
+    int32_t effect_volume_left = 0;
+    int32_t effect_volume_right = 0;
+
+    uint32_t premaster_peak = 0;
+
+    void init(uint32_t grain, uint32_t voice_count, SasOutputMode output_mode, uint32_t sample_rate);
+    void set_effect_type(SasEffectType type);
+
+    // Produce one grain of interleaved samples (2 or 4 channels depending on the output mode).
+    // With mix_in, the grain is added to the samples already there, scaled by the mix volumes
+    void process(int16_t *out, bool mix_in = false, int32_t mix_volume_left = 0, int32_t mix_volume_right = 0);
+
+private:
+    std::vector<float> dry_left;
+    std::vector<float> dry_right;
+    std::vector<float> wet_left;
+    std::vector<float> wet_right;
+    std::vector<float> voice_samples;
+    std::vector<float> gains;
+    std::vector<int16_t> source;
+
+    std::vector<float> delay_left;
+    std::vector<float> delay_right;
+    uint32_t delay_position = 0;
+
+    void render_voice(SasVoice &voice);
+    void apply_effect();
+};
@@ -17,9 +17,15 @@
 
 #pragma once
 
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <queue>
 #include <string>
+#include <thread>
+#include <vector>
 
 struct AVFrame;
 struct AVPacket;
@@ -124,9 +130,18 @@ struct MjpegDecoderState : public DecoderState {
 
     bool send(const uint8_t *data, uint32_t size) override;
     bool receive(uint8_t *data, DecoderSize *size) override;
+    // Converts the decoded planes straight into the output, without an intermediate YCbCr copy
+    bool receive_rgba(uint8_t *rgba, DecoderSize *size, bool bt601, bool bgra);
+    // Decodes the next images at 1 / (1 << lowres) of their size, the IDCT doing the scaling
+    void set_downscale(uint32_t lowres);
     DecoderColorSpace get_color_space();
 
     MjpegDecoderState();
+
+private:
+    std::vector<uint8_t> packet_buffer;
+
+    AVFrame *receive_frame();
 };
 
 struct Atrac9DecoderSavedState {
@@ -222,20 +237,72 @@ struct AacDecoderState : public DecoderState {
     ~AacDecoderState() override;
 };
 
+// Media read through the file functions of the title instead of the host file system
+struct PlayerReader {
+    virtual ~PlayerReader() = default;
+
+    // Opens the media when its video starts, the previous video is closed first
+    virtual bool open() = 0;
+    virtual uint64_t size() = 0;
+    // Returns the number of bytes read, or a negative value on error
+    virtual int32_t read(uint8_t *data, uint64_t offset, uint32_t size) = 0;
+};
+
+struct PlayerSource {
+    std::string path;
+    // Null when the media is a host file
+    std::shared_ptr<PlayerReader> reader;
+};
+
+// Decoded video frame or audio samples, the buffers are recycled between the decode thread and the caller
+struct PlayerFrame {
+    std::vector<uint8_t> data;
+    uint64_t timestamp = 0;
+
+    // Audio only, the samples are interleaved signed 16-bit
+    uint32_t channels = 0;
+    uint32_t sample_rate = 0;
+    uint32_t sample_count = 0;
+};
+
+// Stream info of the last frames given to the caller
+struct PlayerStreamInfo {
+    uint64_t timestamp = 0;
+    uint32_t channels = 0;
+    uint32_t sample_rate = 0;
+    uint32_t sample_count = 0;
+};
+
+// Demuxes and decodes ahead on its own thread, the caller only dequeues the decoded frames
 struct PlayerState {
+    std::mutex mutex;
+    std::condition_variable cond;
+
+    // Guarded by the mutex
     std::string video_playing;
-    std::queue<std::string> videos_queue;
+    std::queue<PlayerSource> videos_queue;
 
-    AVFormatContext *format{};
-    AVCodecContext *video_context{};
-    AVCodecContext *audio_context{};
-    int32_t video_stream_id = -1;
-    int32_t audio_stream_id = -1;
+    std::deque<PlayerFrame> video_frames;
+    std::deque<PlayerFrame> audio_frames;
+    std::vector<std::vector<uint8_t>> free_video_buffers;
+    std::vector<std::vector<uint8_t>> free_audio_buffers;
 
-    std::queue<AVPacket *> audio_packets;
-    std::queue<AVPacket *> video_packets;
+    bool stop_decoding = false;
+    bool decode_ended = false;
 
-    uint64_t time_of_last_frame = 0;
+    // Open or read of a PlayerReader asked by the decode thread, it is served by the next call of the caller thread
+    bool read_open = false;
+    uint8_t *read_data = nullptr;
+    uint64_t read_offset = 0;
+    uint32_t read_size = 0;
+    int32_t read_result = 0;
+    bool read_pending = false;
+    bool read_done = false;
+
+    // Readers of the videos closed by the decode thread, they are destroyed by the caller
+    std::vector<std::shared_ptr<PlayerReader>> retired_readers;
+
+    DecoderSize video_size = {};
     uint64_t framerate_microseconds = 0;
 
     uint64_t last_timestamp = 0;
@@ -243,25 +310,54 @@ struct PlayerState {
     uint32_t last_sample_rate = 0;
     uint32_t last_sample_count = 0;
 
+    // Only used by the decode thread while it runs
+    std::thread decode_thread;
+    std::thread::id decode_thread_id;
+    std::shared_ptr<PlayerReader> reader;
+    uint64_t reader_position = 0;
+    AVIOContext *io{};
+
+    AVFormatContext *format{};
+    AVCodecContext *video_context{};
+    AVCodecContext *audio_context{};
+    int32_t video_stream_id = -1;
+    int32_t audio_stream_id = -1;
+
     DecoderSize get_size();
     uint64_t get_framerate_microseconds();
+    PlayerStreamInfo get_stream_info();
+    bool is_playing();
+    bool has_queued_videos();
 
     void pop_video();
     void free_video();
-    void switch_video(const std::string &path);
+    void switch_video(const PlayerSource &source);
+
+    bool open_media(const PlayerSource &source);
+    void close_media();
+    void decode_loop();
+    void decode_packet(int32_t stream_id, AVPacket *packet, AVFrame *frame);
 
-    bool next_packet(int32_t stream_id);
+    int32_t request_read(bool open, uint8_t *data, uint32_t size);
+    bool open_source();
+    int32_t read_source(uint8_t *data, uint32_t size);
+    void serve_read();
 
-    std::vector<int16_t> receive_audio();
-    std::vector<uint8_t> receive_video();
+    // Swap the next decoded frame into frame, its previous buffer is recycled. Returns false if no frame is ready
+    bool receive_audio(PlayerFrame &frame);
+    bool receive_video(PlayerFrame &frame);
 
     void queue(const std::string &path);
+    void queue(const PlayerSource &source);
 
     ~PlayerState();
 };
 
 void convert_rgb_to_yuv(const uint8_t *rgba, uint8_t *yuv, uint32_t width, uint32_t height, const DecoderColorSpace color_space, int32_t inPitch);
-void convert_yuv_to_rgb(const uint8_t *yuv, uint8_t *rgba, uint32_t width, uint32_t height, const DecoderColorSpace color_space);
+void convert_ycbcr_to_rgba(const uint8_t *const planes[3], const uint32_t strides[3], uint8_t *rgba, uint32_t rgba_pitch,
+    uint32_t width, uint32_t height, const DecoderColorSpace color_space, bool bt601, bool bgra);
+// Reads the image size and sampling from the SOF segment, returns 0 or a SceJpegError
+int parse_jpeg_header(const uint8_t *jpeg, uint32_t size, DecoderSize &image_size, DecoderColorSpace &color_space);
 int convert_yuv_to_jpeg(const uint8_t *yuv, uint8_t *jpeg, uint32_t width, uint32_t height, uint32_t max_size, const DecoderColorSpace color_space, int32_t compress_ratio);
 void copy_yuv_data_from_frame(AVFrame *frame, uint8_t *dest, const uint32_t width, const uint32_t height, bool is_p3);
 std::string codec_error_name(int error);
@@ -29,57 +29,6 @@ extern "C" {
 
 #include <cassert>
 
-void convert_yuv_to_rgb(const uint8_t *yuv, uint8_t *rgba, uint32_t width, uint32_t height, const DecoderColorSpace color_space) {
-    AVPixelFormat format = AV_PIX_FMT_YUVJ444P;
-    int strides_divisor = 1;
-    int slice_position = 8;
-
-    switch (color_space) {
-    case COLORSPACE_YUV444P:
-        format = AV_PIX_FMT_YUV444P;
-        strides_divisor = 1;
-        slice_position = 8; // 2
-        break;
-    case COLORSPACE_YUV422P:
-        format = AV_PIX_FMT_YUV422P;
-        strides_divisor = 2;
-        slice_position = 6; // 1.5
-        break;
-    case COLORSPACE_YUV420P:
-        format = AV_PIX_FMT_YUV420P;
-        strides_divisor = 2;
-        slice_position = 5; // 1.25
-        break;
-    }
-
-    SwsContext *context = sws_getContext(width, height, format, width, height, AV_PIX_FMT_RGBA, SWS_FULL_CHR_H_INT | SWS_ACCURATE_RND, nullptr, nullptr, nullptr);
-    assert(context);
-
-    const uint8_t *slices[] = {
-        &yuv[0], // Y Slice
-        &yuv[width * height], // U Slice
-        &yuv[width * height * slice_position / 4], // V Slice
-    };
-
-    int strides[] = {
-        static_cast<int>(width),
-        static_cast<int>(width) / strides_divisor,
-        static_cast<int>(width) / strides_divisor,
-    };
-
-    uint8_t *dst_slices[] = {
-        rgba,
-    };
-
-    const int dst_strides[] = {
-        static_cast<int>(width * 4),
-    };
-
-    int error = sws_scale(context, slices, strides, 0, height, dst_slices, dst_strides);
-    assert(error == height);
-    sws_freeContext(context);
-}
-
 void convert_rgb_to_yuv(const uint8_t *rgba, uint8_t *yuv, uint32_t width, uint32_t height, const DecoderColorSpace color_space, int32_t inPitch) {
     AVPixelFormat format = AV_PIX_FMT_NONE;
     int strides_divisor = 1;
@@ -236,12 +185,88 @@ int convert_yuv_to_jpeg(const uint8_t *yuv, uint8_t *jpeg, uint32_t width, uint3
     return size;
 }
 
+int parse_jpeg_header(const uint8_t *jpeg, uint32_t size, DecoderSize &image_size, DecoderColorSpace &color_space) {
+    if ((size < 4) || (jpeg[0] != 0xFF) || (jpeg[1] != 0xD8))
+        return SCE_JPEG_ERROR_NO_SOI;
+
+    bool has_sof = false;
+    uint32_t pos = 2;
+    while (pos + 4 <= size) {
+        if (jpeg[pos] != 0xFF)
+            return SCE_JPEG_ERROR_UNKNOWN_MARKER;
+
+        const uint8_t marker = jpeg[pos + 1];
+        if ((marker == 0xFF) || (marker == 0x01) || ((marker >= 0xD0) && (marker <= 0xD7))) {
+            // Fill bytes and standalone markers have no length
+            pos += (marker == 0xFF) ? 1 : 2;
+            continue;
+        }
+
+        if (marker == 0xD9)
+            return SCE_JPEG_ERROR_IMAGE_EMPTY;
+
+        const uint32_t length = (jpeg[pos + 2] << 8) | jpeg[pos + 3];
+        if ((length < 2) || (pos + 2 + length > size))
+            return SCE_JPEG_ERROR_BAD_MARKER_LENGTH;
+
+        const uint8_t *segment = &jpeg[pos + 4];
+        if ((marker >= 0xC0) && (marker <= 0xCF) && (marker != 0xC4) && (marker != 0xC8) && (marker != 0xCC)) {
+            if (has_sof)
+                return SCE_JPEG_ERROR_SOF_DUPLICATE;
+            if ((marker & 3) == 3)
+                return SCE_JPEG_ERROR_NO_LOSSLESS_SUPPORT;
+            if (marker >= 0xC8)
+                return SCE_JPEG_ERROR_NO_ARITH_SUPPORT;
+            if ((length < 8) || (length < 8 + segment[5] * 3u))
+                return SCE_JPEG_ERROR_BAD_SOF_MARKER;
+            if (segment[0] != 8)
+                return SCE_JPEG_ERROR_BAD_PRECISION;
+
+            image_size.height = (segment[1] << 8) | segment[2];
+            image_size.width = (segment[3] << 8) | segment[4];
+            if ((image_size.width == 0) || (image_size.height == 0))
+                return SCE_JPEG_ERROR_UNSUPPORT_IMAGE_SIZE;
+
+            const uint8_t component_count = segment[5];
+            if (component_count == 1) {
+                color_space = COLORSPACE_GRAYSCALE;
+            } else if (component_count == 3) {
+                // Chroma has to be at full resolution relatively to the luma sampling factors
+                if ((segment[6 + 3 + 1] != 0x11) || (segment[6 + 6 + 1] != 0x11))
+                    return SCE_JPEG_ERROR_UNSUPPORT_SAMPLING;
+
+                switch (segment[6 + 1]) {
+                case 0x11: color_space = COLORSPACE_YUV444P; break;
+                case 0x21: color_space = COLORSPACE_YUV422P; break;
+                case 0x22: color_space = COLORSPACE_YUV420P; break;
+                default: return SCE_JPEG_ERROR_UNSUPPORT_SAMPLING;
+                }
+            } else {
+                return SCE_JPEG_ERROR_COMPONENT_COUNT;
+            }
+
+            has_sof = true;
+        } else if (marker == 0xDA) {
+            // Entropy coded data follows, there is nothing left to learn from the headers
+            if (!has_sof)
+                return SCE_JPEG_ERROR_BAD_SOS_MARKER;
+            return 0;
+        }
+
+        pos += 2 + length;
+    }
+
+    return SCE_JPEG_ERROR_BAD_SOS_MARKER;
+}
+
 bool MjpegDecoderState::send(const uint8_t *data, uint32_t size) {
-    std::vector<uint8_t> jpeg_buffer(size + AV_INPUT_BUFFER_PADDING_SIZE);
-    std::memcpy(jpeg_buffer.data(), data, size);
+    // The buffer is kept between images, only the padding required by FFmpeg needs clearing
+    packet_buffer.resize(size + AV_INPUT_BUFFER_PADDING_SIZE);
+    std::memcpy(packet_buffer.data(), data, size);
+    std::memset(packet_buffer.data() + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
 
     AVPacket *packet = av_packet_alloc();
-    packet->data = jpeg_buffer.data();
+    packet->data = packet_buffer.data();
     packet->size = size;
     int error = avcodec_send_packet(context, packet);
     av_packet_free(&packet);
@@ -253,17 +278,50 @@ bool MjpegDecoderState::send(const uint8_t *data, uint32_t size) {
     return true;
 }
 
-bool MjpegDecoderState::receive(uint8_t *data, DecoderSize *size) {
+AVFrame *MjpegDecoderState::receive_frame() {
     AVFrame *frame = av_frame_alloc();
     int error = avcodec_receive_frame(context, frame);
     if (error < 0) {
         LOG_WARN("Error receiving Mjpeg frame: {}.", codec_error_name(error));
         av_frame_free(&frame);
-        return false;
+        return nullptr;
+    }
+
+    switch (frame->format) {
+    case AV_PIX_FMT_GRAY8:
+        this->color_space_out = COLORSPACE_GRAYSCALE;
+        break;
+    case AV_PIX_FMT_YUVJ444P:
+        this->color_space_out = COLORSPACE_YUV444P;
+        break;
+    case AV_PIX_FMT_YUVJ422P:
+        this->color_space_out = COLORSPACE_YUV422P;
+        break;
+    case AV_PIX_FMT_YUVJ420P:
+        this->color_space_out = COLORSPACE_YUV420P;
+        break;
+    default:
+        LOG_WARN("Mjpeg frame is in unimplemented format {}.", frame->format);
+        av_frame_free(&frame);
+        return nullptr;
     }
 
+    return frame;
+}
+
+bool MjpegDecoderState::receive(uint8_t *data, DecoderSize *size) {
+    AVFrame *frame = receive_frame();
+    if (!frame)
+        return false;
+
     if (data) {
         switch (frame->format) {
+        case AV_PIX_FMT_GRAY8: {
+            for (int b = 0; b < frame->height; b++) {
+                std::memcpy(&data[b * frame->width], &frame->data[0][b * frame->linesize[0]], frame->width);
+            }
+            break;
+        }
         case AV_PIX_FMT_YUVJ444P: {
             uint8_t *channels[] = {
                 &data[0], // y
@@ -312,22 +370,29 @@ bool MjpegDecoderState::receive(uint8_t *data, DecoderSize *size) {
         }
     }
 
-    switch (frame->format) {
-    case AV_PIX_FMT_YUVJ444P:
-        this->color_space_out = COLORSPACE_YUV444P;
-        break;
-    case AV_PIX_FMT_YUVJ422P:
-        this->color_space_out = COLORSPACE_YUV422P;
-        break;
-    case AV_PIX_FMT_YUVJ420P:
-        this->color_space_out = COLORSPACE_YUV420P;
-        break;
-    default:
-        LOG_WARN("Mjpeg frame is in unimplemented format {}.", frame->format);
-        av_frame_free(&frame);
-        return false;
+    if (size) {
+        size->width = frame->width;
+        size->height = frame->height;
     }
 
+    av_frame_free(&frame);
+
+    return true;
+}
+
+bool MjpegDecoderState::receive_rgba(uint8_t *rgba, DecoderSize *size, bool bt601, bool bgra) {
+    AVFrame *frame = receive_frame();
+    if (!frame)
+        return false;
+
+    const uint8_t *planes[] = { frame->data[0], frame->data[1], frame->data[2] };
+    const uint32_t strides[] = {
+        static_cast<uint32_t>(frame->linesize[0]),
+        static_cast<uint32_t>(frame->linesize[1]),
+        static_cast<uint32_t>(frame->linesize[2]),
+    };
+    convert_ycbcr_to_rgba(planes, strides, rgba, frame->width, frame->width, frame->height, color_space_out, bt601, bgra);
+
     if (size) {
         size->width = frame->width;
         size->height = frame->height;
@@ -338,6 +403,10 @@ bool MjpegDecoderState::receive(uint8_t *data, DecoderSize *size) {
     return true;
 }
 
+void MjpegDecoderState::set_downscale(uint32_t lowres) {
+    context->lowres = static_cast<int>(lowres);
+}
+
 DecoderColorSpace MjpegDecoderState::get_color_space() {
     return this->color_space_out;
 }
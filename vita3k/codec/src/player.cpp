@@ -25,71 +25,222 @@ extern "C" {
 #include <libavformat/avformat.h>
 }
 
-#include <cassert>
-#include <chrono>
+#include <algorithm>
+
+// Size of the buffer filled by each read of the title file functions
+static constexpr int READ_AHEAD_SIZE = 256 * 1024;
+
+// Number of decoded video frames the decode thread stays ahead of the caller
+static constexpr size_t MAX_VIDEO_FRAMES = 4;
+// Audio is only bounded by the video when there is one, this limit drops the audio of a title that never reads it
+static constexpr size_t MAX_AUDIO_FRAMES = 64;
+
+static int read_reader(void *opaque, uint8_t *buf, int buf_size) {
+    PlayerState *player = static_cast<PlayerState *>(opaque);
+    const uint64_t file_size = player->reader->size();
+    if (player->reader_position >= file_size)
+        return AVERROR_EOF;
+
+    const uint32_t size = static_cast<uint32_t>(std::min<uint64_t>(buf_size, file_size - player->reader_position));
+    const int32_t read = player->read_source(buf, size);
+    if (read < 0)
+        return AVERROR(EIO);
+    if (read == 0)
+        return AVERROR_EOF;
+
+    player->reader_position += read;
+    return read;
+}
 
-uint64_t PlayerState::get_framerate_microseconds() {
-    AVRational rational = format->streams[video_stream_id]->avg_frame_rate;
-    return 1000000ull * rational.den / rational.num;
+static int64_t seek_reader(void *opaque, int64_t offset, int whence) {
+    PlayerState *player = static_cast<PlayerState *>(opaque);
+    const int64_t file_size = static_cast<int64_t>(player->reader->size());
+
+    int64_t position;
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+        return file_size;
+    case SEEK_SET:
+        position = offset;
+        break;
+    case SEEK_CUR:
+        position = static_cast<int64_t>(player->reader_position) + offset;
+        break;
+    case SEEK_END:
+        position = file_size + offset;
+        break;
+    default:
+        return -1;
+    }
+
+    if (position < 0)
+        return -1;
+
+    player->reader_position = position;
+    return position;
 }
 
-DecoderSize PlayerState::get_size() {
-    if (video_context)
-        return { { static_cast<uint32_t>(video_context->width), static_cast<uint32_t>(video_context->height) } };
+static std::vector<uint8_t> take_buffer(std::vector<std::vector<uint8_t>> &pool) {
+    if (pool.empty())
+        return {};
 
-    return {};
+    std::vector<uint8_t> buffer = std::move(pool.back());
+    pool.pop_back();
+    return buffer;
 }
 
-void PlayerState::pop_video() {
-    switch_video(videos_queue.front());
-    videos_queue.pop();
+static void recycle_buffer(std::vector<std::vector<uint8_t>> &pool, std::vector<uint8_t> &&buffer) {
+    // A few more than the queue size, for the frames held by the caller
+    if ((buffer.capacity() > 0) && (pool.size() < MAX_VIDEO_FRAMES + 2))
+        pool.push_back(std::move(buffer));
 }
 
-void PlayerState::free_video() {
-    if (video_context)
-        avcodec_free_context(&video_context);
+int32_t PlayerState::request_read(bool open, uint8_t *data, uint32_t size) {
+    std::unique_lock<std::mutex> lock(mutex);
+    read_open = open;
+    read_data = data;
+    read_offset = reader_position;
+    read_size = size;
+    read_pending = true;
+    read_done = false;
+    cond.notify_all();
+    cond.wait(lock, [&] { return read_done || stop_decoding; });
+
+    if (!read_done) {
+        read_pending = false;
+        return -1;
+    }
 
-    if (audio_context)
-        avcodec_free_context(&audio_context);
+    return read_result;
+}
 
-    if (format)
-        avformat_close_input(&format);
+bool PlayerState::open_source() {
+    // The reader may only be usable from the caller thread, the decode thread asks it to open the file
+    if (std::this_thread::get_id() != decode_thread_id)
+        return reader->open();
 
-    while (!video_packets.empty()) {
-        AVPacket *packet = video_packets.front();
-        av_packet_free(&packet);
-        video_packets.pop();
-    }
+    return request_read(true, nullptr, 0) >= 0;
+}
+
+int32_t PlayerState::read_source(uint8_t *data, uint32_t size) {
+    if (std::this_thread::get_id() != decode_thread_id)
+        return reader->read(data, reader_position, size);
+
+    return request_read(false, data, size);
+}
 
-    while (!audio_packets.empty()) {
-        AVPacket *packet = audio_packets.front();
-        av_packet_free(&packet);
-        audio_packets.pop();
+void PlayerState::serve_read() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!retired_readers.empty()) {
+        // Closing a file runs the title functions, it must be done before the next one is opened and without the mutex
+        std::vector<std::shared_ptr<PlayerReader>> retired;
+        retired.swap(retired_readers);
+        lock.unlock();
+        retired.clear();
+        lock.lock();
     }
 
-    video_playing.clear();
+    if (!read_pending)
+        return;
+
+    read_pending = false;
+    const bool open = read_open;
+    uint8_t *const data = read_data;
+    const uint64_t offset = read_offset;
+    const uint32_t size = read_size;
+    const std::shared_ptr<PlayerReader> source_reader = reader;
+
+    // The decode thread waits for the result, the reader is not modified until then
+    lock.unlock();
+    const int32_t result = open ? (source_reader->open() ? 0 : -1) : source_reader->read(data, offset, size);
+    lock.lock();
+
+    read_result = result;
+    read_done = true;
+    cond.notify_all();
 }
 
-void PlayerState::switch_video(const std::string &path) {
-    free_video();
-    video_playing = path;
+DecoderSize PlayerState::get_size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return video_size;
+}
+
+uint64_t PlayerState::get_framerate_microseconds() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return framerate_microseconds;
+}
+
+PlayerStreamInfo PlayerState::get_stream_info() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return { last_timestamp, last_channels, last_sample_rate, last_sample_count };
+}
+
+bool PlayerState::is_playing() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !video_playing.empty();
+}
+
+bool PlayerState::has_queued_videos() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !videos_queue.empty();
+}
+
+void PlayerState::pop_video() {
+    PlayerSource source;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (videos_queue.empty())
+            return;
+        source = videos_queue.front();
+        videos_queue.pop();
+    }
+    switch_video(source);
+}
+
+bool PlayerState::open_media(const PlayerSource &source) {
+    if (source.reader) {
+        // FFmpeg pulls the data from the title on demand, only the read ahead buffer is kept in memory
+        reader = source.reader;
+        reader_position = 0;
+        if (!open_source()) {
+            LOG_ERROR("Failed to open video: {}", source.path);
+            return false;
+        }
+
+        uint8_t *buffer = static_cast<uint8_t *>(av_malloc(READ_AHEAD_SIZE));
+        io = avio_alloc_context(buffer, READ_AHEAD_SIZE, 0, this, read_reader, nullptr, seek_reader);
+        format = avformat_alloc_context();
+        format->pb = io;
+        format->flags |= AVFMT_FLAG_CUSTOM_IO;
+    }
 
-    int error = avformat_open_input(&format, path.c_str(), nullptr, nullptr);
-    assert(error == 0);
+    if (avformat_open_input(&format, source.path.c_str(), nullptr, nullptr) != 0) {
+        LOG_ERROR("Failed to open video: {}", source.path);
+        return false;
+    }
 
     // Load stream info.
-    error = avformat_find_stream_info(format, nullptr);
-    assert(error >= 0);
+    if (avformat_find_stream_info(format, nullptr) < 0) {
+        LOG_ERROR("Failed to find the streams of video: {}", source.path);
+        return false;
+    }
 
     video_stream_id = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
     audio_stream_id = av_find_best_stream(format, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
 
+    DecoderSize size = {};
+    uint64_t framerate = 0;
     if (video_stream_id >= 0) {
         AVStream *video_stream = format->streams[video_stream_id];
         const AVCodec *video_codec = avcodec_find_decoder(video_stream->codecpar->codec_id);
         video_context = avcodec_alloc_context3(video_codec);
         avcodec_parameters_to_context(video_context, video_stream->codecpar);
         avcodec_open2(video_context, video_codec, nullptr);
+
+        size = { { static_cast<uint32_t>(video_context->width), static_cast<uint32_t>(video_context->height) } };
+        const AVRational rational = video_stream->avg_frame_rate;
+        if (rational.num > 0)
+            framerate = 1000000ull * rational.den / rational.num;
     }
 
     if (audio_stream_id >= 0) {
@@ -99,152 +250,270 @@ void PlayerState::switch_video(const std::string &path) {
         avcodec_parameters_to_context(audio_context, audio_stream->codecpar);
         avcodec_open2(audio_context, audio_codec, nullptr);
     }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    video_playing = source.path;
+    video_size = size;
+    framerate_microseconds = framerate;
+    if (audio_context) {
+        // The stream info is known without decoding, the sample count is updated with the first frame
+        last_channels = audio_context->ch_layout.nb_channels;
+        last_sample_rate = audio_context->sample_rate;
+        last_sample_count = audio_context->frame_size;
+    }
+
+    return true;
 }
 
-bool PlayerState::next_packet(int32_t stream_id) {
-    std::queue<AVPacket *> &this_queue = stream_id == video_stream_id ? video_packets : audio_packets;
-    std::queue<AVPacket *> &other_queue = stream_id != video_stream_id ? video_packets : audio_packets;
+void PlayerState::close_media() {
+    if (video_context)
+        avcodec_free_context(&video_context);
 
-    while (true) {
-        if (!this_queue.empty()) {
-            AVPacket *this_packet = this_queue.front();
-            this_queue.pop();
+    if (audio_context)
+        avcodec_free_context(&audio_context);
 
-            if (stream_id == video_stream_id) {
-                int err = avcodec_send_packet(video_context, this_packet);
-                assert(err == 0);
-            }
+    if (format)
+        avformat_close_input(&format);
 
-            if (stream_id == audio_stream_id) {
-                int err = avcodec_send_packet(audio_context, this_packet);
-                assert(err == 0);
-            }
+    // The custom IO is not freed with the format
+    if (io) {
+        av_freep(&io->buffer);
+        avio_context_free(&io);
+    }
 
-            av_packet_free(&this_packet);
-            return true;
-        }
+    video_stream_id = -1;
+    audio_stream_id = -1;
 
-        AVPacket *packet = av_packet_alloc();
-        if (av_read_frame(format, packet) != 0)
-            return false;
+    if (reader) {
+        std::lock_guard<std::mutex> lock(mutex);
+        retired_readers.push_back(std::move(reader));
+    }
+}
 
-        if (packet->stream_index == stream_id) {
-            this_queue.push(packet);
+void PlayerState::decode_packet(int32_t stream_id, AVPacket *packet, AVFrame *frame) {
+    const bool is_video = stream_id == video_stream_id;
+    AVCodecContext *context = is_video ? video_context : audio_context;
+    if (!context || (!is_video && (stream_id != audio_stream_id)))
+        return;
+
+    // A null packet drains the decoder
+    if (avcodec_send_packet(context, packet) < 0)
+        return;
+
+    while (avcodec_receive_frame(context, frame) == 0) {
+        PlayerFrame decoded;
+        if (is_video) {
+            std::unique_lock<std::mutex> lock(mutex);
+            decoded.data = take_buffer(free_video_buffers);
+            lock.unlock();
+
+            decoded.timestamp = frame->best_effort_timestamp;
+            decoded.data.resize(H264DecoderState::buffer_size({ { static_cast<uint32_t>(frame->width), static_cast<uint32_t>(frame->height) } }));
+            copy_yuv_data_from_frame(frame, decoded.data.data(), frame->width, frame->height, false);
+
+            lock.lock();
+            video_frames.push_back(std::move(decoded));
         } else {
-            other_queue.push(packet);
+            LOG_WARN_IF(frame->format != AV_SAMPLE_FMT_FLTP, "Unknown audio format {}.", frame->format);
+
+            std::unique_lock<std::mutex> lock(mutex);
+            decoded.data = take_buffer(free_audio_buffers);
+            lock.unlock();
+
+            const int channels = frame->ch_layout.nb_channels;
+            decoded.timestamp = frame->best_effort_timestamp;
+            decoded.channels = channels;
+            decoded.sample_rate = frame->sample_rate;
+            decoded.sample_count = frame->nb_samples;
+            decoded.data.resize(frame->nb_samples * channels * sizeof(int16_t));
+
+            int16_t *samples = reinterpret_cast<int16_t *>(decoded.data.data());
+            for (int b = 0; b < channels; b++) {
+                const float *frame_data = reinterpret_cast<const float *>(frame->data[b]);
+                for (int a = 0; a < frame->nb_samples; a++)
+                    samples[a * channels + b] = static_cast<int16_t>(frame_data[a] * INT16_MAX);
+            }
+
+            lock.lock();
+            // Only happens when the title does not read the audio, do not keep it forever
+            if ((video_stream_id >= 0) && (audio_frames.size() >= MAX_AUDIO_FRAMES)) {
+                recycle_buffer(free_audio_buffers, std::move(audio_frames.front().data));
+                audio_frames.pop_front();
+            }
+            audio_frames.push_back(std::move(decoded));
         }
+        cond.notify_all();
     }
 }
 
-std::vector<int16_t> PlayerState::receive_audio() {
-    if (audio_stream_id < 0)
-        return {};
-
-    if (video_playing.empty())
-        return {};
-
+void PlayerState::decode_loop() {
+    decode_thread_id = std::this_thread::get_id();
+    AVPacket *packet = av_packet_alloc();
     AVFrame *frame = av_frame_alloc();
-    std::vector<int16_t> data;
+
     while (true) {
-        int error = avcodec_receive_frame(audio_context, frame);
+        {
+            // The video queue paces the decoding, or the audio queue when there is no video
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&] {
+                if (stop_decoding)
+                    return true;
+                if (video_stream_id >= 0)
+                    return video_frames.size() < MAX_VIDEO_FRAMES;
+                return audio_frames.size() < MAX_AUDIO_FRAMES;
+            });
+            if (stop_decoding)
+                break;
+        }
 
-        if (error == AVERROR(EAGAIN) && next_packet(audio_stream_id))
+        if (av_read_frame(format, packet) == 0) {
+            decode_packet(packet->stream_index, packet, frame);
+            av_packet_unref(packet);
             continue;
+        }
 
-        if (error != 0) {
-            if (videos_queue.empty()) {
-                // Stop playing videos or
-                video_playing.clear();
+        // End of the video, get the last frames out of the decoders
+        decode_packet(video_stream_id, nullptr, frame);
+        decode_packet(audio_stream_id, nullptr, frame);
+
+        // Play the next video (if there is any).
+        PlayerSource next;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            decode_ended = true;
+            cond.notify_all();
+            cond.wait(lock, [&] { return stop_decoding || !videos_queue.empty(); });
+            if (stop_decoding)
                 break;
-            } else {
-                // Play the next video (if there is any).
-                switch_video(videos_queue.front());
-                videos_queue.pop();
-                continue;
-            }
-        }
 
-        LOG_WARN_IF(frame->format != AV_SAMPLE_FMT_FLTP, "Unknown audio format {}.", frame->format);
+            next = videos_queue.front();
+            videos_queue.pop();
+            decode_ended = false;
+        }
 
-        last_channels = frame->ch_layout.nb_channels;
-        last_sample_count = frame->nb_samples;
-        last_sample_rate = frame->sample_rate;
+        close_media();
+        if (!open_media(next)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            decode_ended = true;
+            cond.notify_all();
+            break;
+        }
+    }
 
-        data.resize(frame->nb_samples * frame->ch_layout.nb_channels);
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+}
 
-        for (int a = 0; a < frame->nb_samples; a++) {
-            for (int b = 0; b < frame->ch_layout.nb_channels; b++) {
-                auto *frame_data = reinterpret_cast<float *>(frame->data[b]);
-                float current_sample = frame_data[a];
-                int16_t pcm_sample = current_sample * INT16_MAX;
+void PlayerState::free_video() {
+    std::vector<std::shared_ptr<PlayerReader>> retired;
 
-                data[a * frame->ch_layout.nb_channels + b] = pcm_sample;
-            }
+    if (decode_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop_decoding = true;
         }
-
-        break;
+        cond.notify_all();
+        decode_thread.join();
+        decode_thread_id = {};
     }
 
-    av_frame_free(&frame);
-    return data;
+    close_media();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &frame : video_frames)
+        recycle_buffer(free_video_buffers, std::move(frame.data));
+    video_frames.clear();
+    for (auto &frame : audio_frames)
+        recycle_buffer(free_audio_buffers, std::move(frame.data));
+    audio_frames.clear();
+
+    retired.swap(retired_readers);
+    read_pending = false;
+    stop_decoding = false;
+    decode_ended = false;
+    video_size = {};
+    framerate_microseconds = 0;
+    video_playing.clear();
 }
 
-std::vector<uint8_t> PlayerState::receive_video() {
-    if (video_stream_id < 0)
-        return {};
+void PlayerState::switch_video(const PlayerSource &source) {
+    free_video();
 
-    if (video_playing.empty())
-        return {};
+    // The file is opened on the caller thread, the decode thread only starts once it is ready
+    if (!open_media(source)) {
+        free_video();
+        return;
+    }
 
-    AVFrame *frame = av_frame_alloc();
-    std::vector<uint8_t> data;
-    while (true) {
-        int error = avcodec_receive_frame(video_context, frame);
+    decode_thread = std::thread(&PlayerState::decode_loop, this);
+}
 
-        if (error == AVERROR(EAGAIN) && next_packet(video_stream_id))
-            continue;
+bool PlayerState::receive_audio(PlayerFrame &frame) {
+    serve_read();
 
-        if (error != 0) {
-            if (videos_queue.empty()) {
-                // Stop playing videos or
-                video_playing.clear();
-                break;
-            } else {
-                // Play the next video (if there is any).
-                switch_video(videos_queue.front());
-                videos_queue.pop();
-                continue;
-            }
-        }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (audio_frames.empty()) {
+        // Stop playing once everything decoded was given
+        if (decode_ended && video_frames.empty())
+            video_playing.clear();
+        return false;
+    }
 
-        last_timestamp = frame->best_effort_timestamp;
+    recycle_buffer(free_audio_buffers, std::move(frame.data));
+    frame = std::move(audio_frames.front());
+    audio_frames.pop_front();
+    cond.notify_all();
 
-        data.resize(H264DecoderState::buffer_size(
-            { { static_cast<uint32_t>(video_context->width), static_cast<uint32_t>(video_context->height) } }));
-        copy_yuv_data_from_frame(frame, data.data(), frame->width, frame->height, false);
+    last_channels = frame.channels;
+    last_sample_rate = frame.sample_rate;
+    last_sample_count = frame.sample_count;
+    return true;
+}
 
-        break;
+bool PlayerState::receive_video(PlayerFrame &frame) {
+    serve_read();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (video_frames.empty()) {
+        // Stop playing once everything decoded was given
+        if (decode_ended && audio_frames.empty())
+            video_playing.clear();
+        return false;
     }
 
-    av_frame_free(&frame);
-    return data;
+    recycle_buffer(free_video_buffers, std::move(frame.data));
+    frame = std::move(video_frames.front());
+    video_frames.pop_front();
+    cond.notify_all();
+
+    last_timestamp = frame.timestamp;
+    return true;
 }
 
 void PlayerState::queue(const std::string &path) {
     if (fs::exists(path)) {
-        LOG_INFO("Queued video: '{}'.", path);
-        if (video_playing.empty())
-            switch_video(path);
-        else
-            videos_queue.push(path);
+        queue(PlayerSource{ path, nullptr });
     } else {
         LOG_INFO("Cannot find video: {}", path);
     }
 }
 
+void PlayerState::queue(const PlayerSource &source) {
+    LOG_INFO("Queued video: '{}'.", source.path);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!video_playing.empty()) {
+            videos_queue.push(source);
+            cond.notify_all();
+            return;
+        }
+    }
+
+    switch_video(source);
+}
+
 PlayerState::~PlayerState() {
     free_video();
 
-    video_playing.clear();
     videos_queue = {};
 }
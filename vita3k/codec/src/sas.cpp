@@ -0,0 +1,694 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <codec/sas.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// VAG ADPCM prediction filters, in 1/64 units
+static constexpr int32_t vag_filters[5][2] = {
+    { 0, 0 },
+    { 60, 0 },
+    { 115, -52 },
+    { 98, -55 },
+    { 122, -60 },
+};
+
+static constexpr uint32_t VAG_BLOCK_SIZE = 16;
+static constexpr uint32_t VAG_BLOCK_SAMPLES = 28;
+
+enum VagFlag : uint8_t {
+    VAG_FLAG_LOOP_END = 1,
+    VAG_FLAG_LOOP_REPEAT = 2,
+    VAG_FLAG_LOOP_START = 4,
+    // the whole block is a terminator without samples
+    VAG_FLAG_END_OF_DATA = 7,
+};
+
+// Below this height the envelope is inaudible on 16-bit output
+static constexpr int32_t ENVELOPE_HEIGHT_SILENT = 0x8000;
+
+static constexpr float SAMPLE_MAX = 32767.0f;
+
+static void accumulate_scalar(float *dest, const float *source, float scale, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++)
+        dest[i] += source[i] * scale;
+}
+
+static void multiply_scalar(float *data, const float *gains, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++)
+        data[i] *= gains[i];
+}
+
+// Linear interpolation between the two source samples around each position, in 1/4096 of a sample
+static void interpolate_scalar(float *out, const int16_t *src, uint32_t position, uint32_t pitch, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++, position += pitch) {
+        const uint32_t index = position >> 12;
+        const float fraction = static_cast<float>(position & 0xFFF) * (1.0f / 4096.0f);
+        out[i] = src[index] + (src[index + 1] - src[index]) * fraction;
+    }
+}
+
+static void store_stereo_scalar(const float *left, const float *right, int16_t *out, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        out[i * 2] = static_cast<int16_t>(std::lrint(std::clamp(left[i], -SAMPLE_MAX - 1.0f, SAMPLE_MAX)));
+        out[i * 2 + 1] = static_cast<int16_t>(std::lrint(std::clamp(right[i], -SAMPLE_MAX - 1.0f, SAMPLE_MAX)));
+    }
+}
+
+#if defined(__aarch64__)
+static void accumulate(float *dest, const float *source, float scale, uint32_t count) {
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32(dest + i, vfmaq_n_f32(vld1q_f32(dest + i), vld1q_f32(source + i), scale));
+
+    accumulate_scalar(dest + i, source + i, scale, count - i);
+}
+
+static void multiply(float *data, const float *gains, uint32_t count) {
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32(data + i, vmulq_f32(vld1q_f32(data + i), vld1q_f32(gains + i)));
+
+    multiply_scalar(data + i, gains + i, count - i);
+}
+
+// The source samples are gathered one by one, the fractions and the blend are done four at a time
+static void interpolate(float *out, const int16_t *src, uint32_t position, uint32_t pitch, uint32_t count) {
+    const uint32_t steps[4] = { 0, pitch, pitch * 2, pitch * 3 };
+    const uint32x4_t step = vld1q_u32(steps);
+    const uint32x4_t fraction_mask = vdupq_n_u32(0xFFF);
+
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4, position += pitch * 4) {
+        const uint32x4_t positions = vaddq_u32(vdupq_n_u32(position), step);
+        const float32x4_t fraction = vmulq_n_f32(vcvtq_f32_u32(vandq_u32(positions, fraction_mask)), 1.0f / 4096.0f);
+
+        float low[4];
+        float high[4];
+        for (uint32_t j = 0; j < 4; j++) {
+            const uint32_t index = (position + steps[j]) >> 12;
+            low[j] = src[index];
+            high[j] = src[index + 1];
+        }
+
+        const float32x4_t a = vld1q_f32(low);
+        vst1q_f32(out + i, vfmaq_f32(a, vsubq_f32(vld1q_f32(high), a), fraction));
+    }
+
+    interpolate_scalar(out + i, src, position, pitch, count - i);
+}
+
+static void store_stereo(const float *left, const float *right, int16_t *out, uint32_t count) {
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // round to nearest then narrow with saturation
+        int16x4x2_t samples;
+        samples.val[0] = vqmovn_s32(vcvtnq_s32_f32(vld1q_f32(left + i)));
+        samples.val[1] = vqmovn_s32(vcvtnq_s32_f32(vld1q_f32(right + i)));
+        vst2_s16(out + i * 2, samples);
+    }
+
+    store_stereo_scalar(left + i, right + i, out + i * 2, count - i);
+}
+#elif defined(__x86_64__) || defined(_M_X64)
+static void accumulate(float *dest, const float *source, float scale, uint32_t count) {
+    const __m128 scale_vec = _mm_set1_ps(scale);
+
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(dest + i, _mm_add_ps(_mm_loadu_ps(dest + i), _mm_mul_ps(_mm_loadu_ps(source + i), scale_vec)));
+
+    accumulate_scalar(dest + i, source + i, scale, count - i);
+}
+
+static void multiply(float *data, const float *gains, uint32_t count) {
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), _mm_loadu_ps(gains + i)));
+
+    multiply_scalar(data + i, gains + i, count - i);
+}
+
+// The source samples are gathered one by one, the fractions and the blend are done four at a time
+static void interpolate(float *out, const int16_t *src, uint32_t position, uint32_t pitch, uint32_t count) {
+    const __m128i step = _mm_setr_epi32(0, pitch, pitch * 2, pitch * 3);
+    const __m128i fraction_mask = _mm_set1_epi32(0xFFF);
+    const __m128 fraction_scale = _mm_set1_ps(1.0f / 4096.0f);
+
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4, position += pitch * 4) {
+        const __m128i positions = _mm_add_epi32(_mm_set1_epi32(position), step);
+        const __m128 fraction = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(positions, fraction_mask)), fraction_scale);
+
+        const uint32_t i0 = position >> 12;
+        const uint32_t i1 = (position + pitch) >> 12;
+        const uint32_t i2 = (position + pitch * 2) >> 12;
+        const uint32_t i3 = (position + pitch * 3) >> 12;
+        const __m128 a = _mm_setr_ps(src[i0], src[i1], src[i2], src[i3]);
+        const __m128 b = _mm_setr_ps(src[i0 + 1], src[i1 + 1], src[i2 + 1], src[i3 + 1]);
+        _mm_storeu_ps(out + i, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), fraction)));
+    }
+
+    interpolate_scalar(out + i, src, position, pitch, count - i);
+}
+
+static void store_stereo(const float *left, const float *right, int16_t *out, uint32_t count) {
+    // out of range conversions give INT_MIN, so clamp before converting
+    const __m128 low = _mm_set1_ps(-SAMPLE_MAX - 1.0f);
+    const __m128 high = _mm_set1_ps(SAMPLE_MAX);
+
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i l = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(left + i), low), high));
+        const __m128i r = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(right + i), low), high));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 2), _mm_packs_epi32(_mm_unpacklo_epi32(l, r), _mm_unpackhi_epi32(l, r)));
+    }
+
+    store_stereo_scalar(left + i, right + i, out + i * 2, count - i);
+}
+#else
+static void accumulate(float *dest, const float *source, float scale, uint32_t count) {
+    accumulate_scalar(dest, source, scale, count);
+}
+
+static void multiply(float *data, const float *gains, uint32_t count) {
+    multiply_scalar(data, gains, count);
+}
+
+static void interpolate(float *out, const int16_t *src, uint32_t position, uint32_t pitch, uint32_t count) {
+    interpolate_scalar(out, src, position, pitch, count);
+}
+
+static void store_stereo(const float *left, const float *right, int16_t *out, uint32_t count) {
+    store_stereo_scalar(left, right, out, count);
+}
+#endif
+
+static float peak_of(const float *data, uint32_t count) {
+    float peak = 0.0f;
+    for (uint32_t i = 0; i < count; i++)
+        peak = std::max(peak, std::abs(data[i]));
+
+    return peak;
+}
+
+static float to_gain(int32_t volume) {
+    return static_cast<float>(volume) / SAS_VOLUME_MAX;
+}
+
+// Rates of the packed registers, the same encoding as the SPU
+static int32_t simple_rate(uint32_t value) {
+    value &= 0x7F;
+    if (value == 0x7F)
+        return 0;
+
+    const int32_t rate = static_cast<int32_t>(((7 - (value & 3)) << 26) >> (value >> 2));
+    return std::max(rate, 1);
+}
+
+static int32_t exponent_rate(uint32_t value) {
+    value &= 0x7F;
+    if (value == 0x7F)
+        return 0;
+
+    const int32_t rate = static_cast<int32_t>(((7 - (value & 3)) << 24) >> (value >> 2));
+    return std::max(rate, 1);
+}
+
+void SasEnvelope::set_simple(uint32_t adsr1, uint32_t adsr2) {
+    attack_curve = (adsr1 & 0x8000) ? SAS_CURVE_LINEAR_BENT : SAS_CURVE_LINEAR_INCREASE;
+    attack_rate = simple_rate(adsr1 >> 8);
+
+    const uint32_t decay_shift = (adsr1 >> 4) & 0xF;
+    decay_curve = SAS_CURVE_EXPONENT_DECREASE;
+    decay_rate = decay_shift == 0 ? 0x7FFFFFFF : static_cast<int32_t>(0x80000000U >> decay_shift);
+
+    sustain_level = static_cast<int32_t>(((adsr1 & 0xF) + 1) << 26);
+
+    switch (adsr2 >> 13) {
+    case 0: sustain_curve = SAS_CURVE_LINEAR_INCREASE; break;
+    case 2: sustain_curve = SAS_CURVE_LINEAR_DECREASE; break;
+    case 4: sustain_curve = SAS_CURVE_LINEAR_BENT; break;
+    default: sustain_curve = SAS_CURVE_EXPONENT_DECREASE; break;
+    }
+    sustain_rate = sustain_curve == SAS_CURVE_EXPONENT_DECREASE ? exponent_rate(adsr2 >> 6) : simple_rate(adsr2 >> 6);
+
+    const uint32_t release_shift = adsr2 & 0x1F;
+    if (adsr2 & 0x20) {
+        release_curve = SAS_CURVE_EXPONENT_DECREASE;
+        release_rate = release_shift == 0 ? 0x7FFFFFFF : static_cast<int32_t>(0x80000000U >> release_shift);
+    } else {
+        release_curve = SAS_CURVE_LINEAR_DECREASE;
+        if (release_shift == 31)
+            release_rate = 0;
+        else if (release_shift == 30)
+            release_rate = 0x40000000;
+        else if (release_shift == 29)
+            release_rate = 1;
+        else
+            release_rate = 0x10000000 >> release_shift;
+    }
+}
+
+void SasEnvelope::key_on() {
+    phase = Phase::Attack;
+    height = 0;
+}
+
+void SasEnvelope::key_off() {
+    if (phase != Phase::Off)
+        phase = Phase::Release;
+}
+
+static int32_t advance_height(int32_t height, SasEnvelopeCurve curve, int32_t rate) {
+    int64_t result = height;
+
+    switch (curve) {
+    case SAS_CURVE_LINEAR_INCREASE:
+        result += rate;
+        break;
+    case SAS_CURVE_LINEAR_DECREASE:
+        result -= rate;
+        break;
+    case SAS_CURVE_LINEAR_BENT:
+        // slows down in the last quarter
+        result += result < (SAS_ENVELOPE_HEIGHT_MAX / 4) * 3 ? rate : rate / 4;
+        break;
+    case SAS_CURVE_EXPONENT_DECREASE:
+        result -= (result * rate) >> 31;
+        if (rate != 0 && result < ENVELOPE_HEIGHT_SILENT)
+            result = 0;
+        break;
+    case SAS_CURVE_EXPONENT_INCREASE:
+        result += ((SAS_ENVELOPE_HEIGHT_MAX - result) * rate) >> 31;
+        if (rate != 0 && SAS_ENVELOPE_HEIGHT_MAX - result < ENVELOPE_HEIGHT_SILENT)
+            result = SAS_ENVELOPE_HEIGHT_MAX;
+        break;
+    case SAS_CURVE_DIRECT:
+        result = rate;
+        break;
+    }
+
+    return static_cast<int32_t>(std::clamp<int64_t>(result, 0, SAS_ENVELOPE_HEIGHT_MAX));
+}
+
+void SasEnvelope::step() {
+    switch (phase) {
+    case Phase::Attack:
+        height = advance_height(height, attack_curve, attack_rate);
+        if (height >= SAS_ENVELOPE_HEIGHT_MAX || attack_curve == SAS_CURVE_DIRECT)
+            phase = Phase::Decay;
+        break;
+    case Phase::Decay:
+        height = advance_height(height, decay_curve, decay_rate);
+        if (height <= sustain_level || decay_curve == SAS_CURVE_DIRECT) {
+            // the decay stops at the sustain level even when a fast rate steps past it
+            height = decay_curve == SAS_CURVE_DIRECT ? height : sustain_level;
+            phase = Phase::Sustain;
+        }
+        break;
+    case Phase::Sustain:
+        height = advance_height(height, sustain_curve, sustain_rate);
+        if (height == 0)
+            phase = Phase::Off;
+        break;
+    case Phase::Release:
+        height = advance_height(height, release_curve, release_rate);
+        if (height == 0 || release_curve == SAS_CURVE_DIRECT) {
+            height = 0;
+            phase = Phase::Off;
+        }
+        break;
+    case Phase::Off:
+        break;
+    }
+}
+
+void SasVoice::key_on() {
+    playing = true;
+    paused = false;
+    ended = false;
+
+    position = 0;
+    source_ended = false;
+    history[0] = 0;
+    history[1] = 0;
+    block_index = VAG_BLOCK_SAMPLES;
+    noise_counter = 0;
+    noise_level = 1;
+    pitch_fraction = 0;
+    dry_peak = 0;
+    wet_peak = 0;
+
+    envelope.key_on();
+    fetch(carry, 2);
+}
+
+void SasVoice::key_off() {
+    envelope.key_off();
+}
+
+// Decode the next block in the voice block buffer, return false once there is no more data
+static bool decode_vag_block(SasVoice &voice) {
+    // at most one jump, so a loop on a terminator block cannot spin forever
+    bool jumped = false;
+    while (true) {
+        if (voice.source_ended)
+            return false;
+
+        const bool data_end = voice.position + VAG_BLOCK_SIZE > voice.size
+            || voice.data[voice.position + 1] == VAG_FLAG_END_OF_DATA;
+        if (!data_end)
+            break;
+
+        if (!voice.loop || jumped) {
+            voice.source_ended = true;
+            return false;
+        }
+
+        voice.position = voice.loop_start;
+        jumped = true;
+    }
+
+    const uint8_t *block = voice.data + voice.position;
+    const uint8_t flags = block[1];
+    if (flags & VAG_FLAG_LOOP_START)
+        voice.loop_start = voice.position;
+
+    const uint32_t filter = std::min<uint32_t>(block[0] >> 4, 4);
+    uint32_t shift = block[0] & 0xF;
+    // the hardware treats the unused shifts like 9
+    if (shift > 12)
+        shift = 9;
+
+    const int32_t coef0 = vag_filters[filter][0];
+    const int32_t coef1 = vag_filters[filter][1];
+    for (uint32_t i = 0; i < VAG_BLOCK_SAMPLES; i++) {
+        const uint8_t byte = block[2 + i / 2];
+        const int16_t nibble = static_cast<int16_t>(((i & 1) ? (byte & 0xF0) : (byte << 4)) << 8);
+        const int32_t sample = (nibble >> shift) + ((voice.history[0] * coef0 + voice.history[1] * coef1 + 32) >> 6);
+        const int16_t clamped = static_cast<int16_t>(std::clamp(sample, -32768, 32767));
+
+        voice.history[1] = voice.history[0];
+        voice.history[0] = clamped;
+        voice.block[i] = clamped;
+    }
+    voice.block_index = 0;
+
+    voice.position += VAG_BLOCK_SIZE;
+    if (flags & VAG_FLAG_LOOP_END) {
+        if ((flags & VAG_FLAG_LOOP_REPEAT) || voice.loop)
+            voice.position = voice.loop_start;
+        else
+            voice.position = voice.size;
+    }
+
+    return true;
+}
+
+void SasVoice::fetch(int16_t *out, uint32_t count) {
+    uint32_t done = 0;
+
+    switch (type) {
+    case SasVoiceType::Vag:
+        while (done < count) {
+            if (block_index == VAG_BLOCK_SAMPLES && !decode_vag_block(*this))
+                break;
+
+            const uint32_t chunk = std::min(count - done, VAG_BLOCK_SAMPLES - block_index);
+            std::copy_n(&block[block_index], chunk, out + done);
+            block_index += chunk;
+            done += chunk;
+        }
+        break;
+    case SasVoiceType::Pcm: {
+        const int16_t *samples = reinterpret_cast<const int16_t *>(data);
+        while (done < count && !source_ended) {
+            if (position >= size) {
+                if (!loop || loop_start >= size) {
+                    source_ended = true;
+                    break;
+                }
+                position = loop_start;
+            }
+
+            const uint32_t chunk = std::min(count - done, size - position);
+            std::memcpy(out + done, samples + position, chunk * sizeof(int16_t));
+            position += chunk;
+            done += chunk;
+        }
+        break;
+    }
+    case SasVoiceType::Noise:
+        // SPU style noise, the clock selects how often the generator steps
+        for (; done < count; done++) {
+            noise_counter += (4 + (noise_clock & 3)) << (noise_clock >> 2);
+            while (noise_counter >= 0x20000) {
+                noise_counter -= 0x20000;
+                const uint32_t parity = ((noise_level >> 15) ^ (noise_level >> 12) ^ (noise_level >> 11) ^ (noise_level >> 10) ^ 1) & 1;
+                noise_level = (noise_level << 1) | parity;
+            }
+            out[done] = static_cast<int16_t>(noise_level);
+        }
+        break;
+    case SasVoiceType::None:
+        source_ended = true;
+        break;
+    }
+
+    std::fill(out + done, out + count, 0);
+}
+
+void SasCore::init(uint32_t grain, uint32_t voice_count, SasOutputMode output_mode, uint32_t sample_rate) {
+    this->grain = grain;
+    this->voice_count = voice_count;
+    this->output_mode = output_mode;
+    this->sample_rate = sample_rate;
+
+    voices = {};
+    for (SasVoice &voice : voices) {
+        // play the sample as is until the game sets an envelope
+        voice.envelope.attack_rate = 0x7FFFFFFF;
+        voice.envelope.sustain_level = SAS_ENVELOPE_HEIGHT_MAX;
+        voice.envelope.release_rate = 0x1000000;
+    }
+
+    dry_left.assign(SAS_MAX_GRAIN, 0.0f);
+    dry_right.assign(SAS_MAX_GRAIN, 0.0f);
+    wet_left.assign(SAS_MAX_GRAIN, 0.0f);
+    wet_right.assign(SAS_MAX_GRAIN, 0.0f);
+    voice_samples.assign(SAS_MAX_GRAIN, 0.0f);
+    gains.assign(SAS_MAX_GRAIN, 0.0f);
+    // enough source samples for a full grain at the highest pitch, plus the two carried ones
+    source.assign((SAS_MAX_GRAIN * SAS_PITCH_MAX) / SAS_PITCH_BASE + 2, 0);
+
+    set_effect_type(SasEffectType::Off);
+    dry_enabled = true;
+    wet_enabled = false;
+    effect_volume_left = 0;
+    effect_volume_right = 0;
+    premaster_peak = 0;
+}
+
+void SasCore::set_effect_type(SasEffectType type) {
+    effect_type = type;
+
+    // up to one second of delay
+    delay_left.assign(sample_rate, 0.0f);
+    delay_right.assign(sample_rate, 0.0f);
+    delay_position = 0;
+}
+
+void SasCore::render_voice(SasVoice &voice) {
+    if (!voice.playing || voice.paused)
+        return;
+
+    float *samples = voice_samples.data();
+    int16_t *src = source.data();
+
+    if (voice.type == SasVoiceType::Noise) {
+        // noise has its own clock, the pitch does not apply
+        voice.fetch(src, grain);
+        for (uint32_t i = 0; i < grain; i++)
+            samples[i] = src[i];
+    } else {
+        // src[0] and src[1] are the samples around the current position, the new ones follow
+        const uint32_t pitch = static_cast<uint32_t>(voice.pitch);
+        const uint32_t end = voice.pitch_fraction + grain * pitch;
+        const uint32_t consumed = end >> 12;
+
+        src[0] = voice.carry[0];
+        src[1] = voice.carry[1];
+        voice.fetch(src + 2, consumed);
+
+        if (pitch == SAS_PITCH_BASE && voice.pitch_fraction == 0) {
+            for (uint32_t i = 0; i < grain; i++)
+                samples[i] = src[i];
+        } else {
+            interpolate(samples, src, voice.pitch_fraction, pitch, grain);
+        }
+
+        voice.carry[0] = src[consumed];
+        voice.carry[1] = src[consumed + 1];
+        voice.pitch_fraction = end & 0xFFF;
+    }
+
+    // the envelope height becomes a per sample gain
+    for (uint32_t i = 0; i < grain; i++) {
+        voice.envelope.step();
+        gains[i] = static_cast<float>(voice.envelope.height) * (1.0f / SAS_ENVELOPE_HEIGHT_MAX);
+    }
+    multiply(samples, gains.data(), grain);
+
+    if (voice.distortion != 0) {
+        const float drive = 1.0f + 3.0f * to_gain(voice.distortion);
+        for (uint32_t i = 0; i < grain; i++)
+            samples[i] = std::clamp(samples[i] * drive, -SAMPLE_MAX, SAMPLE_MAX);
+    }
+
+    const float peak = peak_of(samples, grain);
+    voice.dry_peak = static_cast<uint32_t>(peak * std::max(std::abs(to_gain(voice.volume_left)), std::abs(to_gain(voice.volume_right))));
+    voice.wet_peak = static_cast<uint32_t>(peak * std::max(std::abs(to_gain(voice.wet_volume_left)), std::abs(to_gain(voice.wet_volume_right))));
+
+    if (voice.volume_left != 0)
+        accumulate(dry_left.data(), samples, to_gain(voice.volume_left), grain);
+    if (voice.volume_right != 0)
+        accumulate(dry_right.data(), samples, to_gain(voice.volume_right), grain);
+    if (voice.wet_volume_left != 0)
+        accumulate(wet_left.data(), samples, to_gain(voice.wet_volume_left), grain);
+    if (voice.wet_volume_right != 0)
+        accumulate(wet_right.data(), samples, to_gain(voice.wet_volume_right), grain);
+
+    if (voice.source_ended || voice.envelope.phase == SasEnvelope::Phase::Off) {
+        voice.playing = false;
+        voice.ended = true;
+        voice.envelope.phase = SasEnvelope::Phase::Off;
+        voice.envelope.height = 0;
+    }
+}
+
+struct EffectPreset {
+    // in ms
+    uint32_t delay;
+    float feedback;
+};
+
+static EffectPreset get_effect_preset(SasEffectType type, uint32_t delay, uint32_t feedback) {
+    switch (type) {
+    case SasEffectType::Room: return { 25, 0.35f };
+    case SasEffectType::StudioSmall: return { 33, 0.4f };
+    case SasEffectType::StudioMedium: return { 50, 0.45f };
+    case SasEffectType::StudioLarge: return { 75, 0.5f };
+    case SasEffectType::Hall: return { 100, 0.6f };
+    case SasEffectType::Space: return { 200, 0.7f };
+    case SasEffectType::Pipe: return { 10, 0.6f };
+    // the game sets the delay and the feedback (both 0-127) for these two
+    case SasEffectType::Echo:
+    case SasEffectType::Delay:
+        return { std::max<uint32_t>(delay * 1000 / 128, 1), static_cast<float>(feedback) / 128.0f };
+    case SasEffectType::Off: break;
+    }
+
+    return { 1, 0.0f };
+}
+
+void SasCore::apply_effect() {
+    if (effect_type == SasEffectType::Off) {
+        std::fill_n(wet_left.begin(), grain, 0.0f);
+        std::fill_n(wet_right.begin(), grain, 0.0f);
+        return;
+    }
+
+    const EffectPreset preset = get_effect_preset(effect_type, effect_delay, effect_feedback);
+    const uint32_t length = std::clamp<uint32_t>(preset.delay * sample_rate / 1000, 1, static_cast<uint32_t>(delay_left.size()));
+    const float volume_left = to_gain(effect_volume_left);
+    const float volume_right = to_gain(effect_volume_right);
+
+    uint32_t position = delay_position % length;
+    for (uint32_t i = 0; i < grain; i++) {
+        const float delayed_left = delay_left[position];
+        const float delayed_right = delay_right[position];
+        delay_left[position] = wet_left[i] + delayed_left * preset.feedback;
+        delay_right[position] = wet_right[i] + delayed_right * preset.feedback;
+
+        wet_left[i] = delayed_left * volume_left;
+        wet_right[i] = delayed_right * volume_right;
+
+        if (++position == length)
+            position = 0;
+    }
+    delay_position = position;
+}
+
+void SasCore::process(int16_t *out, bool mix_in, int32_t mix_volume_left, int32_t mix_volume_right) {
+    std::fill_n(dry_left.begin(), grain, 0.0f);
+    std::fill_n(dry_right.begin(), grain, 0.0f);
+    std::fill_n(wet_left.begin(), grain, 0.0f);
+    std::fill_n(wet_right.begin(), grain, 0.0f);
+
+    for (uint32_t i = 0; i < voice_count; i++)
+        render_voice(voices[i]);
+
+    if (output_mode == SAS_OUTPUT_MULTI) {
+        for (uint32_t i = 0; i < grain; i++) {
+            const float channels[4] = { dry_left[i], dry_right[i], wet_left[i], wet_right[i] };
+            for (uint32_t channel = 0; channel < 4; channel++) {
+                float sample = channels[channel];
+                if (mix_in)
+                    sample += out[i * 4 + channel] * to_gain(channel & 1 ? mix_volume_right : mix_volume_left);
+                out[i * 4 + channel] = static_cast<int16_t>(std::lrint(std::clamp(sample, -SAMPLE_MAX - 1.0f, SAMPLE_MAX)));
+            }
+        }
+
+        premaster_peak = static_cast<uint32_t>(std::max(peak_of(dry_left.data(), grain), peak_of(dry_right.data(), grain)));
+        return;
+    }
+
+    apply_effect();
+
+    // the dry buses become the output
+    if (!dry_enabled) {
+        std::fill_n(dry_left.begin(), grain, 0.0f);
+        std::fill_n(dry_right.begin(), grain, 0.0f);
+    }
+    if (wet_enabled) {
+        accumulate(dry_left.data(), wet_left.data(), 1.0f, grain);
+        accumulate(dry_right.data(), wet_right.data(), 1.0f, grain);
+    }
+
+    premaster_peak = static_cast<uint32_t>(std::max(peak_of(dry_left.data(), grain), peak_of(dry_right.data(), grain)));
+
+    if (mix_in) {
+        const float volume_left = to_gain(mix_volume_left);
+        const float volume_right = to_gain(mix_volume_right);
+        for (uint32_t i = 0; i < grain; i++) {
+            dry_left[i] += out[i * 2] * volume_left;
+            dry_right[i] += out[i * 2 + 1] * volume_right;
+        }
+    }
+
+    store_stereo(dry_left.data(), dry_right.data(), out, grain);
+}
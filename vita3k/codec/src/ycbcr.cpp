@@ -0,0 +1,170 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <codec/state.h>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// Fixed point YCbCr to RGB conversion shared by the scalar and SIMD paths so they give the exact same results.
+// Every term is computed as (value << 7) * coef >> 16, the coefficients being the usual ones scaled by 512.
+// They are kept even so the NEON doubling multiply high gives the same result as the SSE2 multiply high.
+struct CscCoefs {
+    int16_t y_offset;
+    int16_t y;
+    int16_t cr_r;
+    int16_t cb_g;
+    int16_t cr_g;
+    int16_t cb_b;
+};
+
+// Full range, as stored in JFIF files
+static constexpr CscCoefs CSC_JFIF = { 0, 512, 718, 176, 366, 908 };
+// Limited range BT.601
+static constexpr CscCoefs CSC_BT601 = { 16, 596, 818, 200, 416, 1032 };
+
+static int16_t mul_high(int32_t value, int16_t coef) {
+    return static_cast<int16_t>((value * 128 * coef) >> 16);
+}
+
+static uint8_t clamp_u8(int32_t value) {
+    return static_cast<uint8_t>(std::clamp(value, 0, 255));
+}
+
+static void convert_row_scalar(const uint8_t *y, const uint8_t *cb, const uint8_t *cr, uint8_t *out, uint32_t width, const CscCoefs &coefs, bool bgra) {
+    const int r_index = bgra ? 2 : 0;
+    const int b_index = bgra ? 0 : 2;
+    for (uint32_t x = 0; x < width; x++) {
+        const int32_t luma = mul_high(y[x] - coefs.y_offset, coefs.y);
+        const int32_t chroma_b = cb[x] - 128;
+        const int32_t chroma_r = cr[x] - 128;
+
+        out[x * 4 + r_index] = clamp_u8(luma + mul_high(chroma_r, coefs.cr_r));
+        out[x * 4 + 1] = clamp_u8(luma - mul_high(chroma_b, coefs.cb_g) - mul_high(chroma_r, coefs.cr_g));
+        out[x * 4 + b_index] = clamp_u8(luma + mul_high(chroma_b, coefs.cb_b));
+        out[x * 4 + 3] = 0xFF;
+    }
+}
+
+#if defined(__aarch64__)
+static void convert_row(const uint8_t *y, const uint8_t *cb, const uint8_t *cr, uint8_t *out, uint32_t width, const CscCoefs &coefs, bool bgra) {
+    const int16x8_t y_offset = vdupq_n_s16(coefs.y_offset);
+    const int16x8_t chroma_offset = vdupq_n_s16(128);
+
+    uint32_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const int16x8_t luma_in = vshlq_n_s16(vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(y + x))), y_offset), 7);
+        const int16x8_t chroma_b = vshlq_n_s16(vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(cb + x))), chroma_offset), 7);
+        const int16x8_t chroma_r = vshlq_n_s16(vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(cr + x))), chroma_offset), 7);
+
+        // vqdmulh computes (2 * a * b) >> 16, hence the halved coefficients
+        const int16x8_t luma = vqdmulhq_n_s16(luma_in, coefs.y / 2);
+        const int16x8_t r = vaddq_s16(luma, vqdmulhq_n_s16(chroma_r, coefs.cr_r / 2));
+        const int16x8_t g = vsubq_s16(vsubq_s16(luma, vqdmulhq_n_s16(chroma_b, coefs.cb_g / 2)), vqdmulhq_n_s16(chroma_r, coefs.cr_g / 2));
+        const int16x8_t b = vaddq_s16(luma, vqdmulhq_n_s16(chroma_b, coefs.cb_b / 2));
+
+        uint8x8x4_t pixels;
+        pixels.val[bgra ? 2 : 0] = vqmovun_s16(r);
+        pixels.val[1] = vqmovun_s16(g);
+        pixels.val[bgra ? 0 : 2] = vqmovun_s16(b);
+        pixels.val[3] = vdup_n_u8(0xFF);
+        vst4_u8(out + x * 4, pixels);
+    }
+
+    convert_row_scalar(y + x, cb + x, cr + x, out + x * 4, width - x, coefs, bgra);
+}
+#elif defined(__x86_64__) || defined(_M_X64)
+static void convert_row(const uint8_t *y, const uint8_t *cb, const uint8_t *cr, uint8_t *out, uint32_t width, const CscCoefs &coefs, bool bgra) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi8(static_cast<char>(0xFF));
+    const __m128i y_offset = _mm_set1_epi16(coefs.y_offset);
+    const __m128i chroma_offset = _mm_set1_epi16(128);
+    const __m128i y_coef = _mm_set1_epi16(coefs.y);
+    const __m128i cr_r = _mm_set1_epi16(coefs.cr_r);
+    const __m128i cb_g = _mm_set1_epi16(coefs.cb_g);
+    const __m128i cr_g = _mm_set1_epi16(coefs.cr_g);
+    const __m128i cb_b = _mm_set1_epi16(coefs.cb_b);
+
+    uint32_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m128i luma_in = _mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(y + x)), zero), y_offset), 7);
+        const __m128i chroma_b = _mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(cb + x)), zero), chroma_offset), 7);
+        const __m128i chroma_r = _mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(cr + x)), zero), chroma_offset), 7);
+
+        const __m128i luma = _mm_mulhi_epi16(luma_in, y_coef);
+        const __m128i r = _mm_add_epi16(luma, _mm_mulhi_epi16(chroma_r, cr_r));
+        const __m128i g = _mm_sub_epi16(_mm_sub_epi16(luma, _mm_mulhi_epi16(chroma_b, cb_g)), _mm_mulhi_epi16(chroma_r, cr_g));
+        const __m128i b = _mm_add_epi16(luma, _mm_mulhi_epi16(chroma_b, cb_b));
+
+        const __m128i first = _mm_packus_epi16(bgra ? b : r, zero);
+        const __m128i third = _mm_packus_epi16(bgra ? r : b, zero);
+        const __m128i first_second = _mm_unpacklo_epi8(first, _mm_packus_epi16(g, zero));
+        const __m128i third_alpha = _mm_unpacklo_epi8(third, alpha);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x * 4), _mm_unpacklo_epi16(first_second, third_alpha));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x * 4 + 16), _mm_unpackhi_epi16(first_second, third_alpha));
+    }
+
+    convert_row_scalar(y + x, cb + x, cr + x, out + x * 4, width - x, coefs, bgra);
+}
+#else
+static void convert_row(const uint8_t *y, const uint8_t *cb, const uint8_t *cr, uint8_t *out, uint32_t width, const CscCoefs &coefs, bool bgra) {
+    convert_row_scalar(y, cb, cr, out, width, coefs, bgra);
+}
+#endif
+
+void convert_ycbcr_to_rgba(const uint8_t *const planes[3], const uint32_t strides[3], uint8_t *rgba, uint32_t rgba_pitch,
+    uint32_t width, uint32_t height, const DecoderColorSpace color_space, bool bt601, bool bgra) {
+    const CscCoefs &coefs = bt601 ? CSC_BT601 : CSC_JFIF;
+    const bool grayscale = color_space == COLORSPACE_GRAYSCALE;
+    const bool half_width = (color_space == COLORSPACE_YUV422P) || (color_space == COLORSPACE_YUV420P);
+    const bool half_height = color_space == COLORSPACE_YUV420P;
+
+    // Grayscale images use neutral chroma, subsampled chroma is widened one row at a time so a single row kernel is needed
+    std::vector<uint8_t> chroma_rows;
+    if (grayscale || half_width)
+        chroma_rows.assign(width * 2, 128);
+    uint8_t *wide_cb = chroma_rows.data();
+    uint8_t *wide_cr = chroma_rows.data() + width;
+
+    for (uint32_t row = 0; row < height; row++) {
+        const uint8_t *y = planes[0] + row * strides[0];
+        const uint8_t *cb = wide_cb;
+        const uint8_t *cr = wide_cr;
+        if (!grayscale) {
+            const uint32_t chroma_row = half_height ? row / 2 : row;
+            cb = planes[1] + chroma_row * strides[1];
+            cr = planes[2] + chroma_row * strides[2];
+
+            if (half_width) {
+                for (uint32_t x = 0; x < width; x++) {
+                    wide_cb[x] = cb[x / 2];
+                    wide_cr[x] = cr[x / 2];
+                }
+                cb = wide_cb;
+                cr = wide_cr;
+            }
+        }
+
+        convert_row(y, cb, cr, rgba + row * rgba_pitch * 4, width, coefs, bgra);
+    }
+}
@@ -0,0 +1,151 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// SAS voice engine benchmark
+// Plays every voice of a SasCore at once with a mix of VAG, PCM and noise voices at random pitches
+// and envelopes, and reports the time spent on each grain against the real time length of the grain.
+
+#include <codec/sas.h>
+
+#include <CLI11.hpp>
+#include <fmt/format.h>
+
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t SAMPLE_RATE = 48000;
+constexpr uint32_t SOURCE_SAMPLES = SAMPLE_RATE;
+
+// VAG blocks holding a sine wave, each block is stored with filter 0 and the smallest shift that fits
+std::vector<uint8_t> make_vag(uint32_t sample_count) {
+    const uint32_t block_count = (sample_count + 27) / 28;
+    std::vector<uint8_t> vag(block_count * 16);
+    for (uint32_t block = 0; block < block_count; block++) {
+        uint8_t *out = &vag[block * 16];
+        const int shift = 12 - 3;
+        out[0] = shift;
+        out[1] = block == block_count - 1 ? 3 : (block == 0 ? 4 : 0);
+        for (uint32_t i = 0; i < 28; i++) {
+            const double phase = (block * 28 + i) * 440.0 * 2.0 * M_PI / SAMPLE_RATE;
+            const int nibble = static_cast<int>(std::lround(std::sin(phase) * 7.0)) & 0xF;
+            out[2 + i / 2] |= static_cast<uint8_t>(i & 1 ? nibble << 4 : nibble);
+        }
+    }
+
+    return vag;
+}
+
+std::vector<int16_t> make_pcm(uint32_t sample_count) {
+    std::vector<int16_t> pcm(sample_count);
+    for (uint32_t i = 0; i < sample_count; i++)
+        pcm[i] = static_cast<int16_t>(std::sin(i * 330.0 * 2.0 * M_PI / SAMPLE_RATE) * 16384.0);
+
+    return pcm;
+}
+
+double run(const std::vector<uint8_t> &vag, const std::vector<int16_t> &pcm, uint32_t voice_count, uint32_t grain, SasOutputMode output_mode, bool effect, uint32_t grain_count) {
+    auto core = std::make_unique<SasCore>();
+    core->init(grain, voice_count, output_mode, SAMPLE_RATE);
+    if (effect) {
+        core->set_effect_type(SasEffectType::Hall);
+        core->wet_enabled = true;
+        core->effect_volume_left = SAS_VOLUME_MAX / 2;
+        core->effect_volume_right = SAS_VOLUME_MAX / 2;
+    }
+
+    std::mt19937 random(1234);
+    std::uniform_int_distribution<int32_t> pitch(SAS_PITCH_BASE / 2, SAS_PITCH_BASE * 2);
+    for (uint32_t i = 0; i < voice_count; i++) {
+        SasVoice &voice = core->voices[i];
+        switch (i % 3) {
+        case 0:
+            voice.type = SasVoiceType::Vag;
+            voice.data = vag.data();
+            voice.size = static_cast<uint32_t>(vag.size());
+            voice.loop = true;
+            break;
+        case 1:
+            voice.type = SasVoiceType::Pcm;
+            voice.data = reinterpret_cast<const uint8_t *>(pcm.data());
+            voice.size = static_cast<uint32_t>(pcm.size());
+            voice.loop = true;
+            break;
+        default:
+            voice.type = SasVoiceType::Noise;
+            voice.noise_clock = i % SAS_NOISE_CLOCK_MAX;
+            break;
+        }
+
+        voice.pitch = pitch(random);
+        voice.volume_left = SAS_VOLUME_MAX / 4;
+        voice.volume_right = SAS_VOLUME_MAX / 4;
+        voice.wet_volume_left = effect ? SAS_VOLUME_MAX / 8 : 0;
+        voice.wet_volume_right = effect ? SAS_VOLUME_MAX / 8 : 0;
+        voice.envelope.set_simple(0x000F | (random() & 0x0F00), 0x1FC0 | (random() & 0x1F));
+        voice.key_on();
+    }
+
+    const uint32_t channels = output_mode == SAS_OUTPUT_MULTI ? 4 : 2;
+    std::vector<int16_t> out(grain * channels);
+
+    // warm up
+    for (uint32_t i = 0; i < 10; i++)
+        core->process(out.data());
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < grain_count; i++)
+        core->process(out.data());
+    const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count() / grain_count;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<uint32_t> grains = { 256, 1024 };
+    uint32_t voice_count = SAS_MAX_VOICES;
+    uint32_t grain_count = 10000;
+    bool multi = false;
+
+    CLI::App app{ "Vita3K SAS voice engine benchmark" };
+    app.add_option("--grain,-g", grains, "Samples produced by each call, one run for each value")->check(CLI::Range(SAS_MIN_GRAIN, SAS_MAX_GRAIN));
+    app.add_option("--voices,-v", voice_count, "Number of voices playing")->check(CLI::Range(1U, SAS_MAX_VOICES));
+    app.add_option("--count,-n", grain_count, "Number of grains timed")->check(CLI::Range(1, 10000000));
+    app.add_flag("--multi,-m", multi, "Use the 4 channel output");
+    CLI11_PARSE(app, argc, argv);
+
+    const std::vector<uint8_t> vag = make_vag(SOURCE_SAMPLES);
+    const std::vector<int16_t> pcm = make_pcm(SOURCE_SAMPLES);
+    const SasOutputMode output_mode = multi ? SAS_OUTPUT_MULTI : SAS_OUTPUT_STEREO;
+
+    fmt::print("voices: {}, grains: {}\n", voice_count, grain_count);
+    for (const uint32_t grain : grains) {
+        const double budget = grain * 1000000.0 / SAMPLE_RATE;
+        for (const bool effect : { false, true }) {
+            const double us = run(vag, pcm, voice_count, grain, output_mode, effect, grain_count);
+            fmt::print("grain: {:5}, effect: {:3}, {:8.2f} us per grain, {:5.2f}% of the {:.0f} us budget\n",
+                grain, effect ? "on" : "off", us, us * 100.0 / budget, budget);
+        }
+    }
+
+    return 0;
+}
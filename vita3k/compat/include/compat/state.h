@@ -21,6 +21,7 @@
 #include <imgui.h>
 #include <map>
 #include <string>
+#include <vector>
 
 namespace compat {
 
@@ -35,15 +36,24 @@ enum CompatibilityState {
     PLAYABLE,
 };
 
+// One entry of the compatibility database, stored as is in the binary index
 struct Compatibility {
+    char title_id[12];
     uint32_t issue_id;
-    CompatibilityState state = UNKNOWN;
-    time_t updated_at;
+    int32_t state = UNKNOWN;
+    uint32_t padding;
+    int64_t updated_at;
 };
 
+static_assert(sizeof(Compatibility) == 32);
+
 struct CompatState {
     bool compat_db_loaded = false;
-    std::map<std::string, Compatibility> app_compat_db;
+    // Sorted by title ID
+    std::vector<Compatibility> app_compat_db;
+
+    const Compatibility *find(const std::string &title_id) const;
+    CompatibilityState get_state(const std::string &title_id) const;
     std::map<CompatibilityState, ImVec4> compat_color{
         { UNKNOWN, ImVec4(0.54f, 0.54f, 0.54f, 1.f) },
         { NOTHING, ImVec4(1.00f, 0.00f, 0.00f, 1.f) }, // #ff0000
@@ -28,6 +28,9 @@
 
 #include <pugixml.hpp>
 
+#include <algorithm>
+#include <cstring>
+
 enum LabelIdState {
     Nothing = 1260231569, // 0x4b1d9b91
     Bootable = 1344750319, // 0x502742ef
@@ -44,85 +47,206 @@ static std::string db_updated_at;
 static const uint32_t db_version = 1;
 static uint32_t db_issue_count = 0;
 
-bool load_app_compat_db(GuiState &gui, EmuEnvState &emuenv) {
-    const auto app_compat_db_path = emuenv.cache_path / "app_compat_db.xml";
-    if (!fs::exists(app_compat_db_path)) {
-        LOG_WARN("Compatibility database not found at {}.", app_compat_db_path);
+// Binary index compiled from the xml database, rebuilt only when the xml changes
+static constexpr uint32_t COMPAT_INDEX_MAGIC = 0x42444356; // VCDB
+static constexpr uint32_t COMPAT_INDEX_VERSION = 1;
+
+struct CompatIndexHeader {
+    uint32_t magic;
+    uint32_t index_version;
+    uint32_t db_version;
+    uint32_t issue_count;
+    uint64_t xml_size;
+    int64_t xml_mtime;
+    char db_updated_at[32];
+    uint32_t entry_count;
+    uint32_t padding;
+};
+
+static bool compare_title_id(const Compatibility &entry, const std::string &title_id) {
+    return strncmp(entry.title_id, title_id.c_str(), sizeof(entry.title_id)) < 0;
+}
+
+const Compatibility *CompatState::find(const std::string &title_id) const {
+    const auto it = std::lower_bound(app_compat_db.begin(), app_compat_db.end(), title_id, compare_title_id);
+    if ((it == app_compat_db.end()) || (strncmp(it->title_id, title_id.c_str(), sizeof(it->title_id)) != 0))
+        return nullptr;
+
+    return &*it;
+}
+
+CompatibilityState CompatState::get_state(const std::string &title_id) const {
+    if (!compat_db_loaded)
+        return UNKNOWN;
+
+    const auto entry = find(title_id);
+    return entry ? static_cast<CompatibilityState>(entry->state) : UNKNOWN;
+}
+
+static bool load_compat_index(GuiState &gui, const fs::path &index_path, const uint64_t xml_size, const int64_t xml_mtime) {
+    fs::ifstream index(index_path, std::ios::in | std::ios::binary);
+    if (!index.is_open())
         return false;
-    }
 
-    // Parse and load file of compatibility database
-    pugi::xml_document doc;
-    pugi::xml_parse_result result = doc.load_file(app_compat_db_path.c_str());
-    if (!result) {
-        LOG_ERROR("Compatibility database {} could not be loaded: {}", app_compat_db_path, result.description());
+    CompatIndexHeader header{};
+    index.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!index || (header.magic != COMPAT_INDEX_MAGIC) || (header.index_version != COMPAT_INDEX_VERSION) || (header.db_version != db_version)
+        || (header.xml_size != xml_size) || (header.xml_mtime != xml_mtime))
         return false;
-    }
 
-    // Check compatibility database version
-    const auto compatibility = doc.child("compatibility");
-    const auto version = compatibility.attribute("version").as_uint();
-    db_issue_count = compatibility.attribute("issue_count").as_uint();
-    if (db_version != version) {
-        LOG_WARN("Compatibility database version {} is outdated, download it again.", version);
-        return update_app_compat_db(gui, emuenv);
+    std::vector<Compatibility> entries(header.entry_count);
+    index.read(reinterpret_cast<char *>(entries.data()), entries.size() * sizeof(Compatibility));
+    if (!index)
+        return false;
+
+    gui.compat.app_compat_db = std::move(entries);
+    db_issue_count = header.issue_count;
+    if (db_updated_at.empty())
+        db_updated_at.assign(header.db_updated_at, strnlen(header.db_updated_at, sizeof(header.db_updated_at)));
+
+    return true;
+}
+
+static void save_compat_index(const GuiState &gui, const fs::path &index_path, const uint64_t xml_size, const int64_t xml_mtime, const std::string &updated_at) {
+    CompatIndexHeader header{};
+    header.magic = COMPAT_INDEX_MAGIC;
+    header.index_version = COMPAT_INDEX_VERSION;
+    header.db_version = db_version;
+    header.issue_count = db_issue_count;
+    header.xml_size = xml_size;
+    header.xml_mtime = xml_mtime;
+    strncpy(header.db_updated_at, updated_at.c_str(), sizeof(header.db_updated_at) - 1);
+    header.entry_count = static_cast<uint32_t>(gui.compat.app_compat_db.size());
+
+    // Write to a temporary file first so an interrupted write never leaves a truncated index behind
+    const auto temp_index_path = fs::path(index_path).replace_extension(".tmp");
+    {
+        fs::ofstream index(temp_index_path, std::ios::out | std::ios::binary);
+        if (!index.is_open()) {
+            LOG_WARN("Could not create compatibility database index at {}.", temp_index_path);
+            return;
+        }
+
+        index.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        index.write(reinterpret_cast<const char *>(gui.compat.app_compat_db.data()), gui.compat.app_compat_db.size() * sizeof(Compatibility));
     }
 
-    // Check if compatibility database is up to date in first load
-    if (db_updated_at.empty()) {
-        db_updated_at = compatibility.attribute("db_updated_at").as_string();
-        if (update_app_compat_db(gui, emuenv))
-            return true;
+    boost::system::error_code error;
+    fs::rename(temp_index_path, index_path, error);
+    if (error)
+        LOG_WARN("Could not save compatibility database index at {}: {}", index_path, error.message());
+}
+
+bool load_app_compat_db(GuiState &gui, EmuEnvState &emuenv) {
+    const auto app_compat_db_path = emuenv.cache_path / "app_compat_db.xml";
+    if (!fs::exists(app_compat_db_path)) {
+        LOG_WARN("Compatibility database not found at {}.", app_compat_db_path);
+        return false;
     }
 
     // Clear old compat database
     gui.compat.compat_db_loaded = false;
     gui.compat.app_compat_db.clear();
 
-    //  Load compatibility database
-    for (const auto &app : doc.child("compatibility")) {
-        const std::string title_id = app.attribute("title_id").as_string();
-        const auto issue_id = app.child("issue_id").text().as_uint();
+    // Use the binary index when it was compiled from the same xml file
+    boost::system::error_code error;
+    const auto index_path = emuenv.cache_path / "app_compat_db.bin";
+    const uint64_t xml_size = fs::file_size(app_compat_db_path, error);
+    const int64_t xml_mtime = fs::last_write_time(app_compat_db_path, error);
+    const auto first_load = db_updated_at.empty();
+    if (!load_compat_index(gui, index_path, xml_size, xml_mtime)) {
+        // Parse and load file of compatibility database
+        pugi::xml_document doc;
+        pugi::xml_parse_result result = doc.load_file(app_compat_db_path.c_str());
+        if (!result) {
+            LOG_ERROR("Compatibility database {} could not be loaded: {}", app_compat_db_path, result.description());
+            return false;
+        }
 
-        // Check if title ID is valid
-        if ((title_id.find("PCS") == std::string::npos) && (title_id != "NPXS10007")) {
-            LOG_WARN_IF(emuenv.cfg.log_compat_warn, "Title ID {} is invalid. Please check GitHub issue {} and verify it!", title_id, issue_id);
-            continue;
+        // Check compatibility database version
+        const auto compatibility = doc.child("compatibility");
+        const auto version = compatibility.attribute("version").as_uint();
+        db_issue_count = compatibility.attribute("issue_count").as_uint();
+        if (db_version != version) {
+            LOG_WARN("Compatibility database version {} is outdated, download it again.", version);
+            return update_app_compat_db(gui, emuenv);
         }
 
-        auto state = CompatibilityState::UNKNOWN;
-        const auto labels = app.child("labels");
-        if (!labels.empty()) {
-            for (const auto &label : labels) {
-                const auto label_id = static_cast<LabelIdState>(label.text().as_uint());
-                switch (label_id) {
-                case LabelIdState::Nothing: state = NOTHING; break;
-                case LabelIdState::Bootable: state = BOOTABLE; break;
-                case LabelIdState::Intro: state = INTRO; break;
-                case LabelIdState::Menu: state = MENU; break;
-                case LabelIdState::Ingame_Less: state = INGAME_LESS; break;
-                case LabelIdState::Ingame_More: state = INGAME_MORE; break;
-                case LabelIdState::Playable: state = PLAYABLE; break;
-                default: break;
+        const std::string updated_at = compatibility.attribute("db_updated_at").as_string();
+        if (first_load)
+            db_updated_at = updated_at;
+
+        //  Load compatibility database
+        for (const auto &app : doc.child("compatibility")) {
+            const std::string title_id = app.attribute("title_id").as_string();
+            const auto issue_id = app.child("issue_id").text().as_uint();
+
+            // Check if title ID is valid
+            if (((title_id.find("PCS") == std::string::npos) && (title_id != "NPXS10007")) || (title_id.size() >= sizeof(Compatibility::title_id))) {
+                LOG_WARN_IF(emuenv.cfg.log_compat_warn, "Title ID {} is invalid. Please check GitHub issue {} and verify it!", title_id, issue_id);
+                continue;
+            }
+
+            auto state = CompatibilityState::UNKNOWN;
+            const auto labels = app.child("labels");
+            if (!labels.empty()) {
+                for (const auto &label : labels) {
+                    const auto label_id = static_cast<LabelIdState>(label.text().as_uint());
+                    switch (label_id) {
+                    case LabelIdState::Nothing: state = NOTHING; break;
+                    case LabelIdState::Bootable: state = BOOTABLE; break;
+                    case LabelIdState::Intro: state = INTRO; break;
+                    case LabelIdState::Menu: state = MENU; break;
+                    case LabelIdState::Ingame_Less: state = INGAME_LESS; break;
+                    case LabelIdState::Ingame_More: state = INGAME_MORE; break;
+                    case LabelIdState::Playable: state = PLAYABLE; break;
+                    default: break;
+                    }
                 }
             }
+            const auto updated_at = app.child("updated_at").text().as_llong();
+
+            // Check if app missing a status label
+            if (state == UNKNOWN)
+                LOG_WARN_IF(emuenv.cfg.log_compat_warn, "App with Title ID {} has an issue but no status label. Please check GitHub issue {} and request a status label be added.", title_id, issue_id);
+
+            Compatibility entry{};
+            strncpy(entry.title_id, title_id.c_str(), sizeof(entry.title_id) - 1);
+            entry.issue_id = issue_id;
+            entry.state = state;
+            entry.updated_at = updated_at;
+            gui.compat.app_compat_db.push_back(entry);
         }
-        const auto updated_at = app.child("updated_at").text().as_llong();
 
-        // Check if app missing a status label
-        if (state == UNKNOWN)
-            LOG_WARN_IF(emuenv.cfg.log_compat_warn, "App with Title ID {} has an issue but no status label. Please check GitHub issue {} and request a status label be added.", title_id, issue_id);
-
-        // Check if app already exists in compatibility database
-        if (gui.compat.app_compat_db.contains(title_id))
-            LOG_WARN_IF(emuenv.cfg.log_compat_warn, "App with Title ID {} already exists in compatibility database. Please check and close GitHub issue {}.", title_id, gui.compat.app_compat_db[title_id].issue_id);
+        // Sort by title ID, the last entry of a title ID wins
+        auto &db = gui.compat.app_compat_db;
+        std::stable_sort(db.begin(), db.end(), [](const Compatibility &a, const Compatibility &b) {
+            return strncmp(a.title_id, b.title_id, sizeof(a.title_id)) < 0;
+        });
+        size_t count = 0;
+        for (size_t i = 0; i < db.size(); i++) {
+            if ((count > 0) && (strncmp(db[count - 1].title_id, db[i].title_id, sizeof(db[i].title_id)) == 0)) {
+                // Check if app already exists in compatibility database
+                LOG_WARN_IF(emuenv.cfg.log_compat_warn, "App with Title ID {} already exists in compatibility database. Please check and close GitHub issue {}.", db[i].title_id, db[count - 1].issue_id);
+                db[count - 1] = db[i];
+            } else
+                db[count++] = db[i];
+        }
+        db.resize(count);
 
-        gui.compat.app_compat_db[title_id] = { issue_id, state, updated_at };
+        if (!error)
+            save_compat_index(gui, index_path, xml_size, xml_mtime, updated_at);
     }
 
+    // Check if compatibility database is up to date in first load
+    if (first_load && update_app_compat_db(gui, emuenv))
+        return true;
+
     // Update compatibility status of all user apps
-    for (auto &app : gui.app_selector.user_apps)
-        app.compat = gui.compat.app_compat_db.contains(app.title_id) ? gui.compat.app_compat_db[app.title_id].state : CompatibilityState::UNKNOWN;
+    for (auto &app : gui.app_selector.user_apps) {
+        const auto entry = gui.compat.find(app.title_id);
+        app.compat = entry ? static_cast<CompatibilityState>(entry->state) : CompatibilityState::UNKNOWN;
+    }
 
     return !gui.compat.app_compat_db.empty();
 }
@@ -165,8 +289,9 @@ bool update_app_compat_db(GuiState &gui, EmuEnvState &emuenv) {
         return false;
     }
 
-    // Rename new database to replace old database
+    // Rename new database to replace old database, its index is rebuilt on next load
     fs::rename(new_app_compat_db_path, app_compat_db_path);
+    fs::remove(emuenv.cache_path / "app_compat_db.bin");
 
     const auto old_db_updated_at = db_updated_at;
     const auto old_compat_db_count = db_issue_count;
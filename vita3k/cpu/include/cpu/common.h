@@ -19,6 +19,7 @@
 
 #include <fmt/format.h>
 #include <mem/ptr.h> // Address.
+#include <util/types.h>
 
 #include <array>
 #include <cstdint>
@@ -43,6 +44,12 @@ typedef void *ExclusiveMonitorPtr;
 struct CPUProtocolBase {
     virtual void call_svc(CPUState &cpu, uint32_t svc, Address pc, ThreadState &thread) = 0;
     virtual Address get_watch_memory_addr(Address addr) = 0;
+    // a thread accessed watched memory, return true if it must stop
+    virtual bool on_watch_memory_access(SceUID thread_id, Address addr, bool write) = 0;
+    // protect again the watched memory pages which were unprotected by an access
+    virtual void rearm_memory_watch() = 0;
+    // insert the breakpoints overlapping the code word at addr before it is translated
+    virtual uint32_t apply_code_breakpoints(Address addr, uint32_t code) = 0;
 #ifdef USE_DYNARMIC
     virtual ExclusiveMonitorPtr get_exlusive_monitor() = 0;
 #endif
@@ -69,3 +69,7 @@ void set_log_code(CPUState &state, bool log);
 void set_log_mem(CPUState &state, bool log);
 bool get_log_code(CPUState &state);
 bool get_log_mem(CPUState &state);
+// must be called from the thread which accessed the watched memory, break_thread stops it like a breakpoint
+void request_watch_rearm(bool break_thread);
+// id of the guest thread running on the calling host thread, 0 if there is none
+SceUID current_thread_id();
@@ -99,4 +99,5 @@ public:
 
     std::size_t processor_id() const override;
     void invalidate_jit_cache(Address start, size_t length) override;
+    void request_watch_rearm(bool break_thread) override;
 };
@@ -69,4 +69,8 @@ struct CPUInterface {
     virtual std::size_t processor_id() const {
         return 0;
     }
+
+    // called from the access violation handler when a watched memory page was accessed
+    // only needed by backends relying on page protection for memory watchpoints
+    virtual void request_watch_rearm(bool break_thread) {}
 };
@@ -90,11 +90,16 @@ CPUStatePtr init_cpu(CPUBackend backend, bool cpu_opt, SceUID thread_id, std::si
     return state;
 }
 
+// cpu running guest code on this thread, used to know which cpu accessed a watched memory page
+static thread_local CPUState *current_cpu = nullptr;
+
 int run(CPUState &state) {
+    current_cpu = &state;
     return state.cpu->run();
 }
 
 int step(CPUState &state) {
+    current_cpu = &state;
     return state.cpu->step();
 }
 
@@ -194,6 +199,15 @@ bool get_log_mem(CPUState &state) {
     return state.cpu->get_log_mem();
 }
 
+void request_watch_rearm(bool break_thread) {
+    if (current_cpu)
+        current_cpu->cpu->request_watch_rearm(break_thread);
+}
+
+SceUID current_thread_id() {
+    return current_cpu ? current_cpu->thread_id : 0;
+}
+
 std::size_t get_processor_id(CPUState &state) {
     return state.cpu->processor_id();
 }
@@ -26,6 +26,9 @@
 
 //#include <dynarmic/frontend/A32/a32_ir_emitter.h>
 
+// halt reason used when a watched memory page must be protected again
+constexpr Dynarmic::HaltReason WATCH_REARM_HALT = Dynarmic::HaltReason::UserDefined7;
+
 class ArmDynarmicCP15 : public Dynarmic::A32::Coprocessor {
     uint32_t tpidruro;
 
@@ -101,7 +104,8 @@ public:
     std::optional<std::uint32_t> MemoryReadCode(Dynarmic::A32::VAddr addr) override {
         if (cpu->log_mem)
             LOG_TRACE("Instruction fetch at address 0x{:X}", addr);
-        return MemoryRead32(addr);
+        // breakpoints only exist in the translated code, they cost nothing to the blocks which do not contain one
+        return parent->protocol->apply_code_breakpoints(addr, MemoryRead32(addr));
     }
 
     static void TraceInstruction(uint64_t self_, uint64_t address, uint64_t is_thumb) {
@@ -332,16 +336,29 @@ int DynarmicCPU::run() {
     exit_request = false;
     parent->svc_called = false;
     Dynarmic::HaltReason halt_reason;
-    do {
+    while (true) {
         halt_reason = jit->Run();
-    } while (halt_reason == Dynarmic::HaltReason::Step || halt_reason == Dynarmic::HaltReason::CacheInvalidation);
+
+        if (Dynarmic::Has(halt_reason, WATCH_REARM_HALT)) {
+            // a watched page was accessed during the last block and is now unprotected
+            parent->protocol->rearm_memory_watch();
+            halt_reason = halt_reason & ~WATCH_REARM_HALT;
+            // a watchpoint hit stops the thread like a breakpoint
+            if (halt_reason == Dynarmic::HaltReason{} && !break_)
+                continue;
+        }
+
+        if (break_ || (halt_reason != Dynarmic::HaltReason::Step && halt_reason != Dynarmic::HaltReason::CacheInvalidation))
+            break;
+    }
 
     return halted;
 }
 
 int DynarmicCPU::step() {
     parent->svc_called = false;
-    jit->Step();
+    if (Dynarmic::Has(jit->Step(), WATCH_REARM_HALT))
+        parent->protocol->rearm_memory_watch();
     return 0;
 }
 
@@ -484,6 +501,14 @@ void DynarmicCPU::invalidate_jit_cache(Address start, size_t length) {
     jit->InvalidateCacheRange(start, length);
 }
 
+void DynarmicCPU::request_watch_rearm(bool break_thread) {
+    // the access which triggered the fault is done once the signal handler returns
+    // stop at the end of the current block so the page can be protected again
+    if (break_thread)
+        break_ = true;
+    jit->HaltExecution(WATCH_REARM_HALT);
+}
+
 // TODO: proper abstraction
 ExclusiveMonitorPtr new_exclusive_monitor(int max_num_cores) {
     return new Dynarmic::ExclusiveMonitor(max_num_cores);
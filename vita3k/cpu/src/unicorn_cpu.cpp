@@ -62,6 +62,8 @@ void UnicornCPU::read_hook(uc_engine *uc, uc_mem_type type, uint64_t address, in
     if (start) {
         memcpy(&value, Ptr<const void>(static_cast<Address>(address)).get(mem), size);
         state.log_memory_access(uc, "Read", start, size, value, mem, *state.parent, address - start);
+        if (state.parent->protocol->on_watch_memory_access(state.parent->thread_id, static_cast<Address>(address), false))
+            state.trigger_breakpoint();
     }
 }
 
@@ -71,6 +73,8 @@ void UnicornCPU::write_hook(uc_engine *uc, uc_mem_type type, uint64_t address, i
     if (start) {
         MemState &mem = *state.parent->mem;
         state.log_memory_access(uc, "Write", start, size, value, mem, *state.parent, address - start);
+        if (state.parent->protocol->on_watch_memory_access(state.parent->thread_id, static_cast<Address>(address), true))
+            state.trigger_breakpoint();
     }
 }
 
@@ -22,7 +22,10 @@
 
 struct ControllerBinding;
 
-std::array<ControllerBinding, 15> get_controller_bindings_ext(EmuEnvState &emuenv);
+const std::array<ControllerBinding, 15> &get_controller_bindings_ext(EmuEnvState &emuenv);
 SceCtrlExternalInputMode get_type_of_controller(const int idx);
 int ctrl_get(const SceUID thread_id, EmuEnvState &emuenv, int port, SceCtrlData2 *pData, SceUInt32 count, bool negative, bool is_peek, bool is_v2, bool from_ext);
+// Open the new controllers and close the disconnected ones, called on SDL controller device events
 void refresh_controllers(CtrlState &state, EmuEnvState &emuenv);
+// Sample the keyboard and controllers and publish the input for the guest, called once per host event poll
+void update_ctrl_snapshot(EmuEnvState &emuenv);
@@ -23,9 +23,13 @@
 #include <SDL_haptic.h>
 #include <SDL_joystick.h>
 
+#include <util/seqlock.h>
+
+#include <array>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 struct _SDL_GameController;
 
@@ -53,7 +57,21 @@ struct SDL_JoystickGUIDComparator {
 
 typedef std::map<SDL_JoystickGUID, Controller, SDL_JoystickGUIDComparator> ControllerList;
 
+// Input of one port from the keyboard and the controllers assigned to it
+struct CtrlPortInput {
+    // buttons for the functions without and with the L2/R2/L3/R3 buttons
+    uint32_t buttons;
+    uint32_t buttons_ext;
+    // left x/y and right x/y, from -1 to 1 for each device, summed
+    float axes[4];
+};
+
+struct CtrlSnapshot {
+    CtrlPortInput ports[SCE_CTRL_MAX_WIRELESS_NUM];
+};
+
 struct CtrlState {
+    // held while the controller list is modified and by the other threads reading it
     std::mutex mutex;
     ControllerList controllers;
     int controllers_num = 0;
@@ -65,4 +83,12 @@ struct CtrlState {
 
     // last vsync the data was read
     uint64_t last_vcount[5] = {};
+
+    // Input sampled on each host event poll, the guest only reads the last published one
+    SeqLock<CtrlSnapshot> snapshot;
+
+    // controller-binds config the bindings were built from, they are only rebuilt when it changes
+    std::vector<short> bound_config;
+    std::array<ControllerBinding, 13> bindings = {};
+    std::array<ControllerBinding, 15> bindings_ext = {};
 };
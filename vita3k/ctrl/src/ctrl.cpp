@@ -27,6 +27,7 @@
 
 #include <SDL_keyboard.h>
 
+#include <algorithm>
 #include <array>
 
 #ifdef ANDROID
@@ -95,6 +96,8 @@ SceCtrlExternalInputMode get_type_of_controller(const int idx) {
 }
 
 void refresh_controllers(CtrlState &state, EmuEnvState &emuenv) {
+    std::lock_guard<std::mutex> guard(state.mutex);
+
     // Remove disconnected controllers
     bool found_gyro = false;
     bool found_accel = false;
@@ -176,54 +179,56 @@ static float keys_to_axis(const uint8_t *keys, SDL_Scancode code1, SDL_Scancode
     return temp;
 }
 
-static void apply_keyboard(uint32_t *buttons, float axes[4], bool ext, EmuEnvState &emuenv) {
+static void apply_keyboard(CtrlPortInput &input, EmuEnvState &emuenv) {
     const uint8_t *const keys = SDL_GetKeyboardState(nullptr);
-    if (ext) {
-        if (keys[emuenv.cfg.keyboard_button_l1])
-            *buttons |= SCE_CTRL_L1;
-        if (keys[emuenv.cfg.keyboard_button_r1])
-            *buttons |= SCE_CTRL_R1;
-        if (keys[emuenv.cfg.keyboard_button_l2])
-            *buttons |= SCE_CTRL_L2;
-        if (keys[emuenv.cfg.keyboard_button_r2])
-            *buttons |= SCE_CTRL_R2;
-        if (keys[emuenv.cfg.keyboard_button_l3])
-            *buttons |= SCE_CTRL_L3;
-        if (keys[emuenv.cfg.keyboard_button_r3])
-            *buttons |= SCE_CTRL_R3;
-    } else {
-        if (keys[emuenv.cfg.keyboard_button_l1])
-            *buttons |= SCE_CTRL_L;
-        if (keys[emuenv.cfg.keyboard_button_r1])
-            *buttons |= SCE_CTRL_R;
-    }
+    uint32_t buttons = 0;
     if (keys[emuenv.cfg.keyboard_button_select])
-        *buttons |= SCE_CTRL_SELECT;
+        buttons |= SCE_CTRL_SELECT;
     if (keys[emuenv.cfg.keyboard_button_start])
-        *buttons |= SCE_CTRL_START;
+        buttons |= SCE_CTRL_START;
     if (keys[emuenv.cfg.keyboard_button_up])
-        *buttons |= SCE_CTRL_UP;
+        buttons |= SCE_CTRL_UP;
     if (keys[emuenv.cfg.keyboard_button_right])
-        *buttons |= SCE_CTRL_RIGHT;
+        buttons |= SCE_CTRL_RIGHT;
     if (keys[emuenv.cfg.keyboard_button_down])
-        *buttons |= SCE_CTRL_DOWN;
+        buttons |= SCE_CTRL_DOWN;
     if (keys[emuenv.cfg.keyboard_button_left])
-        *buttons |= SCE_CTRL_LEFT;
+        buttons |= SCE_CTRL_LEFT;
     if (keys[emuenv.cfg.keyboard_button_triangle])
-        *buttons |= SCE_CTRL_TRIANGLE;
+        buttons |= SCE_CTRL_TRIANGLE;
     if (keys[emuenv.cfg.keyboard_button_circle])
-        *buttons |= SCE_CTRL_CIRCLE;
+        buttons |= SCE_CTRL_CIRCLE;
     if (keys[emuenv.cfg.keyboard_button_cross])
-        *buttons |= SCE_CTRL_CROSS;
+        buttons |= SCE_CTRL_CROSS;
     if (keys[emuenv.cfg.keyboard_button_square])
-        *buttons |= SCE_CTRL_SQUARE;
+        buttons |= SCE_CTRL_SQUARE;
     if (keys[emuenv.cfg.keyboard_button_psbutton])
-        *buttons |= SCE_CTRL_PSBUTTON;
+        buttons |= SCE_CTRL_PSBUTTON;
 
-    axes[0] += keys_to_axis(keys, static_cast<SDL_Scancode>(emuenv.cfg.keyboard_leftstick_left), static_cast<SDL_Scancode>(emuenv.cfg.keyboard_leftstick_right));
-    axes[1] += keys_to_axis(keys, static_cast<SDL_Scancode>(emuenv.cfg.keyboard_leftstick_up), static_cast<SDL_Scancode>(emuenv.cfg.keyboard_leftstick_down));
-    axes[2] += keys_to_axis(keys, static_cast<SDL_Scancode>(emuenv.cfg.keyboard_rightstick_left), static_cast<SDL_Scancode>(emuenv.cfg.keyboard_rightstick_right));
-    axes[3] += keys_to_axis(keys, static_cast<SDL_Scancode>(emuenv.cfg.keyboard_rightstick_up), static_cast<SDL_Scancode>(emuenv.cfg.keyboard_rightstick_down));
+    input.buttons |= buttons;
+    input.buttons_ext |= buttons;
+
+    if (keys[emuenv.cfg.keyboard_button_l1]) {
+        input.buttons |= SCE_CTRL_L;
+        input.buttons_ext |= SCE_CTRL_L1;
+    }
+    if (keys[emuenv.cfg.keyboard_button_r1]) {
+        input.buttons |= SCE_CTRL_R;
+        input.buttons_ext |= SCE_CTRL_R1;
+    }
+    if (keys[emuenv.cfg.keyboard_button_l2])
+        input.buttons_ext |= SCE_CTRL_L2;
+    if (keys[emuenv.cfg.keyboard_button_r2])
+        input.buttons_ext |= SCE_CTRL_R2;
+    if (keys[emuenv.cfg.keyboard_button_l3])
+        input.buttons_ext |= SCE_CTRL_L3;
+    if (keys[emuenv.cfg.keyboard_button_r3])
+        input.buttons_ext |= SCE_CTRL_R3;
+
+    input.axes[0] += keys_to_axis(keys, static_cast<SDL_Scancode>(emuenv.cfg.keyboard_leftstick_left), static_cast<SDL_Scancode>(emuenv.cfg.keyboard_leftstick_right));
+    input.axes[1] += keys_to_axis(keys, static_cast<SDL_Scancode>(emuenv.cfg.keyboard_leftstick_up), static_cast<SDL_Scancode>(emuenv.cfg.keyboard_leftstick_down));
+    input.axes[2] += keys_to_axis(keys, static_cast<SDL_Scancode>(emuenv.cfg.keyboard_rightstick_left), static_cast<SDL_Scancode>(emuenv.cfg.keyboard_rightstick_right));
+    input.axes[3] += keys_to_axis(keys, static_cast<SDL_Scancode>(emuenv.cfg.keyboard_rightstick_up), static_cast<SDL_Scancode>(emuenv.cfg.keyboard_rightstick_down));
 }
 
 static float axis_to_axis(int16_t axis) {
@@ -249,80 +254,107 @@ static uint8_t float_to_byte(float f) {
     return static_cast<uint8_t>(clamped * 255);
 }
 
-static std::array<ControllerBinding, 13> get_controller_bindings(EmuEnvState &emuenv) {
-    return { {
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_BACK]), SCE_CTRL_SELECT },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_START]), SCE_CTRL_START },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_DPAD_UP]), SCE_CTRL_UP },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_DPAD_RIGHT]), SCE_CTRL_RIGHT },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_DPAD_DOWN]), SCE_CTRL_DOWN },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_DPAD_LEFT]), SCE_CTRL_LEFT },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_LEFTSHOULDER]), SCE_CTRL_L },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_RIGHTSHOULDER]), SCE_CTRL_R },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_Y]), SCE_CTRL_TRIANGLE },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_B]), SCE_CTRL_CIRCLE },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_A]), SCE_CTRL_CROSS },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_X]), SCE_CTRL_SQUARE },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_GUIDE]), SCE_CTRL_PSBUTTON },
+// The bindings only depend on the config, they are rebuilt when the controller binds were modified
+static void update_controller_bindings(CtrlState &state, EmuEnvState &emuenv) {
+    const auto &binds = emuenv.cfg.controller_binds;
+    if (state.bound_config == binds)
+        return;
+
+    state.bound_config = binds;
+    state.bindings = { {
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_BACK]), SCE_CTRL_SELECT },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_START]), SCE_CTRL_START },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_DPAD_UP]), SCE_CTRL_UP },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_DPAD_RIGHT]), SCE_CTRL_RIGHT },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_DPAD_DOWN]), SCE_CTRL_DOWN },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_DPAD_LEFT]), SCE_CTRL_LEFT },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_LEFTSHOULDER]), SCE_CTRL_L },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_RIGHTSHOULDER]), SCE_CTRL_R },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_Y]), SCE_CTRL_TRIANGLE },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_B]), SCE_CTRL_CIRCLE },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_A]), SCE_CTRL_CROSS },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_X]), SCE_CTRL_SQUARE },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_GUIDE]), SCE_CTRL_PSBUTTON },
+    } };
+    state.bindings_ext = { {
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_BACK]), SCE_CTRL_SELECT },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_LEFTSTICK]), SCE_CTRL_L3 },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_RIGHTSTICK]), SCE_CTRL_R3 },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_START]), SCE_CTRL_START },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_DPAD_UP]), SCE_CTRL_UP },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_DPAD_RIGHT]), SCE_CTRL_RIGHT },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_DPAD_DOWN]), SCE_CTRL_DOWN },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_DPAD_LEFT]), SCE_CTRL_LEFT },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_LEFTSHOULDER]), SCE_CTRL_L1 },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_RIGHTSHOULDER]), SCE_CTRL_R1 },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_Y]), SCE_CTRL_TRIANGLE },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_B]), SCE_CTRL_CIRCLE },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_A]), SCE_CTRL_CROSS },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_X]), SCE_CTRL_SQUARE },
+        { SDL_GameControllerButton(binds[SDL_CONTROLLER_BUTTON_GUIDE]), SCE_CTRL_PSBUTTON },
     } };
 }
 
-std::array<ControllerBinding, 15> get_controller_bindings_ext(EmuEnvState &emuenv) {
-    return { {
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_BACK]), SCE_CTRL_SELECT },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_LEFTSTICK]), SCE_CTRL_L3 },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_RIGHTSTICK]), SCE_CTRL_R3 },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_START]), SCE_CTRL_START },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_DPAD_UP]), SCE_CTRL_UP },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_DPAD_RIGHT]), SCE_CTRL_RIGHT },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_DPAD_DOWN]), SCE_CTRL_DOWN },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_DPAD_LEFT]), SCE_CTRL_LEFT },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_LEFTSHOULDER]), SCE_CTRL_L1 },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_RIGHTSHOULDER]), SCE_CTRL_R1 },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_Y]), SCE_CTRL_TRIANGLE },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_B]), SCE_CTRL_CIRCLE },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_A]), SCE_CTRL_CROSS },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_X]), SCE_CTRL_SQUARE },
-        { SDL_GameControllerButton(emuenv.cfg.controller_binds[SDL_CONTROLLER_BUTTON_GUIDE]), SCE_CTRL_PSBUTTON },
-    } };
+const std::array<ControllerBinding, 15> &get_controller_bindings_ext(EmuEnvState &emuenv) {
+    update_controller_bindings(emuenv.ctrl, emuenv);
+    return emuenv.ctrl.bindings_ext;
 }
 
-static void apply_controller(EmuEnvState &emuenv, uint32_t *buttons, float axes[4], SDL_GameController *controller, bool ext) {
-    if (ext) {
-        for (const auto &binding : get_controller_bindings_ext(emuenv)) {
-            if (SDL_GameControllerGetButton(controller, binding.controller)) {
-                *buttons |= binding.button;
-            }
-        }
+static void apply_controller(const CtrlState &state, CtrlPortInput &input, SDL_GameController *controller) {
+    // query each button once, the bindings of both modes are then looked up in the mask
+    uint32_t pressed = 0;
+    for (int button = 0; button < SDL_CONTROLLER_BUTTON_MAX; button++) {
+        if (SDL_GameControllerGetButton(controller, static_cast<SDL_GameControllerButton>(button)))
+            pressed |= 1U << button;
+    }
 
-        if (SDL_GameControllerGetAxis(controller, SDL_CONTROLLER_AXIS_TRIGGERLEFT) > 0x3FFF) {
-            *buttons |= SCE_CTRL_L2;
-        }
-        if (SDL_GameControllerGetAxis(controller, SDL_CONTROLLER_AXIS_TRIGGERRIGHT) > 0x3FFF) {
-            *buttons |= SCE_CTRL_R2;
-        }
-    } else {
-        for (const auto &binding : get_controller_bindings(emuenv)) {
-            if (SDL_GameControllerGetButton(controller, binding.controller)) {
-                *buttons |= binding.button;
-            }
-        }
+    const auto is_pressed = [pressed](const ControllerBinding &binding) {
+        return (binding.controller >= 0) && (binding.controller < SDL_CONTROLLER_BUTTON_MAX) && (pressed & (1U << binding.controller));
+    };
+
+    for (const auto &binding : state.bindings) {
+        if (is_pressed(binding))
+            input.buttons |= binding.button;
+    }
+    for (const auto &binding : state.bindings_ext) {
+        if (is_pressed(binding))
+            input.buttons_ext |= binding.button;
     }
 
-    axes[0] += axis_to_axis(SDL_GameControllerGetAxis(controller, SDL_CONTROLLER_AXIS_LEFTX));
-    axes[1] += axis_to_axis(SDL_GameControllerGetAxis(controller, SDL_CONTROLLER_AXIS_LEFTY));
-    axes[2] += axis_to_axis(SDL_GameControllerGetAxis(controller, SDL_CONTROLLER_AXIS_RIGHTX));
-    axes[3] += axis_to_axis(SDL_GameControllerGetAxis(controller, SDL_CONTROLLER_AXIS_RIGHTY));
+    if (SDL_GameControllerGetAxis(controller, SDL_CONTROLLER_AXIS_TRIGGERLEFT) > 0x3FFF) {
+        input.buttons_ext |= SCE_CTRL_L2;
+    }
+    if (SDL_GameControllerGetAxis(controller, SDL_CONTROLLER_AXIS_TRIGGERRIGHT) > 0x3FFF) {
+        input.buttons_ext |= SCE_CTRL_R2;
+    }
+
+    input.axes[0] += axis_to_axis(SDL_GameControllerGetAxis(controller, SDL_CONTROLLER_AXIS_LEFTX));
+    input.axes[1] += axis_to_axis(SDL_GameControllerGetAxis(controller, SDL_CONTROLLER_AXIS_LEFTY));
+    input.axes[2] += axis_to_axis(SDL_GameControllerGetAxis(controller, SDL_CONTROLLER_AXIS_RIGHTX));
+    input.axes[3] += axis_to_axis(SDL_GameControllerGetAxis(controller, SDL_CONTROLLER_AXIS_RIGHTY));
 }
 
-static void retrieve_ctrl_data(EmuEnvState &emuenv, int port, bool is_v2, bool negative, bool from_ext_function, SceUInt32 &buttons, SceUInt8 &lx, SceUInt8 &ly, SceUInt8 &rx, SceUInt8 &ry) {
-    std::lock_guard<std::mutex> guard(emuenv.ctrl.mutex);
+void update_ctrl_snapshot(EmuEnvState &emuenv) {
+    CtrlState &state = emuenv.ctrl;
+    update_controller_bindings(state, emuenv);
 
+    CtrlSnapshot snapshot = {};
+    // the keyboard is always on the first port
+    apply_keyboard(snapshot.ports[0], emuenv);
+    for (const auto &[_, controller] : state.controllers) {
+        // port 0 means all the ports were already used
+        if (controller.port > 0)
+            apply_controller(state, snapshot.ports[controller.port - 1], controller.controller.get());
+    }
+
+    state.snapshot.store(snapshot);
+}
+
+static void retrieve_ctrl_data(EmuEnvState &emuenv, int port, bool is_v2, bool negative, bool from_ext_function, SceUInt32 &buttons, SceUInt8 &lx, SceUInt8 &ly, SceUInt8 &rx, SceUInt8 &ry) {
     if (port == 0) {
         port++;
     }
     CtrlState &state = emuenv.ctrl;
-    refresh_controllers(state, emuenv);
 
     std::array<float, 4> axes;
     axes.fill(0);
@@ -349,13 +381,10 @@ static void retrieve_ctrl_data(EmuEnvState &emuenv, int port, bool is_v2, bool n
         return;
     }
 
-    if (port == 1) {
-        apply_keyboard(&buttons, axes.data(), is_v2, emuenv);
-    }
-    for (const auto &[_, controller] : state.controllers) {
-        if (controller.port == port) {
-            apply_controller(emuenv, &buttons, axes.data(), controller.controller.get(), is_v2);
-        }
+    if (port <= SCE_CTRL_MAX_WIRELESS_NUM) {
+        const CtrlPortInput input = state.snapshot.load().ports[port - 1];
+        buttons |= is_v2 ? input.buttons_ext : input.buttons;
+        std::copy_n(input.axes, axes.size(), axes.begin());
     }
 
     reset_axes();
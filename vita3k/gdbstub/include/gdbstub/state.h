@@ -18,6 +18,7 @@
 #pragma once
 
 #include <memory>
+#include <string>
 #include <thread>
 
 #ifdef _WIN32
@@ -46,6 +47,8 @@ struct GDBState {
     bool server_die = false;
 
     std::string last_reply = "";
+    // received data not parsed yet because it does not contain a complete packet
+    std::string recv_buffer;
     int thread_info_index = 0;
 
     SceUID inferior_thread = 0;
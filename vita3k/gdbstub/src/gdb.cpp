@@ -418,9 +418,20 @@ static std::string cmd_write_binary(EmuEnvState &state, PacketCommand &command)
 
 static std::string cmd_detach(EmuEnvState &state, PacketCommand &command) { return "OK"; }
 
+// stop reply for thread_id, telling gdb which watchpoint was hit if that is what stopped it
+static std::string stop_reply(EmuEnvState &state, SceUID thread_id) {
+    const auto hit = state.kernel.debugger.take_watch_hit(thread_id);
+    if (!hit)
+        return "S05";
+
+    const char *kind = (hit->type == WatchType::Write) ? "watch" : ((hit->type == WatchType::Read) ? "rwatch" : "awatch");
+    return fmt::format("T05{}:{:x};thread:{};", kind, hit->addr, to_hex(thread_id));
+}
+
 static std::string cmd_continue(EmuEnvState &state, PacketCommand &command) {
     const std::string content = content_string(command);
-    constexpr auto watch_delay = std::chrono::milliseconds(100);
+    // threads notify the debugger as soon as they are suspended, this is only how often server_die is checked
+    constexpr auto die_check_delay = std::chrono::milliseconds(100);
 
     uint64_t index = 5;
     uint64_t next = 0;
@@ -436,18 +447,22 @@ static std::string cmd_continue(EmuEnvState &state, PacketCommand &command) {
         case 'S': {
             bool step = cmd == 's' || cmd == 'S';
 
+            state.kernel.debugger.clear_suspended_threads();
+
             // inferior_thread is the thread that triggered breakpoint before
             // step or run that thread
 
             if (state.gdb.inferior_thread != 0) {
-                const auto guard = std::lock_guard(state.kernel.mutex);
-                auto thread = state.kernel.threads[state.gdb.inferior_thread];
-                auto thread_lock = std::unique_lock(thread->mutex);
+                // the kernel mutex must not be held while the thread runs, it may need it for its imports
+                auto thread = state.kernel.get_thread(state.gdb.inferior_thread);
                 thread->resume(step);
                 if (step) {
                     // Wait until it finish stepping
-                    // TODO if that thread waits for sync primitive, dead lock.
-                    thread->status_cond.wait(thread_lock, [&]() { return thread->status == ThreadStatus::suspend; });
+                    // TODO if that thread waits for sync primitive, this waits until the primitive is signaled.
+                    while (!state.kernel.debugger.wait_thread_suspended(thread->id, die_check_delay)) {
+                        if (state.gdb.server_die)
+                            return "";
+                    }
                 }
             }
 
@@ -467,25 +482,13 @@ static std::string cmd_continue(EmuEnvState &state, PacketCommand &command) {
                     }
                 }
                 // wait until some threads trigger breakpoint
-                bool did_break = false;
-                while (!did_break) {
-                    auto lock = std::unique_lock(state.kernel.mutex);
-
+                SceUID break_thread = 0;
+                while (!break_thread) {
                     if (state.gdb.server_die)
                         return "";
-                    for (const auto &[id, thread] : state.kernel.threads) {
-                        const auto thread_guard = std::lock_guard(thread->mutex);
-                        if (thread->status == ThreadStatus::suspend && hit_breakpoint(*thread->cpu)) {
-                            state.gdb.inferior_thread = id;
-                            did_break = true;
-                            break;
-                        }
-                    }
-
-                    lock.unlock();
-
-                    std::this_thread::sleep_for(std::chrono::milliseconds(watch_delay));
+                    break_thread = state.kernel.debugger.wait_thread_suspended(0, die_check_delay);
                 }
+                state.gdb.inferior_thread = break_thread;
 
                 auto thread = state.kernel.get_thread(state.gdb.inferior_thread);
                 LOG_INFO("GDB Breakpoint trigger (thread name: {}, thread_id: {})", thread->name, thread->id);
@@ -506,7 +509,7 @@ static std::string cmd_continue(EmuEnvState &state, PacketCommand &command) {
             }
 
             state.gdb.current_thread = state.gdb.inferior_thread;
-            return "S05";
+            return stop_reply(state, state.gdb.inferior_thread);
         }
         default:
             LOG_GDB("Unsupported vCont command '{}'", cmd);
@@ -591,6 +594,17 @@ static std::string cmd_add_breakpoint(EmuEnvState &state, PacketCommand &command
 
     LOG_GDB("GDB Server New Breakpoint at {} ({}, {}).", log_hex(address), type, kind);
 
+    // type 2, 3 and 4 are write, read and access watchpoints, kind is then the number of bytes watched
+    if (type >= 2 && type <= 4) {
+        const WatchType watch_type = (type == 2) ? WatchType::Write : ((type == 3) ? WatchType::Read : WatchType::Access);
+        // an empty reply lets gdb fall back to software watchpoints
+        if (!state.kernel.debugger.add_watch_memory_addr(state.mem, address, kind, watch_type)) {
+            LOG_GDB("GDB Server: watchpoints need the memory watch to be enabled.");
+            return "";
+        }
+        return "OK";
+    }
+
     // kind is 2 if it's thumb mode
     // https://sourceware.org/gdb/current/onlinedocs/gdb/ARM-Breakpoint-Kinds.html#ARM-Breakpoint-Kinds
     state.kernel.debugger.add_breakpoint(state.mem, address, kind == 2);
@@ -608,7 +622,10 @@ static std::string cmd_remove_breakpoint(EmuEnvState &state, PacketCommand &comm
     const uint32_t kind = static_cast<uint32_t>(std::stol(content.substr(second + 1, content.size() - second - 1)));
 
     LOG_GDB("GDB Server Removed Breakpoint at {} ({}, {}).", log_hex(address), type, kind);
-    state.kernel.debugger.remove_breakpoint(state.mem, address);
+    if (type >= 2 && type <= 4)
+        state.kernel.debugger.remove_watch_memory_addr(state.mem, address);
+    else
+        state.kernel.debugger.remove_breakpoint(state.mem, address);
 
     return "OK";
 }
@@ -720,50 +737,66 @@ static int64_t server_next(EmuEnvState &state) {
         LOG_GDB("GDB Server Connection Closed");
         return -1;
     }
-    buffer[length] = '\0';
 
-    for (int64_t a = 0; a < length; a++) {
-        switch (buffer[a]) {
+    // packets can be split across several recv calls or several packets received at once,
+    // keep the incomplete end of the data for the next call
+    std::string &pending = state.gdb.recv_buffer;
+    pending.append(buffer, length);
+
+    size_t a = 0;
+    while (a < pending.size() && !state.gdb.server_die) {
+        switch (pending[a]) {
         case '+': {
+            a++;
             break; // Cool.
         }
         case '-': {
-            LOG_GDB("GDB Server Transmission Error. {}", std::string(buffer, length));
+            LOG_GDB("GDB Server Transmission Error. {}", pending);
             server_reply(state.gdb, state.gdb.last_reply.c_str());
+            a++;
             break;
         }
         case '$': {
-            server_ack(state.gdb, '+');
+            // a packet ends with #XX, XX being its checksum
+            const size_t end = pending.find('#', a);
+            if (end == std::string::npos || end + 2 >= pending.size()) {
+                pending.erase(0, a);
+                return length;
+            }
 
-            PacketCommand command = parse_command(buffer + a, length - a);
+            PacketCommand command = parse_command(&pending[a], end + 3 - a);
             if (command.is_valid) {
+                server_ack(state.gdb, '+');
+
+                bool recognized = false;
                 for (const auto &function : functions) {
                     if (command_begins_with(command, function.name)) {
                         LOG_GDB("GDB Server Recognized Command as {}. {}", function.name,
                             std::string(command.content_start, command.content_length));
                         state.gdb.last_reply = function.function(state, command);
+                        recognized = true;
                         if (state.gdb.server_die)
                             break;
                         server_reply(state.gdb, state.gdb.last_reply.c_str());
                         break;
                     }
                 }
-                LOG_GDB("GDB Server Unrecognized Command. {}", std::string(command.content_start, command.content_length));
-
-                a += command.content_length + 3;
-
+                if (!recognized)
+                    LOG_GDB("GDB Server Unrecognized Command. {}", std::string(command.content_start, command.content_length));
             } else {
                 server_ack(state.gdb, '-');
 
-                LOG_GDB("GDB Server Invalid Command. {}", std::string(buffer, length));
+                LOG_GDB("GDB Server Invalid Command. {}", pending.substr(a, end + 3 - a));
             }
+            a = end + 3;
             break;
         }
-        default: break;
-        }
-        if (state.gdb.server_die)
+        default:
+            a++;
             break;
+        }
     }
+    pending.erase(0, a);
 
     return length;
 }
@@ -777,6 +810,8 @@ static void server_listen(EmuEnvState &state) {
     }
 
     LOG_INFO("GDB Server Received Connection");
+    state.gdb.recv_buffer.clear();
+    state.kernel.debugger.set_client_attached(true);
 
     int64_t status;
 
@@ -784,6 +819,7 @@ static void server_listen(EmuEnvState &state) {
         status = server_next(state);
     } while (status >= 0 && !state.gdb.server_die);
 
+    state.kernel.debugger.set_client_attached(false);
     server_close(state);
 }
 
@@ -71,6 +71,12 @@ struct App {
     compat::CompatibilityState compat;
 };
 
+// Used to know if the param.sfo of an app changed since its info was stored in the apps cache
+struct AppMetadata {
+    time_t sfo_mtime = 0;
+    uint64_t sfo_hash = 0;
+};
+
 struct AppInfo {
     std::string trophy;
     tm updated;
@@ -91,7 +97,7 @@ struct IconAsyncLoader {
 
     std::unordered_map<std::string, IconData> icon_data;
 
-    std::thread thread;
+    std::vector<std::thread> threads;
     std::atomic_bool quit = false;
 
     void commit(GuiState &gui);
@@ -103,6 +109,7 @@ struct IconAsyncLoader {
 struct AppsSelector {
     std::vector<App> sys_apps;
     std::vector<App> user_apps;
+    std::unordered_map<std::string, AppMetadata> user_apps_metadata;
     uint32_t apps_cache_lang;
     AppInfo app_info;
     std::optional<IconAsyncLoader> icon_async_loader;
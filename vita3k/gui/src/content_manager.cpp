@@ -365,11 +365,14 @@ void draw_content_manager(GuiState &gui, EmuEnvState &emuenv) {
                         fs::remove_all(emuenv.pref_path / "ux0/addcont" / content.first);
                         gui.app_selector.user_apps.erase(gui.app_selector.user_apps.begin() + (get_app_index(gui, content.first) - &gui.app_selector.user_apps[0]));
                         gui.app_selector.user_apps_icon.erase(content.first);
+                        remove_app_cache(gui, emuenv, content.first);
                     }
                     const auto SAVE_PATH{ emuenv.pref_path / "ux0/user" / emuenv.io.user_id / "savedata" / content.first };
                     fs::remove_all(SAVE_PATH);
                 }
             }
+            if (menu == "app")
+                save_apps_cache(gui, emuenv);
             init_content_manager(gui, emuenv);
             contents_selected.clear();
             content_delete = false;
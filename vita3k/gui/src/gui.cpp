@@ -38,12 +38,17 @@
 
 #include <SDL_video.h>
 #include <imgui_internal.h>
+#include <xxh3.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <fstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace gui {
@@ -314,35 +319,100 @@ vfs::FileBuffer init_default_icon(GuiState &gui, EmuEnvState &emuenv) {
     return buffer;
 }
 
-static IconData load_app_icon(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path) {
+// Decoded icons are cached as raw RGBA next to the apps cache, decoding the png is most of the icon loading time
+struct CachedIconHeader {
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int64_t icon_mtime;
+};
+
+static constexpr uint32_t CACHED_ICON_VERSION = 1;
+
+static fs::path get_cached_icon_path(EmuEnvState &emuenv, const std::string &app_path) {
+    return emuenv.pref_path / "ux0/temp/icons" / (app_path + ".rgba");
+}
+
+static bool read_cached_icon(const fs::path &cached_icon_path, time_t icon_mtime, IconData &image) {
+    fs::ifstream cached_icon(cached_icon_path, std::ios::in | std::ios::binary);
+    if (!cached_icon.is_open())
+        return false;
+
+    CachedIconHeader header;
+    if (!cached_icon.read(reinterpret_cast<char *>(&header), sizeof(header)) || (header.version != CACHED_ICON_VERSION)
+        || (header.icon_mtime != icon_mtime) || (header.width != 128) || (header.height != 128))
+        return false;
+
+    const size_t size = header.width * header.height * 4;
+    std::unique_ptr<void, void (*)(void *)> pixels(std::malloc(size), std::free);
+    if (!cached_icon.read(static_cast<char *>(pixels.get()), size))
+        return false;
+
+    image.width = header.width;
+    image.height = header.height;
+    image.data = std::move(pixels);
+    return true;
+}
+
+static void write_cached_icon(const fs::path &cached_icon_path, time_t icon_mtime, const IconData &image) {
+    boost::system::error_code error;
+    fs::create_directories(cached_icon_path.parent_path(), error);
+
+    fs::ofstream cached_icon(cached_icon_path, std::ios::out | std::ios::binary);
+    if (!cached_icon.is_open())
+        return;
+
+    const CachedIconHeader header{ CACHED_ICON_VERSION, image.width, image.height, icon_mtime };
+    cached_icon.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    cached_icon.write(static_cast<const char *>(image.data.get()), image.width * image.height * 4);
+}
+
+// Called from the icon loader threads, the title is given by the caller as the app list must not be read there
+static IconData load_app_icon(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path, const std::string &title_id, const std::string &title) {
     IconData image;
     vfs::FileBuffer buffer;
 
-    const auto APP_INDEX = get_app_index(gui, app_path);
+    // the default icon is not cached, only the ones of the apps
+    boost::system::error_code error;
+    const time_t icon_mtime = fs::last_write_time(emuenv.pref_path / "ux0/app" / app_path / "sce_sys/icon0.png", error);
+    const bool use_cache = !error;
+    if (use_cache && read_cached_icon(get_cached_icon_path(emuenv, app_path), icon_mtime, image))
+        return image;
 
     if (!vfs::read_app_file(buffer, emuenv.pref_path, app_path, "sce_sys/icon0.png")) {
         buffer = init_default_icon(gui, emuenv);
         if (buffer.empty()) {
             LOG_WARN("Default icon not found for title {}, [{}] in path {}.",
-                APP_INDEX->title_id, APP_INDEX->title, app_path);
+                title_id, title, app_path);
             return {};
         } else
-            LOG_INFO("Default icon found for App {}, [{}] in path {}.", APP_INDEX->title_id, APP_INDEX->title, app_path);
+            LOG_INFO("Default icon found for App {}, [{}] in path {}.", title_id, title, app_path);
     }
     image.data.reset(stbi_load_from_memory(
         buffer.data(), static_cast<int>(buffer.size()),
         &image.width, &image.height, nullptr, STBI_rgb_alpha));
     if (!image.data || image.width != 128 || image.height != 128) {
         LOG_ERROR("Invalid icon for title {}, [{}] in path {}.",
-            APP_INDEX->title_id, APP_INDEX->title, app_path);
+            title_id, title, app_path);
         return {};
     }
 
+    if (use_cache)
+        write_cached_icon(get_cached_icon_path(emuenv, app_path), icon_mtime, image);
+
     return image;
 }
 
+void remove_app_cache(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path) {
+    gui.app_selector.user_apps_metadata.erase(app_path);
+
+    boost::system::error_code error;
+    fs::remove(get_cached_icon_path(emuenv, app_path), error);
+}
+
 void init_app_icon(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path) {
-    IconData data = load_app_icon(gui, emuenv, app_path);
+    const auto APP_INDEX = get_app_index(gui, app_path);
+    IconData data = load_app_icon(gui, emuenv, app_path, APP_INDEX ? APP_INDEX->title_id : app_path, APP_INDEX ? APP_INDEX->title : app_path);
     if (data.data) {
         gui.app_selector.user_apps_icon[app_path].init(gui.imgui_state.get(), data.data.get(), data.width, data.height);
     }
@@ -366,34 +436,50 @@ void IconAsyncLoader::commit(GuiState &gui) {
 IconAsyncLoader::IconAsyncLoader(GuiState &gui, EmuEnvState &emuenv, const std::vector<gui::App> &app_list) {
     // I don't feel comfortable passing app_list down to be iterated by thread.
     // Methods like delete_app might mutate it, so I'd like to copy what I need now.
-    auto paths = [&app_list]() {
-        std::vector<std::string> copy(app_list.size());
-        std::transform(app_list.begin(), app_list.end(), copy.begin(), [](const auto &a) { return a.path; });
+    struct IconSource {
+        std::string path;
+        std::string title_id;
+        std::string title;
+    };
+    auto sources = [&app_list]() {
+        std::vector<IconSource> copy(app_list.size());
+        std::transform(app_list.begin(), app_list.end(), copy.begin(), [](const auto &a) { return IconSource{ a.path, a.title_id, a.title }; });
 
         return copy;
     };
 
     quit = false;
-    thread = std::thread([&, paths = paths()]() {
-        for (const auto &path : paths) {
-            if (quit)
-                return;
-
-            // load the actual texture
-            IconData data = load_app_icon(gui, emuenv, path);
-
-            // Duplicate code here from init_app_icon
-            {
-                std::lock_guard<std::mutex> lock(mutex);
-                icon_data[path] = std::move(data);
+    auto shared_sources = std::make_shared<const std::vector<IconSource>>(sources());
+    auto next_path = std::make_shared<std::atomic<size_t>>(0);
+
+    // icons are independent, decode them on several threads
+    const size_t thread_count = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, 8);
+    for (size_t i = 0; i < std::min(thread_count, shared_sources->size()); i++) {
+        threads.emplace_back([&, shared_sources, next_path]() {
+            for (size_t index = (*next_path)++; index < shared_sources->size(); index = (*next_path)++) {
+                if (quit)
+                    return;
+
+                const IconSource &source = (*shared_sources)[index];
+                const std::string &path = source.path;
+
+                // load the actual texture
+                IconData data = load_app_icon(gui, emuenv, path, source.title_id, source.title);
+
+                // Duplicate code here from init_app_icon
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    icon_data[path] = std::move(data);
+                }
             }
-        }
-    });
+        });
+    }
 }
 
 IconAsyncLoader::~IconAsyncLoader() {
     quit = true;
-    thread.join();
+    for (auto &thread : threads)
+        thread.join();
 }
 
 void init_apps_icon(GuiState &gui, EmuEnvState &emuenv, const std::vector<gui::App> &app_list) {
@@ -439,59 +525,83 @@ std::string get_sys_lang_name(uint32_t lang_id) {
     return current_sys_lang->second;
 }
 
-static bool get_user_apps(GuiState &gui, EmuEnvState &emuenv) {
+static constexpr uint32_t APPS_CACHE_VERSION = 2;
+
+static bool read_apps_cache(EmuEnvState &emuenv, std::vector<App> &apps, std::unordered_map<std::string, AppMetadata> &apps_metadata, uint32_t &cache_lang) {
     const auto apps_cache_path{ emuenv.pref_path / "ux0/temp/apps.dat" };
     fs::ifstream apps_cache(apps_cache_path, std::ios::in | std::ios::binary);
-    if (apps_cache.is_open()) {
-        gui.app_selector.user_apps.clear();
-        // Read size of apps list
-        size_t size;
-        apps_cache.read((char *)&size, sizeof(size));
-
-        // Check version of cache
-        uint32_t versionInFile;
-        apps_cache.read((char *)&versionInFile, sizeof(uint32_t));
-        if (versionInFile != 1) {
-            LOG_WARN("Current version of cache: {}, is outdated, recreate it.", versionInFile);
-            return false;
-        }
+    if (!apps_cache.is_open())
+        return false;
+
+    // Read size of apps list
+    size_t size;
+    apps_cache.read((char *)&size, sizeof(size));
+
+    // Check version of cache
+    uint32_t versionInFile;
+    apps_cache.read((char *)&versionInFile, sizeof(uint32_t));
+    if (versionInFile != APPS_CACHE_VERSION) {
+        LOG_WARN("Current version of cache: {}, is outdated, recreate it.", versionInFile);
+        return false;
+    }
 
-        // Read language of cache
-        apps_cache.read((char *)&gui.app_selector.apps_cache_lang, sizeof(uint32_t));
-        if (gui.app_selector.apps_cache_lang != emuenv.cfg.sys_lang) {
-            LOG_WARN("Current lang of cache: {}, is different configuration: {}, recreate it.", get_sys_lang_name(gui.app_selector.apps_cache_lang), get_sys_lang_name(emuenv.cfg.sys_lang));
-            return false;
-        }
+    // Read language of cache
+    apps_cache.read((char *)&cache_lang, sizeof(uint32_t));
 
-        // Read App info value
-        for (size_t a = 0; a < size; a++) {
-            auto read = [&apps_cache]() {
-                size_t size;
+    // Read App info value
+    for (size_t a = 0; a < size; a++) {
+        auto read = [&apps_cache]() {
+            size_t size;
 
-                apps_cache.read((char *)&size, sizeof(size));
+            apps_cache.read((char *)&size, sizeof(size));
 
-                std::vector<char> buffer(size); // dont trust std::string to hold buffer enough
-                apps_cache.read(buffer.data(), size);
+            std::vector<char> buffer(size); // dont trust std::string to hold buffer enough
+            apps_cache.read(buffer.data(), size);
 
-                return std::string(buffer.begin(), buffer.end());
-            };
+            return std::string(buffer.begin(), buffer.end());
+        };
 
-            App app;
+        App app;
 
-            app.app_ver = read();
-            app.category = read();
-            app.content_id = read();
-            app.addcont = read();
-            app.savedata = read();
-            app.parental_level = read();
-            app.stitle = read();
-            app.title = read();
-            app.title_id = read();
-            app.path = read();
+        app.app_ver = read();
+        app.category = read();
+        app.content_id = read();
+        app.addcont = read();
+        app.savedata = read();
+        app.parental_level = read();
+        app.stitle = read();
+        app.title = read();
+        app.title_id = read();
+        app.path = read();
 
-            gui.app_selector.user_apps.push_back(app);
-        }
+        AppMetadata metadata;
+        apps_cache.read((char *)&metadata.sfo_mtime, sizeof(metadata.sfo_mtime));
+        apps_cache.read((char *)&metadata.sfo_hash, sizeof(metadata.sfo_hash));
+        if (!apps_cache)
+            return false;
+
+        apps_metadata[app.path] = metadata;
+        apps.push_back(app);
+    }
+
+    return true;
+}
+
+static bool get_user_apps(GuiState &gui, EmuEnvState &emuenv) {
+    gui.app_selector.user_apps.clear();
+    gui.app_selector.user_apps_metadata.clear();
+    if (!read_apps_cache(emuenv, gui.app_selector.user_apps, gui.app_selector.user_apps_metadata, gui.app_selector.apps_cache_lang)) {
+        gui.app_selector.user_apps.clear();
+        return false;
+    }
+
+    if (gui.app_selector.apps_cache_lang != emuenv.cfg.sys_lang) {
+        LOG_WARN("Current lang of cache: {}, is different configuration: {}, recreate it.", get_sys_lang_name(gui.app_selector.apps_cache_lang), get_sys_lang_name(emuenv.cfg.sys_lang));
+        gui.app_selector.user_apps.clear();
+        return false;
+    }
 
+    if (!gui.app_selector.user_apps.empty()) {
         init_apps_icon(gui, emuenv, gui.app_selector.user_apps);
         load_and_update_compat_user_apps(gui, emuenv);
     }
@@ -510,7 +620,7 @@ void save_apps_cache(GuiState &gui, EmuEnvState &emuenv) {
         apps_cache.write((char *)&size, sizeof(size));
 
         // Write version of cache
-        const uint32_t versionInFile = 1;
+        const uint32_t versionInFile = APPS_CACHE_VERSION;
         apps_cache.write((const char *)&versionInFile, sizeof(uint32_t));
 
         // Write language of cache
@@ -536,6 +646,12 @@ void save_apps_cache(GuiState &gui, EmuEnvState &emuenv) {
             write(app.title);
             write(app.title_id);
             write(app.path);
+
+            // an app without metadata is parsed again on the next scan
+            const auto metadata_it = gui.app_selector.user_apps_metadata.find(app.path);
+            const AppMetadata metadata = (metadata_it != gui.app_selector.user_apps_metadata.end()) ? metadata_it->second : AppMetadata{};
+            apps_cache.write((const char *)&metadata.sfo_mtime, sizeof(metadata.sfo_mtime));
+            apps_cache.write((const char *)&metadata.sfo_hash, sizeof(metadata.sfo_hash));
         }
         apps_cache.close();
     }
@@ -600,16 +716,33 @@ App *get_app_index(GuiState &gui, const std::string &app_path) {
     return (app_index != app_type.end()) ? &(*app_index) : nullptr;
 }
 
+static App make_app(const sfo::SfoAppInfo &info, const std::string &app_path) {
+    return { info.app_version, info.app_category, info.app_content_id, info.app_addcont, info.app_savedata, info.app_parental_level, info.app_short_title, info.app_title, info.app_title_id, app_path };
+}
+
+static void get_default_app_info(sfo::SfoAppInfo &info, const std::string &app_path) {
+    info.app_addcont = info.app_savedata = info.app_short_title = info.app_title = info.app_title_id = app_path; // Use app path as TitleID, addcont, Savedata, Short title and Title
+    info.app_version = info.app_category = info.app_parental_level = "N/A";
+}
+
+static time_t get_app_sfo_mtime(EmuEnvState &emuenv, const std::string &app_path) {
+    boost::system::error_code error;
+    const time_t mtime = fs::last_write_time(emuenv.pref_path / "ux0/app" / app_path / "sce_sys/param.sfo", error);
+    return error ? 0 : mtime;
+}
+
 void get_app_param(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path) {
     emuenv.app_path = app_path;
     vfs::FileBuffer param;
+    AppMetadata metadata;
     if (vfs::read_app_file(param, emuenv.pref_path, app_path, "sce_sys/param.sfo")) {
         sfo::get_param_info(emuenv.app_info, param, emuenv.cfg.sys_lang);
+        metadata = { get_app_sfo_mtime(emuenv, app_path), XXH3_64bits(param.data(), param.size()) };
     } else {
-        emuenv.app_info.app_addcont = emuenv.app_info.app_savedata = emuenv.app_info.app_short_title = emuenv.app_info.app_title = emuenv.app_info.app_title_id = emuenv.app_path; // Use app path as TitleID, addcont, Savedata, Short title and Title
-        emuenv.app_info.app_version = emuenv.app_info.app_category = emuenv.app_info.app_parental_level = "N/A";
+        get_default_app_info(emuenv.app_info, emuenv.app_path);
     }
-    gui.app_selector.user_apps.push_back({ emuenv.app_info.app_version, emuenv.app_info.app_category, emuenv.app_info.app_content_id, emuenv.app_info.app_addcont, emuenv.app_info.app_savedata, emuenv.app_info.app_parental_level, emuenv.app_info.app_short_title, emuenv.app_info.app_title, emuenv.app_info.app_title_id, emuenv.app_path });
+    gui.app_selector.user_apps.push_back(make_app(emuenv.app_info, emuenv.app_path));
+    gui.app_selector.user_apps_metadata[app_path] = metadata;
 }
 
 void get_user_apps_title(GuiState &gui, EmuEnvState &emuenv) {
@@ -617,15 +750,79 @@ void get_user_apps_title(GuiState &gui, EmuEnvState &emuenv) {
     if (!fs::exists(app_path))
         return;
 
-    gui.app_selector.user_apps.clear();
+    std::vector<std::string> app_paths;
     for (const auto &app : fs::directory_iterator(app_path)) {
         if (!app.path().empty() && fs::is_directory(app.path())
             && !app.path().filename_is_dot() && !app.path().filename_is_dot_dot()) {
-            const auto app_path = app.path().stem().generic_string();
-            get_app_param(gui, emuenv, app_path);
+            app_paths.push_back(app.path().stem().generic_string());
         }
     }
 
+    // the apps already in the cache are only parsed again if their param.sfo changed
+    std::vector<App> cached_apps;
+    std::unordered_map<std::string, AppMetadata> cached_metadata;
+    uint32_t cache_lang = 0;
+    std::unordered_map<std::string, const App *> cached_apps_by_path;
+    if (read_apps_cache(emuenv, cached_apps, cached_metadata, cache_lang) && (cache_lang == emuenv.cfg.sys_lang)) {
+        for (const App &app : cached_apps)
+            cached_apps_by_path[app.path] = &app;
+    }
+
+    std::vector<App> apps(app_paths.size());
+    std::vector<AppMetadata> apps_metadata(app_paths.size());
+    std::atomic<size_t> next_app = 0;
+    std::atomic<size_t> parsed_count = 0;
+    const auto scan_apps = [&]() {
+        for (size_t index = next_app++; index < app_paths.size(); index = next_app++) {
+            const std::string &path = app_paths[index];
+            const auto cached_app = cached_apps_by_path.find(path);
+            const bool is_cached = cached_app != cached_apps_by_path.end();
+            const AppMetadata cached = is_cached ? cached_metadata.at(path) : AppMetadata{};
+            AppMetadata &metadata = apps_metadata[index];
+
+            metadata.sfo_mtime = get_app_sfo_mtime(emuenv, path);
+            if (is_cached && metadata.sfo_mtime && (cached.sfo_mtime == metadata.sfo_mtime)) {
+                apps[index] = *cached_app->second;
+                metadata.sfo_hash = cached.sfo_hash;
+                continue;
+            }
+
+            vfs::FileBuffer param;
+            sfo::SfoAppInfo info;
+            if (vfs::read_app_file(param, emuenv.pref_path, path, "sce_sys/param.sfo")) {
+                metadata.sfo_hash = XXH3_64bits(param.data(), param.size());
+                // only the modification time changed, the content is the same
+                if (is_cached && (cached.sfo_hash == metadata.sfo_hash)) {
+                    apps[index] = *cached_app->second;
+                    continue;
+                }
+
+                sfo::get_param_info(info, param, emuenv.cfg.sys_lang);
+            } else {
+                metadata = {};
+                get_default_app_info(info, path);
+            }
+            apps[index] = make_app(info, path);
+            parsed_count++;
+        }
+    };
+
+    // reading the param.sfo files is mostly waiting for the disk, use a few threads even with a small number of cores
+    const size_t thread_count = std::min<size_t>(std::clamp<size_t>(std::thread::hardware_concurrency(), 2, 8), app_paths.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < thread_count; i++)
+        threads.emplace_back(scan_apps);
+    scan_apps();
+    for (auto &thread : threads)
+        thread.join();
+
+    LOG_INFO("Found {} applications, {} of them were not in the cache or changed.", apps.size(), parsed_count.load());
+
+    gui.app_selector.user_apps = std::move(apps);
+    gui.app_selector.user_apps_metadata.clear();
+    for (size_t i = 0; i < app_paths.size(); i++)
+        gui.app_selector.user_apps_metadata[app_paths[i]] = apps_metadata[i];
+
     save_apps_cache(gui, emuenv);
 }
 
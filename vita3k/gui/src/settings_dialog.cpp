@@ -942,6 +942,11 @@ void draw_settings_dialog(GuiState &gui, EmuEnvState &emuenv) {
                 ImGui::SetTooltip("%s", lang.gpu["spirv_shader_description"].c_str());
             }
         }
+        if (is_vulkan) {
+            ImGui::Checkbox(lang.gpu["spirv_optimization"].c_str(), &emuenv.cfg.spirv_optimization);
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("%s", lang.gpu["spirv_optimization_description"].c_str());
+        }
         const auto shaders_cache_path{ emuenv.cache_path / "shaders" };
         if (fs::exists(shaders_cache_path) && !fs::is_empty(shaders_cache_path)) {
             ImGui::Spacing();
@@ -1355,17 +1360,17 @@ void draw_settings_dialog(GuiState &gui, EmuEnvState &emuenv) {
         ImGui::Spacing();
         if (ImGui::Button(emuenv.kernel.debugger.watch_code ? lang.debug["unwatch_code"].c_str() : lang.debug["watch_code"].c_str())) {
             emuenv.kernel.debugger.watch_code = !emuenv.kernel.debugger.watch_code;
-            emuenv.kernel.debugger.update_watches();
+            emuenv.kernel.debugger.update_watches(emuenv.mem);
         }
         ImGui::SameLine();
         if (ImGui::Button(emuenv.kernel.debugger.watch_memory ? lang.debug["unwatch_memory"].c_str() : lang.debug["watch_memory"].c_str())) {
             emuenv.kernel.debugger.watch_memory = !emuenv.kernel.debugger.watch_memory;
-            emuenv.kernel.debugger.update_watches();
+            emuenv.kernel.debugger.update_watches(emuenv.mem);
         }
         ImGui::SameLine();
         if (ImGui::Button(emuenv.kernel.debugger.watch_import_calls ? lang.debug["unwatch_import_calls"].c_str() : lang.debug["watch_import_calls"].c_str())) {
             emuenv.kernel.debugger.watch_import_calls = !emuenv.kernel.debugger.watch_import_calls;
-            emuenv.kernel.debugger.update_watches();
+            emuenv.kernel.debugger.update_watches(emuenv.mem);
         }
 
 #ifdef TRACY_ENABLE
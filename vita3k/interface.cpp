@@ -566,7 +566,6 @@ static void take_screenshot(EmuEnvState &emuenv) {
 }
 
 bool handle_events(EmuEnvState &emuenv, GuiState &gui) {
-    refresh_controllers(emuenv.ctrl, emuenv);
     const auto allow_switch_state = !emuenv.io.title_id.empty() && !gui.vita_area.app_close && !gui.vita_area.home_screen && !gui.vita_area.user_management && !gui.configuration_menu.custom_settings_dialog && !gui.configuration_menu.settings_dialog && !gui.controls_menu.controls_dialog && gui::get_sys_apps_state(gui);
 
     const auto ui_navigation = [&emuenv, &gui, allow_switch_state](const uint32_t sce_ctrl_btn) {
@@ -764,6 +763,11 @@ bool handle_events(EmuEnvState &emuenv, GuiState &gui) {
             }
             break;
 
+        case SDL_CONTROLLERDEVICEADDED:
+        case SDL_CONTROLLERDEVICEREMOVED:
+            refresh_controllers(emuenv.ctrl, emuenv);
+            break;
+
         case SDL_CONTROLLERTOUCHPADDOWN:
         case SDL_CONTROLLERTOUCHPADMOTION:
         case SDL_CONTROLLERTOUCHPADUP:
@@ -798,6 +802,9 @@ bool handle_events(EmuEnvState &emuenv, GuiState &gui) {
         }
     }
 
+    // the SDL input state is only updated while polling the events, sample it once for the guest
+    update_ctrl_snapshot(emuenv);
+
     return true;
 }
 
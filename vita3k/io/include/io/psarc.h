@@ -0,0 +1,79 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class WorkerPool;
+
+namespace psarc {
+
+enum class Compression {
+    NONE,
+    ZLIB,
+    LZMA,
+};
+
+struct Entry {
+    std::string path;
+    uint32_t first_block;
+    uint64_t size;
+    uint64_t offset;
+};
+
+// Reads size bytes at offset of the underlying archive file, returns false on short reads.
+// The archive only calls it from the thread issuing the read, never from decompression workers.
+using ReadCallback = std::function<bool(uint64_t offset, void *dst, uint64_t size)>;
+
+struct Archive {
+    Compression compression = Compression::NONE;
+    uint32_t block_size = 0;
+    bool ignore_case = false;
+
+    // Entry 0 is the manifest and is not listed in entry_indices
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, uint32_t> entry_indices;
+
+    // Compressed size of every block, 0 meaning a full block_size, and its offset from the start of its entry
+    std::vector<uint32_t> block_sizes;
+    std::vector<uint64_t> block_offsets;
+
+    bool open(ReadCallback read_callback);
+
+    // Looks an entry up by its manifest path, with or without the leading slash. Returns -1 when missing.
+    int32_t find(const std::string &path) const;
+
+    // Reads size bytes at offset of the given entry, decompressing the covered blocks on up to thread_count threads.
+    // Returns the amount of bytes read or -1 if the archive data could not be read or decompressed.
+    int64_t read(uint32_t entry_index, uint64_t offset, void *dst, uint64_t size, uint32_t thread_count = 1) const;
+
+private:
+    ReadCallback read_callback;
+    // Decompression threads, started by the first read needing them and kept for the next ones, null until open
+    std::shared_ptr<WorkerPool> workers;
+
+    std::string normalize(const std::string &path) const;
+    bool decompress_block(const uint8_t *src, uint32_t src_size, uint8_t *dst, uint32_t dst_size) const;
+};
+
+} // namespace psarc
@@ -0,0 +1,242 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <io/psarc.h>
+
+#include <util/log.h>
+#include <util/worker_pool.h>
+
+#include <miniz.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+
+namespace psarc {
+
+static constexpr uint32_t PSARC_HEADER_SIZE = 0x20;
+static constexpr uint32_t PSARC_TOC_ENTRY_MIN_SIZE = 0x1E;
+static constexpr uint32_t PSARC_FLAG_IGNORE_CASE = 1;
+
+static uint64_t read_be(const uint8_t *data, const uint32_t bytes) {
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < bytes; i++)
+        value = (value << 8) | data[i];
+    return value;
+}
+
+bool Archive::open(ReadCallback callback) {
+    read_callback = std::move(callback);
+    if (!workers)
+        workers = std::make_shared<WorkerPool>();
+    entries.clear();
+    entry_indices.clear();
+    block_sizes.clear();
+    block_offsets.clear();
+
+    uint8_t header[PSARC_HEADER_SIZE];
+    if (!read_callback(0, header, sizeof(header)) || memcmp(header, "PSAR", 4) != 0) {
+        LOG_ERROR("Not a PSARC archive");
+        return false;
+    }
+
+    if (memcmp(header + 0x8, "zlib", 4) == 0)
+        compression = Compression::ZLIB;
+    else if (memcmp(header + 0x8, "lzma", 4) == 0)
+        compression = Compression::LZMA;
+    else
+        compression = Compression::NONE;
+
+    const uint32_t toc_length = static_cast<uint32_t>(read_be(header + 0xC, 4));
+    const uint32_t toc_entry_size = static_cast<uint32_t>(read_be(header + 0x10, 4));
+    const uint32_t toc_entries = static_cast<uint32_t>(read_be(header + 0x14, 4));
+    block_size = static_cast<uint32_t>(read_be(header + 0x18, 4));
+    ignore_case = read_be(header + 0x1C, 4) & PSARC_FLAG_IGNORE_CASE;
+
+    if ((toc_entries == 0) || (toc_entry_size < PSARC_TOC_ENTRY_MIN_SIZE) || (block_size == 0) || (toc_length < PSARC_HEADER_SIZE + static_cast<uint64_t>(toc_entries) * toc_entry_size)) {
+        LOG_ERROR("Invalid PSARC table of contents (length: {}, entry size: {}, entries: {}, block size: {})", toc_length, toc_entry_size, toc_entries, block_size);
+        return false;
+    }
+
+    std::vector<uint8_t> toc(toc_length - PSARC_HEADER_SIZE);
+    if (!read_callback(PSARC_HEADER_SIZE, toc.data(), toc.size())) {
+        LOG_ERROR("Failed to read PSARC table of contents");
+        return false;
+    }
+
+    // Each block size is stored on as many bytes as needed to represent block_size - 1
+    uint32_t block_size_bytes = 1;
+    while ((1ULL << (8 * block_size_bytes)) < block_size)
+        block_size_bytes++;
+
+    const size_t block_table_offset = static_cast<size_t>(toc_entries) * toc_entry_size;
+    const size_t block_count = (toc.size() - block_table_offset) / block_size_bytes;
+    block_sizes.resize(block_count);
+    for (size_t i = 0; i < block_count; i++)
+        block_sizes[i] = static_cast<uint32_t>(read_be(&toc[block_table_offset + i * block_size_bytes], block_size_bytes));
+
+    block_offsets.resize(block_count);
+    entries.resize(toc_entries);
+    for (uint32_t i = 0; i < toc_entries; i++) {
+        // The first 16 bytes are the MD5 of the entry path, which is not needed to look entries up
+        const uint8_t *toc_entry = &toc[static_cast<size_t>(i) * toc_entry_size];
+        Entry &entry = entries[i];
+        entry.first_block = static_cast<uint32_t>(read_be(toc_entry + 0x10, 4));
+        entry.size = read_be(toc_entry + 0x14, 5);
+        entry.offset = read_be(toc_entry + 0x19, 5);
+
+        const uint64_t entry_blocks = (entry.size + block_size - 1) / block_size;
+        if (entry.first_block + entry_blocks > block_count) {
+            LOG_ERROR("PSARC entry {} references blocks outside of the block table", i);
+            return false;
+        }
+
+        uint64_t offset = 0;
+        for (uint64_t block = entry.first_block; block < entry.first_block + entry_blocks; block++) {
+            block_offsets[block] = offset;
+            offset += block_sizes[block] ? block_sizes[block] : block_size;
+        }
+    }
+
+    // Entry 0 is the manifest, a newline separated list of the paths of the following entries
+    std::string manifest(entries[0].size, '\0');
+    if (read(0, 0, manifest.data(), manifest.size()) != static_cast<int64_t>(manifest.size())) {
+        LOG_ERROR("Failed to read PSARC manifest");
+        return false;
+    }
+
+    uint32_t entry_index = 1;
+    size_t line_start = 0;
+    while ((line_start < manifest.size()) && (entry_index < toc_entries)) {
+        size_t line_end = manifest.find('\n', line_start);
+        if (line_end == std::string::npos)
+            line_end = manifest.size();
+
+        std::string path = manifest.substr(line_start, line_end - line_start);
+        if (!path.empty() && (path.back() == '\r'))
+            path.pop_back();
+
+        entries[entry_index].path = path;
+        entry_indices.emplace(normalize(path), entry_index);
+        entry_index++;
+        line_start = line_end + 1;
+    }
+
+    return true;
+}
+
+std::string Archive::normalize(const std::string &path) const {
+    std::string normalized = path;
+    std::replace(normalized.begin(), normalized.end(), '\\', '/');
+    if (!normalized.starts_with('/'))
+        normalized.insert(normalized.begin(), '/');
+    if (ignore_case)
+        std::transform(normalized.begin(), normalized.end(), normalized.begin(), [](unsigned char c) { return std::tolower(c); });
+
+    return normalized;
+}
+
+int32_t Archive::find(const std::string &path) const {
+    const auto it = entry_indices.find(normalize(path));
+    if (it == entry_indices.end())
+        return -1;
+
+    return static_cast<int32_t>(it->second);
+}
+
+bool Archive::decompress_block(const uint8_t *src, uint32_t src_size, uint8_t *dst, uint32_t dst_size) const {
+    // Blocks which do not shrink when compressed are stored as is
+    if (src_size == dst_size) {
+        memcpy(dst, src, dst_size);
+        return true;
+    }
+
+    switch (compression) {
+    case Compression::ZLIB: {
+        mz_ulong dest_len = dst_size;
+        const int res = mz_uncompress(dst, &dest_len, src, src_size);
+        if ((res != MZ_OK) || (dest_len != dst_size)) {
+            LOG_ERROR("Failed to decompress PSARC block: {}", mz_error(res));
+            return false;
+        }
+        return true;
+    }
+    case Compression::LZMA:
+        LOG_ERROR_ONCE("LZMA compressed PSARC blocks are not supported");
+        return false;
+    default:
+        LOG_ERROR("Unexpected PSARC block size {} for a stored block of {} bytes", src_size, dst_size);
+        return false;
+    }
+}
+
+int64_t Archive::read(uint32_t entry_index, uint64_t offset, void *dst, uint64_t size, uint32_t thread_count) const {
+    if (entry_index >= entries.size())
+        return -1;
+
+    const Entry &entry = entries[entry_index];
+    if (offset >= entry.size)
+        return 0;
+
+    size = std::min(size, entry.size - offset);
+    if (size == 0)
+        return 0;
+
+    const uint64_t first = offset / block_size;
+    const uint64_t last = (offset + size - 1) / block_size;
+    const uint64_t count = last - first + 1;
+
+    const auto compressed_size = [&](uint64_t block) -> uint64_t {
+        const uint32_t value = block_sizes[entry.first_block + block];
+        return value ? value : block_size;
+    };
+
+    // All the blocks of an entry are contiguous, fetch the whole compressed range in one go
+    const uint64_t src_begin = block_offsets[entry.first_block + first];
+    const uint64_t src_end = block_offsets[entry.first_block + last] + compressed_size(last);
+    std::vector<uint8_t> src(src_end - src_begin);
+    if (!read_callback(entry.offset + src_begin, src.data(), src.size()))
+        return -1;
+
+    std::vector<uint8_t> blocks(count * block_size);
+    std::atomic<bool> failed = false;
+
+    const std::function<void(size_t)> decompress_block_at = [&](size_t i) {
+        if (failed)
+            return;
+
+        const uint64_t block = first + i;
+        const uint64_t block_start = block * block_size;
+        const uint32_t dst_size = static_cast<uint32_t>(std::min<uint64_t>(block_size, entry.size - block_start));
+        const uint8_t *block_src = &src[block_offsets[entry.first_block + block] - src_begin];
+
+        if (!decompress_block(block_src, static_cast<uint32_t>(compressed_size(block)), &blocks[i * block_size], dst_size))
+            failed = true;
+    };
+
+    const auto worker_count = static_cast<uint32_t>(std::min<uint64_t>(std::max(thread_count, 1U), count) - 1);
+    workers->run(worker_count, count, decompress_block_at);
+
+    if (failed)
+        return -1;
+
+    memcpy(dst, &blocks[offset - first * block_size], size);
+    return static_cast<int64_t>(size);
+}
+
+} // namespace psarc
@@ -0,0 +1,193 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <io/psarc.h>
+
+#include <miniz.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstring>
+#include <random>
+#include <thread>
+
+namespace {
+
+constexpr uint32_t TEST_BLOCK_SIZE = 0x100;
+
+void write_be(std::vector<uint8_t> &out, uint64_t value, uint32_t bytes) {
+    for (uint32_t i = 0; i < bytes; i++)
+        out.push_back(static_cast<uint8_t>(value >> (8 * (bytes - i - 1))));
+}
+
+// Builds a zlib PSARC laid out like the ones shipped by games: header, table of contents, block sizes and then the entries data
+std::vector<uint8_t> build_psarc(const std::vector<std::pair<std::string, std::vector<uint8_t>>> &files) {
+    std::vector<std::vector<uint8_t>> contents;
+    std::string manifest;
+    for (const auto &[path, data] : files)
+        manifest += (manifest.empty() ? "" : "\n") + path;
+    contents.emplace_back(manifest.begin(), manifest.end());
+    for (const auto &[path, data] : files)
+        contents.push_back(data);
+
+    std::vector<uint8_t> data;
+    std::vector<uint32_t> block_sizes;
+    std::vector<uint32_t> first_blocks;
+    std::vector<uint64_t> offsets;
+    for (const auto &content : contents) {
+        first_blocks.push_back(static_cast<uint32_t>(block_sizes.size()));
+        offsets.push_back(data.size());
+        for (size_t start = 0; start < content.size(); start += TEST_BLOCK_SIZE) {
+            const mz_ulong raw_size = static_cast<mz_ulong>(std::min<size_t>(TEST_BLOCK_SIZE, content.size() - start));
+            std::vector<uint8_t> compressed(mz_compressBound(raw_size));
+            mz_ulong compressed_size = static_cast<mz_ulong>(compressed.size());
+            EXPECT_EQ(mz_compress(compressed.data(), &compressed_size, &content[start], raw_size), MZ_OK);
+
+            if (compressed_size < raw_size) {
+                data.insert(data.end(), compressed.begin(), compressed.begin() + compressed_size);
+                block_sizes.push_back(compressed_size);
+            } else {
+                data.insert(data.end(), content.begin() + start, content.begin() + start + raw_size);
+                block_sizes.push_back(raw_size == TEST_BLOCK_SIZE ? 0 : raw_size);
+            }
+        }
+    }
+
+    const uint32_t toc_length = 0x20 + static_cast<uint32_t>(contents.size()) * 0x1E + static_cast<uint32_t>(block_sizes.size());
+
+    std::vector<uint8_t> archive = { 'P', 'S', 'A', 'R' };
+    write_be(archive, 0x00010004, 4);
+    archive.insert(archive.end(), { 'z', 'l', 'i', 'b' });
+    write_be(archive, toc_length, 4);
+    write_be(archive, 0x1E, 4);
+    write_be(archive, contents.size(), 4);
+    write_be(archive, TEST_BLOCK_SIZE, 4);
+    write_be(archive, 0, 4);
+
+    for (size_t i = 0; i < contents.size(); i++) {
+        archive.insert(archive.end(), 16, 0);
+        write_be(archive, first_blocks[i], 4);
+        write_be(archive, contents[i].size(), 5);
+        write_be(archive, toc_length + offsets[i], 5);
+    }
+
+    for (const uint32_t block_size : block_sizes)
+        write_be(archive, block_size, 1);
+
+    archive.insert(archive.end(), data.begin(), data.end());
+    return archive;
+}
+
+psarc::ReadCallback memory_reader(const std::vector<uint8_t> &archive) {
+    return [&archive](uint64_t offset, void *dst, uint64_t size) {
+        if (offset + size > archive.size())
+            return false;
+        memcpy(dst, &archive[offset], size);
+        return true;
+    };
+}
+
+std::vector<uint8_t> make_text(size_t size) {
+    const std::string pattern = "The quick brown fox jumps over the lazy dog. ";
+    std::vector<uint8_t> text(size);
+    for (size_t i = 0; i < size; i++)
+        text[i] = pattern[i % pattern.size()];
+    return text;
+}
+
+std::vector<uint8_t> make_noise(size_t size) {
+    std::mt19937 rng(42);
+    std::vector<uint8_t> noise(size);
+    for (auto &byte : noise)
+        byte = static_cast<uint8_t>(rng());
+    return noise;
+}
+
+} // namespace
+
+TEST(psarc, reads_entries_through_manifest) {
+    const auto text = make_text(1000);
+    const auto noise = make_noise(300);
+    const auto archive_data = build_psarc({ { "/data/text.txt", text }, { "data/noise.bin", noise } });
+
+    psarc::Archive archive;
+    ASSERT_TRUE(archive.open(memory_reader(archive_data)));
+    EXPECT_EQ(archive.compression, psarc::Compression::ZLIB);
+    ASSERT_EQ(archive.entries.size(), 3);
+
+    const int32_t text_index = archive.find("data/text.txt");
+    const int32_t noise_index = archive.find("/data/noise.bin");
+    ASSERT_EQ(text_index, 1);
+    ASSERT_EQ(noise_index, 2);
+    EXPECT_EQ(archive.find("/data/missing.bin"), -1);
+
+    std::vector<uint8_t> out(text.size());
+    ASSERT_EQ(archive.read(text_index, 0, out.data(), out.size()), static_cast<int64_t>(text.size()));
+    EXPECT_EQ(out, text);
+
+    out.resize(noise.size());
+    ASSERT_EQ(archive.read(noise_index, 0, out.data(), out.size()), static_cast<int64_t>(noise.size()));
+    EXPECT_EQ(out, noise);
+}
+
+TEST(psarc, reads_ranges_across_blocks_in_parallel) {
+    const auto text = make_text(TEST_BLOCK_SIZE * 16 + 17);
+    const auto archive_data = build_psarc({ { "/big.txt", text } });
+
+    psarc::Archive archive;
+    ASSERT_TRUE(archive.open(memory_reader(archive_data)));
+
+    // The decompression threads are kept between the reads, and only some of them may be used
+    for (const uint32_t threads : { 1, 4, 2, 4 }) {
+        std::vector<uint8_t> out(TEST_BLOCK_SIZE * 5);
+        const uint64_t offset = TEST_BLOCK_SIZE * 3 + 10;
+        ASSERT_EQ(archive.read(1, offset, out.data(), out.size(), threads), static_cast<int64_t>(out.size()));
+        EXPECT_TRUE(std::equal(out.begin(), out.end(), text.begin() + offset));
+    }
+
+    // Reads past the end of an entry are clamped to its size
+    std::vector<uint8_t> tail(64);
+    ASSERT_EQ(archive.read(1, text.size() - 17, tail.data(), tail.size(), 4), 17);
+    EXPECT_TRUE(std::equal(tail.begin(), tail.begin() + 17, text.end() - 17));
+    EXPECT_EQ(archive.read(1, text.size(), tail.data(), tail.size()), 0);
+
+    // Reads issued while another one uses the threads decompress on their own thread
+    std::vector<std::thread> readers;
+    std::atomic<int> failures = 0;
+    for (int i = 0; i < 4; i++) {
+        readers.emplace_back([&, i] {
+            std::vector<uint8_t> out(TEST_BLOCK_SIZE * 8);
+            const uint64_t offset = TEST_BLOCK_SIZE * i + i;
+            for (int j = 0; j < 50; j++) {
+                if ((archive.read(1, offset, out.data(), out.size(), 4) != static_cast<int64_t>(out.size())) || !std::equal(out.begin(), out.end(), text.begin() + offset))
+                    failures++;
+            }
+        });
+    }
+    for (auto &reader : readers)
+        reader.join();
+    EXPECT_EQ(failures, 0);
+}
+
+TEST(psarc, rejects_invalid_archives) {
+    std::vector<uint8_t> archive_data = build_psarc({ { "/file.bin", make_noise(16) } });
+    archive_data[0] = 'X';
+
+    psarc::Archive archive;
+    EXPECT_FALSE(archive.open(memory_reader(archive_data)));
+}
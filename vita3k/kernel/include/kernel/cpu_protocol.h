@@ -28,6 +28,9 @@ struct CPUProtocol : public CPUProtocolBase {
     ~CPUProtocol() override = default;
     void call_svc(CPUState &cpu, uint32_t svc, Address pc, ThreadState &thread) override;
     Address get_watch_memory_addr(Address addr) override;
+    bool on_watch_memory_access(SceUID thread_id, Address addr, bool write) override;
+    void rearm_memory_watch() override;
+    uint32_t apply_code_breakpoints(Address addr, uint32_t code) override;
 #ifdef USE_DYNARMIC
     ExclusiveMonitorPtr get_exlusive_monitor() override;
 #endif
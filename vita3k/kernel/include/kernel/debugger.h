@@ -20,6 +20,14 @@
 #include <map>
 #include <mem/state.h>
 #include <mem/util.h>
+#include <util/containers.h>
+#include <util/types.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <optional>
+#include <set>
 
 constexpr uint32_t TRAMPOLINE_JUMPER_SVC = 0x54;
 constexpr uint32_t TRAMPOLINE_HANDLER_SVC = 0x53;
@@ -43,12 +51,34 @@ struct Breakpoint {
     unsigned char data[4];
 };
 
+struct SuspendedThread {
+    SceUID thread_id;
+    bool hit_breakpoint;
+};
+
+enum class WatchType {
+    // only log the accesses, used by the memory watch option
+    Log,
+    // gdb watchpoints, the accessing thread is stopped
+    Write,
+    Read,
+    Access,
+};
+
 struct WatchMemory {
     Address start;
     size_t size;
+    WatchType type = WatchType::Log;
+};
+
+struct WatchHit {
+    Address addr;
+    WatchType type;
 };
 
 typedef std::map<Address, WatchMemory> WatchMemoryAddrs;
+// page number -> watched ranges intersecting this page
+typedef unordered_map_fast<Address, std::vector<WatchMemory>> WatchMemoryPages;
 typedef std::map<Address, Breakpoint> Breakpoints;
 typedef std::map<Address, std::unique_ptr<Trampoline>> Trampolines;
 
@@ -65,20 +95,58 @@ struct Debugger {
     bool log_exports = false;
     bool dump_elfs = false;
 
-    void add_watch_memory_addr(Address addr, size_t size);
-    void remove_watch_memory_addr(KernelState &state, Address addr);
+    // return false if the watch can not be armed because the memory watch is disabled
+    bool add_watch_memory_addr(MemState &mem, Address addr, size_t size, WatchType type = WatchType::Log);
+    void remove_watch_memory_addr(MemState &mem, Address addr);
     void add_breakpoint(MemState &mem, uint32_t addr, bool thumb_mode);
     void remove_breakpoint(MemState &mem, uint32_t addr);
+    // replace the bytes of the code word at addr covered by a breakpoint with a BKPT instruction
+    uint32_t apply_code_breakpoints(Address addr, uint32_t code);
     void add_trampoile(MemState &mem, uint32_t addr, bool thumb_mode, const TrampolineCallback &callback);
     Trampoline *get_trampoline(Address addr);
     void remove_trampoline(MemState &mem, uint32_t addr);
     Address get_watch_memory_addr(Address addr);
-    void update_watches();
+    // called when thread_id accessed watched memory, return true if the thread must stop
+    bool on_watch_memory_access(SceUID thread_id, Address addr, bool write);
+    // the watchpoint which stopped thread_id, if any
+    std::optional<WatchHit> take_watch_hit(SceUID thread_id);
+    // protect again the watched pages which have been accessed since the last call
+    void rearm_watch_memory(MemState &mem);
+    void update_watches(MemState &mem);
+
+    // called by a thread once it is suspended, wakes up the gdb stub waiting for it
+    void notify_thread_suspended(SceUID thread_id, bool hit_breakpoint);
+    void clear_suspended_threads();
+    // suspensions are only recorded while a gdb client is connected
+    void set_client_attached(bool attached);
+    // wait for thread_id to be suspended, or any thread to hit a breakpoint if thread_id is 0
+    // return the id of the suspended thread or 0 on timeout
+    SceUID wait_thread_suspended(SceUID thread_id, std::chrono::milliseconds timeout);
 
 private:
     std::mutex mutex;
     KernelState &parent;
     WatchMemoryAddrs watch_memory_addrs;
+    WatchMemoryPages watch_memory_pages;
+    // with dynarmic, memory watches are implemented by protecting the watched pages
+    bool watch_pages_protected = false;
+    bool watch_pages_need_rearm = false;
+    // start of the watched ranges with a protection currently in place
+    std::set<Address> armed_watches;
+    // watchpoint hit by each stopped thread
+    std::map<SceUID, WatchHit> watch_hits;
+
+    bool use_page_watch() const;
+    void protect_watch_memory(MemState &mem, const std::vector<WatchMemory> &watches);
+    // with dynarmic, breakpoints are inserted in the code given to the JIT instead of the guest memory
+    bool use_jit_breakpoints() const;
     Breakpoints breakpoints;
+    // read without mutex by apply_code_breakpoints
+    std::atomic<bool> has_breakpoints = false;
     Trampolines trampolines;
+
+    std::mutex suspend_mutex;
+    std::condition_variable suspend_cond;
+    std::vector<SuspendedThread> suspended_threads;
+    bool client_attached = false;
 };
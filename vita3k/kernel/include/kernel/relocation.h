@@ -20,6 +20,10 @@
 #include <mem/ptr.h>
 
 #include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 struct MemState;
 
@@ -30,9 +34,91 @@ struct SegmentInfoForReloc {
 };
 using SegmentInfosForReloc = std::map<uint16_t, SegmentInfoForReloc>;
 
+// symbol_segment values which are not a segment index
+constexpr uint8_t RELOC_SYMBOL_NONE = 0xf; // the symbol value is 0
+constexpr uint8_t RELOC_SYMBOL_EXPLICIT = 0x10; // the symbol value is given when applying the relocations (var imports)
+
+// A single relocation, decoded from the packed entries and independent of where the segments are loaded
+struct Relocation {
+    uint32_t patch_offset; // offset of the patched word in its segment
+    uint32_t addend;
+    uint8_t patch_segment;
+    uint8_t symbol_segment;
+    uint8_t code;
+};
+
+enum class RelocationGroup : uint8_t {
+    Absolute,
+    Original,
+    Relative,
+    Mov,
+    Call,
+};
+
+// Position of a relocation in its group
+struct RelocationRef {
+    RelocationGroup group;
+    uint32_t index;
+};
+
+// Relocations grouped by the kind of write they do, each group is applied in its own pass
+struct RelocationTable {
+    std::vector<Relocation> absolute; // Abs32, Target1 and Abs8
+    // Abs32 relative to the segment containing the original value (formats 6 to 9)
+    // addend is 1 when the symbol of the previous relocation of this group is kept if no segment contains the value
+    std::vector<Relocation> original;
+    std::vector<Relocation> relative; // Rel32, Target2 and Prel31
+    std::vector<Relocation> mov; // MOVW/MOVT, ARM and Thumb
+    std::vector<Relocation> call; // Call, Jump24 and ThumbCall
+
+    // Only filled when relocations of different groups patch the same word, the result then depends on their order
+    // (formats 6 to 9 read the value in memory, and the last write wins): all of them are applied in the order of the entries
+    std::vector<RelocationRef> entry_order;
+
+    std::vector<Relocation> &get_group(RelocationGroup group);
+    const std::vector<Relocation> &get_group(RelocationGroup group) const;
+
+    size_t size() const {
+        return absolute.size() + original.size() + relative.size() + mov.size() + call.size();
+    }
+};
+using RelocationTablePtr = std::shared_ptr<const RelocationTable>;
+
+/**
+ * \param is_var_import True when alternate format 1 should be used (it's used for var import relocations)
+ * \return True on success, false on error
+ */
+bool decode_relocations(const void *entries, uint32_t size, bool is_var_import, RelocationTable &table);
+
+/**
+ * \param explicit_symval Value of the symbol for the relocations using RELOC_SYMBOL_EXPLICIT
+ * \return True on success, false on error
+ */
+bool apply_relocations(const RelocationTable &table, const SegmentInfosForReloc &segments, const MemState &mem, uint32_t explicit_symval = 0);
+
 /**
  * \param is_var_import True when alternate format 1 should be used (it's used for var import relocations)
  * \param explicit_symval Used only if is_var_import is true, specifies the value to be written to the relocation target
  * \return True on success, false on error
  */
 bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &segments, const MemState &mem, bool is_var_import = false, uint32_t explicit_symval = 0);
+
+// Decoded relocation tables of the modules loaded so far, indexed by the hash of their relocation data
+// Loading the same module again (PRX reloaded by the game or the app restarted) skips the decoding
+struct RelocationCache {
+    RelocationTablePtr get(const void *entries, uint32_t size);
+
+private:
+    struct CachedTable {
+        // compared on a hash hit, so that colliding relocation data never shares a table
+        std::vector<uint8_t> entries;
+        RelocationTablePtr table;
+    };
+
+    std::mutex mutex;
+    std::unordered_multimap<uint64_t, CachedTable> tables;
+    // size of the relocation data kept in tables
+    size_t cached_size = 0;
+};
+
+bool relocate(RelocationCache &cache, const void *entries, uint32_t size, const SegmentInfosForReloc &segments, const MemState &mem);
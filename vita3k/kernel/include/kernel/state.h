@@ -20,6 +20,7 @@
 #include <kernel/callback.h>
 #include <kernel/cpu_protocol.h>
 #include <kernel/debugger.h>
+#include <kernel/relocation.h>
 #include <kernel/sync_primitives.h>
 #include <kernel/types.h>
 #include <mem/allocator.h>
@@ -138,6 +139,11 @@ struct KernelState {
     FuncBindingInfos func_binding_infos;
     VarBindingInfos var_binding_infos;
     ModuleUidByNid module_uid_by_nid;
+    // stub values of the var imports without export, allocated from a single block and never freed
+    Address var_import_stubs_next = 0;
+    Address var_import_stubs_end = 0;
+
+    RelocationCache relocation_cache;
 
     bool cpu_opt;
     CPUBackend cpu_backend;
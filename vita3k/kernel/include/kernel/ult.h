@@ -0,0 +1,199 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <cpu/common.h>
+#include <util/types.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct ThreadState;
+typedef std::shared_ptr<ThreadState> ThreadStatePtr;
+
+// User-level threads (SceUlt) scheduled M:N on the worker threads of their runtime.
+// Nothing here enters the kernel: every object is protected by the single lock held by the caller,
+// a blocked ulthread is simply left out of the ready queue until another ulthread or thread wakes it.
+namespace ult {
+
+// Identifies the owner of a mutex or write lock: a ulthread (by guest address) or a kernel thread
+using Owner = uint64_t;
+
+inline Owner kernel_thread_owner(SceUID thread_id) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(thread_id)) << 32) | 1;
+}
+
+enum class UlthreadStatus {
+    Ready,
+    Running,
+    Waiting,
+    Finished
+};
+
+struct Ulthread;
+struct Runtime;
+
+// A ulthread or a kernel thread blocked on one of the objects below
+struct Waiter {
+    Ulthread *ulthread = nullptr;
+    // only used by kernel threads, which sleep until woken is set
+    std::condition_variable *cond = nullptr;
+    bool woken = false;
+
+    Owner owner = 0;
+    int32_t count = 0;
+    bool write = false;
+    void *data = nullptr;
+};
+
+struct Ulthread {
+    Address address = 0;
+    std::string name;
+    Address entry = 0;
+    uint32_t arg = 0;
+    Address stack_top = 0;
+    Runtime *runtime = nullptr;
+
+    UlthreadStatus status = UlthreadStatus::Ready;
+    bool started = false;
+    int32_t exit_status = 0;
+
+    // guest registers while the ulthread is not running
+    CPUContext context;
+    Waiter waiter;
+    std::deque<Waiter *> joiners;
+};
+
+struct Worker {
+    Runtime *runtime = nullptr;
+    ThreadStatePtr thread;
+    std::thread host_thread;
+    Ulthread *current = nullptr;
+    // where the worker returns when it has no ulthread left to run
+    CPUContext dispatch_context;
+};
+
+struct Runtime {
+    Address address = 0;
+    std::string name;
+    uint32_t max_ulthreads = 0;
+    uint32_t ulthread_count = 0;
+
+    std::deque<Ulthread *> ready;
+    // idle workers sleep here until a ulthread becomes ready
+    std::condition_variable ready_cond;
+    std::vector<std::unique_ptr<Worker>> workers;
+    bool shutdown = false;
+
+    // guest code entered by the workers, see the SceUlt module
+    Address dispatch_stub = 0;
+    Address exit_stub = 0;
+
+    uint64_t switch_count = 0;
+};
+
+struct Mutex {
+    Address address = 0;
+    std::string name;
+    Owner owner = 0;
+    std::deque<Waiter *> waiters;
+};
+
+struct ConditionVariable {
+    Address address = 0;
+    std::string name;
+    Mutex *mutex = nullptr;
+    std::deque<Waiter *> waiters;
+};
+
+struct Semaphore {
+    Address address = 0;
+    std::string name;
+    int32_t count = 0;
+    std::deque<Waiter *> waiters;
+};
+
+struct ReaderWriterLock {
+    Address address = 0;
+    std::string name;
+    uint32_t readers = 0;
+    Owner writer = 0;
+    std::deque<Waiter *> waiters;
+};
+
+struct Queue;
+
+struct QueueDataPool {
+    Address address = 0;
+    std::string name;
+    uint32_t capacity = 0;
+    uint32_t used = 0;
+    uint32_t data_size = 0;
+    std::vector<Queue *> queues;
+};
+
+struct Queue {
+    Address address = 0;
+    std::string name;
+    uint32_t data_size = 0;
+    QueueDataPool *pool = nullptr;
+    std::deque<std::vector<uint8_t>> data;
+    std::deque<Waiter *> pushers;
+    std::deque<Waiter *> poppers;
+};
+
+void make_ready(Ulthread &ulthread);
+void wake(Waiter &waiter);
+// Take the next ulthread to run on a worker of the runtime, nullptr if there is none
+Ulthread *pop_ready(Runtime &runtime);
+
+// The functions below return true when the operation completed,
+// false when the waiter was queued and the caller must block until it is woken.
+bool join(Ulthread &ulthread, Waiter &waiter);
+// Returns true if a joiner took the exit status, the ulthread can then be released
+bool finish(Ulthread &ulthread, int32_t status);
+
+bool mutex_lock(Mutex &mutex, Waiter &waiter);
+bool mutex_try_lock(Mutex &mutex, Owner owner);
+// Returns false if the owner does not hold the mutex
+bool mutex_unlock(Mutex &mutex, Owner owner);
+
+// The waiter must hold the mutex of the condition variable, it holds it again once woken
+void condition_variable_wait(ConditionVariable &cond, Waiter &waiter);
+void condition_variable_signal(ConditionVariable &cond, bool all);
+
+bool semaphore_acquire(Semaphore &semaphore, Waiter &waiter);
+bool semaphore_try_acquire(Semaphore &semaphore, int32_t count);
+void semaphore_release(Semaphore &semaphore, int32_t count);
+
+bool rwlock_lock(ReaderWriterLock &rwlock, Waiter &waiter);
+bool rwlock_try_lock(ReaderWriterLock &rwlock, Owner owner, bool write);
+bool rwlock_unlock_read(ReaderWriterLock &rwlock);
+bool rwlock_unlock_write(ReaderWriterLock &rwlock, Owner owner);
+
+bool queue_push(Queue &queue, Waiter &waiter);
+bool queue_try_push(Queue &queue, const void *data);
+bool queue_pop(Queue &queue, Waiter &waiter);
+bool queue_try_pop(Queue &queue, void *data);
+
+} // namespace ult
@@ -63,6 +63,18 @@ Address CPUProtocol::get_watch_memory_addr(Address addr) {
     return kernel->debugger.get_watch_memory_addr(addr);
 }
 
+bool CPUProtocol::on_watch_memory_access(SceUID thread_id, Address addr, bool write) {
+    return kernel->debugger.on_watch_memory_access(thread_id, addr, write);
+}
+
+void CPUProtocol::rearm_memory_watch() {
+    kernel->debugger.rearm_watch_memory(*mem);
+}
+
+uint32_t CPUProtocol::apply_code_breakpoints(Address addr, uint32_t code) {
+    return kernel->debugger.apply_code_breakpoints(addr, code);
+}
+
 #ifdef USE_DYNARMIC
 ExclusiveMonitorPtr CPUProtocol::get_exlusive_monitor() {
     return kernel->exclusive_monitor;
@@ -15,8 +15,10 @@
 // with this program; if not, write to the Free Software Foundation, Inc.,
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
+#include <cpu/functions.h>
 #include <kernel/debugger.h>
 #include <kernel/state.h>
+#include <mem/functions.h>
 #include <util/align.h>
 #include <util/log.h>
 
@@ -27,29 +29,113 @@ inline bool is_thumb16(uint32_t inst) {
     return (inst & 0xF8000000) < 0xE8000000;
 }
 
+bool Debugger::use_jit_breakpoints() const {
+    // dynarmic fetches the code to translate through MemoryReadCode, unicorn reads the guest memory directly
+    return parent.cpu_backend == CPUBackend::Dynarmic;
+}
+
+// The guest memory is never accessed while mutex is held: a watched page faults and its handler takes mutex too
+
 void Debugger::add_breakpoint(MemState &mem, uint32_t addr, bool thumb_mode) {
-    const auto lock = std::lock_guard(mutex);
     Breakpoint bk;
     bk.thumb_mode = thumb_mode;
-    if (thumb_mode) {
-        std::memcpy(&bk.data, Ptr<uint8_t>(addr).get(mem), sizeof(THUMB_BREAKPOINT));
-        std::memcpy(Ptr<uint8_t>(addr).get(mem), THUMB_BREAKPOINT, sizeof(THUMB_BREAKPOINT));
-    } else {
-        std::memcpy(&bk.data, Ptr<uint8_t>(addr).get(mem), sizeof(ARM_BREAKPOINT));
-        std::memcpy(Ptr<uint8_t>(addr).get(mem), ARM_BREAKPOINT, sizeof(ARM_BREAKPOINT));
+    const size_t size = thumb_mode ? sizeof(THUMB_BREAKPOINT) : sizeof(ARM_BREAKPOINT);
+    std::memcpy(&bk.data, Ptr<uint8_t>(addr).get(mem), size);
+    // with dynarmic the guest memory is left untouched, see apply_code_breakpoints
+    if (!use_jit_breakpoints())
+        std::memcpy(Ptr<uint8_t>(addr).get(mem), thumb_mode ? THUMB_BREAKPOINT : ARM_BREAKPOINT, size);
+
+    {
+        const auto lock = std::lock_guard(mutex);
+        breakpoints.emplace(addr, bk);
+        has_breakpoints = true;
     }
-    breakpoints.emplace(addr, bk);
+    // only the blocks containing this instruction are translated again
     parent.invalidate_jit_cache(addr, 4);
 }
 
 void Debugger::remove_breakpoint(MemState &mem, uint32_t addr) {
-    const auto lock = std::lock_guard(mutex);
-    if (breakpoints.contains(addr)) {
-        auto last = breakpoints[addr];
+    Breakpoint last;
+    {
+        const auto lock = std::lock_guard(mutex);
+        const auto it = breakpoints.find(addr);
+        if (it == breakpoints.end())
+            return;
+
+        last = it->second;
+        breakpoints.erase(it);
+        has_breakpoints = !breakpoints.empty();
+    }
+
+    if (!use_jit_breakpoints())
         std::memcpy(Ptr<uint8_t>(addr).get(mem), &last.data, last.thumb_mode ? sizeof(THUMB_BREAKPOINT) : sizeof(ARM_BREAKPOINT));
-        breakpoints.erase(addr);
-        parent.invalidate_jit_cache(addr, 4);
+    parent.invalidate_jit_cache(addr, 4);
+}
+
+uint32_t Debugger::apply_code_breakpoints(Address addr, uint32_t code) {
+    // called for every code word translated, skip the lock when there is nothing to apply
+    if (!has_breakpoints)
+        return code;
+
+    const auto lock = std::lock_guard(mutex);
+    if (breakpoints.empty())
+        return code;
+
+    uint8_t *code_bytes = reinterpret_cast<uint8_t *>(&code);
+    // a breakpoint is at most 4 bytes long, the ones starting up to 3 bytes before addr can overlap the word
+    for (auto it = breakpoints.lower_bound(addr >= 3 ? addr - 3 : 0); it != breakpoints.end() && it->first < addr + 4; ++it) {
+        const unsigned char *patch = it->second.thumb_mode ? THUMB_BREAKPOINT : ARM_BREAKPOINT;
+        const uint32_t patch_size = it->second.thumb_mode ? sizeof(THUMB_BREAKPOINT) : sizeof(ARM_BREAKPOINT);
+        for (uint32_t i = 0; i < patch_size; i++) {
+            const Address byte_addr = it->first + i;
+            if (byte_addr >= addr && byte_addr < addr + 4)
+                code_bytes[byte_addr - addr] = patch[i];
+        }
     }
+
+    return code;
+}
+
+void Debugger::notify_thread_suspended(SceUID thread_id, bool hit_breakpoint) {
+    {
+        const auto lock = std::lock_guard(suspend_mutex);
+        // only the gdb stub waits for them, and it clears them before resuming the threads
+        if (!client_attached)
+            return;
+        suspended_threads.push_back({ thread_id, hit_breakpoint });
+    }
+    suspend_cond.notify_all();
+}
+
+void Debugger::set_client_attached(bool attached) {
+    const auto lock = std::lock_guard(suspend_mutex);
+    client_attached = attached;
+    suspended_threads.clear();
+}
+
+void Debugger::clear_suspended_threads() {
+    {
+        const auto lock = std::lock_guard(mutex);
+        watch_hits.clear();
+    }
+    const auto lock = std::lock_guard(suspend_mutex);
+    suspended_threads.clear();
+}
+
+SceUID Debugger::wait_thread_suspended(SceUID thread_id, std::chrono::milliseconds timeout) {
+    auto lock = std::unique_lock(suspend_mutex);
+    SceUID result = 0;
+    suspend_cond.wait_for(lock, timeout, [&]() {
+        for (const SuspendedThread &thread : suspended_threads) {
+            if (thread_id ? thread.thread_id == thread_id : thread.hit_breakpoint) {
+                result = thread.thread_id;
+                return true;
+            }
+        }
+        return false;
+    });
+
+    return result;
 }
 
 void Debugger::add_trampoile(MemState &mem, uint32_t addr, bool thumb_mode, const TrampolineCallback &callback) {
@@ -109,41 +195,198 @@ Trampoline *Debugger::get_trampoline(Address addr) {
 }
 
 void Debugger::remove_trampoline(MemState &mem, uint32_t addr) {
-    std::lock_guard<std::mutex> lock(mutex);
-    const auto it = trampolines.find(addr);
-    if (it != trampolines.end()) {
-        uint32_t *insts = Ptr<uint32_t>(addr).get(mem);
-        insts[0] = it->second->original;
+    std::unique_ptr<Trampoline> tr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto it = trampolines.find(addr);
+        if (it == trampolines.end())
+            return;
+
+        tr = std::move(it->second);
         trampolines.erase(it);
-        parent.invalidate_jit_cache(addr, 4);
     }
+
+    uint32_t *insts = Ptr<uint32_t>(addr).get(mem);
+    insts[0] = tr->original;
+    parent.invalidate_jit_cache(addr, 4);
 }
 
 Debugger::Debugger(KernelState &kernel)
     : parent(kernel) {
 }
 
-void Debugger::add_watch_memory_addr(Address addr, size_t size) {
+static constexpr uint32_t WATCH_PAGE_SIZE = KiB(4);
+
+bool Debugger::use_page_watch() const {
+    // unicorn calls get_watch_memory_addr on every memory access instead
+    return parent.cpu_backend == CPUBackend::Dynarmic;
+}
+
+void Debugger::protect_watch_memory(MemState &mem, const std::vector<WatchMemory> &watches) {
+    // must be called without holding mutex, the protect callback locks it while protect_mutex is held
+    for (const WatchMemory &watch : watches) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            // protections on the same pages get merged, a page already protected for something else is fine
+            if (!armed_watches.insert(watch.start).second)
+                continue;
+        }
+
+        add_protect(mem, watch.start, static_cast<uint32_t>(watch.size), MemPerm::None, [this, watch](Address addr, bool write) {
+            // this is called from the access violation handler of the thread doing the access
+            // every watch sharing the faulting segment gets this call, only the first one containing addr handles it
+            bool stop = false;
+            const Address start = get_watch_memory_addr(addr);
+            if (start == watch.start) {
+                LOG_TRACE("{} watched memory at address {} + {} ({})", write ? "Write" : "Read", log_hex(start), log_hex(addr - start), log_hex(addr));
+                stop = on_watch_memory_access(current_thread_id(), addr, write);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                armed_watches.erase(watch.start);
+                watch_pages_need_rearm = true;
+            }
+            // the whole protected segment gets unprotected, protect it again once the access is done
+            request_watch_rearm(stop);
+            return true;
+        });
+    }
+}
+
+void Debugger::rearm_watch_memory(MemState &mem) {
+    std::vector<WatchMemory> watches;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!watch_pages_protected || !watch_pages_need_rearm)
+            return;
+
+        watch_pages_need_rearm = false;
+        for (const auto &[_, watch] : watch_memory_addrs)
+            watches.push_back(watch);
+    }
+    protect_watch_memory(mem, watches);
+}
+
+bool Debugger::add_watch_memory_addr(MemState &mem, Address addr, size_t size, WatchType type) {
+    if (size == 0)
+        return false;
+
+    const WatchMemory watch{ addr, size, type };
+    bool need_protect;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // unicorn only checks the watches when it logs the memory accesses, dynarmic only protects the pages then
+        if (type != WatchType::Log && !watch_memory)
+            return false;
+
+        watch_memory_addrs.insert_or_assign(addr, watch);
+        for (Address page = addr / WATCH_PAGE_SIZE; page <= (addr + size - 1) / WATCH_PAGE_SIZE; page++) {
+            auto &page_watches = watch_memory_pages[page];
+            std::erase_if(page_watches, [&](const WatchMemory &item) { return item.start == addr; });
+            page_watches.push_back(watch);
+        }
+        need_protect = watch_pages_protected;
+    }
+
+    if (need_protect)
+        protect_watch_memory(mem, { watch });
+
+    return true;
+}
+
+void Debugger::remove_watch_memory_addr(MemState &mem, Address addr) {
+    WatchMemory watch;
+    bool armed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto it = watch_memory_addrs.find(addr);
+        if (it == watch_memory_addrs.end())
+            return;
+
+        watch = it->second;
+        for (Address page = watch.start / WATCH_PAGE_SIZE; page <= (watch.start + watch.size - 1) / WATCH_PAGE_SIZE; page++) {
+            auto &page_watches = watch_memory_pages[page];
+            std::erase_if(page_watches, [&](const WatchMemory &item) { return item.start == watch.start; });
+            if (page_watches.empty())
+                watch_memory_pages.erase(page);
+        }
+        watch_memory_addrs.erase(it);
+        armed = armed_watches.erase(watch.start) > 0;
+    }
+
+    // like in protect_watch_memory, the protection must be changed without holding mutex
+    // the pages stay protected if another protection shares them
+    if (armed)
+        remove_protect(mem, watch.start, static_cast<uint32_t>(watch.size));
+}
+
+bool Debugger::on_watch_memory_access(SceUID thread_id, Address addr, bool write) {
     std::lock_guard<std::mutex> lock(mutex);
-    watch_memory_addrs.emplace(addr, WatchMemory{ addr, size });
+    const auto it = watch_memory_pages.find(addr / WATCH_PAGE_SIZE);
+    if (it == watch_memory_pages.end() || !thread_id)
+        return false;
+
+    for (const WatchMemory &watch : it->second) {
+        if (addr < watch.start || addr >= watch.start + watch.size)
+            continue;
+
+        const bool match = (watch.type == WatchType::Access)
+            || (watch.type == WatchType::Write && write)
+            || (watch.type == WatchType::Read && !write);
+        if (match) {
+            watch_hits[thread_id] = { addr, watch.type };
+            return true;
+        }
+    }
+
+    return false;
 }
 
-void Debugger::remove_watch_memory_addr(KernelState &state, Address addr) {
+std::optional<WatchHit> Debugger::take_watch_hit(SceUID thread_id) {
     std::lock_guard<std::mutex> lock(mutex);
-    watch_memory_addrs.erase(addr);
+    const auto it = watch_hits.find(thread_id);
+    if (it == watch_hits.end())
+        return std::nullopt;
+
+    const WatchHit hit = it->second;
+    watch_hits.erase(it);
+    return hit;
 }
 
-// TODO use boost icl or interval tree instead if this turns out to be a significant bottleneck
 Address Debugger::get_watch_memory_addr(Address addr) {
     std::lock_guard<std::mutex> lock(mutex);
-    for (const auto &item : watch_memory_addrs) {
-        if (item.second.start <= addr && addr < item.second.start + item.second.size) {
-            return item.second.start;
+    const auto it = watch_memory_pages.find(addr / WATCH_PAGE_SIZE);
+    if (it == watch_memory_pages.end())
+        return 0;
+
+    for (const WatchMemory &watch : it->second) {
+        if (watch.start <= addr && addr < watch.start + watch.size) {
+            return watch.start;
         }
     }
     return 0;
 }
 
-void Debugger::update_watches() {
+void Debugger::update_watches(MemState &mem) {
     parent.set_memory_watch(watch_memory);
+
+    if (!use_page_watch())
+        return;
+
+    std::vector<WatchMemory> watches;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (watch_memory == watch_pages_protected)
+            return;
+
+        // when disabled, the pages which are still protected are not armed again after their next access
+        watch_pages_protected = watch_memory;
+        if (!watch_memory)
+            return;
+
+        for (const auto &[_, watch] : watch_memory_addrs)
+            watches.push_back(watch);
+    }
+    protect_watch_memory(mem, watches);
 }
@@ -113,6 +113,10 @@ void KernelState::load_process_param(MemState &mem, Ptr<uint32_t> ptr) {
 }
 
 void KernelState::set_memory_watch(bool enabled) {
+    // dynarmic uses page protection for the memory watch, logging all memory accesses is not needed
+    if (cpu_backend == CPUBackend::Dynarmic)
+        return;
+
     std::lock_guard<std::mutex> lock(mutex);
     for (const auto &thread : threads) {
         auto &cpu = *thread.second->cpu;
@@ -58,6 +58,25 @@ struct VarImportsHeader {
 };
 static_assert(sizeof(VarImportsHeader) == sizeof(uint32_t));
 
+// must be called with export_nids_mutex locked
+static Ptr<uint32_t> alloc_var_import_stub(KernelState &kernel, MemState &mem) {
+    // stubs are never freed, allocate them from a shared block instead of using a page for each
+    if (kernel.var_import_stubs_next == kernel.var_import_stubs_end) {
+        constexpr uint32_t STUBS_BLOCK_SIZE = KiB(4);
+        const Address block = alloc(mem, STUBS_BLOCK_SIZE, "Stub var import reloc symvals");
+        if (!block) {
+            LOG_ERROR("Failed to allocate the var import stubs");
+            return {};
+        }
+        kernel.var_import_stubs_next = block;
+        kernel.var_import_stubs_end = block + STUBS_BLOCK_SIZE;
+    }
+
+    const Ptr<uint32_t> stub(kernel.var_import_stubs_next);
+    kernel.var_import_stubs_next += sizeof(uint32_t);
+    return stub;
+}
+
 static bool load_var_imports(const uint32_t *nids, const Ptr<uint32_t> *entries, size_t count, const SegmentInfosForReloc &segments, KernelState &kernel, MemState &mem, uint32_t module_id) {
     const std::lock_guard<std::mutex> guard(kernel.export_nids_mutex);
     for (size_t i = 0; i < count; ++i) {
@@ -83,8 +102,9 @@ static bool load_var_imports(const uint32_t *nids, const Ptr<uint32_t> *entries,
             constexpr auto STUB_SYMVAL = 0xDEADBEEF;
             LOG_DEBUG("\tNID NOT FOUND {} ({}) at {}, setting to stub value {}", log_hex(nid), name, log_hex(entry.address()), log_hex(STUB_SYMVAL));
 
-            auto alloc_name = fmt::format("Stub var import reloc symval, NID {} ({})", log_hex(nid), name);
-            auto stub_symval_ptr = Ptr<uint32_t>(alloc(mem, 4, alloc_name.c_str()));
+            const auto stub_symval_ptr = alloc_var_import_stub(kernel, mem);
+            if (!stub_symval_ptr)
+                return false;
             *stub_symval_ptr.get(mem) = STUB_SYMVAL;
 
             export_address = stub_symval_ptr.address();
@@ -393,8 +413,9 @@ static bool unload_var_exports(const uint32_t *nids, const Ptr<uint32_t> *entrie
         // replace again the nid by a stub
         constexpr auto STUB_SYMVAL = 0xDEADBEEF;
 
-        auto alloc_name = fmt::format("Stub var import reloc symval, NID {} ({})", log_hex(nid), import_name(nid));
-        auto stub_symval_ptr = Ptr<uint32_t>(alloc(mem, 4, alloc_name.c_str()));
+        const auto stub_symval_ptr = alloc_var_import_stub(kernel, mem);
+        if (!stub_symval_ptr)
+            return false;
         *stub_symval_ptr.get(mem) = STUB_SYMVAL;
 
         const Ptr<uint32_t> entry = stub_symval_ptr;
@@ -643,12 +664,12 @@ SceUID load_self(KernelState &kernel, MemState &mem, const void *self, const std
 
                 int res = mz_uncompress(uncompressed.get(), &dest_bytes, compressed_segment_bytes, static_cast<mz_ulong>(seg_infos[seg_index].length));
                 assert(res == MZ_OK);
-                if (!relocate(uncompressed.get(), seg_header.p_filesz, segment_reloc_info, mem)) {
+                if (!relocate(kernel.relocation_cache, uncompressed.get(), seg_header.p_filesz, segment_reloc_info, mem)) {
                     return -1;
                 }
 
             } else {
-                if (!relocate(seg_bytes, seg_header.p_filesz, segment_reloc_info, mem)) {
+                if (!relocate(kernel.relocation_cache, seg_bytes, seg_header.p_filesz, segment_reloc_info, mem)) {
                     return -1;
                 }
             }
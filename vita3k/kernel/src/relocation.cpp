@@ -20,11 +20,19 @@
 
 #include <self.h>
 
+#include <xxh3.h>
+
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <cstring>
 #include <string>
+#include <unordered_map>
+#include <utility>
 
 static constexpr bool LOG_RELOCATIONS = false;
+// amount of relocation data whose decoded tables are kept, the cache starts again once it is exceeded
+static constexpr size_t RELOCATION_CACHE_MAX_SIZE = 32 * 1024 * 1024;
 
 enum Code {
     None = 0,
@@ -245,88 +253,107 @@ static void write_thumb_mov_abs(void *data, uint16_t symbol) {
     pair->upper.imm4 = symbol >> 12;
 }
 
-static bool relocate_entry(void *data, uint32_t code, uint32_t symval, uint32_t addend, uint32_t addr) {
-    LOG_DEBUG_IF(LOG_RELOCATIONS, "code: {}, *data: {}, data: {}, addr: {}, symval: {}, addend: {}", code, log_hex(*static_cast<uint32_t *>(data)), data, log_hex(addr), log_hex(symval), log_hex(addend));
+std::vector<Relocation> &RelocationTable::get_group(RelocationGroup group) {
+    return const_cast<std::vector<Relocation> &>(std::as_const(*this).get_group(group));
+}
+
+const std::vector<Relocation> &RelocationTable::get_group(RelocationGroup group) const {
+    // clang-format off
+    switch (group) {
+    case RelocationGroup::Absolute: return absolute;
+    case RelocationGroup::Original: return original;
+    case RelocationGroup::Relative: return relative;
+    case RelocationGroup::Mov: return mov;
+    case RelocationGroup::Call: break;
+    }
+    // clang-format on
+    return call;
+}
+
+// Adds the decoded relocations to their group and checks whether the groups can be applied one after the other
+struct RelocationRecorder {
+    RelocationTable &table;
+    std::vector<RelocationRef> order;
+    // group of the relocations patching each word, indexed by patch segment and word offset
+    std::unordered_map<uint64_t, RelocationGroup> patched_words;
+    bool groups_overlap = false;
+
+    explicit RelocationRecorder(RelocationTable &table)
+        : table(table) {}
+
+    void add(RelocationGroup group, const Relocation &relocation) {
+        std::vector<Relocation> &relocations = table.get_group(group);
+        order.push_back({ group, static_cast<uint32_t>(relocations.size()) });
+        relocations.push_back(relocation);
+
+        // a patch is at most 4 bytes long, not always aligned
+        for (uint64_t word = relocation.patch_offset / 4; word <= (relocation.patch_offset + 3ull) / 4; word++) {
+            const auto [it, inserted] = patched_words.emplace((uint64_t(relocation.patch_segment) << 32) | word, group);
+            groups_overlap |= !inserted && (it->second != group);
+        }
+    }
+};
+
+static void add_relocation(RelocationRecorder &recorder, uint32_t code, uint8_t patch_segment, uint32_t patch_offset, uint8_t symbol_segment, uint32_t addend) {
+    const Relocation relocation{ patch_offset, addend, patch_segment, symbol_segment, static_cast<uint8_t>(code) };
     switch (code) {
     case None:
     case V4BX: // Untested.
     case RBase:
-        return true;
+        return;
 
     case Abs32:
     case Target1:
-        write(data, symval + addend);
-        return true;
-
     case Abs8:
-        write_abs8(data, symval + addend);
-        return true;
+        recorder.add(RelocationGroup::Absolute, relocation);
+        return;
 
     case Rel32:
     case Target2:
-        write(data, symval + addend - addr);
-        return true;
-
     case Prel31:
-        write_masked(data, symval + addend - addr, INT32_MAX);
-        return true;
-
-    case ThumbCall:
-        write_thumb_call(data, symval + addend - addr);
-        return true;
-
-    case Call:
-    case Jump24:
-        write_call(data, (symval + addend - addr) >> 2);
-        return true;
+        recorder.add(RelocationGroup::Relative, relocation);
+        return;
 
     case MovwAbsNc:
-        write_mov_abs(data, symval + addend);
-        return true;
-
     case MovtAbs:
-        write_mov_abs(data, (symval + addend) >> 16);
-        return true;
-
     case ThumbMovwAbsNc:
-        write_thumb_mov_abs(data, symval + addend);
-        return true;
-
     case ThumbMovtAbs:
-        write_thumb_mov_abs(data, (symval + addend) >> 16);
-        return true;
+        recorder.add(RelocationGroup::Mov, relocation);
+        return;
+
+    case ThumbCall:
+    case Call:
+    case Jump24:
+        recorder.add(RelocationGroup::Call, relocation);
+        return;
     }
 
-    LOG_WARN("Unhandled relocation code {}.", code);
-    return true; // ignore unhandled relocations
+    LOG_WARN("Unhandled relocation code {}.", code); // ignore unhandled relocations
 }
 
-bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &segments, const MemState &mem, bool is_var_import, uint32_t explicit_symval) {
+bool decode_relocations(const void *entries, uint32_t size, bool is_var_import, RelocationTable &table) {
     const void *const end = static_cast<const uint8_t *>(entries) + size;
     const Entry *entry = static_cast<const Entry *>(entries);
+    RelocationRecorder recorder(table);
 
-    const auto segment_count = segments.size();
-
-    if (LOG_RELOCATIONS) {
-        LOG_DEBUG("Relocating patch of size: {}, # of segments: {}", log_hex(size), segment_count);
-        for (const auto &seg : segments)
-            LOG_DEBUG("    Segment: {} -> {} (size: {})", seg.first, log_hex(seg.second.addr), seg.second.size);
-    }
-
-    // initialized in format 1 and 2
-    Address g_addr = 0,
-            g_offset = 0,
-            g_patchseg = 0;
+    // initialized in format 0, 1 and 2
+    uint32_t g_offset = 0;
+    uint8_t g_patchseg = 0;
 
     // initialized in format 0, 1, 2, and 3
-    Address g_saddr = 0,
-            g_addend = 0,
-            g_type = 0,
-            g_type2 = 0;
+    uint8_t g_symseg = RELOC_SYMBOL_NONE;
+    uint32_t g_addend = 0,
+             g_type = 0,
+             g_type2 = 0;
+
+    // formats 6 to 9 keep the symbol found by the previous one of them when the value is in no segment
+    bool last_original = false;
 
     const EntryFormatUnknown *generic_entry = nullptr;
     while (entry < end) {
         generic_entry = static_cast<const EntryFormatUnknown *>(entry);
+        if (generic_entry->format < 6)
+            last_original = false;
 
         if (is_var_import)
             assert(generic_entry->format == 1 || generic_entry->format == 2);
@@ -334,106 +361,43 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
         switch (generic_entry->format) {
         case 0: {
             const EntryFormat0 *const format0_entry = static_cast<const EntryFormat0 *>(entry);
+            LOG_DEBUG_IF(LOG_RELOCATIONS, "[FORMAT0]: offset: {}, code: {}, code2: {}, sym_seg: {}, patch_seg: {}, addend: {}",
+                log_hex(format0_entry->offset), format0_entry->code, format0_entry->code2, format0_entry->symbol_segment, format0_entry->patch_segment, log_hex(format0_entry->addend));
 
-            const auto symbol_seg = format0_entry->symbol_segment;
-            const auto symbol_seg_start = segments.find(symbol_seg)->second.addr;
-            const auto patch_seg = format0_entry->patch_segment;
-            const auto patch_seg_start = segments.find(patch_seg)->second.addr;
-
-            const Address s = (format0_entry->symbol_segment == 0xf) ? 0 : symbol_seg_start;
-            const Address p = patch_seg_start + format0_entry->offset;
-            const Address a = format0_entry->addend;
-
-            LOG_DEBUG_IF(LOG_RELOCATIONS, "[FORMAT0]: offset: {}, code: {}, sym_seg: {}, sym_start: {}, patch_seg: {}, patch_start: {}, s: {}, p: {}, a: {}. {}",
-                format0_entry->offset, format0_entry->code, symbol_seg, log_hex(symbol_seg_start), patch_seg, log_hex(patch_seg_start), log_hex(s), log_hex(p), log_hex(a), log_hex((uint64_t)Ptr<uint32_t>(p).get(mem)));
-
-            if (!relocate_entry(Ptr<uint32_t>(p).get(mem), format0_entry->code, s, a, p)) {
-                return false;
-            }
-
-            const Address addr2 = p + format0_entry->dist2 * 2;
-
-            if (format0_entry->code2 != 0) {
-                LOG_DEBUG_IF(LOG_RELOCATIONS, "[FORMAT0/2]: code: {}, sym_seg: {}, sym_start: {}, s: {}, patch_seg: {}, p: {}, a: {}. {}",
-                    format0_entry->code2, format0_entry->symbol_segment, symbol_seg_start, format0_entry->patch_segment, log_hex(patch_seg_start), log_hex(s), log_hex(addr2), log_hex(a), log_hex((uint64_t)Ptr<uint32_t>(addr2).get(mem)));
-
-                if (!relocate_entry(Ptr<uint32_t>(addr2).get(mem), format0_entry->code2, s, a, addr2)) {
-                    return false;
-                }
-            }
-
-            g_addr = patch_seg_start;
-            g_offset = format0_entry->offset;
             g_patchseg = format0_entry->patch_segment;
-            g_saddr = s;
-            g_addend = a;
+            g_offset = format0_entry->offset;
+            g_symseg = format0_entry->symbol_segment;
+            g_addend = format0_entry->addend;
             g_type = format0_entry->code;
             g_type2 = format0_entry->code2;
 
+            add_relocation(recorder, g_type, g_patchseg, g_offset, g_symseg, g_addend);
+            if (g_type2 != 0)
+                add_relocation(recorder, g_type2, g_patchseg, g_offset + format0_entry->dist2 * 2, g_symseg, g_addend);
+
             break;
         }
         case 1: {
             if (!is_var_import) {
                 const EntryFormat1 *const format1_entry = static_cast<const EntryFormat1 *>(entry);
-
-                const auto symbol_seg = format1_entry->symbol_segment;
-                const auto symbol_seg_start = segments.find(symbol_seg)->second.addr;
-                const auto patch_seg = format1_entry->patch_segment;
-                const auto patch_seg_start = segments.find(patch_seg)->second.addr;
-                const Address s = (format1_entry->symbol_segment == 0xf) ? 0 : symbol_seg_start;
-
                 const Address offset = format1_entry->offset_lo | (format1_entry->offset_hi << 12);
-                const Address p = patch_seg_start + offset;
-                const Address a = format1_entry->addend;
-
-                LOG_DEBUG_IF(LOG_RELOCATIONS, "[FORMAT1]: code: {}, sym_seg: {}, sym_start: {}, patch_seg: {}, data_start: {}, s: {}, offset: {}, p: {}, a: {}",
-                    format1_entry->code, symbol_seg, log_hex(symbol_seg_start), patch_seg, log_hex(patch_seg_start), log_hex(s), format1_entry->patch_segment, patch_seg_start, log_hex(offset), log_hex(p), log_hex(a));
+                LOG_DEBUG_IF(LOG_RELOCATIONS, "[FORMAT1]: code: {}, sym_seg: {}, patch_seg: {}, offset: {}, addend: {}",
+                    format1_entry->code, format1_entry->symbol_segment, format1_entry->patch_segment, log_hex(offset), log_hex(format1_entry->addend));
 
-                if (!relocate_entry(Ptr<uint32_t>(p).get(mem), format1_entry->code, s, a, p)) {
-                    return false;
-                }
-
-                g_addr = patch_seg_start;
-                g_offset = offset;
                 g_patchseg = format1_entry->patch_segment;
-                g_saddr = s;
-                g_addend = a;
+                g_offset = offset;
+                g_symseg = format1_entry->symbol_segment;
+                g_addend = format1_entry->addend;
                 g_type = format1_entry->code;
                 g_type2 = 0;
 
+                add_relocation(recorder, g_type, g_patchseg, g_offset, g_symseg, g_addend);
             } else {
                 const EntryFormat1Alt *const format1_entry = static_cast<const EntryFormat1Alt *>(entry);
+                LOG_DEBUG_IF(LOG_RELOCATIONS, "[FORMAT1_VAR_IMPORT]: code: {}, patch_seg: {}, offset: {}, addend: {}",
+                    format1_entry->code, format1_entry->patch_segment, log_hex(format1_entry->offset), log_hex(format1_entry->addend));
 
-                const auto patch_seg = format1_entry->patch_segment;
-                const auto patch_seg_start_it = segments.find(patch_seg);
-                const Address s = explicit_symval;
-
-                Address patch_seg_start{};
-                if (patch_seg_start_it != segments.end())
-                    patch_seg_start = patch_seg_start_it->second.addr;
-                else {
-                    LOG_WARN("[FORMAT1_VAR_IMPORT] patch segment {} not found. Skipping relocation. s: {} ", patch_seg, log_hex(s));
-                    goto advance_entry;
-                }
-
-                const Address offset = format1_entry->offset;
-                const Address p = patch_seg_start + offset;
-                const Address a = format1_entry->addend;
-
-                LOG_DEBUG_IF(LOG_RELOCATIONS, "[FORMAT1_VAR_IMPORT]: code: {}, patch_seg: {}, data_start: {}, s: {}, offset: {}, p: {}, a: {}",
-                    format1_entry->code, patch_seg, log_hex(patch_seg_start), log_hex(s), format1_entry->patch_segment, patch_seg_start, log_hex(offset), log_hex(p), log_hex(a));
-
-                if (!relocate_entry(Ptr<uint32_t>(p).get(mem), format1_entry->code, s, a, p)) {
-                    return false;
-                }
-
-                g_addr = patch_seg_start;
-                g_offset = offset;
-                g_patchseg = format1_entry->patch_segment;
-                g_saddr = s;
-                g_addend = a;
-                g_type = format1_entry->code;
-                g_type2 = 0;
+                add_relocation(recorder, format1_entry->code, format1_entry->patch_segment, format1_entry->offset, RELOC_SYMBOL_EXPLICIT, format1_entry->addend);
             }
 
             break;
@@ -441,60 +405,22 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
         case 2: {
             if (!is_var_import) {
                 const EntryFormat2 *const format2_entry = static_cast<const EntryFormat2 *>(entry);
-
-                const auto symbol_seg = format2_entry->symbol_segment;
-                const auto symbol_seg_start = segments.find(symbol_seg)->second.addr;
+                LOG_DEBUG_IF(LOG_RELOCATIONS, "[FORMAT2]: code: {}, sym_seg: {}, offset: {}, addend: {}",
+                    format2_entry->code, format2_entry->symbol_segment, log_hex(format2_entry->offset), log_hex(format2_entry->addend));
 
                 g_offset += format2_entry->offset;
-                g_saddr = (format2_entry->symbol_segment == 0xf) ? 0 : symbol_seg_start;
+                g_symseg = format2_entry->symbol_segment;
                 g_addend = format2_entry->addend;
                 g_type = format2_entry->code;
-
-                const auto s = g_saddr;
-                const auto a = g_addend;
-                const auto p = g_addr + g_offset;
-
-                LOG_DEBUG_IF(LOG_RELOCATIONS, "[FORMAT2]: code: {}, sym_seg: {}, sym_start: {}, offset: {}, s: {}, p: {}, a: {}",
-                    format2_entry->code, symbol_seg, log_hex(symbol_seg_start), log_hex(format2_entry->offset), log_hex(s), log_hex(p), log_hex(a));
-
-                if (!relocate_entry(Ptr<uint32_t>(p).get(mem), g_type, s, a, p)) {
-                    return false;
-                }
-
                 g_type2 = 0;
-            } else {
-                const EntryFormat2Alt *const format1_entry = static_cast<const EntryFormat2Alt *>(entry);
 
-                const auto patch_seg = format1_entry->patch_segment;
-                const auto patch_seg_start_it = segments.find(patch_seg);
-                const Address s = explicit_symval;
-
-                Address patch_seg_start{};
-                if (patch_seg_start_it != segments.end())
-                    patch_seg_start = patch_seg_start_it->second.addr;
-                else {
-                    LOG_WARN("[FORMAT2_VAR_IMPORT] patch segment {} not found. Skipping relocation. s: {} ", patch_seg, log_hex(s));
-                    goto advance_entry;
-                }
-
-                const Address offset = format1_entry->offset;
-                const Address p = patch_seg_start + offset;
-                const Address a = format1_entry->addend;
-
-                LOG_DEBUG_IF(LOG_RELOCATIONS, "[FORMAT2_VAR_IMPORT]: code: {}, patch_seg: {}, data_start: {}, s: {}, offset: {}, p: {}, a: {}",
-                    format1_entry->code, patch_seg, log_hex(patch_seg_start), log_hex(s), format1_entry->patch_segment, patch_seg_start, log_hex(offset), log_hex(p), log_hex(a));
-
-                if (!relocate_entry(Ptr<uint32_t>(p).get(mem), format1_entry->code, s, a, p)) {
-                    return false;
-                }
+                add_relocation(recorder, g_type, g_patchseg, g_offset, g_symseg, g_addend);
+            } else {
+                const EntryFormat2Alt *const format2_entry = static_cast<const EntryFormat2Alt *>(entry);
+                LOG_DEBUG_IF(LOG_RELOCATIONS, "[FORMAT2_VAR_IMPORT]: code: {}, patch_seg: {}, offset: {}, addend: {}",
+                    format2_entry->code, format2_entry->patch_segment, log_hex(format2_entry->offset), log_hex(format2_entry->addend));
 
-                g_addr = patch_seg_start;
-                g_offset = offset;
-                g_patchseg = format1_entry->patch_segment;
-                g_saddr = s;
-                g_addend = a;
-                g_type = format1_entry->code;
-                g_type2 = 0;
+                add_relocation(recorder, format2_entry->code, format2_entry->patch_segment, format2_entry->offset, RELOC_SYMBOL_EXPLICIT, format2_entry->addend);
             }
 
             break;
@@ -504,37 +430,14 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
             LOG_DEBUG_IF(LOG_RELOCATIONS, "[FORMAT3]: sym_seg: {}, mode: {} ({}), offset: {}, dist2: {}, addend: {}",
                 log_hex(format3_entry->symbol_segment), format3_entry->mode, format3_entry->mode ? "THUMB" : "ARM", log_hex(format3_entry->offset), log_hex(format3_entry->dist2), log_hex(format3_entry->addend));
 
-            const auto symbol_seg = format3_entry->symbol_segment;
-            const auto symbol_seg_start = segments.find(symbol_seg)->second.addr;
-            const Address s = (format3_entry->symbol_segment == 0xf) ? 0 : symbol_seg_start;
-            const auto mode = format3_entry->mode;
-            const auto offset = format3_entry->offset;
-            const auto dist2 = format3_entry->dist2;
-
-            if (mode == 1)
-                g_type = ThumbMovwAbsNc;
-            else if (mode == 0)
-                g_type = MovwAbsNc;
-
-            if (mode == 1)
-                g_type2 = ThumbMovtAbs;
-            else if (mode == 0)
-                g_type2 = MovtAbs;
-
-            g_offset += offset;
-            g_saddr = s;
+            g_type = format3_entry->mode ? ThumbMovwAbsNc : MovwAbsNc;
+            g_type2 = format3_entry->mode ? ThumbMovtAbs : MovtAbs;
+            g_offset += format3_entry->offset;
+            g_symseg = format3_entry->symbol_segment;
             g_addend = format3_entry->addend;
 
-            const auto a = g_addend;
-            const auto p = g_addr + g_offset;
-
-            if (!relocate_entry(Ptr<uint32_t>(p).get(mem), g_type, s, a, p)) {
-                return false;
-            }
-
-            if (!relocate_entry(Ptr<uint32_t>(p + dist2).get(mem), g_type2, s, a, p + dist2)) {
-                return false;
-            }
+            add_relocation(recorder, g_type, g_patchseg, g_offset, g_symseg, g_addend);
+            add_relocation(recorder, g_type2, g_patchseg, g_offset + format3_entry->dist2, g_symseg, g_addend);
 
             break;
         }
@@ -542,22 +445,10 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
             const EntryFormat4 *const format4_entry = static_cast<const EntryFormat4 *>(entry);
             LOG_DEBUG_IF(LOG_RELOCATIONS, "[FORMAT4]: offset: {}, dist2: {}", log_hex(format4_entry->offset), log_hex(format4_entry->dist2));
 
-            const auto offset = format4_entry->offset;
-            const auto dist2 = format4_entry->dist2;
-
-            g_offset += offset;
+            g_offset += format4_entry->offset;
 
-            const auto s = g_saddr;
-            const auto a = g_addend;
-            const auto p = g_addr + g_offset;
-
-            if (!relocate_entry(Ptr<uint32_t>(p).get(mem), g_type, s, a, p)) {
-                return false;
-            }
-
-            if (!relocate_entry(Ptr<uint32_t>(p + dist2).get(mem), g_type2, s, a, p + dist2)) {
-                return false;
-            }
+            add_relocation(recorder, g_type, g_patchseg, g_offset, g_symseg, g_addend);
+            add_relocation(recorder, g_type2, g_patchseg, g_offset + format4_entry->dist2, g_symseg, g_addend);
 
             break;
         }
@@ -565,29 +456,12 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
             const EntryFormat5 *const format5_entry = static_cast<const EntryFormat5 *>(entry);
 
             g_offset += format5_entry->dist1;
-
-            const auto s = g_saddr;
-            const auto a = g_addend;
-            const auto p = g_addr + g_offset;
-
-            if (!relocate_entry(Ptr<uint32_t>(p).get(mem), g_type, s, a, p)) {
-                return false;
-            }
-
-            if (!relocate_entry(Ptr<uint32_t>(p + format5_entry->dist2).get(mem), g_type2, s, a, p + format5_entry->dist2)) {
-                return false;
-            }
+            add_relocation(recorder, g_type, g_patchseg, g_offset, g_symseg, g_addend);
+            add_relocation(recorder, g_type2, g_patchseg, g_offset + format5_entry->dist2, g_symseg, g_addend);
 
             g_offset += format5_entry->dist3;
-            const auto p2 = g_addr + g_offset;
-
-            if (!relocate_entry(Ptr<uint32_t>(p2).get(mem), g_type, s, a, p2)) {
-                return false;
-            }
-
-            if (!relocate_entry(Ptr<uint32_t>(p2 + format5_entry->dist4).get(mem), g_type2, s, a, p2 + format5_entry->dist4)) {
-                return false;
-            }
+            add_relocation(recorder, g_type, g_patchseg, g_offset, g_symseg, g_addend);
+            add_relocation(recorder, g_type2, g_patchseg, g_offset + format5_entry->dist4, g_symseg, g_addend);
 
             break;
         }
@@ -596,32 +470,11 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
 
             g_offset += format6_entry->offset;
 
-            const auto patch_seg_start = segments.find(g_patchseg)->second.addr;
-
-            const uint32_t orgval = *Ptr<uint32_t>(patch_seg_start + g_offset).get(mem);
-
-            uint32_t segbase = 0;
-            for (const auto &seg_ : segments) {
-                const auto seg = seg_.second;
-                if (orgval >= seg.p_vaddr && orgval < seg.p_vaddr + seg.size) {
-                    segbase = seg.p_vaddr;
-                    g_saddr = seg.addr;
-                }
-            }
-
-            assert((uint32_t)orgval >= (uint32_t)segbase);
-            const auto addend = orgval - segbase;
-
-            g_type2 = 0;
+            // the symbol segment depends on the value in memory, it is found when applying the relocation
+            recorder.add(RelocationGroup::Original, { g_offset, last_original, g_patchseg, g_symseg, Abs32 });
+            last_original = true;
             g_type = Abs32;
-
-            const auto s = g_saddr;
-            const auto a = addend;
-            const auto p = g_addr + g_offset;
-
-            if (!relocate_entry(Ptr<uint32_t>(p).get(mem), g_type, s, a, p)) {
-                return false;
-            }
+            g_type2 = 0;
 
             break;
         }
@@ -645,37 +498,14 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
             // clang-format on
 
             do {
-                auto offset = (offsets & mask) * sizeof(uint32_t);
-                g_offset += static_cast<Address>(offset);
-
-                const auto patch_seg_start = segments.find(g_patchseg)->second.addr;
-
-                const uint32_t orgval = *Ptr<uint32_t>(patch_seg_start + g_offset).get(mem);
-
-                uint32_t segbase = 0;
-                for (const auto &seg_ : segments) {
-                    const auto seg = seg_.second;
-                    if (orgval >= seg.p_vaddr && orgval < seg.p_vaddr + seg.size) {
-                        segbase = seg.p_vaddr;
-                        g_saddr = seg.addr;
-                    }
-                }
-
-                assert((uint32_t)orgval >= (uint32_t)segbase);
-                const auto addend = orgval - segbase;
-
-                g_type2 = 0;
-                g_type = Abs32;
-
-                const auto s = g_saddr;
-                const auto a = addend;
-                const auto p = g_addr + g_offset;
-
-                if (!relocate_entry(Ptr<uint32_t>(p).get(mem), g_type, s, a, p)) {
-                    return false;
-                }
+                g_offset += (offsets & mask) * sizeof(uint32_t);
+                recorder.add(RelocationGroup::Original, { g_offset, last_original, g_patchseg, g_symseg, Abs32 });
+                last_original = true;
             } while (offsets >>= bitsize);
 
+            g_type = Abs32;
+            g_type2 = 0;
+
             break;
         }
         default: {
@@ -684,7 +514,6 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
         }
         }
 
-    advance_entry:
         // clang-format off
         switch (generic_entry->format) {
         case 0: entry = static_cast<const EntryFormat0 *>(entry) + 1; break;
@@ -701,5 +530,205 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
         // clang-format on
     }
 
+    if (recorder.groups_overlap)
+        table.entry_order = std::move(recorder.order);
+
     return true;
 }
+
+bool apply_relocations(const RelocationTable &table, const SegmentInfosForReloc &segments, const MemState &mem, uint32_t explicit_symval) {
+    if (LOG_RELOCATIONS) {
+        LOG_DEBUG("Applying {} relocations, # of segments: {}", table.size(), segments.size());
+        for (const auto &seg : segments)
+            LOG_DEBUG("    Segment: {} -> {} (size: {})", seg.first, log_hex(seg.second.addr), seg.second.size);
+    }
+
+    // segment indexes are 4 bits wide, resolve them once instead of looking up the map for each relocation
+    std::array<Address, 16> patch_bases{};
+    std::array<bool, 16> has_patch_base{};
+    std::array<Address, RELOC_SYMBOL_EXPLICIT + 1> symbol_bases{};
+    std::array<bool, RELOC_SYMBOL_EXPLICIT + 1> has_symbol_base{};
+    for (const auto &[index, segment] : segments) {
+        if (index >= patch_bases.size())
+            continue;
+        patch_bases[index] = segment.addr;
+        has_patch_base[index] = true;
+        symbol_bases[index] = segment.addr;
+        has_symbol_base[index] = true;
+    }
+    symbol_bases[RELOC_SYMBOL_NONE] = 0;
+    has_symbol_base[RELOC_SYMBOL_NONE] = true;
+    symbol_bases[RELOC_SYMBOL_EXPLICIT] = explicit_symval;
+    has_symbol_base[RELOC_SYMBOL_EXPLICIT] = true;
+
+    const auto resolve_patch = [&](const Relocation &relocation, Address &p) {
+        if (!has_patch_base[relocation.patch_segment]) {
+            LOG_WARN("Relocation patch segment {} not found. Skipping relocation.", relocation.patch_segment);
+            return false;
+        }
+        p = patch_bases[relocation.patch_segment] + relocation.patch_offset;
+        return true;
+    };
+    const auto resolve = [&](const Relocation &relocation, Address &p, Address &s) {
+        if (!has_symbol_base[relocation.symbol_segment]) {
+            LOG_WARN("Relocation symbol segment {} not found. Skipping relocation.", relocation.symbol_segment);
+            return false;
+        }
+        s = symbol_bases[relocation.symbol_segment];
+        return resolve_patch(relocation, p);
+    };
+
+    Address s_original = 0;
+    const auto apply_original = [&](const Relocation &relocation) {
+        Address p;
+        if (!resolve_patch(relocation, p))
+            return;
+        if (!relocation.addend)
+            s_original = has_symbol_base[relocation.symbol_segment] ? symbol_bases[relocation.symbol_segment] : 0;
+
+        void *const data = Ptr<uint32_t>(p).get(mem);
+        uint32_t orgval;
+        memcpy(&orgval, data, sizeof(orgval));
+
+        uint32_t segbase = 0;
+        for (const auto &[_, seg] : segments) {
+            if (orgval >= seg.p_vaddr && orgval < seg.p_vaddr + seg.size) {
+                segbase = seg.p_vaddr;
+                s_original = seg.addr;
+            }
+        }
+        write(data, s_original + orgval - segbase);
+    };
+
+    const auto apply_absolute = [&](const Relocation &relocation) {
+        Address p, s;
+        if (!resolve(relocation, p, s))
+            return;
+
+        void *const data = Ptr<uint32_t>(p).get(mem);
+        if (relocation.code == Abs8)
+            write_abs8(data, s + relocation.addend);
+        else
+            write(data, s + relocation.addend);
+    };
+
+    const auto apply_relative = [&](const Relocation &relocation) {
+        Address p, s;
+        if (!resolve(relocation, p, s))
+            return;
+
+        void *const data = Ptr<uint32_t>(p).get(mem);
+        if (relocation.code == Prel31)
+            write_masked(data, s + relocation.addend - p, INT32_MAX);
+        else
+            write(data, s + relocation.addend - p);
+    };
+
+    const auto apply_mov = [&](const Relocation &relocation) {
+        Address p, s;
+        if (!resolve(relocation, p, s))
+            return;
+
+        void *const data = Ptr<uint32_t>(p).get(mem);
+        const uint32_t value = s + relocation.addend;
+        // clang-format off
+        switch (relocation.code) {
+        case MovwAbsNc: write_mov_abs(data, value); break;
+        case MovtAbs: write_mov_abs(data, value >> 16); break;
+        case ThumbMovwAbsNc: write_thumb_mov_abs(data, value); break;
+        case ThumbMovtAbs: write_thumb_mov_abs(data, value >> 16); break;
+        }
+        // clang-format on
+    };
+
+    const auto apply_call = [&](const Relocation &relocation) {
+        Address p, s;
+        if (!resolve(relocation, p, s))
+            return;
+
+        void *const data = Ptr<uint32_t>(p).get(mem);
+        if (relocation.code == ThumbCall)
+            write_thumb_call(data, s + relocation.addend - p);
+        else
+            write_call(data, (s + relocation.addend - p) >> 2);
+    };
+
+    if (!table.entry_order.empty()) {
+        // some words are patched by relocations of different groups, the passes would change the result
+        for (const RelocationRef &ref : table.entry_order) {
+            const Relocation &relocation = table.get_group(ref.group)[ref.index];
+            // clang-format off
+            switch (ref.group) {
+            case RelocationGroup::Absolute: apply_absolute(relocation); break;
+            case RelocationGroup::Original: apply_original(relocation); break;
+            case RelocationGroup::Relative: apply_relative(relocation); break;
+            case RelocationGroup::Mov: apply_mov(relocation); break;
+            case RelocationGroup::Call: apply_call(relocation); break;
+            }
+            // clang-format on
+        }
+
+        return true;
+    }
+
+    // no other group patches the words this pass reads, so it can be done first
+    for (const Relocation &relocation : table.original)
+        apply_original(relocation);
+    for (const Relocation &relocation : table.absolute)
+        apply_absolute(relocation);
+    for (const Relocation &relocation : table.relative)
+        apply_relative(relocation);
+    for (const Relocation &relocation : table.mov)
+        apply_mov(relocation);
+    for (const Relocation &relocation : table.call)
+        apply_call(relocation);
+
+    return true;
+}
+
+bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &segments, const MemState &mem, bool is_var_import, uint32_t explicit_symval) {
+    RelocationTable table;
+    if (!decode_relocations(entries, size, is_var_import, table))
+        return false;
+
+    return apply_relocations(table, segments, mem, explicit_symval);
+}
+
+RelocationTablePtr RelocationCache::get(const void *entries, uint32_t size) {
+    const uint8_t *const entry_bytes = static_cast<const uint8_t *>(entries);
+    const auto same_entries = [&](const CachedTable &cached) {
+        return cached.entries.size() == size && std::equal(cached.entries.begin(), cached.entries.end(), entry_bytes);
+    };
+
+    // the size is used as seed so that two relocation segments must also have the same size to collide
+    const uint64_t hash = XXH3_64bits_withSeed(entries, size, size);
+    {
+        const std::lock_guard<std::mutex> guard(mutex);
+        const auto [begin, end] = tables.equal_range(hash);
+        for (auto it = begin; it != end; ++it) {
+            if (same_entries(it->second))
+                return it->second.table;
+        }
+    }
+
+    auto table = std::make_shared<RelocationTable>();
+    if (!decode_relocations(entries, size, false, *table))
+        return nullptr;
+
+    if (size > RELOCATION_CACHE_MAX_SIZE)
+        return table;
+
+    const std::lock_guard<std::mutex> guard(mutex);
+    if (cached_size + size > RELOCATION_CACHE_MAX_SIZE) {
+        tables.clear();
+        cached_size = 0;
+    }
+    tables.emplace(hash, CachedTable{ std::vector<uint8_t>(entry_bytes, entry_bytes + size), table });
+    cached_size += size;
+    return table;
+}
+
+bool relocate(RelocationCache &cache, const void *entries, uint32_t size, const SegmentInfosForReloc &segments, const MemState &mem) {
+    const RelocationTablePtr table = cache.get(entries, size);
+    return table && apply_relocations(*table, segments, mem);
+}
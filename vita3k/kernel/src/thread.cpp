@@ -78,7 +78,7 @@ int ThreadState::init(const char *name, Ptr<const void> entry_point, int init_pr
     if (kernel.debugger.watch_code) {
         set_log_code(*cpu, true);
     }
-    if (kernel.debugger.watch_memory) {
+    if (kernel.debugger.watch_memory && kernel.cpu_backend != CPUBackend::Dynarmic) {
         set_log_mem(*cpu, true);
     }
 
@@ -275,6 +275,7 @@ bool ThreadState::run_loop() {
             if (hit_breakpoint(*cpu) || to_do == ThreadToDo::suspend) {
                 update_status(ThreadStatus::suspend);
                 to_do = ThreadToDo::wait;
+                kernel.debugger.notify_thread_suspended(id, hit_breakpoint(*cpu));
             }
 
             if (call_level < run_level && run_level > 1)
@@ -0,0 +1,291 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/ult.h>
+
+#include <cstring>
+
+namespace ult {
+
+void make_ready(Ulthread &ulthread) {
+    ulthread.status = UlthreadStatus::Ready;
+    ulthread.runtime->ready.push_back(&ulthread);
+    ulthread.runtime->ready_cond.notify_one();
+}
+
+void wake(Waiter &waiter) {
+    if (waiter.ulthread) {
+        make_ready(*waiter.ulthread);
+    } else {
+        waiter.woken = true;
+        waiter.cond->notify_one();
+    }
+}
+
+Ulthread *pop_ready(Runtime &runtime) {
+    if (runtime.ready.empty())
+        return nullptr;
+
+    Ulthread *ulthread = runtime.ready.front();
+    runtime.ready.pop_front();
+    ulthread->status = UlthreadStatus::Running;
+    runtime.switch_count++;
+    return ulthread;
+}
+
+bool join(Ulthread &ulthread, Waiter &waiter) {
+    if (ulthread.status != UlthreadStatus::Finished) {
+        ulthread.joiners.push_back(&waiter);
+        return false;
+    }
+
+    if (waiter.data)
+        *static_cast<int32_t *>(waiter.data) = ulthread.exit_status;
+    return true;
+}
+
+bool finish(Ulthread &ulthread, int32_t status) {
+    ulthread.status = UlthreadStatus::Finished;
+    ulthread.exit_status = status;
+
+    const bool joined = !ulthread.joiners.empty();
+    for (Waiter *waiter : ulthread.joiners) {
+        if (waiter->data)
+            *static_cast<int32_t *>(waiter->data) = status;
+        wake(*waiter);
+    }
+    ulthread.joiners.clear();
+
+    return joined;
+}
+
+bool mutex_lock(Mutex &mutex, Waiter &waiter) {
+    if (!mutex.owner) {
+        mutex.owner = waiter.owner;
+        return true;
+    }
+
+    mutex.waiters.push_back(&waiter);
+    return false;
+}
+
+bool mutex_try_lock(Mutex &mutex, Owner owner) {
+    if (mutex.owner)
+        return false;
+
+    mutex.owner = owner;
+    return true;
+}
+
+bool mutex_unlock(Mutex &mutex, Owner owner) {
+    if (mutex.owner != owner)
+        return false;
+
+    if (mutex.waiters.empty()) {
+        mutex.owner = 0;
+        return true;
+    }
+
+    // hand the mutex over, the woken waiter never has to try again
+    Waiter *waiter = mutex.waiters.front();
+    mutex.waiters.pop_front();
+    mutex.owner = waiter->owner;
+    wake(*waiter);
+    return true;
+}
+
+void condition_variable_wait(ConditionVariable &cond, Waiter &waiter) {
+    mutex_unlock(*cond.mutex, waiter.owner);
+    cond.waiters.push_back(&waiter);
+}
+
+void condition_variable_signal(ConditionVariable &cond, bool all) {
+    while (!cond.waiters.empty()) {
+        Waiter *waiter = cond.waiters.front();
+        cond.waiters.pop_front();
+
+        // the waiter stays blocked on the mutex until it owns it again
+        if (mutex_lock(*cond.mutex, *waiter))
+            wake(*waiter);
+
+        if (!all)
+            break;
+    }
+}
+
+bool semaphore_acquire(Semaphore &semaphore, Waiter &waiter) {
+    if (semaphore_try_acquire(semaphore, waiter.count))
+        return true;
+
+    semaphore.waiters.push_back(&waiter);
+    return false;
+}
+
+bool semaphore_try_acquire(Semaphore &semaphore, int32_t count) {
+    // never overtake a queued waiter, a large request would starve otherwise
+    if (!semaphore.waiters.empty() || semaphore.count < count)
+        return false;
+
+    semaphore.count -= count;
+    return true;
+}
+
+void semaphore_release(Semaphore &semaphore, int32_t count) {
+    semaphore.count += count;
+
+    while (!semaphore.waiters.empty() && semaphore.count >= semaphore.waiters.front()->count) {
+        Waiter *waiter = semaphore.waiters.front();
+        semaphore.waiters.pop_front();
+        semaphore.count -= waiter->count;
+        wake(*waiter);
+    }
+}
+
+static bool rwlock_can_lock(const ReaderWriterLock &rwlock, bool write) {
+    if (write)
+        return !rwlock.writer && rwlock.readers == 0;
+
+    return !rwlock.writer;
+}
+
+static void rwlock_grant(ReaderWriterLock &rwlock, Owner owner, bool write) {
+    if (write)
+        rwlock.writer = owner;
+    else
+        rwlock.readers++;
+}
+
+static void rwlock_wake(ReaderWriterLock &rwlock) {
+    while (!rwlock.waiters.empty() && rwlock_can_lock(rwlock, rwlock.waiters.front()->write)) {
+        Waiter *waiter = rwlock.waiters.front();
+        rwlock.waiters.pop_front();
+        rwlock_grant(rwlock, waiter->owner, waiter->write);
+        wake(*waiter);
+    }
+}
+
+bool rwlock_lock(ReaderWriterLock &rwlock, Waiter &waiter) {
+    if (rwlock_try_lock(rwlock, waiter.owner, waiter.write))
+        return true;
+
+    rwlock.waiters.push_back(&waiter);
+    return false;
+}
+
+bool rwlock_try_lock(ReaderWriterLock &rwlock, Owner owner, bool write) {
+    // queued writers go first, readers would starve them otherwise
+    if (!rwlock.waiters.empty() || !rwlock_can_lock(rwlock, write))
+        return false;
+
+    rwlock_grant(rwlock, owner, write);
+    return true;
+}
+
+bool rwlock_unlock_read(ReaderWriterLock &rwlock) {
+    if (rwlock.readers == 0)
+        return false;
+
+    rwlock.readers--;
+    rwlock_wake(rwlock);
+    return true;
+}
+
+bool rwlock_unlock_write(ReaderWriterLock &rwlock, Owner owner) {
+    if (rwlock.writer != owner)
+        return false;
+
+    rwlock.writer = 0;
+    rwlock_wake(rwlock);
+    return true;
+}
+
+static void queue_store(Queue &queue, const void *data) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    queue.data.emplace_back(bytes, bytes + queue.data_size);
+    queue.pool->used++;
+}
+
+// A data slot of the pool was freed, give it to a pusher blocked on any queue of the pool
+static void queue_pool_release(QueueDataPool &pool) {
+    pool.used--;
+
+    for (Queue *queue : pool.queues) {
+        if (queue->pushers.empty())
+            continue;
+
+        Waiter *waiter = queue->pushers.front();
+        queue->pushers.pop_front();
+        queue_store(*queue, waiter->data);
+        wake(*waiter);
+        return;
+    }
+}
+
+bool queue_push(Queue &queue, Waiter &waiter) {
+    if (queue_try_push(queue, waiter.data))
+        return true;
+
+    queue.pushers.push_back(&waiter);
+    return false;
+}
+
+bool queue_try_push(Queue &queue, const void *data) {
+    // a blocked popper means the queue is empty, copy straight to it
+    if (!queue.poppers.empty()) {
+        Waiter *waiter = queue.poppers.front();
+        queue.poppers.pop_front();
+        memcpy(waiter->data, data, queue.data_size);
+        wake(*waiter);
+        return true;
+    }
+
+    if (queue.pool->used >= queue.pool->capacity)
+        return false;
+
+    queue_store(queue, data);
+    return true;
+}
+
+bool queue_pop(Queue &queue, Waiter &waiter) {
+    if (queue_try_pop(queue, waiter.data))
+        return true;
+
+    queue.poppers.push_back(&waiter);
+    return false;
+}
+
+bool queue_try_pop(Queue &queue, void *data) {
+    if (!queue.data.empty()) {
+        memcpy(data, queue.data.front().data(), queue.data_size);
+        queue.data.pop_front();
+        queue_pool_release(*queue.pool);
+        return true;
+    }
+
+    // the pool is full because of other queues, take the data from a blocked pusher
+    if (!queue.pushers.empty()) {
+        Waiter *waiter = queue.pushers.front();
+        queue.pushers.pop_front();
+        memcpy(data, waiter->data, queue.data_size);
+        wake(*waiter);
+        return true;
+    }
+
+    return false;
+}
+
+} // namespace ult
@@ -0,0 +1,221 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// Synthetic SceUlt job system benchmark
+// A producer ulthread feeds jobs through a queue to consumer ulthreads which take a shared mutex
+// and yield after every job. The ulthreads are host state machines scheduled by the same code as
+// the SceUlt module, only the guest context switch is left out. Reports ulthread switches per second.
+
+#include <kernel/ult.h>
+
+#include <CLI11.hpp>
+#include <fmt/format.h>
+
+#include <chrono>
+#include <mutex>
+
+namespace {
+
+constexpr int32_t END_OF_JOBS = -1;
+
+enum class Step {
+    Pop,
+    Work,
+    Lock,
+    Locked,
+};
+
+struct BenchUlthread : ult::Ulthread {
+    bool producer = false;
+    Step step = Step::Pop;
+    int32_t value = 0;
+    // next job pushed by the producer
+    int32_t next = 0;
+};
+
+struct Bench {
+    std::mutex mutex;
+    ult::Runtime runtime;
+    ult::QueueDataPool pool;
+    ult::Queue queue;
+    ult::Mutex total_mutex;
+    int64_t total = 0;
+    int32_t job_count = 0;
+    int32_t consumer_count = 0;
+};
+
+ult::Waiter &reset_waiter(BenchUlthread &bench_thread) {
+    ult::Waiter &waiter = bench_thread.waiter;
+    waiter = ult::Waiter{};
+    waiter.ulthread = &bench_thread;
+    waiter.owner = bench_thread.address;
+    return waiter;
+}
+
+// Run the ulthread until it blocks, yields or exits, the bench lock is held
+void run_producer(Bench &bench, BenchUlthread &producer) {
+    while (producer.next < bench.job_count + bench.consumer_count) {
+        // one end marker per consumer once every job is queued
+        producer.value = producer.next < bench.job_count ? producer.next : END_OF_JOBS;
+        producer.next++;
+
+        ult::Waiter &waiter = reset_waiter(producer);
+        waiter.data = &producer.value;
+        if (!ult::queue_push(bench.queue, waiter))
+            return;
+    }
+
+    ult::finish(producer, 0);
+}
+
+void run_consumer(Bench &bench, BenchUlthread &consumer, std::unique_lock<std::mutex> &lock) {
+    while (true) {
+        switch (consumer.step) {
+        case Step::Pop: {
+            ult::Waiter &waiter = reset_waiter(consumer);
+            waiter.data = &consumer.value;
+            consumer.step = Step::Work;
+            if (!ult::queue_pop(bench.queue, waiter))
+                return;
+            break;
+        }
+        case Step::Work: {
+            if (consumer.value == END_OF_JOBS) {
+                ult::finish(consumer, 0);
+                return;
+            }
+
+            // the job itself, done outside of the scheduler lock like guest code would
+            lock.unlock();
+            uint32_t hash = static_cast<uint32_t>(consumer.value);
+            for (int i = 0; i < 16; i++)
+                hash = hash * 0x9E3779B1 + 1;
+            consumer.value = static_cast<int32_t>(hash & 0xFF);
+            lock.lock();
+
+            consumer.step = Step::Lock;
+            break;
+        }
+        case Step::Lock:
+            consumer.step = Step::Locked;
+            if (!ult::mutex_lock(bench.total_mutex, reset_waiter(consumer)))
+                return;
+            break;
+        case Step::Locked:
+            bench.total += consumer.value;
+            ult::mutex_unlock(bench.total_mutex, consumer.address);
+
+            // yield after every job
+            consumer.step = Step::Pop;
+            ult::make_ready(consumer);
+            return;
+        }
+    }
+}
+
+void run_worker(Bench &bench) {
+    std::unique_lock<std::mutex> lock(bench.mutex);
+    while (true) {
+        bench.runtime.ready_cond.wait(lock, [&]() { return bench.runtime.shutdown || !bench.runtime.ready.empty(); });
+        if (bench.runtime.shutdown)
+            return;
+
+        ult::Ulthread *ulthread = ult::pop_ready(bench.runtime);
+        BenchUlthread &bench_thread = *static_cast<BenchUlthread *>(ulthread);
+        if (bench_thread.producer)
+            run_producer(bench, bench_thread);
+        else
+            run_consumer(bench, bench_thread, lock);
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    uint32_t worker_count = 4;
+    int32_t consumer_count = 16;
+    int32_t job_count = 1000000;
+    uint32_t queue_size = 64;
+
+    CLI::App app{ "Vita3K SceUlt job system benchmark" };
+    app.add_option("--workers,-w", worker_count, "Number of worker threads of the runtime")->check(CLI::Range(1, 64));
+    app.add_option("--consumers,-c", consumer_count, "Number of consumer ulthreads")->check(CLI::Range(1, 4096));
+    app.add_option("--jobs,-n", job_count, "Number of jobs pushed by the producer")->check(CLI::Range(1, 100000000));
+    app.add_option("--queue-size,-q", queue_size, "Capacity of the job queue")->check(CLI::Range(1, 65536));
+    CLI11_PARSE(app, argc, argv);
+
+    Bench bench;
+    bench.job_count = job_count;
+    bench.consumer_count = consumer_count;
+    bench.pool.capacity = queue_size;
+    bench.pool.data_size = sizeof(int32_t);
+    bench.pool.queues.push_back(&bench.queue);
+    bench.queue.data_size = sizeof(int32_t);
+    bench.queue.pool = &bench.pool;
+
+    std::vector<std::unique_ptr<BenchUlthread>> ulthreads(consumer_count + 1);
+    for (size_t i = 0; i < ulthreads.size(); i++) {
+        ulthreads[i] = std::make_unique<BenchUlthread>();
+        // only used as an owner id, like the guest address of a real ulthread
+        ulthreads[i]->address = static_cast<Address>((i + 1) * 0x100);
+        ulthreads[i]->runtime = &bench.runtime;
+    }
+    ulthreads[0]->producer = true;
+
+    const auto start = std::chrono::steady_clock::now();
+    {
+        const std::lock_guard<std::mutex> lock(bench.mutex);
+        for (const auto &bench_thread : ulthreads)
+            ult::make_ready(*bench_thread);
+    }
+
+    for (uint32_t i = 0; i < worker_count; i++) {
+        auto worker = std::make_unique<ult::Worker>();
+        worker->runtime = &bench.runtime;
+        worker->host_thread = std::thread(run_worker, std::ref(bench));
+        bench.runtime.workers.push_back(std::move(worker));
+    }
+
+    // join every ulthread from this thread, like a kernel thread would
+    {
+        std::unique_lock<std::mutex> lock(bench.mutex);
+        std::condition_variable cond;
+        for (const auto &bench_thread : ulthreads) {
+            ult::Waiter waiter;
+            waiter.cond = &cond;
+            if (!ult::join(*bench_thread, waiter))
+                cond.wait(lock, [&]() { return waiter.woken; });
+        }
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    {
+        const std::lock_guard<std::mutex> lock(bench.mutex);
+        bench.runtime.shutdown = true;
+        bench.runtime.ready_cond.notify_all();
+    }
+    for (const auto &worker : bench.runtime.workers)
+        worker->host_thread.join();
+
+    const double seconds = elapsed.count();
+    fmt::print("workers: {}, consumers: {}, jobs: {}\n", worker_count, consumer_count, job_count);
+    fmt::print("elapsed: {:.3f} s, checksum: {}\n", seconds, bench.total);
+    fmt::print("ulthread switches: {} ({:.0f} per second)\n", bench.runtime.switch_count, bench.runtime.switch_count / seconds);
+    fmt::print("jobs per second: {:.0f}\n", job_count / seconds);
+
+    return 0;
+}
@@ -569,6 +569,8 @@ struct LangState {
             { "mapping_method_description", "Memory mapping improved performances, reduces memory usage and fixes many graphical issues.\nHowever, it may be unstable on some GPUs" },
             { "spirv_shader", "Use Spir-V Shader (deprecated)" },
             { "spirv_shader_description", "Pass generated Spir-V shader directly to driver.\nNote that some beneficial extensions will be disabled,\nand not all GPUs are compatible with this." },
+            { "spirv_optimization", "Optimize Spir-V Shaders" },
+            { "spirv_optimization_description", "Run a few optimization passes on the generated shaders before giving them to the driver.\nThis can reduce the shader compilation time and help slow GPUs.\nOptimized shaders are cached separately, changes apply to newly compiled shaders." },
             { "clean_shaders", "Clean Shaders Cache and Log" },
             { "fps_hack", "FPS Hack" },
             { "fps_hack_description", "Game hack which allows some games running at 30 FPS to run at 60 FPS on the emulator.\nNote that this is a hack and will only work on some games.\nOn other games, it may have no effect or make them run twice as fast." }
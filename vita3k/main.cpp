@@ -29,9 +29,12 @@
 #include <io/state.h>
 #include <kernel/state.h>
 #include <modules/module_parent.h>
+#include <np/functions.h>
+#include <np/state.h>
 #include <packages/functions.h>
 #include <packages/pkg.h>
 #include <packages/sfo.h>
+#include <regmgr/functions.h>
 #include <renderer/functions.h>
 #include <renderer/shaders.h>
 #include <renderer/state.h>
@@ -88,6 +91,10 @@ static void set_current_game_id(const std::string_view game_id) {
 }
 
 static void run_execv(char *argv[], EmuEnvState &emuenv) {
+    // The process is replaced without destroying the states, write the registry modifications and the trophy progress now
+    regmgr::stop_regmgr(emuenv.regmgr);
+    stop_trophy_progress_saves(emuenv.np.trophy_state);
+
     // retrieve the JNI environment.
     JNIEnv *env = reinterpret_cast<JNIEnv *>(SDL_AndroidGetJNIEnv());
 
@@ -113,6 +120,10 @@ static void run_execv(char *argv[], EmuEnvState &emuenv) {
 };
 #else
 static void run_execv(char *argv[], EmuEnvState &emuenv) {
+    // The process is replaced without destroying the states, write the registry modifications and the trophy progress now
+    regmgr::stop_regmgr(emuenv.regmgr);
+    stop_trophy_progress_saves(emuenv.np.trophy_state);
+
     char const *args[10];
     args[0] = argv[0];
     args[1] = "-a";
@@ -41,6 +41,8 @@ Address alloc_aligned(MemState &state, uint32_t size, const char *name, unsigned
 void protect_inner(MemState &state, Address addr, uint32_t size, const MemPerm perm);
 void unprotect_inner(MemState &state, Address addr, uint32_t size);
 bool add_protect(MemState &state, Address addr, const uint32_t size, const MemPerm perm, const ProtectCallback& callback);
+// remove a protection added by add_protect with the same range, the pages stay protected while other protections use them
+void remove_protect(MemState &state, Address addr, const uint32_t size);
 void add_external_mapping(MemState &mem, Address addr, uint32_t size, uint8_t *addr_ptr);
 void remove_external_mapping(MemState &mem, uint8_t *addr_ptr, uint32_t size);
 bool is_protecting(MemState &state, Address addr, MemPerm *perm = nullptr);
@@ -356,6 +356,27 @@ bool add_protect(MemState &state, Address addr, const uint32_t size, const MemPe
     return true;
 }
 
+void remove_protect(MemState &state, Address addr, const uint32_t size) {
+    const std::lock_guard<std::mutex> lock(state.protect_mutex);
+    const Address block_addr = align_down(addr, state.page_size);
+    const auto it = state.protect_tree.lower_bound(block_addr);
+    if (it == state.protect_tree.end() || block_addr >= it->first + it->second.size)
+        return;
+
+    // the segment may hold the blocks of other protections merged with this one, only drop this block
+    ProtectSegmentInfo &info = it->second;
+    const auto [blocks_begin, blocks_end] = info.blocks.equal_range(block_addr);
+    const auto block = std::find_if(blocks_begin, blocks_end, [&](const auto &item) { return item.second.size == size; });
+    if (block == blocks_end)
+        return;
+
+    info.blocks.erase(block);
+    if (info.blocks.empty()) {
+        unprotect_inner(state, it->first, info.size);
+        state.protect_tree.erase(it);
+    }
+}
+
 bool is_protecting(MemState &state, Address addr, MemPerm *perm) {
     const std::lock_guard<std::mutex> lock(state.protect_mutex);
     auto ite = state.protect_tree.lower_bound(addr);
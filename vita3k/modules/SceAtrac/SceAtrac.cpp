@@ -19,8 +19,18 @@
 
 #include "../SceAudiodec/SceAudiodecUser.h"
 
+#include <modules/module_parent.h>
+
+#include <codec/state.h>
+#include <kernel/state.h>
 #include <util/tracy.h>
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
 TRACY_MODULE_NAME(SceAtrac);
 
 #define SCE_ATRAC_ALIGNMENT_SIZE 0x100U
@@ -86,9 +96,379 @@ struct SceAtracStreamInfo {
     SceUInt32 writableSize;
 };
 
+enum SceAtracDecoderStatus : SceUInt32 {
+    SCE_ATRAC_ALL_DATA_WAS_DECODED = 0x1,
+    SCE_ATRAC_ALL_DATA_IS_ON_MEMORY = 0x2,
+    SCE_ATRAC_NONLOOP_PART_IS_ON_MEMORY = 0x4,
+    SCE_ATRAC_LOOP_PART_IS_ON_MEMORY = 0x8
+};
+
+constexpr uint32_t SCE_ATRAC_AT9_MAX_HANDLES = SCE_ATRAC_AT9_MAX_TOTAL_CH;
+constexpr uint32_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+// A handle playing one AT9 file. The buffer given by the game is either the whole file or a ring the game
+// keeps filled: stream byte n lives at buffer[n % buffer_size], and the stream follows the file order
+// except that it jumps back to the superframe before the loop start each time the loop end is written
+struct AtracHandle {
+    Ptr<uint8_t> buffer;
+    uint32_t buffer_size = 0;
+    bool all_on_memory = false;
+
+    std::unique_ptr<Atrac9DecoderState> decoder;
+    uint32_t channels = 0;
+    uint32_t sample_rate = 0;
+    uint32_t bit_rate = 0;
+    uint32_t frame_samples = 0;
+    uint32_t superframe_samples = 0;
+    uint32_t superframe_size = 0;
+
+    // Offset and size of the encoded data in the file
+    uint32_t data_offset = 0;
+    uint32_t data_size = 0;
+    uint32_t encoder_delay = 0;
+    uint32_t total_samples = 0;
+    // Both inclusive, -1 when the file has no loop
+    int32_t loop_start = -1;
+    int32_t loop_end = -1;
+
+    uint32_t output_samples = 0;
+    uint32_t next_sample = 0;
+    int32_t loop_num = 0;
+    int32_t internal_error = 0;
+
+    // Decoded samples of the last decoded superframe
+    std::vector<int16_t> decoded;
+    int32_t decoded_superframe = -1;
+
+    uint64_t stream_written = 0;
+    uint64_t stream_consumed = 0;
+    // Superframe at the consumed position of the stream
+    uint32_t stream_superframe = 0;
+    uint32_t file_write_offset = 0;
+    int32_t write_loop_num = 0;
+
+    bool has_loop() const {
+        return loop_start >= 0;
+    }
+
+    bool is_looping() const {
+        return has_loop() && loop_num != 0;
+    }
+
+    uint32_t superframe_of(uint32_t sample) const {
+        return (sample + encoder_delay) / superframe_samples;
+    }
+
+    // The superframe to decode first when starting at a sample, the previous one primes the overlap
+    uint32_t priming_superframe_of(uint32_t sample) const {
+        const uint32_t superframe = superframe_of(sample);
+        return superframe > 0 ? superframe - 1 : 0;
+    }
+
+    uint32_t superframe_offset(uint32_t superframe) const {
+        return data_offset + superframe * superframe_size;
+    }
+
+    uint32_t data_end() const {
+        return data_offset + data_size;
+    }
+
+    // End of the superframe holding the loop end
+    uint32_t loop_boundary() const {
+        return std::min(superframe_offset(superframe_of(loop_end) + 1), data_end());
+    }
+
+    // File offset at which the writer stops or jumps back to the loop start
+    uint32_t write_boundary() const {
+        if (has_loop() && write_loop_num != 0)
+            return loop_boundary();
+
+        return data_end();
+    }
+
+    uint32_t stream_available() const {
+        return static_cast<uint32_t>(stream_written - stream_consumed);
+    }
+
+    uint32_t writable_size() const {
+        if (all_on_memory)
+            return 0;
+
+        const uint32_t vacant = buffer_size - stream_available();
+        const uint32_t until_wrap = buffer_size - static_cast<uint32_t>(stream_written % buffer_size);
+        return std::min({ vacant, until_wrap, write_boundary() - file_write_offset });
+    }
+
+    // Called once bytes have been written to the stream, takes the loop jump when the boundary is reached
+    void advance_writer(uint32_t size) {
+        stream_written += size;
+        file_write_offset += size;
+        if (file_write_offset >= write_boundary() && has_loop() && write_loop_num != 0) {
+            if (write_loop_num > 0)
+                write_loop_num--;
+            file_write_offset = superframe_offset(priming_superframe_of(loop_start));
+        }
+    }
+
+    // Arming the loop after the data past the loop end was written drops that data from the stream so the
+    // writer jumps back to the loop start instead, fails if the decoder already consumed it
+    bool set_loop_num(int32_t num) {
+        const bool arming = has_loop() && write_loop_num == 0 && num != 0 && !all_on_memory;
+        if (arming && file_write_offset > loop_boundary()) {
+            const uint32_t excess = file_write_offset - loop_boundary();
+            if (excess > stream_available())
+                return false;
+
+            stream_written -= excess;
+            file_write_offset = loop_boundary();
+        }
+
+        loop_num = num;
+        write_loop_num = num;
+        if (arming)
+            advance_writer(0);
+
+        return true;
+    }
+
+    // Move the next output to the given sample, the decoder restarts from the superframe before it
+    void seek(uint32_t sample, bool restart_stream) {
+        next_sample = sample;
+        decoded_superframe = -1;
+        decoder->flush();
+        stream_superframe = priming_superframe_of(sample);
+
+        if (restart_stream && !all_on_memory) {
+            stream_consumed = stream_written;
+            write_loop_num = loop_num;
+            file_write_offset = superframe_offset(priming_superframe_of(sample));
+        }
+    }
+
+    SceUInt32 status() const {
+        SceUInt32 result = 0;
+        if (!is_looping() && next_sample >= total_samples)
+            result |= SCE_ATRAC_ALL_DATA_WAS_DECODED;
+        if (all_on_memory)
+            result |= SCE_ATRAC_ALL_DATA_IS_ON_MEMORY | SCE_ATRAC_NONLOOP_PART_IS_ON_MEMORY | (has_loop() ? SCE_ATRAC_LOOP_PART_IS_ON_MEMORY : 0U);
+        else if (file_write_offset == data_end() && !is_looping())
+            result |= SCE_ATRAC_NONLOOP_PART_IS_ON_MEMORY;
+
+        return result;
+    }
+
+    SceInt32 decode_superframe(MemState &mem, uint32_t superframe, std::vector<uint8_t> &scratch);
+    SceInt32 decode(MemState &mem, int16_t *output, SceUInt32 &output_count);
+};
+
+struct AtracState {
+    std::mutex mutex;
+    bool group_created = false;
+    uint32_t total_channels = 0;
+    uint32_t used_channels = 0;
+    std::array<std::unique_ptr<AtracHandle>, SCE_ATRAC_AT9_MAX_HANDLES> handles;
+
+    AtracHandle *get_handle(SceInt32 atrac_handle) {
+        if ((atrac_handle >> 16) != SCE_ATRAC_TYPE_AT9)
+            return nullptr;
+
+        const uint32_t index = atrac_handle & 0xFFFF;
+        if (index >= handles.size())
+            return nullptr;
+
+        return handles[index].get();
+    }
+};
+
+LIBRARY_INIT(SceAtrac) {
+    emuenv.kernel.obj_store.create<AtracState>();
+}
+
+SceInt32 AtracHandle::decode_superframe(MemState &mem, uint32_t superframe, std::vector<uint8_t> &scratch) {
+    const uint8_t *data;
+    if (all_on_memory) {
+        data = buffer.get(mem) + superframe_offset(superframe);
+    } else {
+        // Copy out the superframe when it wraps around the end of the ring
+        const uint32_t start = static_cast<uint32_t>(stream_consumed % buffer_size);
+        if (start + superframe_size <= buffer_size) {
+            data = buffer.get(mem) + start;
+        } else {
+            const uint32_t first_part = buffer_size - start;
+            scratch.resize(superframe_size);
+            memcpy(scratch.data(), buffer.get(mem) + start, first_part);
+            memcpy(scratch.data() + first_part, buffer.get(mem), superframe_size - first_part);
+            data = scratch.data();
+        }
+        stream_consumed += superframe_size;
+        stream_superframe++;
+    }
+
+    const uint32_t frames = superframe_samples / frame_samples;
+    uint32_t used = 0;
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        if (!decoder->send(data + used, superframe_size - used)) {
+            internal_error = SCE_ATRAC_ERROR_INVALID_DATA;
+            return SCE_ATRAC_ERROR_INVALID_DATA;
+        }
+        used += decoder->get_es_size();
+        decoder->receive(reinterpret_cast<uint8_t *>(&decoded[frame * frame_samples * channels]), nullptr);
+    }
+
+    decoded_superframe = static_cast<int32_t>(superframe);
+    return 0;
+}
+
+SceInt32 AtracHandle::decode(MemState &mem, int16_t *output, SceUInt32 &output_count) {
+    output_count = 0;
+
+    uint32_t segment_end = is_looping() ? loop_end + 1 : total_samples;
+    if (next_sample >= segment_end) {
+        if (!is_looping())
+            return SCE_ATRAC_ERROR_ALL_DATA_WAS_DECODED;
+
+        if (loop_num > 0)
+            loop_num--;
+        seek(loop_start, false);
+        segment_end = is_looping() ? loop_end + 1 : total_samples;
+    }
+
+    const uint32_t target = superframe_of(next_sample);
+    uint32_t first = target;
+    if (decoded_superframe == static_cast<int32_t>(target)) {
+        first = target + 1;
+    } else if (decoded_superframe < 0 || static_cast<uint32_t>(decoded_superframe) + 1 != target) {
+        decoder->flush();
+        first = target > 0 ? target - 1 : 0;
+    }
+
+    if (!all_on_memory && first <= target) {
+        if (stream_superframe > target)
+            return SCE_ATRAC_ERROR_INVALID_DATA;
+        if (stream_available() < (target + 1 - stream_superframe) * superframe_size)
+            return SCE_ATRAC_ERROR_DATA_SHORTAGE_IN_BUFFER;
+
+        // Superframes the stream holds before the ones needed are skipped
+        first = std::max(first, stream_superframe);
+        stream_consumed += static_cast<uint64_t>(first - stream_superframe) * superframe_size;
+        stream_superframe = first;
+    }
+
+    std::vector<uint8_t> scratch;
+    for (uint32_t superframe = first; superframe <= target; superframe++) {
+        const SceInt32 res = decode_superframe(mem, superframe, scratch);
+        if (res < 0)
+            return res;
+    }
+
+    const uint32_t position = next_sample + encoder_delay - target * superframe_samples;
+    output_count = std::min({ output_samples, superframe_samples - position, segment_end - next_sample });
+    memcpy(output, &decoded[position * channels], output_count * channels * sizeof(int16_t));
+    next_sample += output_count;
+
+    return 0;
+}
+
+template <typename T>
+static T read_le(const uint8_t *data) {
+    T value;
+    memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+// Read the RIFF header of an AT9 file, all the chunks before the data have to be in the first read
+static SceInt32 parse_at9_header(AtracHandle &handle, const uint8_t *data, uint32_t size) {
+    if (size < 12)
+        return SCE_ATRAC_ERROR_READ_SIZE_IS_TOO_SMALL;
+    if (memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0)
+        return SCE_ATRAC_ERROR_INVALID_DATA;
+
+    bool fmt_found = false;
+    uint32_t config_data = 0;
+    uint32_t offset = 12;
+    while (true) {
+        if (offset + 8 > size)
+            return SCE_ATRAC_ERROR_READ_SIZE_IS_TOO_SMALL;
+
+        const uint8_t *chunk = data + offset + 8;
+        const uint32_t chunk_size = read_le<uint32_t>(data + offset + 4);
+
+        if (memcmp(data + offset, "data", 4) == 0) {
+            handle.data_offset = offset + 8;
+            handle.data_size = chunk_size;
+            break;
+        }
+
+        if (offset + 8 + chunk_size > size)
+            return SCE_ATRAC_ERROR_READ_SIZE_IS_TOO_SMALL;
+
+        if (memcmp(data + offset, "fmt ", 4) == 0) {
+            // WAVEFORMATEXTENSIBLE followed by the AT9 version and config data
+            if (chunk_size < 48 || read_le<uint16_t>(chunk) != WAVE_FORMAT_EXTENSIBLE)
+                return SCE_ATRAC_ERROR_UNSUPPORTED_DATA;
+
+            handle.channels = read_le<uint16_t>(chunk + 2);
+            handle.sample_rate = read_le<uint32_t>(chunk + 4);
+            handle.bit_rate = read_le<uint32_t>(chunk + 8) * 8 / 1000;
+            handle.superframe_size = read_le<uint16_t>(chunk + 12);
+            config_data = read_le<uint32_t>(chunk + 44);
+            fmt_found = true;
+        } else if (memcmp(data + offset, "fact", 4) == 0) {
+            if (chunk_size < 8)
+                return SCE_ATRAC_ERROR_INVALID_DATA;
+
+            handle.total_samples = read_le<uint32_t>(chunk);
+            handle.encoder_delay = read_le<uint32_t>(chunk + (chunk_size >= 12 ? 8 : 4));
+        } else if (memcmp(data + offset, "smpl", 4) == 0) {
+            if (chunk_size >= 36 + 24 && read_le<uint32_t>(chunk + 28) > 0) {
+                handle.loop_start = read_le<int32_t>(chunk + 36 + 8);
+                handle.loop_end = read_le<int32_t>(chunk + 36 + 12);
+            }
+        }
+
+        // Chunks are padded to an even size
+        offset += 8 + chunk_size + (chunk_size & 1);
+    }
+
+    if (!fmt_found || handle.channels == 0 || handle.channels > 2 || handle.total_samples == 0)
+        return SCE_ATRAC_ERROR_INVALID_DATA;
+    if (handle.has_loop() && (handle.loop_start > handle.loop_end || static_cast<uint32_t>(handle.loop_end) >= handle.total_samples))
+        return SCE_ATRAC_ERROR_INVALID_DATA;
+
+    handle.decoder = std::make_unique<Atrac9DecoderState>(config_data);
+    if (handle.decoder->get(DecoderQuery::CHANNELS) != handle.channels)
+        return SCE_ATRAC_ERROR_UNSUPPORTED_DATA;
+
+    handle.frame_samples = handle.decoder->get(DecoderQuery::AT9_SAMPLE_PER_FRAME);
+    handle.superframe_samples = handle.decoder->get(DecoderQuery::AT9_SAMPLE_PER_SUPERFRAME);
+    handle.superframe_size = handle.decoder->get(DecoderQuery::AT9_SUPERFRAME_SIZE);
+    handle.output_samples = handle.superframe_samples;
+    handle.decoded.resize(handle.superframe_samples * handle.channels);
+
+    // Samples past the last superframe of data cannot be decoded
+    const uint32_t decodable = (handle.data_size / handle.superframe_size) * handle.superframe_samples;
+    if (decodable <= handle.encoder_delay)
+        return SCE_ATRAC_ERROR_INVALID_DATA;
+    handle.total_samples = std::min(handle.total_samples, decodable - handle.encoder_delay);
+
+    return 0;
+}
+
 EXPORT(SceInt32, sceAtracAddStreamData, SceInt32 atracHandle, SceUInt32 addSize) {
     TRACY_FUNC(sceAtracAddStreamData, atracHandle, addSize);
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    AtracHandle *handle = state->get_handle(atracHandle);
+    if (!handle) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_HANDLE);
+    }
+
+    if (addSize > handle->writable_size()) {
+        return RET_ERROR(SCE_ATRAC_ERROR_ADDED_DATA_IS_TOO_BIG);
+    }
+
+    handle->advance_writer(addSize);
+    return 0;
 }
 
 EXPORT(SceInt32, sceAtracCreateDecoderGroup, SceUInt32 atracType, const SceAtracDecoderGroup *decoderGroup, Ptr<void> pvWorkMem, SceInt32 initAudiodecFlag) {
@@ -121,6 +501,12 @@ EXPORT(SceInt32, sceAtracCreateDecoderGroup, SceUInt32 atracType, const SceAtrac
         return RET_ERROR(SCE_ATRAC_ERROR_INVALID_TOTAL_CH);
     }
 
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (state->group_created) {
+        return RET_ERROR(SCE_ATRAC_ERROR_ALREADY_CREATED);
+    }
+
     if (initAudiodecFlag) {
         SceAudiodecInitParam audiodecInitParam = {};
         audiodecInitParam.size = sizeof(audiodecInitParam.at9);
@@ -132,7 +518,11 @@ EXPORT(SceInt32, sceAtracCreateDecoderGroup, SceUInt32 atracType, const SceAtrac
         }
     }
 
-    return UNIMPLEMENTED();
+    state->group_created = true;
+    state->total_channels = decoderGroup->totalCh;
+    state->used_channels = 0;
+
+    return 0;
 }
 
 EXPORT(SceInt32, sceAtracDecode, SceInt32 atracHandle, Ptr<void> pOutputBuffer, Ptr<SceUInt32> pOutputSamples, Ptr<SceUInt32> pDecoderStatus) {
@@ -145,7 +535,22 @@ EXPORT(SceInt32, sceAtracDecode, SceInt32 atracHandle, Ptr<void> pOutputBuffer,
         return RET_ERROR(SCE_ATRAC_ERROR_INVALID_ALIGNMENT);
     }
 
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    AtracHandle *handle = state->get_handle(atracHandle);
+    if (!handle) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_HANDLE);
+    }
+
+    SceUInt32 output_count = 0;
+    const SceInt32 res = handle->decode(emuenv.mem, pOutputBuffer.cast<int16_t>().get(emuenv.mem), output_count);
+    *pOutputSamples.get(emuenv.mem) = output_count;
+    *pDecoderStatus.get(emuenv.mem) = handle->status();
+    if (res < 0) {
+        return RET_ERROR(res);
+    }
+
+    return 0;
 }
 
 EXPORT(SceInt32, sceAtracDeleteDecoderGroup, SceUInt32 atracType, SceInt32 termAudiodecFlag) {
@@ -154,6 +559,16 @@ EXPORT(SceInt32, sceAtracDeleteDecoderGroup, SceUInt32 atracType, SceInt32 termA
         return RET_ERROR(SCE_ATRAC_ERROR_INVALID_TYPE);
     }
 
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->group_created) {
+        return RET_ERROR(SCE_ATRAC_ERROR_NOT_CREATED);
+    }
+
+    if (state->used_channels > 0) {
+        return RET_ERROR(SCE_ATRAC_ERROR_REMAIN_VALID_HANDLE);
+    }
+
     if (termAudiodecFlag) {
         SceInt32 res = CALL_EXPORT(sceAudiodecTermLibrary, SCE_AUDIODEC_TYPE_AT9);
         if (res < 0) {
@@ -161,7 +576,10 @@ EXPORT(SceInt32, sceAtracDeleteDecoderGroup, SceUInt32 atracType, SceInt32 termA
         }
     }
 
-    return UNIMPLEMENTED();
+    state->group_created = false;
+    state->total_channels = 0;
+
+    return 0;
 }
 
 EXPORT(SceInt32, sceAtracGetContentInfo, SceInt32 atracHandle, SceAtracContentInfo *contentInfo) {
@@ -174,7 +592,33 @@ EXPORT(SceInt32, sceAtracGetContentInfo, SceInt32 atracHandle, SceAtracContentIn
         return RET_ERROR(SCE_ATRAC_ERROR_INVALID_SIZE);
     }
 
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    const AtracHandle *handle = state->get_handle(atracHandle);
+    if (!handle) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_HANDLE);
+    }
+
+    contentInfo->atracType = SCE_ATRAC_TYPE_AT9;
+    contentInfo->channel = handle->channels;
+    contentInfo->samplingRate = handle->sample_rate;
+    contentInfo->endSample = static_cast<SceInt32>(handle->total_samples) - 1;
+    contentInfo->loopStartSample = handle->loop_start;
+    contentInfo->loopEndSample = handle->loop_end;
+    contentInfo->bitRate = handle->bit_rate;
+    contentInfo->fixedEncBlockSize = handle->superframe_size;
+    contentInfo->fixedEncBlockSample = handle->superframe_samples;
+    contentInfo->frameSample = handle->frame_samples;
+    if (handle->has_loop()) {
+        const uint32_t loop_block_start = handle->superframe_offset(handle->priming_superframe_of(handle->loop_start));
+        contentInfo->loopBlockOffset = loop_block_start;
+        contentInfo->loopBlockSize = handle->superframe_offset(handle->superframe_of(handle->loop_end) + 1) - loop_block_start;
+    } else {
+        contentInfo->loopBlockOffset = 0;
+        contentInfo->loopBlockSize = 0;
+    }
+
+    return 0;
 }
 
 EXPORT(SceInt32, sceAtracGetDecoderGroupInfo, SceUInt32 atracType, SceAtracDecoderGroup *createdDecoder, SceAtracDecoderGroup *availableDecoder) {
@@ -191,7 +635,18 @@ EXPORT(SceInt32, sceAtracGetDecoderGroupInfo, SceUInt32 atracType, SceAtracDecod
         return RET_ERROR(SCE_ATRAC_ERROR_INVALID_TYPE);
     }
 
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->group_created) {
+        return RET_ERROR(SCE_ATRAC_ERROR_NOT_CREATED);
+    }
+
+    createdDecoder->wordLength = SCE_ATRAC_WORD_LENGTH_16BITS;
+    createdDecoder->totalCh = state->total_channels;
+    availableDecoder->wordLength = SCE_ATRAC_WORD_LENGTH_16BITS;
+    availableDecoder->totalCh = state->total_channels - state->used_channels;
+
+    return 0;
 }
 
 EXPORT(SceInt32, sceAtracGetDecoderStatus, SceInt32 atracHandle, Ptr<SceUInt32> pDecoderStatus) {
@@ -200,7 +655,15 @@ EXPORT(SceInt32, sceAtracGetDecoderStatus, SceInt32 atracHandle, Ptr<SceUInt32>
         return RET_ERROR(SCE_ATRAC_ERROR_INVALID_POINTER);
     }
 
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    const AtracHandle *handle = state->get_handle(atracHandle);
+    if (!handle) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_HANDLE);
+    }
+
+    *pDecoderStatus.get(emuenv.mem) = handle->status();
+    return 0;
 }
 
 EXPORT(SceInt32, sceAtracGetInternalError, SceInt32 atracHandle, Ptr<SceInt32> pInternalError) {
@@ -209,7 +672,15 @@ EXPORT(SceInt32, sceAtracGetInternalError, SceInt32 atracHandle, Ptr<SceInt32> p
         return RET_ERROR(SCE_ATRAC_ERROR_INVALID_POINTER);
     }
 
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    const AtracHandle *handle = state->get_handle(atracHandle);
+    if (!handle) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_HANDLE);
+    }
+
+    *pInternalError.get(emuenv.mem) = handle->internal_error;
+    return 0;
 }
 
 EXPORT(SceInt32, sceAtracGetLoopInfo, SceInt32 atracHandle, Ptr<SceInt32> pLoopNum, Ptr<SceUInt32> pLoopStatus) {
@@ -218,7 +689,16 @@ EXPORT(SceInt32, sceAtracGetLoopInfo, SceInt32 atracHandle, Ptr<SceInt32> pLoopN
         return RET_ERROR(SCE_ATRAC_ERROR_INVALID_POINTER);
     }
 
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    const AtracHandle *handle = state->get_handle(atracHandle);
+    if (!handle) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_HANDLE);
+    }
+
+    *pLoopNum.get(emuenv.mem) = handle->loop_num;
+    *pLoopStatus.get(emuenv.mem) = handle->is_looping() ? 1 : 0;
+    return 0;
 }
 
 EXPORT(SceInt32, sceAtracGetNextOutputPosition, SceInt32 atracHandle, Ptr<SceUInt32> pNextOutputSample) {
@@ -227,7 +707,19 @@ EXPORT(SceInt32, sceAtracGetNextOutputPosition, SceInt32 atracHandle, Ptr<SceUIn
         return RET_ERROR(SCE_ATRAC_ERROR_INVALID_POINTER);
     }
 
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    const AtracHandle *handle = state->get_handle(atracHandle);
+    if (!handle) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_HANDLE);
+    }
+
+    if (handle->status() & SCE_ATRAC_ALL_DATA_WAS_DECODED) {
+        return RET_ERROR(SCE_ATRAC_ERROR_ALL_DATA_WAS_DECODED);
+    }
+
+    *pNextOutputSample.get(emuenv.mem) = handle->next_sample;
+    return 0;
 }
 
 EXPORT(SceInt32, sceAtracGetOutputSamples, SceInt32 atracHandle, Ptr<SceUInt32> pOutputSamples) {
@@ -236,7 +728,15 @@ EXPORT(SceInt32, sceAtracGetOutputSamples, SceInt32 atracHandle, Ptr<SceUInt32>
         return RET_ERROR(SCE_ATRAC_ERROR_INVALID_POINTER);
     }
 
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    const AtracHandle *handle = state->get_handle(atracHandle);
+    if (!handle) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_HANDLE);
+    }
+
+    *pOutputSamples.get(emuenv.mem) = handle->output_samples;
+    return 0;
 }
 
 EXPORT(SceInt32, sceAtracGetOutputableSamples, SceInt32 atracHandle, Ptr<SceLong64> pOutputableSamples) {
@@ -245,7 +745,27 @@ EXPORT(SceInt32, sceAtracGetOutputableSamples, SceInt32 atracHandle, Ptr<SceLong
         return RET_ERROR(SCE_ATRAC_ERROR_INVALID_POINTER);
     }
 
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    const AtracHandle *handle = state->get_handle(atracHandle);
+    if (!handle) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_HANDLE);
+    }
+
+    if (handle->is_looping() && handle->all_on_memory) {
+        *pOutputableSamples.get(emuenv.mem) = -1;
+    } else if (handle->all_on_memory) {
+        *pOutputableSamples.get(emuenv.mem) = handle->total_samples - std::min(handle->next_sample, handle->total_samples);
+    } else {
+        // Samples of the superframes already in the stream, the first one is counted from the next sample
+        const SceLong64 superframes = handle->stream_available() / handle->superframe_size;
+        const SceLong64 decoded_left = handle->decoded_superframe == static_cast<int32_t>(handle->superframe_of(handle->next_sample))
+            ? (handle->decoded_superframe + 1) * static_cast<SceLong64>(handle->superframe_samples) - handle->next_sample - handle->encoder_delay
+            : 0;
+        *pOutputableSamples.get(emuenv.mem) = decoded_left + superframes * handle->superframe_samples;
+    }
+
+    return 0;
 }
 
 EXPORT(SceInt32, sceAtracGetRemainSamples, SceInt32 atracHandle, Ptr<SceLong64> pRemainSamples) {
@@ -254,7 +774,23 @@ EXPORT(SceInt32, sceAtracGetRemainSamples, SceInt32 atracHandle, Ptr<SceLong64>
         return RET_ERROR(SCE_ATRAC_ERROR_INVALID_POINTER);
     }
 
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    const AtracHandle *handle = state->get_handle(atracHandle);
+    if (!handle) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_HANDLE);
+    }
+
+    if (handle->loop_num < 0 && handle->has_loop()) {
+        *pRemainSamples.get(emuenv.mem) = -1;
+    } else {
+        SceLong64 remain = handle->total_samples - std::min(handle->next_sample, handle->total_samples);
+        if (handle->is_looping())
+            remain += static_cast<SceLong64>(handle->loop_num) * (handle->loop_end - handle->loop_start + 1);
+        *pRemainSamples.get(emuenv.mem) = remain;
+    }
+
+    return 0;
 }
 
 EXPORT(SceInt32, sceAtracGetStreamInfo, SceInt32 atracHandle, SceAtracStreamInfo *streamInfo) {
@@ -267,7 +803,18 @@ EXPORT(SceInt32, sceAtracGetStreamInfo, SceInt32 atracHandle, SceAtracStreamInfo
         return RET_ERROR(SCE_ATRAC_ERROR_INVALID_SIZE);
     }
 
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    const AtracHandle *handle = state->get_handle(atracHandle);
+    if (!handle) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_HANDLE);
+    }
+
+    streamInfo->pWritePosition = Ptr<SceUChar8>(handle->buffer.address() + static_cast<uint32_t>(handle->stream_written % handle->buffer_size));
+    streamInfo->readPosition = handle->file_write_offset;
+    streamInfo->writableSize = handle->writable_size();
+
+    return 0;
 }
 
 EXPORT(SceInt32, sceAtracGetSubBufferInfo, SceInt32 atracHandle, Ptr<SceUInt32> pReadPosition, Ptr<SceUInt32> pMinSubBufferSize, Ptr<SceUInt32> pDataSize) {
@@ -276,7 +823,14 @@ EXPORT(SceInt32, sceAtracGetSubBufferInfo, SceInt32 atracHandle, Ptr<SceUInt32>
         return RET_ERROR(SCE_ATRAC_ERROR_INVALID_POINTER);
     }
 
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->get_handle(atracHandle)) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_HANDLE);
+    }
+
+    // The main buffer always holds whole superframes, so no sub buffer is ever used
+    return RET_ERROR(SCE_ATRAC_ERROR_NO_NEED_SUB_BUFFER);
 }
 
 EXPORT(SceInt32, sceAtracGetVacantSize, SceInt32 atracHandle, Ptr<SceUInt32> pVacantSize) {
@@ -285,12 +839,26 @@ EXPORT(SceInt32, sceAtracGetVacantSize, SceInt32 atracHandle, Ptr<SceUInt32> pVa
         return RET_ERROR(SCE_ATRAC_ERROR_INVALID_POINTER);
     }
 
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    const AtracHandle *handle = state->get_handle(atracHandle);
+    if (!handle) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_HANDLE);
+    }
+
+    *pVacantSize.get(emuenv.mem) = handle->all_on_memory ? 0 : handle->buffer_size - handle->stream_available();
+    return 0;
 }
 
 EXPORT(SceInt32, sceAtracIsSubBufferNeeded, SceInt32 atracHandle) {
     TRACY_FUNC(sceAtracIsSubBufferNeeded, atracHandle);
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->get_handle(atracHandle)) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_HANDLE);
+    }
+
+    return 0;
 }
 
 EXPORT(SceInt32, sceAtracQueryDecoderGroupMemSize, SceUInt32 atracType, const SceAtracDecoderGroup *decoderGroup) {
@@ -324,12 +892,34 @@ EXPORT(SceInt32, sceAtracReleaseHandle, SceInt32 atracHandle) {
         return RET_ERROR(SCE_ATRAC_ERROR_INVALID_HANDLE);
     }
 
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    const AtracHandle *handle = state->get_handle(atracHandle);
+    if (!handle) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_HANDLE);
+    }
+
+    state->used_channels -= handle->channels;
+    state->handles[atracHandle & 0xFFFF].reset();
+
+    return 0;
 }
 
 EXPORT(SceInt32, sceAtracResetNextOutputPosition, SceInt32 atracHandle, SceUInt32 resetSample) {
     TRACY_FUNC(sceAtracResetNextOutputPosition, atracHandle, resetSample);
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    AtracHandle *handle = state->get_handle(atracHandle);
+    if (!handle) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_HANDLE);
+    }
+
+    if (resetSample >= handle->total_samples) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_SAMPLE);
+    }
+
+    handle->seek(resetSample, true);
+    return 0;
 }
 
 EXPORT(SceInt32, sceAtracSetDataAndAcquireHandle, Ptr<SceUChar8> pucBuffer, SceUInt32 uiReadSize, SceUInt32 uiBufferSize) {
@@ -346,7 +936,45 @@ EXPORT(SceInt32, sceAtracSetDataAndAcquireHandle, Ptr<SceUChar8> pucBuffer, SceU
         return RET_ERROR(SCE_ATRAC_ERROR_READ_SIZE_OVER_BUFFER);
     }
 
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->group_created) {
+        return RET_ERROR(SCE_ATRAC_ERROR_NOT_CREATED);
+    }
+
+    auto handle = std::make_unique<AtracHandle>();
+    const SceInt32 res = parse_at9_header(*handle, pucBuffer.get(emuenv.mem), uiReadSize);
+    if (res < 0) {
+        return RET_ERROR(res);
+    }
+
+    if (state->used_channels + handle->channels > state->total_channels) {
+        return RET_ERROR(SCE_ATRAC_ERROR_SHORTAGE_OF_CH);
+    }
+
+    const auto slot = std::find(state->handles.begin(), state->handles.end(), nullptr);
+    if (slot == state->handles.end()) {
+        return RET_ERROR(SCE_ATRAC_ERROR_SHORTAGE_OF_CH);
+    }
+
+    handle->buffer = pucBuffer;
+    handle->buffer_size = uiBufferSize;
+    handle->all_on_memory = uiReadSize >= handle->data_end();
+    if (!handle->all_on_memory) {
+        if (uiBufferSize < handle->data_offset + handle->superframe_size * 2) {
+            return RET_ERROR(SCE_ATRAC_ERROR_MAIN_BUFFER_SIZE_IS_TOO_SMALL);
+        }
+
+        // Bytes read past the loop end are dropped, the stream continues at the loop start instead
+        handle->stream_consumed = handle->data_offset;
+        handle->advance_writer(std::min(uiReadSize, handle->write_boundary()));
+    }
+
+    const SceInt32 index = static_cast<SceInt32>(slot - state->handles.begin());
+    state->used_channels += handle->channels;
+    *slot = std::move(handle);
+
+    return (SCE_ATRAC_TYPE_AT9 << 16) | index;
 }
 
 EXPORT(SceInt32, sceAtracSetLoopNum, SceInt32 atracHandle, SceInt32 loopNum) {
@@ -355,12 +983,39 @@ EXPORT(SceInt32, sceAtracSetLoopNum, SceInt32 atracHandle, SceInt32 loopNum) {
         return RET_ERROR(SCE_ATRAC_ERROR_INVALID_LOOP_NUM);
     }
 
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    AtracHandle *handle = state->get_handle(atracHandle);
+    if (!handle) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_HANDLE);
+    }
+
+    if (!handle->has_loop()) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_LOOP_STATUS);
+    }
+
+    if (!handle->set_loop_num(loopNum)) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_LOOP_STATUS);
+    }
+
+    return 0;
 }
 
 EXPORT(SceInt32, sceAtracSetOutputSamples, SceInt32 atracHandle, SceUInt32 outputSamples) {
     TRACY_FUNC(sceAtracSetOutputSamples, atracHandle, outputSamples);
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    AtracHandle *handle = state->get_handle(atracHandle);
+    if (!handle) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_HANDLE);
+    }
+
+    if (outputSamples == 0 || outputSamples > handle->superframe_samples || (outputSamples % handle->frame_samples) != 0) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_MAX_OUTPUT_SAMPLES);
+    }
+
+    handle->output_samples = outputSamples;
+    return 0;
 }
 
 EXPORT(SceInt32, sceAtracSetSubBuffer, SceInt32 atracHandle, Ptr<SceUChar8> pSubBuffer, SceUInt32 subBufferSize) {
@@ -369,5 +1024,11 @@ EXPORT(SceInt32, sceAtracSetSubBuffer, SceInt32 atracHandle, Ptr<SceUChar8> pSub
         return RET_ERROR(SCE_ATRAC_ERROR_INVALID_ALIGNMENT);
     }
 
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<AtracState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->get_handle(atracHandle)) {
+        return RET_ERROR(SCE_ATRAC_ERROR_INVALID_HANDLE);
+    }
+
+    return RET_ERROR(SCE_ATRAC_ERROR_NO_NEED_SUB_BUFFER);
 }
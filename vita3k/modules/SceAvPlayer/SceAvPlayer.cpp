@@ -101,6 +101,121 @@ struct PlayerInfoState {
     SceAvPlayerMemoryAllocator memory_allocator;
     SceAvPlayerFileManager file_manager;
     SceAvPlayerEventManager event_manager;
+
+    // Last frames given to the guest, their buffers are swapped with the decoded ones
+    PlayerFrame video_frame;
+    PlayerFrame audio_frame;
+};
+
+// Guest thread running on this host thread while it is inside an export, the file functions of the title are run on it
+static thread_local SceUID io_thread_id = 0;
+
+// Sets the thread the file functions can be run on for the duration of an export
+struct IoThreadGuard {
+    SceUID previous_thread_id;
+
+    explicit IoThreadGuard(SceUID thread_id)
+        : previous_thread_id(io_thread_id) {
+        io_thread_id = thread_id;
+    }
+
+    ~IoThreadGuard() {
+        io_thread_id = previous_thread_id;
+    }
+};
+
+// Size of the guest buffer the file is read into
+constexpr uint32_t READ_BUFFER_SIZE = KiB(256);
+
+// Reads the media on demand through the file functions of the title
+struct GuestFileReader : PlayerReader {
+    EmuEnvState &emuenv;
+    PlayerInfoState &player_info;
+    Address path = 0;
+    Address buffer = 0;
+    uint64_t file_size = 0;
+    bool opened = false;
+
+    GuestFileReader(EmuEnvState &emuenv, PlayerInfoState &player_info, Ptr<const char> path)
+        : emuenv(emuenv)
+        , player_info(player_info) {
+        // The path given by the title may not live until the file is opened
+        const std::string host_path = path.get(emuenv.mem);
+        this->path = alloc(emuenv.mem, static_cast<uint32_t>(host_path.size() + 1), "AvPlayer path");
+        memcpy(Ptr<char>(this->path).get(emuenv.mem), host_path.c_str(), host_path.size() + 1);
+        buffer = alloc(emuenv.mem, READ_BUFFER_SIZE, "AvPlayer buffer");
+    }
+
+    ~GuestFileReader() override {
+        // The file is left open if the player is destroyed outside of an export, like when the emulator exits
+        const ThreadStatePtr thread = get_io_thread();
+        if (opened && thread)
+            thread->run_callback(player_info.file_manager.close_file.address(), { player_info.file_manager.user_data });
+        free(emuenv.mem, buffer);
+        free(emuenv.mem, path);
+    }
+
+    bool open() override {
+        const ThreadStatePtr thread = get_io_thread();
+        if (!thread) {
+            LOG_ERROR("Media opened outside of an AvPlayer call");
+            return false;
+        }
+
+        const SceAvPlayerFileManager &file_manager = player_info.file_manager;
+        const int32_t res = static_cast<int32_t>(thread->run_callback(file_manager.open_file.address(), { file_manager.user_data, path }));
+        if (res < 0) {
+            LOG_ERROR("Failed to open {}: {}", Ptr<const char>(path).get(emuenv.mem), log_hex(res));
+            return false;
+        }
+        opened = true;
+
+        // TODO: support file_size > 4GB (callback function returns uint64_t, but I dont know how to get high dword of uint64_t)
+        const uint32_t size = thread->run_callback(file_manager.file_size.address(), { file_manager.user_data });
+        if (size == 0) {
+            LOG_ERROR("File is empty or could not be opened: {}", Ptr<const char>(path).get(emuenv.mem));
+            return false;
+        }
+        file_size = size;
+        return true;
+    }
+
+    ThreadStatePtr get_io_thread() {
+        if (io_thread_id == 0)
+            return nullptr;
+        return emuenv.kernel.get_thread(io_thread_id);
+    }
+
+    uint64_t size() override {
+        return file_size;
+    }
+
+    int32_t read(uint8_t *data, uint64_t offset, uint32_t size) override {
+        const ThreadStatePtr thread = get_io_thread();
+        if (!thread) {
+            LOG_ERROR("Media read outside of an AvPlayer call");
+            return -1;
+        }
+
+        const SceAvPlayerFileManager &file_manager = player_info.file_manager;
+        uint32_t total = 0;
+        while (total < size) {
+            const uint32_t chunk = std::min(size - total, READ_BUFFER_SIZE);
+            // the offset is a 64-bit argument, passed in an aligned register pair
+            const uint64_t chunk_offset = offset + total;
+            const int32_t read = static_cast<int32_t>(thread->run_callback(file_manager.read_file.address(),
+                { file_manager.user_data, buffer, static_cast<uint32_t>(chunk_offset), static_cast<uint32_t>(chunk_offset >> 32), chunk }));
+            if (read <= 0)
+                return total > 0 ? static_cast<int32_t>(total) : read;
+
+            memcpy(data + total, Ptr<uint8_t>(buffer).get(emuenv.mem), read);
+            total += read;
+            if (static_cast<uint32_t>(read) < chunk)
+                break;
+        }
+
+        return static_cast<int32_t>(total);
+    }
 };
 
 enum class DebugLevel {
@@ -242,40 +357,17 @@ EXPORT(int32_t, sceAvPlayerAddSource, SceUID player_handle, Ptr<const char> path
 
     const auto thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
 
-    auto file_path = expand_path(emuenv.io, path.get(emuenv.mem), emuenv.pref_path);
-    if (!fs::exists(file_path) && player_info->file_manager.open_file && player_info->file_manager.close_file && player_info->file_manager.read_file && player_info->file_manager.file_size) {
-        fs::create_directories(emuenv.cache_path);
-
-        // Create temp media file
-        const auto temp_file_path = emuenv.cache_path / "temp_vita_media.mp4";
-        fs::ofstream temp_file(temp_file_path, std::ios::out | std::ios::binary);
+    const IoThreadGuard guard(thread_id);
 
-        const Address buf = alloc(emuenv.mem, KiB(512), "AvPlayer buffer");
-        const auto buf_ptr = Ptr<char>(buf).get(emuenv.mem);
-        thread->run_callback(player_info->file_manager.open_file.address(), { player_info->file_manager.user_data, path.address() });
-        // TODO: support file_size > 4GB (callback function returns uint64_t, but I dont know how to get high dword of uint64_t)
-        const uint32_t file_size = thread->run_callback(player_info->file_manager.file_size.address(), { player_info->file_manager.user_data });
-        auto remaining = file_size;
-        uint32_t offset = 0;
-        while (remaining) {
-            const auto buf_size = std::min((uint32_t)KiB(512), remaining);
-            // zero in 5 parameter means high dword of uint64_t parameter. see previous todo
-            thread->run_callback(player_info->file_manager.read_file.address(), { player_info->file_manager.user_data, buf, offset, 0, buf_size });
-            temp_file.write(buf_ptr, buf_size);
-            offset += buf_size;
-            remaining -= buf_size;
-        }
-        free(emuenv.mem, buf);
-        temp_file.close();
-        thread->run_callback(player_info->file_manager.close_file.address(), { player_info->file_manager.user_data });
-        if (fs::file_size(temp_file_path) != file_size) {
-            LOG_ERROR("File is corrupted or incomplete: {}", temp_file_path);
-            return -1;
-        }
-        file_path = temp_file_path;
+    const auto file_path = expand_path(emuenv.io, path.get(emuenv.mem), emuenv.pref_path);
+    if (!fs::exists(file_path) && player_info->file_manager.open_file && player_info->file_manager.close_file && player_info->file_manager.read_file && player_info->file_manager.file_size) {
+        // Stream the media from the title instead of copying it to the host first, the file is opened when it starts playing
+        const auto reader = std::make_shared<GuestFileReader>(emuenv, *player_info, path);
+        player_info->player.queue(PlayerSource{ path.get(emuenv.mem), reader });
+    } else {
+        player_info->player.queue(file_path.string());
     }
 
-    player_info->player.queue(file_path.string());
     run_event_callback(emuenv, thread, player_info, SCE_AVPLAYER_STATE_BUFFERING, 0, Ptr<void>(0)); // may be important for sound
     run_event_callback(emuenv, thread, player_info, SCE_AVPLAYER_STATE_READY, 0, Ptr<void>(0));
     return 0;
@@ -283,9 +375,23 @@ EXPORT(int32_t, sceAvPlayerAddSource, SceUID player_handle, Ptr<const char> path
 
 EXPORT(int, sceAvPlayerClose, SceUID player_handle) {
     const auto state = emuenv.kernel.obj_store.get<AvPlayerState>();
-    const PlayerPtr &player_info = lock_and_find(player_handle, state->players, state->mutex);
+    const PlayerPtr player_info = lock_and_find(player_handle, state->players, state->mutex);
+    if (!player_info) {
+        return RET_ERROR(SCE_AVPLAYER_ERROR_INVALID_ARGUMENT);
+    }
+
     const auto thread = emuenv.kernel.get_thread(thread_id);
     run_event_callback(emuenv, thread, player_info, SCE_AVPLAYER_STATE_STOP, 0, Ptr<void>(0));
+    {
+        // Close the files of the title while we are on a guest thread
+        const IoThreadGuard guard(thread_id);
+        player_info->player.free_video();
+        std::queue<PlayerSource> queued;
+        {
+            std::lock_guard<std::mutex> player_lock(player_info->player.mutex);
+            queued.swap(player_info->player.videos_queue);
+        }
+    }
     std::lock_guard<std::mutex> lock(state->mutex);
     state->players.erase(player_handle);
     return 0;
@@ -295,7 +401,7 @@ EXPORT(uint64_t, sceAvPlayerCurrentTime, SceUID player_handle) {
     const auto state = emuenv.kernel.obj_store.get<AvPlayerState>();
     const PlayerPtr &player_info = lock_and_find(player_handle, state->players, state->mutex);
 
-    return player_info->player.last_timestamp;
+    return player_info->player.get_stream_info().timestamp;
 }
 
 EXPORT(int, sceAvPlayerDisableStream) {
@@ -323,6 +429,9 @@ EXPORT(bool, sceAvPlayerGetAudioData, SceUID player_handle, SceAvPlayerFrameInfo
     if (!player_info) {
         return false;
     }
+    const IoThreadGuard guard(thread_id);
+    // The decode thread may be waiting on the title file functions even when no frame is given
+    player_info->player.serve_read();
     Ptr<uint8_t> buffer;
 
     if (player_info->paused) {
@@ -330,23 +439,24 @@ EXPORT(bool, sceAvPlayerGetAudioData, SceUID player_handle, SceAvPlayerFrameInfo
             return false;
         } else {
             // This is probably incorrect and will make weird noises :P
+            const PlayerStreamInfo info = player_info->player.get_stream_info();
             buffer = get_buffer(player_info, MediaType::AUDIO, emuenv.mem,
-                player_info->player.last_sample_count * sizeof(int16_t) * player_info->player.last_channels, true);
+                info.sample_count * sizeof(int16_t) * info.channels, true);
         }
     } else {
-        std::vector<int16_t> data = player_info->player.receive_audio();
-
-        if (data.empty())
+        PlayerFrame &frame = player_info->audio_frame;
+        if (!player_info->player.receive_audio(frame))
             return false;
 
-        buffer = get_buffer(player_info, MediaType::AUDIO, emuenv.mem, (uint32_t)data.size() * sizeof(int16_t), false);
-        std::memcpy(buffer.get(emuenv.mem), data.data(), data.size() * sizeof(int16_t));
+        buffer = get_buffer(player_info, MediaType::AUDIO, emuenv.mem, static_cast<uint32_t>(frame.data.size()), false);
+        std::memcpy(buffer.get(emuenv.mem), frame.data.data(), frame.data.size());
     }
 
-    frame_info->timestamp = player_info->player.last_timestamp;
-    frame_info->stream_details.audio.channels = player_info->player.last_channels;
-    frame_info->stream_details.audio.sample_rate = player_info->player.last_sample_rate;
-    frame_info->stream_details.audio.size = player_info->player.last_channels * player_info->player.last_sample_count * sizeof(int16_t);
+    const PlayerStreamInfo info = player_info->player.get_stream_info();
+    frame_info->timestamp = info.timestamp;
+    frame_info->stream_details.audio.channels = info.channels;
+    frame_info->stream_details.audio.sample_rate = info.sample_rate;
+    frame_info->stream_details.audio.size = info.channels * info.sample_count * sizeof(int16_t);
     frame_info->data = buffer;
 
     strcpy(frame_info->stream_details.audio.language, "ENG");
@@ -363,6 +473,10 @@ EXPORT(uint32_t, sceAvPlayerGetStreamInfo, SceUID player_handle, SceUInt32 strea
     STUBBED("ALWAYS SUSPECTS 2 STREAMS: VIDEO AND AUDIO");
     const auto state = emuenv.kernel.obj_store.get<AvPlayerState>();
     const PlayerPtr &player_info = lock_and_find(player_handle, state->players, state->mutex);
+    if (!player_info) {
+        return SCE_AVPLAYER_ERROR_INVALID_ARGUMENT;
+    }
+    const IoThreadGuard guard(thread_id);
     if (stream_no == 0) { // suspect always two streams: audio and video //first is video
         DecoderSize size = player_info->player.get_size();
         stream_info->stream_type = MediaType::VIDEO;
@@ -371,11 +485,11 @@ EXPORT(uint32_t, sceAvPlayerGetStreamInfo, SceUID player_handle, SceUInt32 strea
         stream_info->stream_details.video.aspect_ratio = static_cast<float>(size.width) / static_cast<float>(size.height);
         strcpy(stream_info->stream_details.video.language, "ENG");
     } else if (stream_no == 1) { // audio
-        player_info->player.receive_audio(); // TODO: Get audio info without skipping data frames
+        const PlayerStreamInfo info = player_info->player.get_stream_info();
         stream_info->stream_type = MediaType::AUDIO;
-        stream_info->stream_details.audio.channels = player_info->player.last_channels;
-        stream_info->stream_details.audio.sample_rate = player_info->player.last_sample_rate;
-        stream_info->stream_details.audio.size = player_info->player.last_channels * player_info->player.last_sample_count * sizeof(int16_t);
+        stream_info->stream_details.audio.channels = info.channels;
+        stream_info->stream_details.audio.sample_rate = info.sample_rate;
+        stream_info->stream_details.audio.size = info.channels * info.sample_count * sizeof(int16_t);
         strcpy(stream_info->stream_details.audio.language, "ENG");
     } else {
         return SCE_AVPLAYER_ERROR_INVALID_ARGUMENT;
@@ -390,6 +504,9 @@ EXPORT(bool, sceAvPlayerGetVideoData, SceUID player_handle, SceAvPlayerFrameInfo
         return false;
     }
 
+    const IoThreadGuard guard(thread_id);
+    // The decode thread may be waiting on the title file functions even when no frame is due
+    player_info->player.serve_read();
     Ptr<uint8_t> buffer;
 
     DecoderSize size = player_info->player.get_size();
@@ -408,11 +525,13 @@ EXPORT(bool, sceAvPlayerGetVideoData, SceUID player_handle, SceAvPlayerFrameInfo
                 return false;
             else
                 buffer = get_buffer(player_info, MediaType::VIDEO, emuenv.mem, H264DecoderState::buffer_size(size), false);
-        } else {
+        } else if (player_info->player.receive_video(player_info->video_frame)) {
+            const std::vector<uint8_t> &data = player_info->video_frame.data;
             buffer = get_buffer(player_info, MediaType::VIDEO, emuenv.mem, H264DecoderState::buffer_size(size), true);
-
-            std::vector<uint8_t> data = player_info->player.receive_video();
-            std::memcpy(buffer.get(emuenv.mem), data.data(), data.size());
+            std::memcpy(buffer.get(emuenv.mem), data.data(), std::min<size_t>(data.size(), H264DecoderState::buffer_size(size)));
+        } else {
+            // The decoder is behind, show the last frame again
+            buffer = get_buffer(player_info, MediaType::VIDEO, emuenv.mem, H264DecoderState::buffer_size(size), false);
         }
     } else {
         buffer = get_buffer(player_info, MediaType::VIDEO, emuenv.mem, H264DecoderState::buffer_size(size), false);
@@ -421,7 +540,7 @@ EXPORT(bool, sceAvPlayerGetVideoData, SceUID player_handle, SceAvPlayerFrameInfo
     // uint32_t buf = SCE_AVPLAYER_ERROR_MAYBE_EOF;
     // run_event_callback(emuenv, thread_id, player_info, SCE_AVPLAYER_STATE_ERROR, 0, &buf);
 
-    frame_info->timestamp = player_info->player.last_timestamp;
+    frame_info->timestamp = player_info->player.get_stream_info().timestamp;
     frame_info->stream_details.video.width = size.width;
     frame_info->stream_details.video.height = size.height;
     frame_info->stream_details.video.aspect_ratio = static_cast<float>(size.width) / static_cast<float>(size.height);
@@ -459,7 +578,9 @@ EXPORT(bool, sceAvPlayerIsActive, SceUID player_handle) {
     const auto state = emuenv.kernel.obj_store.get<AvPlayerState>();
     const PlayerPtr &player_info = lock_and_find(player_handle, state->players, state->mutex);
 
-    return !player_info->player.video_playing.empty();
+    const IoThreadGuard guard(thread_id);
+    player_info->player.serve_read();
+    return player_info->player.is_playing();
 }
 
 EXPORT(int, sceAvPlayerJumpToTime) {
@@ -505,7 +626,8 @@ EXPORT(int, sceAvPlayerSetTrickSpeed) {
 EXPORT(int, sceAvPlayerStart, SceUID player_handle) {
     const auto state = emuenv.kernel.obj_store.get<AvPlayerState>();
     const PlayerPtr &player_info = lock_and_find(player_handle, state->players, state->mutex);
-    if (!player_info->player.videos_queue.empty()) {
+    if (player_info->player.has_queued_videos()) {
+        const IoThreadGuard guard(thread_id);
         player_info->player.pop_video();
     }
     const auto thread = emuenv.kernel.get_thread(thread_id);
@@ -516,7 +638,10 @@ EXPORT(int, sceAvPlayerStart, SceUID player_handle) {
 EXPORT(int, sceAvPlayerStop, SceUID player_handle) {
     const auto state = emuenv.kernel.obj_store.get<AvPlayerState>();
     const PlayerPtr &player_info = lock_and_find(player_handle, state->players, emuenv.kernel.mutex);
-    player_info->player.free_video();
+    {
+        const IoThreadGuard guard(thread_id);
+        player_info->player.free_video();
+    }
     const auto thread = emuenv.kernel.get_thread(thread_id);
     run_event_callback(emuenv, thread, player_info, SCE_AVPLAYER_STATE_STOP, 0, Ptr<void>(0));
     return 0;
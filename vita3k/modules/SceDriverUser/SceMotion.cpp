@@ -34,8 +34,7 @@ EXPORT(int, sceMotionGetBasicOrientation, SceFVector3 *basicOrientation) {
     if (!basicOrientation)
         return RET_ERROR(SCE_MOTION_ERROR_NULL_PARAMETER);
 
-    std::lock_guard<std::mutex> guard(emuenv.motion.mutex);
-    Util::Quaternion quat = get_orientation(emuenv.motion);
+    const Util::Quaternion quat = emuenv.motion.snapshot.load().orientation;
 
     *basicOrientation = { 0.f, 0.f, 0.f };
     // get the basic orientation, only one component is not zero and will be 1 or -1
@@ -83,12 +82,12 @@ EXPORT(int, sceMotionGetSensorState, SceMotionSensorState *sensorState, int numR
         return RET_ERROR(SCE_MOTION_ERROR_NULL_PARAMETER);
 
     if (emuenv.ctrl.has_motion_support || emuenv.motion.has_device_motion_support) {
-        std::lock_guard<std::mutex> guard(emuenv.motion.mutex);
-        sensorState->accelerometer = get_acceleration(emuenv.motion);
-        sensorState->gyro = get_gyroscope(emuenv.motion);
+        const MotionSnapshot snapshot = emuenv.motion.snapshot.load();
+        sensorState->accelerometer = snapshot.acceleration;
+        sensorState->gyro = snapshot.gyro;
 
-        sensorState->timestamp = emuenv.motion.last_accel_timestamp;
-        sensorState->counter = emuenv.motion.last_counter;
+        sensorState->timestamp = snapshot.timestamp;
+        sensorState->counter = snapshot.counter;
         sensorState->hostTimestamp = sensorState->timestamp;
         sensorState->dataInfo = 0;
     } else {
@@ -116,13 +115,13 @@ EXPORT(int, sceMotionGetState, SceMotionState *motionState) {
         return RET_ERROR(SCE_MOTION_ERROR_NULL_PARAMETER);
 
     if (emuenv.ctrl.has_motion_support || emuenv.motion.has_device_motion_support) {
-        std::lock_guard<std::mutex> guard(emuenv.motion.mutex);
-        motionState->timestamp = emuenv.motion.last_accel_timestamp;
+        const MotionSnapshot snapshot = emuenv.motion.snapshot.load();
+        motionState->timestamp = snapshot.timestamp;
 
-        motionState->acceleration = get_acceleration(emuenv.motion);
-        motionState->angularVelocity = get_gyroscope(emuenv.motion);
+        motionState->acceleration = snapshot.acceleration;
+        motionState->angularVelocity = snapshot.gyro;
 
-        Util::Quaternion dev_quat = get_orientation(emuenv.motion);
+        const Util::Quaternion dev_quat = snapshot.orientation;
 
         static_assert(sizeof(motionState->deviceQuat) == sizeof(dev_quat));
         memcpy(&motionState->deviceQuat, &dev_quat, sizeof(motionState->deviceQuat));
@@ -16,85 +16,1019 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 #include <module/module.h>
+#include <modules/module_parent.h>
+
+#include <io/device.h>
+#include <io/functions.h>
+#include <io/psarc.h>
+#include <io/state.h>
+#include <kernel/state.h>
+#include <mem/util.h>
+#include <util/fs.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <list>
+#include <map>
+#include <set>
+#include <thread>
+
+enum SceFiosErrorCode : uint32_t {
+    SCE_FIOS_OK = 0,
+    SCE_FIOS_ERROR_UNIMPLEMENTED = 0x80820001,
+    SCE_FIOS_ERROR_BAD_PATH = 0x80820006,
+    SCE_FIOS_ERROR_BAD_PTR = 0x80820007,
+    SCE_FIOS_ERROR_BAD_OFFSET = 0x80820008,
+    SCE_FIOS_ERROR_BAD_SIZE = 0x80820009,
+    SCE_FIOS_ERROR_BAD_IOVCNT = 0x8082000A,
+    SCE_FIOS_ERROR_BAD_OP = 0x8082000B,
+    SCE_FIOS_ERROR_BAD_FH = 0x8082000C,
+    SCE_FIOS_ERROR_NOT_A_FILE = 0x8082000F,
+    SCE_FIOS_ERROR_TIMEOUT = 0x80820012,
+    SCE_FIOS_ERROR_CANCELLED = 0x80820013,
+    SCE_FIOS_ERROR_DECOMPRESSION = 0x80820015,
+};
+
+typedef int32_t SceFiosFH;
+typedef int32_t SceFiosOp;
+typedef int64_t SceFiosSize;
+typedef int64_t SceFiosOffset;
+typedef int64_t SceFiosTime;
+typedef int64_t SceFiosTimeInterval;
+typedef uint64_t SceFiosDate;
+
+constexpr SceFiosFH SCE_FIOS_FH_INVALID = 0;
+constexpr SceFiosOp SCE_FIOS_OP_INVALID = 0;
+constexpr SceFiosTime SCE_FIOS_TIME_NULL = 0;
+
+enum SceFiosWhence {
+    SCE_FIOS_SEEK_SET = 0,
+    SCE_FIOS_SEEK_CUR = 1,
+    SCE_FIOS_SEEK_END = 2
+};
+
+enum SceFiosOpenFlags {
+    SCE_FIOS_O_READ = 1 << 0,
+    SCE_FIOS_O_WRITE = 1 << 1,
+    SCE_FIOS_O_APPEND = 1 << 2,
+    SCE_FIOS_O_CREAT = 1 << 3,
+    SCE_FIOS_O_TRUNC = 1 << 4
+};
+
+enum SceFiosStatusFlags {
+    SCE_FIOS_STATUS_DIRECTORY = 1 << 0,
+    SCE_FIOS_STATUS_READABLE = 1 << 1,
+    SCE_FIOS_STATUS_WRITABLE = 1 << 2
+};
+
+enum SceFiosOpEvent {
+    SCE_FIOS_OPEVENT_COMPLETE = 1,
+    SCE_FIOS_OPEVENT_DELETE = 2
+};
+
+struct SceFiosBuffer {
+    Ptr<void> pPtr;
+    SceSize length;
+};
+
+struct SceFiosOpAttr {
+    SceFiosTime deadline;
+    Ptr<void> pCallback;
+    Ptr<void> pCallbackContext;
+    int32_t priority : 8;
+    uint32_t opflags : 24;
+    uint32_t userTag;
+    Ptr<void> userPtr;
+    Ptr<void> pReserved;
+};
+
+struct SceFiosOpenParams {
+    uint32_t openFlags : 16;
+    uint32_t opFlags : 16;
+    uint32_t reserved;
+    SceFiosBuffer buffer;
+};
+
+struct SceFiosStat {
+    SceFiosOffset fileSize;
+    SceFiosDate accessDate;
+    SceFiosDate modificationDate;
+    SceFiosDate creationDate;
+    uint32_t statFlags;
+    uint32_t reserved;
+    int64_t uid;
+    int64_t gid;
+    int64_t dev;
+    int64_t ino;
+    int64_t mode;
+};
+
+struct SceFiosIOVec {
+    Ptr<void> iov_base;
+    SceSize iov_len;
+};
+
+struct SceFiosParams {
+    uint32_t initialized : 1;
+    uint32_t paramsSize : 15;
+    uint32_t pathMax : 16;
+    uint32_t profiling;
+    uint32_t ioThreadCount;
+    uint32_t threadsPerScheduler;
+    uint32_t extraFlag1 : 1;
+    uint32_t extraFlags : 31;
+    uint32_t maxChunk;
+    uint8_t maxDecompressorThreadCount;
+    uint8_t reserved1;
+    uint8_t reserved2;
+    uint8_t reserved3;
+    Ptr<void> reserved4;
+    Ptr<void> reserved5;
+    SceFiosBuffer opStorage;
+    SceFiosBuffer fhStorage;
+    SceFiosBuffer dhStorage;
+    SceFiosBuffer chunkStorage;
+    Ptr<void> pVprintf;
+    Ptr<void> pMemcpy;
+    Ptr<void> pProfileCallback;
+    int32_t threadPriority[2];
+    int32_t threadAffinity[2];
+    int32_t threadStackSize[2];
+};
+
+static_assert(sizeof(SceFiosOpAttr) == 32, "SceFiosOpAttr struct size is not 32");
+static_assert(sizeof(SceFiosParams) == 104, "SceFiosParams struct size is not 104");
+static_assert(sizeof(SceFiosStat) == 80, "SceFiosStat struct size is not 80");
+
+constexpr uint32_t FIOS_DEFAULT_IO_THREAD_COUNT = 2;
+constexpr uint32_t FIOS_MAX_IO_THREAD_COUNT = 8;
+constexpr uint64_t FIOS_CACHE_CHUNK_SIZE = KiB(64);
+constexpr uint64_t FIOS_CACHE_CAPACITY = MiB(64);
+
+enum FiosExistsKind : uint32_t {
+    FIOS_EXISTS_FILE = 1 << 0,
+    FIOS_EXISTS_DIRECTORY = 1 << 1,
+    FIOS_EXISTS_ANY = FIOS_EXISTS_FILE | FIOS_EXISTS_DIRECTORY
+};
+
+static SceFiosSize fios_error(SceFiosErrorCode error) {
+    return static_cast<int32_t>(error);
+}
+
+struct FiosOp {
+    SceFiosOp id = SCE_FIOS_OP_INVALID;
+    int32_t priority = 0;
+    SceFiosTime deadline = SCE_FIOS_TIME_NULL;
+    uint64_t sequence = 0;
+    SceFiosOffset offset = 0;
+    SceFiosSize requested = 0;
+    std::function<SceFiosSize()> work;
+
+    // Guest thread which submitted the op, its completion callback runs there
+    SceUID thread_id = 0;
+    Address callback = 0;
+    Address callback_context = 0;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::atomic<bool> cancelled = false;
+    bool done = false;
+    int32_t error = SCE_FIOS_OK;
+    SceFiosSize actual = 0;
+};
+
+typedef std::shared_ptr<FiosOp> FiosOpPtr;
+
+// Highest priority first, then earliest deadline, then submission order. Ops without a deadline come last in their priority.
+struct FiosOpOrder {
+    bool operator()(const FiosOpPtr &a, const FiosOpPtr &b) const {
+        if (a->priority != b->priority)
+            return a->priority > b->priority;
+
+        const SceFiosTime deadline_a = a->deadline == SCE_FIOS_TIME_NULL ? std::numeric_limits<SceFiosTime>::max() : a->deadline;
+        const SceFiosTime deadline_b = b->deadline == SCE_FIOS_TIME_NULL ? std::numeric_limits<SceFiosTime>::max() : b->deadline;
+        if (deadline_a != deadline_b)
+            return deadline_a < deadline_b;
+
+        return a->sequence < b->sequence;
+    }
+};
+
+struct FiosArchive;
+typedef std::shared_ptr<FiosArchive> FiosArchivePtr;
+
+struct FiosFile {
+    // Resolved path, also used as the cache key
+    std::string path;
+    SceFiosSize size = 0;
+
+    std::mutex mutex;
+    SceFiosOffset position = 0;
+    // Held for the whole of a read at the file position, so sequential reads of a handle follow each other
+    std::mutex position_read_mutex;
+
+    // Either a host file or an entry of a mounted archive
+    fs::ifstream stream;
+    FiosArchivePtr archive;
+    int32_t entry = -1;
+};
+
+typedef std::shared_ptr<FiosFile> FiosFilePtr;
+
+struct FiosArchive {
+    std::string mount_point;
+    SceFiosFH fh = SCE_FIOS_FH_INVALID;
+    FiosFilePtr file;
+    psarc::Archive psarc;
+};
+
+// Prefetched data, kept as fixed size chunks of each file and evicted least recently used first
+struct FiosCache {
+    typedef std::pair<std::string, uint64_t> Key;
+
+    std::mutex mutex;
+    std::list<Key> lru;
+    std::map<Key, std::pair<std::vector<uint8_t>, std::list<Key>::iterator>> chunks;
+    uint64_t used = 0;
+
+    bool contains(const std::string &path, uint64_t chunk) {
+        const std::lock_guard<std::mutex> guard(mutex);
+        return chunks.contains({ path, chunk });
+    }
+
+    bool read(const std::string &path, uint64_t offset, uint8_t *dst, uint64_t size) {
+        const std::lock_guard<std::mutex> guard(mutex);
+        const auto it = chunks.find({ path, offset / FIOS_CACHE_CHUNK_SIZE });
+        const uint64_t chunk_offset = offset % FIOS_CACHE_CHUNK_SIZE;
+        if ((it == chunks.end()) || (it->second.first.size() < chunk_offset + size))
+            return false;
+
+        memcpy(dst, &it->second.first[chunk_offset], size);
+        lru.splice(lru.begin(), lru, it->second.second);
+        return true;
+    }
+
+    void insert(const std::string &path, uint64_t chunk, std::vector<uint8_t> &&data) {
+        const std::lock_guard<std::mutex> guard(mutex);
+        const Key key = { path, chunk };
+        if (chunks.contains(key))
+            return;
+
+        while (!lru.empty() && (used + data.size() > FIOS_CACHE_CAPACITY)) {
+            const auto evicted = chunks.find(lru.back());
+            used -= evicted->second.first.size();
+            chunks.erase(evicted);
+            lru.pop_back();
+        }
+
+        used += data.size();
+        lru.push_front(key);
+        chunks.emplace(key, std::make_pair(std::move(data), lru.begin()));
+    }
+
+    // Drops the chunks of every path starting with prefix, in the given byte range
+    void flush(const std::string &prefix, uint64_t offset = 0, uint64_t size = std::numeric_limits<uint64_t>::max()) {
+        const std::lock_guard<std::mutex> guard(mutex);
+        const uint64_t first = offset / FIOS_CACHE_CHUNK_SIZE;
+        const uint64_t last = size > std::numeric_limits<uint64_t>::max() - offset ? std::numeric_limits<uint64_t>::max() : (offset + size) / FIOS_CACHE_CHUNK_SIZE;
+        for (auto it = chunks.lower_bound({ prefix, 0 }); (it != chunks.end()) && it->first.first.starts_with(prefix);) {
+            if ((it->first.second >= first) && (it->first.second <= last)) {
+                used -= it->second.first.size();
+                lru.erase(it->second.second);
+                it = chunks.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void clear() {
+        const std::lock_guard<std::mutex> guard(mutex);
+        chunks.clear();
+        lru.clear();
+        used = 0;
+    }
+};
+
+struct FiosCallback {
+    Address callback;
+    Address context;
+    SceFiosOp op;
+    SceFiosOpEvent event;
+    int32_t error;
+};
+
+struct FiosState {
+    std::mutex mutex;
+    bool initialized = false;
+    SceFiosFH next_fh = 1;
+    SceFiosOp next_op = 1;
+    std::map<SceFiosFH, FiosFilePtr> files;
+    std::map<SceFiosOp, FiosOpPtr> ops;
+    std::vector<FiosArchivePtr> archives;
+    uint32_t max_decompressor_thread_count = 1;
+    std::atomic<uint32_t> decompressor_thread_count = 1;
+    FiosCache cache;
+
+    // Op events waiting for their guest thread, in the order they happened
+    std::mutex callback_mutex;
+    std::map<SceUID, std::vector<FiosCallback>> callbacks;
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_cond;
+    std::set<FiosOpPtr, FiosOpOrder> queue;
+    uint64_t next_sequence = 0;
+    uint32_t running = 0;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    ~FiosState() {
+        stop();
+    }
+
+    void start(uint32_t thread_count);
+    void stop();
+};
+
+LIBRARY_INIT(SceFios2) {
+    emuenv.kernel.obj_store.create<FiosState>();
+}
+
+static void queue_callback(FiosState &state, const FiosOp &op, SceFiosOpEvent event, int32_t error) {
+    if (!op.callback)
+        return;
+
+    const std::lock_guard<std::mutex> guard(state.callback_mutex);
+    state.callbacks[op.thread_id].push_back({ op.callback, op.callback_context, op.id, event, error });
+}
+
+// Guest code can only run on its own thread, so the events of an op are delivered once the thread which submitted it calls back into FIOS
+static void run_callbacks(EmuEnvState &emuenv, FiosState &state, SceUID thread_id) {
+    std::vector<FiosCallback> callbacks;
+    {
+        const std::lock_guard<std::mutex> guard(state.callback_mutex);
+        const auto it = state.callbacks.find(thread_id);
+        if (it == state.callbacks.end())
+            return;
+
+        callbacks = std::move(it->second);
+        state.callbacks.erase(it);
+    }
+
+    const ThreadStatePtr thread = emuenv.kernel.get_thread(thread_id);
+    if (!thread)
+        return;
+
+    for (const auto &callback : callbacks)
+        thread->run_callback(callback.callback, { callback.context, static_cast<uint32_t>(callback.op), static_cast<uint32_t>(callback.event), static_cast<uint32_t>(callback.error) });
+}
+
+static void complete_op(FiosState &state, FiosOp &op, SceFiosSize result) {
+    int32_t error;
+    {
+        const std::lock_guard<std::mutex> guard(op.mutex);
+        op.error = static_cast<int32_t>(std::min<SceFiosSize>(result, SCE_FIOS_OK));
+        op.actual = std::max<SceFiosSize>(result, 0);
+        op.done = true;
+        op.work = nullptr;
+        op.cond.notify_all();
+        error = op.error;
+    }
+
+    queue_callback(state, op, SCE_FIOS_OPEVENT_COMPLETE, error);
+}
+
+static void run_worker(FiosState &state) {
+    while (true) {
+        FiosOpPtr op;
+        {
+            std::unique_lock<std::mutex> lock(state.queue_mutex);
+            state.queue_cond.wait(lock, [&]() { return state.stopping || !state.queue.empty(); });
+            if (state.stopping)
+                return;
+
+            op = *state.queue.begin();
+            state.queue.erase(state.queue.begin());
+            state.running++;
+        }
+
+        complete_op(state, *op, op->cancelled ? fios_error(SCE_FIOS_ERROR_CANCELLED) : op->work());
+
+        const std::lock_guard<std::mutex> guard(state.queue_mutex);
+        state.running--;
+    }
+}
+
+void FiosState::start(uint32_t thread_count) {
+    stopping = false;
+    for (uint32_t i = 0; i < thread_count; i++)
+        workers.emplace_back(run_worker, std::ref(*this));
+}
+
+void FiosState::stop() {
+    {
+        const std::lock_guard<std::mutex> guard(queue_mutex);
+        stopping = true;
+    }
+    queue_cond.notify_all();
+    for (auto &worker : workers)
+        worker.join();
+    workers.clear();
+
+    // Wake up anyone still waiting on an op which will never run
+    for (const auto &op : queue)
+        complete_op(*this, *op, fios_error(SCE_FIOS_ERROR_CANCELLED));
+    queue.clear();
+}
+
+static FiosOpPtr submit_op(FiosState &state, SceUID thread_id, const SceFiosOpAttr *attr, std::function<SceFiosSize()> work, SceFiosOffset offset = 0, SceFiosSize requested = 0) {
+    auto op = std::make_shared<FiosOp>();
+    op->thread_id = thread_id;
+    if (attr) {
+        op->priority = attr->priority;
+        op->deadline = attr->deadline;
+        op->callback = attr->pCallback.address();
+        op->callback_context = attr->pCallbackContext.address();
+    }
+    op->offset = offset;
+    op->requested = requested;
+    op->work = std::move(work);
+
+    bool scheduled = false;
+    {
+        const std::lock_guard<std::mutex> guard(state.mutex);
+        op->id = state.next_op++;
+        state.ops.emplace(op->id, op);
+
+        if (state.initialized) {
+            const std::lock_guard<std::mutex> queue_guard(state.queue_mutex);
+            op->sequence = state.next_sequence++;
+            state.queue.insert(op);
+            scheduled = true;
+        }
+    }
+
+    if (scheduled)
+        state.queue_cond.notify_one();
+    else
+        complete_op(state, *op, op->work());
+
+    return op;
+}
+
+static FiosOpPtr find_op(FiosState &state, SceFiosOp id) {
+    const std::lock_guard<std::mutex> guard(state.mutex);
+    const auto it = state.ops.find(id);
+    return it == state.ops.end() ? nullptr : it->second;
+}
+
+static void wait_op(FiosOp &op) {
+    std::unique_lock<std::mutex> lock(op.mutex);
+    op.cond.wait(lock, [&]() { return op.done; });
+}
+
+static void cancel_op(FiosState &state, const FiosOpPtr &op) {
+    op->cancelled = true;
+
+    bool dequeued = false;
+    {
+        const std::lock_guard<std::mutex> guard(state.queue_mutex);
+        dequeued = state.queue.erase(op) > 0;
+    }
+
+    if (dequeued)
+        complete_op(state, *op, fios_error(SCE_FIOS_ERROR_CANCELLED));
+}
+
+static void delete_op(FiosState &state, const FiosOp &op) {
+    {
+        const std::lock_guard<std::mutex> guard(state.mutex);
+        state.ops.erase(op.id);
+    }
+
+    queue_callback(state, op, SCE_FIOS_OPEVENT_DELETE, op.error);
+}
+
+static SceFiosSize run_sync(EmuEnvState &emuenv, FiosState &state, SceUID thread_id, const SceFiosOpAttr *attr, std::function<SceFiosSize()> work) {
+    const FiosOpPtr op = submit_op(state, thread_id, attr, std::move(work));
+    wait_op(*op);
+    delete_op(state, *op);
+    run_callbacks(emuenv, state, thread_id);
+
+    return op->error ? op->error : op->actual;
+}
+
+static SceFiosTime get_current_time() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static FiosFilePtr find_file(FiosState &state, SceFiosFH fh) {
+    const std::lock_guard<std::mutex> guard(state.mutex);
+    const auto it = state.files.find(fh);
+    return it == state.files.end() ? nullptr : it->second;
+}
+
+static SceFiosFH register_file(FiosState &state, const FiosFilePtr &file) {
+    const std::lock_guard<std::mutex> guard(state.mutex);
+    const SceFiosFH fh = state.next_fh++;
+    state.files.emplace(fh, file);
+    return fh;
+}
+
+// Turns a FIOS path such as /app0/data.bin into a kernel path such as app0:/data.bin, once overlays are applied
+static std::string to_device_path(IOState &io, const char *path) {
+    std::string resolved = resolve_path(io, path);
+    if (!resolved.starts_with('/'))
+        return resolved;
+
+    resolved.erase(0, 1);
+    const auto slash = resolved.find('/');
+    const auto colon = resolved.find(':');
+    if ((colon != std::string::npos) && ((slash == std::string::npos) || (colon < slash)))
+        return resolved;
+
+    if (slash == std::string::npos)
+        return resolved + ":/";
+
+    resolved.insert(slash, ":");
+    return resolved;
+}
+
+static FiosArchivePtr find_archive(FiosState &state, const std::string &path, std::string &entry_path) {
+    const std::lock_guard<std::mutex> guard(state.mutex);
+    for (const auto &archive : state.archives) {
+        if (path.starts_with(archive->mount_point) && ((path.size() == archive->mount_point.size()) || (path[archive->mount_point.size()] == '/'))) {
+            entry_path = path.substr(archive->mount_point.size());
+            return archive;
+        }
+    }
+
+    return nullptr;
+}
+
+static SceFiosSize open_fios_file(EmuEnvState &emuenv, FiosState &state, const char *path, FiosFilePtr &file) {
+    if (!path)
+        return fios_error(SCE_FIOS_ERROR_BAD_PATH);
+
+    file = std::make_shared<FiosFile>();
+
+    std::string entry_path;
+    if (const FiosArchivePtr archive = find_archive(state, path, entry_path)) {
+        const int32_t entry = archive->psarc.find(entry_path);
+        if (entry < 0)
+            return fios_error(SCE_FIOS_ERROR_BAD_PATH);
+
+        file->path = archive->mount_point + archive->psarc.entries[entry].path;
+        file->size = archive->psarc.entries[entry].size;
+        file->archive = archive;
+        file->entry = entry;
+        return SCE_FIOS_OK;
+    }
+
+    file->path = to_device_path(emuenv.io, path);
+    if (device::get_device(file->path) == VitaIoDevice::_INVALID)
+        return fios_error(SCE_FIOS_ERROR_BAD_PATH);
+
+    const fs::path host_path = expand_path(emuenv.io, file->path.c_str(), emuenv.pref_path);
+    if (!fs::exists(host_path))
+        return fios_error(SCE_FIOS_ERROR_BAD_PATH);
+    if (!fs::is_regular_file(host_path))
+        return fios_error(SCE_FIOS_ERROR_NOT_A_FILE);
+
+    file->stream.open(host_path, fs::ifstream::binary);
+    if (!file->stream.is_open())
+        return fios_error(SCE_FIOS_ERROR_BAD_PATH);
+
+    file->size = static_cast<SceFiosSize>(fs::file_size(host_path));
+    return SCE_FIOS_OK;
+}
+
+static SceFiosSize read_backing(FiosState &state, FiosFile &file, uint64_t offset, uint8_t *dst, uint64_t size) {
+    if (file.archive) {
+        const int64_t read = file.archive->psarc.read(file.entry, offset, dst, size, state.decompressor_thread_count);
+        return read < 0 ? fios_error(SCE_FIOS_ERROR_DECOMPRESSION) : read;
+    }
+
+    const std::lock_guard<std::mutex> guard(file.mutex);
+    file.stream.clear();
+    file.stream.seekg(offset);
+    file.stream.read(reinterpret_cast<char *>(dst), size);
+    return file.stream.gcount();
+}
+
+// Serves what it can from the prefetch cache and gathers the remaining ranges into as few backing reads as possible
+static SceFiosSize read_fios_file(FiosState &state, FiosFile &file, SceFiosOffset offset, uint8_t *dst, SceFiosSize size) {
+    if (offset < 0)
+        return fios_error(SCE_FIOS_ERROR_BAD_OFFSET);
+    if (size < 0)
+        return fios_error(SCE_FIOS_ERROR_BAD_SIZE);
+    if (offset >= file.size)
+        return 0;
+
+    const uint64_t total = std::min(size, file.size - offset);
+    uint64_t done = 0;
+    while (done < total) {
+        const uint64_t position = offset + done;
+        const uint64_t length = std::min(FIOS_CACHE_CHUNK_SIZE - position % FIOS_CACHE_CHUNK_SIZE, total - done);
+        if (state.cache.read(file.path, position, dst + done, length)) {
+            done += length;
+            continue;
+        }
+
+        uint64_t missing = length;
+        while ((done + missing < total) && !state.cache.contains(file.path, (position + missing) / FIOS_CACHE_CHUNK_SIZE))
+            missing += std::min(FIOS_CACHE_CHUNK_SIZE, total - done - missing);
+
+        const SceFiosSize read = read_backing(state, file, position, dst + done, missing);
+        if (read < 0)
+            return read;
+
+        done += read;
+        if (static_cast<uint64_t>(read) < missing)
+            break;
+    }
+
+    return done;
+}
+
+static SceFiosOffset get_position(FiosFile &file) {
+    const std::lock_guard<std::mutex> guard(file.mutex);
+    return file.position;
+}
+
+// Reads at the file position when the op runs, the position then moves by the amount of bytes actually read
+static SceFiosSize read_at_position(FiosFile &file, const std::function<SceFiosSize(SceFiosOffset)> &read) {
+    const std::lock_guard<std::mutex> read_guard(file.position_read_mutex);
+    const SceFiosOffset offset = get_position(file);
+
+    const SceFiosSize res = read(offset);
+    if (res > 0) {
+        const std::lock_guard<std::mutex> guard(file.mutex);
+        // A seek done while reading takes precedence
+        if (file.position == offset)
+            file.position = offset + res;
+    }
+
+    return res;
+}
+
+static SceFiosSize get_iovec_size(const SceFiosIOVec *iov, int iovcnt) {
+    SceFiosSize size = 0;
+    for (int i = 0; iov && (i < iovcnt); i++)
+        size += iov[i].iov_len;
+    return size;
+}
+
+static SceFiosSize readv_fios_file(EmuEnvState &emuenv, FiosState &state, FiosFile &file, const std::vector<SceFiosIOVec> &vecs, SceFiosOffset offset) {
+    SceFiosSize total = 0;
+    for (const auto &vec : vecs) {
+        const SceFiosSize read = read_fios_file(state, file, offset + total, vec.iov_base.cast<uint8_t>().get(emuenv.mem), vec.iov_len);
+        if (read < 0)
+            return read;
+
+        total += read;
+        if (read < vec.iov_len)
+            break;
+    }
+
+    return total;
+}
+
+static SceFiosSize prefetch_fios_file(FiosState &state, FiosFile &file, SceFiosOffset offset, SceFiosSize size) {
+    if ((offset < 0) || (size < 0))
+        return fios_error(SCE_FIOS_ERROR_BAD_OFFSET);
+    if (offset >= file.size)
+        return 0;
+
+    const uint64_t end = std::min(file.size, size ? offset + size : file.size);
+    SceFiosSize prefetched = 0;
+    for (uint64_t chunk = offset / FIOS_CACHE_CHUNK_SIZE; chunk * FIOS_CACHE_CHUNK_SIZE < end; chunk++) {
+        if (state.cache.contains(file.path, chunk))
+            continue;
+
+        const uint64_t chunk_offset = chunk * FIOS_CACHE_CHUNK_SIZE;
+        std::vector<uint8_t> data(std::min<uint64_t>(FIOS_CACHE_CHUNK_SIZE, file.size - chunk_offset));
+        const SceFiosSize read = read_backing(state, file, chunk_offset, data.data(), data.size());
+        if (read < 0)
+            return read;
+
+        data.resize(read);
+        prefetched += read;
+        state.cache.insert(file.path, chunk, std::move(data));
+    }
+
+    return prefetched;
+}
+
+static std::string get_cache_path(EmuEnvState &emuenv, FiosState &state, const char *path) {
+    std::string entry_path;
+    if (const FiosArchivePtr archive = find_archive(state, path, entry_path)) {
+        const int32_t entry = archive->psarc.find(entry_path);
+        return entry < 0 ? std::string{} : archive->mount_point + archive->psarc.entries[entry].path;
+    }
+
+    return to_device_path(emuenv.io, path);
+}
+
+static SceFiosDate get_host_date(const fs::path &path) {
+    boost::system::error_code error;
+    const time_t time = fs::last_write_time(path, error);
+    return error ? 0 : static_cast<SceFiosDate>(time) * 1'000'000'000;
+}
+
+// Archive manifests only list files, a directory exists as long as one of them lives below it
+static bool is_archive_directory(const FiosArchive &archive, std::string path) {
+    if (!path.starts_with('/'))
+        path.insert(path.begin(), '/');
+    while (path.ends_with('/'))
+        path.pop_back();
+    if (path.empty())
+        return true;
+
+    const auto lower = [](std::string str) {
+        std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return std::tolower(c); });
+        return str;
+    };
+    const std::string prefix = (archive.psarc.ignore_case ? lower(path) : path) + '/';
+    return std::any_of(archive.psarc.entries.begin() + 1, archive.psarc.entries.end(), [&](const psarc::Entry &entry) {
+        return (archive.psarc.ignore_case ? lower(entry.path) : entry.path).starts_with(prefix);
+    });
+}
+
+// Entries of a mounted archive are read only and share the dates of the archive file
+static SceFiosSize stat_fios_path(EmuEnvState &emuenv, FiosState &state, const std::string &path, SceFiosStat &stat) {
+    stat = {};
+
+    std::string entry_path;
+    if (const FiosArchivePtr archive = find_archive(state, path, entry_path)) {
+        const int32_t entry = entry_path.empty() ? -1 : archive->psarc.find(entry_path);
+        if (entry >= 0) {
+            stat.fileSize = archive->psarc.entries[entry].size;
+            stat.statFlags = SCE_FIOS_STATUS_READABLE;
+        } else if (is_archive_directory(*archive, entry_path)) {
+            stat.statFlags = SCE_FIOS_STATUS_DIRECTORY | SCE_FIOS_STATUS_READABLE;
+        } else {
+            return fios_error(SCE_FIOS_ERROR_BAD_PATH);
+        }
+
+        stat.modificationDate = get_host_date(expand_path(emuenv.io, archive->file->path.c_str(), emuenv.pref_path));
+        stat.accessDate = stat.creationDate = stat.modificationDate;
+        return SCE_FIOS_OK;
+    }
+
+    const std::string device_path = to_device_path(emuenv.io, path.c_str());
+    if (device::get_device(device_path) == VitaIoDevice::_INVALID)
+        return fios_error(SCE_FIOS_ERROR_BAD_PATH);
+
+    const fs::path host_path = expand_path(emuenv.io, device_path.c_str(), emuenv.pref_path);
+    boost::system::error_code error;
+    const fs::file_status status = fs::status(host_path, error);
+    if (error || !fs::exists(status))
+        return fios_error(SCE_FIOS_ERROR_BAD_PATH);
+
+    stat.statFlags = SCE_FIOS_STATUS_READABLE;
+    if (fs::is_directory(status))
+        stat.statFlags |= SCE_FIOS_STATUS_DIRECTORY;
+    else
+        stat.fileSize = static_cast<SceFiosOffset>(fs::file_size(host_path, error));
+    if (status.permissions() & fs::owner_write)
+        stat.statFlags |= SCE_FIOS_STATUS_WRITABLE;
+
+    stat.modificationDate = get_host_date(host_path);
+    stat.accessDate = stat.creationDate = stat.modificationDate;
+    return SCE_FIOS_OK;
+}
+
+// A missing path is not an error here, it only leaves *exists false. kind tells whether to accept files, directories or both.
+static SceFiosSize fios_path_exists(EmuEnvState &emuenv, FiosState &state, const std::string &path, FiosExistsKind kind, bool *exists) {
+    SceFiosStat stat;
+    const SceFiosSize res = stat_fios_path(emuenv, state, path, stat);
+    if ((res < 0) && (res != fios_error(SCE_FIOS_ERROR_BAD_PATH)))
+        return res;
+
+    *exists = (res == SCE_FIOS_OK) && (kind & ((stat.statFlags & SCE_FIOS_STATUS_DIRECTORY) ? FIOS_EXISTS_DIRECTORY : FIOS_EXISTS_FILE));
+    return SCE_FIOS_OK;
+}
+
+static SceFiosSize mount_archive(EmuEnvState &emuenv, FiosState &state, const std::string &archive_path, const std::string &mount_point, SceFiosFH *out_fh) {
+    FiosFilePtr file;
+    const SceFiosSize res = open_fios_file(emuenv, state, archive_path.c_str(), file);
+    if (res < 0)
+        return res;
+
+    auto archive = std::make_shared<FiosArchive>();
+    archive->mount_point = mount_point;
+    while (archive->mount_point.ends_with('/'))
+        archive->mount_point.pop_back();
+    archive->file = file;
+
+    const auto read_archive = [&state, file = file.get()](uint64_t offset, void *dst, uint64_t size) {
+        return read_backing(state, *file, offset, static_cast<uint8_t *>(dst), size) == static_cast<SceFiosSize>(size);
+    };
+    if (!archive->psarc.open(read_archive)) {
+        LOG_ERROR("Failed to mount archive {} at {}", archive_path, mount_point);
+        return fios_error(SCE_FIOS_ERROR_NOT_A_FILE);
+    }
+
+    // Manifest paths carry their own leading slash, keep one between them and the mount point
+    for (auto &entry : archive->psarc.entries) {
+        if (!entry.path.starts_with('/'))
+            entry.path.insert(entry.path.begin(), '/');
+    }
+
+    archive->fh = register_file(state, file);
+    {
+        const std::lock_guard<std::mutex> guard(state.mutex);
+        // Longest mount points first so nested mounts resolve to the innermost archive
+        const auto pos = std::find_if(state.archives.begin(), state.archives.end(), [&](const FiosArchivePtr &mounted) {
+            return mounted->mount_point.size() < archive->mount_point.size();
+        });
+        state.archives.insert(pos, archive);
+    }
+
+    LOG_INFO("Mounted archive {} at {} ({} entries)", archive_path, archive->mount_point, archive->psarc.entries.size() - 1);
+    if (out_fh)
+        *out_fh = archive->fh;
+
+    return SCE_FIOS_OK;
+}
+
+static SceFiosSize unmount_archive(FiosState &state, SceFiosFH fh) {
+    FiosArchivePtr archive;
+    {
+        const std::lock_guard<std::mutex> guard(state.mutex);
+        const auto it = std::find_if(state.archives.begin(), state.archives.end(), [&](const FiosArchivePtr &mounted) {
+            return mounted->fh == fh;
+        });
+        if (it == state.archives.end())
+            return fios_error(SCE_FIOS_ERROR_BAD_FH);
+
+        archive = *it;
+        state.archives.erase(it);
+        state.files.erase(fh);
+    }
+
+    state.cache.flush(archive->mount_point + '/');
+    return SCE_FIOS_OK;
+}
 
 EXPORT(int, sceFiosArchiveGetDecompressorThreadCount) {
-    return UNIMPLEMENTED();
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    return state.decompressor_thread_count;
 }
 
-EXPORT(int, sceFiosArchiveGetMountBufferSize) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosArchiveGetMountBufferSize, const SceFiosOpAttr *pAttr, const char *pArchivePath, const void *pOpenParams) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    // The table of contents lives on the host, the guest buffer only has to exist
+    return submit_op(state, thread_id, pAttr, []() -> SceFiosSize { return KiB(1); })->id;
 }
 
-EXPORT(int, sceFiosArchiveGetMountBufferSizeSync) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosArchiveGetMountBufferSizeSync, const SceFiosOpAttr *pAttr, const char *pArchivePath, const void *pOpenParams) {
+    return KiB(1);
 }
 
-EXPORT(int, sceFiosArchiveMount) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosArchiveMount, const SceFiosOpAttr *pAttr, SceFiosFH *pOutFH, const char *pArchivePath, const char *pMountPoint, Ptr<void> mountBuffer, SceSize mountBufferLength, const void *pOpenParams) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    if (!pArchivePath || !pMountPoint)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_PATH); })->id;
+
+    return submit_op(state, thread_id, pAttr, [&emuenv, &state, archive_path = std::string(pArchivePath), mount_point = std::string(pMountPoint), pOutFH]() {
+        return mount_archive(emuenv, state, archive_path, mount_point, pOutFH);
+    })->id;
 }
 
-EXPORT(int, sceFiosArchiveMountSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosArchiveMountSync, const SceFiosOpAttr *pAttr, SceFiosFH *pOutFH, const char *pArchivePath, const char *pMountPoint, Ptr<void> mountBuffer, SceSize mountBufferLength, const void *pOpenParams) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    if (!pArchivePath || !pMountPoint)
+        return SCE_FIOS_ERROR_BAD_PATH;
+
+    return static_cast<int>(run_sync(emuenv, state, thread_id, pAttr, [&]() {
+        return mount_archive(emuenv, state, pArchivePath, pMountPoint, pOutFH);
+    }));
 }
 
-EXPORT(int, sceFiosArchiveSetDecompressorThreadCount) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosArchiveSetDecompressorThreadCount, int threadCount) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    state.decompressor_thread_count = std::clamp<uint32_t>(std::max(threadCount, 1), 1, state.max_decompressor_thread_count);
+    return state.decompressor_thread_count;
 }
 
-EXPORT(int, sceFiosArchiveUnmount) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosArchiveUnmount, const SceFiosOpAttr *pAttr, SceFiosFH fh) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    return submit_op(state, thread_id, pAttr, [&state, fh]() { return unmount_archive(state, fh); })->id;
 }
 
-EXPORT(int, sceFiosArchiveUnmountSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosArchiveUnmountSync, const SceFiosOpAttr *pAttr, SceFiosFH fh) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    return static_cast<int>(run_sync(emuenv, state, thread_id, pAttr, [&]() { return unmount_archive(state, fh); }));
 }
 
-EXPORT(int, sceFiosCacheContainsFileRangeSync) {
-    return UNIMPLEMENTED();
+EXPORT(bool, sceFiosCacheContainsFileRangeSync, const SceFiosOpAttr *pAttr, const char *pPath, SceFiosOffset startOffset, SceFiosSize length) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    FiosFilePtr file;
+    if ((startOffset < 0) || (length < 0) || (open_fios_file(emuenv, state, pPath, file) < 0))
+        return false;
+
+    const uint64_t end = std::min(file->size, length ? startOffset + length : file->size);
+    for (uint64_t chunk = startOffset / FIOS_CACHE_CHUNK_SIZE; chunk * FIOS_CACHE_CHUNK_SIZE < end; chunk++) {
+        if (!state.cache.contains(file->path, chunk))
+            return false;
+    }
+
+    return true;
 }
 
-EXPORT(int, sceFiosCacheContainsFileSync) {
-    return UNIMPLEMENTED();
+EXPORT(bool, sceFiosCacheContainsFileSync, const SceFiosOpAttr *pAttr, const char *pPath) {
+    return CALL_EXPORT(sceFiosCacheContainsFileRangeSync, pAttr, pPath, 0, 0);
 }
 
-EXPORT(int, sceFiosCacheFlushFileRangeSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosCacheFlushFileRangeSync, const SceFiosOpAttr *pAttr, const char *pPath, SceFiosOffset startOffset, SceFiosSize length) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    if (!pPath)
+        return SCE_FIOS_ERROR_BAD_PATH;
+    if ((startOffset < 0) || (length < 0))
+        return SCE_FIOS_ERROR_BAD_OFFSET;
+
+    const std::string path = get_cache_path(emuenv, state, pPath);
+    if (!path.empty())
+        state.cache.flush(path, startOffset, length ? length : std::numeric_limits<uint64_t>::max());
+
+    return SCE_FIOS_OK;
 }
 
-EXPORT(int, sceFiosCacheFlushFileSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosCacheFlushFileSync, const SceFiosOpAttr *pAttr, const char *pPath) {
+    return CALL_EXPORT(sceFiosCacheFlushFileRangeSync, pAttr, pPath, 0, 0);
 }
 
-EXPORT(int, sceFiosCacheFlushSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosCacheFlushSync, const SceFiosOpAttr *pAttr) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    state.cache.clear();
+    return SCE_FIOS_OK;
 }
 
-EXPORT(int, sceFiosCachePrefetchFH) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosCachePrefetchFHRange, const SceFiosOpAttr *pAttr, SceFiosFH fh, SceFiosOffset startOffset, SceFiosSize length) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosFilePtr file = find_file(state, fh);
+    if (!file)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_FH); })->id;
+
+    return submit_op(
+        state, thread_id, pAttr, [&state, file, startOffset, length]() { return prefetch_fios_file(state, *file, startOffset, length); }, startOffset, length)
+        ->id;
 }
 
-EXPORT(int, sceFiosCachePrefetchFHRange) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosCachePrefetchFH, const SceFiosOpAttr *pAttr, SceFiosFH fh) {
+    return CALL_EXPORT(sceFiosCachePrefetchFHRange, pAttr, fh, 0, 0);
 }
 
-EXPORT(int, sceFiosCachePrefetchFHRangeSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosCachePrefetchFHRangeSync, const SceFiosOpAttr *pAttr, SceFiosFH fh, SceFiosOffset startOffset, SceFiosSize length) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosFilePtr file = find_file(state, fh);
+    if (!file)
+        return SCE_FIOS_ERROR_BAD_FH;
+
+    const SceFiosSize res = run_sync(emuenv, state, thread_id, pAttr, [&]() { return prefetch_fios_file(state, *file, startOffset, length); });
+    return static_cast<int>(std::min<SceFiosSize>(res, SCE_FIOS_OK));
 }
 
-EXPORT(int, sceFiosCachePrefetchFHSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosCachePrefetchFHSync, const SceFiosOpAttr *pAttr, SceFiosFH fh) {
+    return CALL_EXPORT(sceFiosCachePrefetchFHRangeSync, pAttr, fh, 0, 0);
 }
 
-EXPORT(int, sceFiosCachePrefetchFile) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosCachePrefetchFileRange, const SceFiosOpAttr *pAttr, const char *pPath, SceFiosOffset startOffset, SceFiosSize length) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    FiosFilePtr file;
+    const SceFiosSize res = open_fios_file(emuenv, state, pPath, file);
+    if (res < 0)
+        return submit_op(state, thread_id, pAttr, [res]() { return res; })->id;
+
+    return submit_op(
+        state, thread_id, pAttr, [&state, file, startOffset, length]() { return prefetch_fios_file(state, *file, startOffset, length); }, startOffset, length)
+        ->id;
 }
 
-EXPORT(int, sceFiosCachePrefetchFileRange) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosCachePrefetchFile, const SceFiosOpAttr *pAttr, const char *pPath) {
+    return CALL_EXPORT(sceFiosCachePrefetchFileRange, pAttr, pPath, 0, 0);
 }
 
-EXPORT(int, sceFiosCancelAllOps) {
-    return UNIMPLEMENTED();
+EXPORT(void, sceFiosCancelAllOps) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    std::set<FiosOpPtr, FiosOpOrder> cancelled;
+    {
+        const std::lock_guard<std::mutex> guard(state.queue_mutex);
+        cancelled.swap(state.queue);
+    }
+
+    for (const auto &op : cancelled) {
+        op->cancelled = true;
+        complete_op(state, *op, fios_error(SCE_FIOS_ERROR_CANCELLED));
+    }
 }
 
 EXPORT(int, sceFiosChangeStat) {
@@ -221,28 +1155,64 @@ EXPORT(int, sceFiosDirectoryDeleteSync) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosDirectoryExists) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosDirectoryExists, const SceFiosOpAttr *pAttr, const char *pPath, bool *pOutExists) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    if (!pPath)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_PATH); })->id;
+    if (!pOutExists)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_PTR); })->id;
+
+    return submit_op(state, thread_id, pAttr, [&emuenv, &state, path = std::string(pPath), pOutExists]() {
+        return fios_path_exists(emuenv, state, path, FIOS_EXISTS_DIRECTORY, pOutExists);
+    })->id;
 }
 
-EXPORT(int, sceFiosDirectoryExistsSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosDirectoryExistsSync, const SceFiosOpAttr *pAttr, const char *pPath, bool *pOutExists) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    if (!pPath)
+        return SCE_FIOS_ERROR_BAD_PATH;
+    if (!pOutExists)
+        return SCE_FIOS_ERROR_BAD_PTR;
+
+    return static_cast<int>(run_sync(emuenv, state, thread_id, pAttr, [&]() { return fios_path_exists(emuenv, state, pPath, FIOS_EXISTS_DIRECTORY, pOutExists); }));
 }
 
-EXPORT(int, sceFiosExists) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosExists, const SceFiosOpAttr *pAttr, const char *pPath, bool *pOutExists) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    if (!pPath)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_PATH); })->id;
+    if (!pOutExists)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_PTR); })->id;
+
+    return submit_op(state, thread_id, pAttr, [&emuenv, &state, path = std::string(pPath), pOutExists]() {
+        return fios_path_exists(emuenv, state, path, FIOS_EXISTS_ANY, pOutExists);
+    })->id;
 }
 
-EXPORT(int, sceFiosExistsSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosExistsSync, const SceFiosOpAttr *pAttr, const char *pPath, bool *pOutExists) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    if (!pPath)
+        return SCE_FIOS_ERROR_BAD_PATH;
+    if (!pOutExists)
+        return SCE_FIOS_ERROR_BAD_PTR;
+
+    return static_cast<int>(run_sync(emuenv, state, thread_id, pAttr, [&]() { return fios_path_exists(emuenv, state, pPath, FIOS_EXISTS_ANY, pOutExists); }));
 }
 
-EXPORT(int, sceFiosFHClose) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosFHClose, const SceFiosOpAttr *pAttr, SceFiosFH fh) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    return submit_op(state, thread_id, pAttr, [&state, fh]() {
+        const std::lock_guard<std::mutex> guard(state.mutex);
+        return state.files.erase(fh) ? SceFiosSize(SCE_FIOS_OK) : fios_error(SCE_FIOS_ERROR_BAD_FH);
+    })->id;
 }
 
-EXPORT(int, sceFiosFHCloseSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosFHCloseSync, const SceFiosOpAttr *pAttr, SceFiosFH fh) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    return static_cast<int>(run_sync(emuenv, state, thread_id, pAttr, [&]() {
+        const std::lock_guard<std::mutex> guard(state.mutex);
+        return state.files.erase(fh) ? SceFiosSize(SCE_FIOS_OK) : fios_error(SCE_FIOS_ERROR_BAD_FH);
+    }));
 }
 
 EXPORT(int, sceFiosFHGetOpenParams) {
@@ -253,8 +1223,10 @@ EXPORT(int, sceFiosFHGetPath) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosFHGetSize) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosFHGetSize, SceFiosFH fh) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosFilePtr file = find_file(state, fh);
+    return file ? file->size : fios_error(SCE_FIOS_ERROR_BAD_FH);
 }
 
 EXPORT(int, sceFiosFHIoctl) {
@@ -265,36 +1237,105 @@ EXPORT(int, sceFiosFHIoctlSync) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosFHOpen) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosFHOpen, const SceFiosOpAttr *pAttr, SceFiosFH *pOutFH, const char *pPath, const SceFiosOpenParams *pOpenParams) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    if (!pOutFH)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_PTR); })->id;
+    if (pOpenParams && (pOpenParams->openFlags & ~SCE_FIOS_O_READ)) {
+        LOG_ERROR("Writable FIOS file handles are not supported (path: {}, flags: {})", pPath ? pPath : "", log_hex(pOpenParams->openFlags));
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_UNIMPLEMENTED); })->id;
+    }
+
+    if (!pPath)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_PATH); })->id;
+
+    *pOutFH = SCE_FIOS_FH_INVALID;
+    return submit_op(state, thread_id, pAttr, [&emuenv, &state, path = std::string(pPath), pOutFH]() {
+        FiosFilePtr file;
+        const SceFiosSize res = open_fios_file(emuenv, state, path.c_str(), file);
+        if (res < 0)
+            return res;
+
+        *pOutFH = register_file(state, file);
+        return SceFiosSize(SCE_FIOS_OK);
+    })->id;
 }
 
-EXPORT(int, sceFiosFHOpenSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosFHOpenSync, const SceFiosOpAttr *pAttr, SceFiosFH *pOutFH, const char *pPath, const SceFiosOpenParams *pOpenParams) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    if (!pOutFH)
+        return SCE_FIOS_ERROR_BAD_PTR;
+    if (pOpenParams && (pOpenParams->openFlags & ~SCE_FIOS_O_READ)) {
+        LOG_ERROR("Writable FIOS file handles are not supported (path: {}, flags: {})", pPath ? pPath : "", log_hex(pOpenParams->openFlags));
+        return SCE_FIOS_ERROR_UNIMPLEMENTED;
+    }
+
+    *pOutFH = SCE_FIOS_FH_INVALID;
+    return static_cast<int>(run_sync(emuenv, state, thread_id, pAttr, [&]() {
+        FiosFilePtr file;
+        const SceFiosSize res = open_fios_file(emuenv, state, pPath, file);
+        if (res < 0)
+            return res;
+
+        *pOutFH = register_file(state, file);
+        return SceFiosSize(SCE_FIOS_OK);
+    }));
 }
 
-EXPORT(int, sceFiosFHOpenWithMode) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosFHOpenWithMode, const SceFiosOpAttr *pAttr, SceFiosFH *pOutFH, const char *pPath, const SceFiosOpenParams *pOpenParams, int32_t nativeMode) {
+    return CALL_EXPORT(sceFiosFHOpen, pAttr, pOutFH, pPath, pOpenParams);
 }
 
-EXPORT(int, sceFiosFHOpenWithModeSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosFHOpenWithModeSync, const SceFiosOpAttr *pAttr, SceFiosFH *pOutFH, const char *pPath, const SceFiosOpenParams *pOpenParams, int32_t nativeMode) {
+    return CALL_EXPORT(sceFiosFHOpenSync, pAttr, pOutFH, pPath, pOpenParams);
 }
 
-EXPORT(int, sceFiosFHPread) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosFHPread, const SceFiosOpAttr *pAttr, SceFiosFH fh, void *pBuf, SceFiosSize length, SceFiosOffset offset) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosFilePtr file = find_file(state, fh);
+    if (!file)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_FH); })->id;
+    if (!pBuf)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_PTR); })->id;
+
+    return submit_op(
+        state, thread_id, pAttr, [&state, file, pBuf, length, offset]() { return read_fios_file(state, *file, offset, static_cast<uint8_t *>(pBuf), length); }, offset, length)
+        ->id;
 }
 
-EXPORT(int, sceFiosFHPreadSync) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosFHPreadSync, const SceFiosOpAttr *pAttr, SceFiosFH fh, void *pBuf, SceFiosSize length, SceFiosOffset offset) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosFilePtr file = find_file(state, fh);
+    if (!file)
+        return fios_error(SCE_FIOS_ERROR_BAD_FH);
+    if (!pBuf)
+        return fios_error(SCE_FIOS_ERROR_BAD_PTR);
+
+    return run_sync(emuenv, state, thread_id, pAttr, [&]() { return read_fios_file(state, *file, offset, static_cast<uint8_t *>(pBuf), length); });
 }
 
-EXPORT(int, sceFiosFHPreadv) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosFHPreadv, const SceFiosOpAttr *pAttr, SceFiosFH fh, const SceFiosIOVec *iov, int iovcnt, SceFiosOffset offset) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosFilePtr file = find_file(state, fh);
+    if (!file)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_FH); })->id;
+    if (!iov || (iovcnt < 0))
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_IOVCNT); })->id;
+
+    std::vector<SceFiosIOVec> vecs(iov, iov + iovcnt);
+    return submit_op(state, thread_id, pAttr, [&emuenv, &state, file, vecs, offset]() { return readv_fios_file(emuenv, state, *file, vecs, offset); }, offset)->id;
 }
 
-EXPORT(int, sceFiosFHPreadvSync) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosFHPreadvSync, const SceFiosOpAttr *pAttr, SceFiosFH fh, const SceFiosIOVec *iov, int iovcnt, SceFiosOffset offset) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosFilePtr file = find_file(state, fh);
+    if (!file)
+        return fios_error(SCE_FIOS_ERROR_BAD_FH);
+    if (!iov || (iovcnt < 0))
+        return fios_error(SCE_FIOS_ERROR_BAD_IOVCNT);
+
+    const std::vector<SceFiosIOVec> vecs(iov, iov + iovcnt);
+    return run_sync(emuenv, state, thread_id, pAttr, [&]() { return readv_fios_file(emuenv, state, *file, vecs, offset); });
 }
 
 EXPORT(int, sceFiosFHPwrite) {
@@ -313,32 +1354,108 @@ EXPORT(int, sceFiosFHPwritevSync) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosFHRead) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosFHRead, const SceFiosOpAttr *pAttr, SceFiosFH fh, void *pBuf, SceFiosSize length) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosFilePtr file = find_file(state, fh);
+    if (!file)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_FH); })->id;
+    if (!pBuf)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_PTR); })->id;
+
+    return submit_op(
+        state, thread_id, pAttr, [&state, file, pBuf, length]() {
+            return read_at_position(*file, [&](SceFiosOffset offset) { return read_fios_file(state, *file, offset, static_cast<uint8_t *>(pBuf), length); });
+        },
+        get_position(*file), length)
+        ->id;
 }
 
-EXPORT(int, sceFiosFHReadSync) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosFHReadSync, const SceFiosOpAttr *pAttr, SceFiosFH fh, void *pBuf, SceFiosSize length) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosFilePtr file = find_file(state, fh);
+    if (!file)
+        return fios_error(SCE_FIOS_ERROR_BAD_FH);
+    if (!pBuf)
+        return fios_error(SCE_FIOS_ERROR_BAD_PTR);
+
+    return run_sync(emuenv, state, thread_id, pAttr, [&]() {
+        return read_at_position(*file, [&](SceFiosOffset offset) { return read_fios_file(state, *file, offset, static_cast<uint8_t *>(pBuf), length); });
+    });
 }
 
-EXPORT(int, sceFiosFHReadv) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosFHReadv, const SceFiosOpAttr *pAttr, SceFiosFH fh, const SceFiosIOVec *iov, int iovcnt) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosFilePtr file = find_file(state, fh);
+    if (!file)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_FH); })->id;
+    if (!iov || (iovcnt < 0))
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_IOVCNT); })->id;
+
+    std::vector<SceFiosIOVec> vecs(iov, iov + iovcnt);
+    return submit_op(
+        state, thread_id, pAttr, [&emuenv, &state, file, vecs]() {
+            return read_at_position(*file, [&](SceFiosOffset offset) { return readv_fios_file(emuenv, state, *file, vecs, offset); });
+        },
+        get_position(*file), get_iovec_size(iov, iovcnt))
+        ->id;
 }
 
-EXPORT(int, sceFiosFHReadvSync) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosFHReadvSync, const SceFiosOpAttr *pAttr, SceFiosFH fh, const SceFiosIOVec *iov, int iovcnt) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosFilePtr file = find_file(state, fh);
+    if (!file)
+        return fios_error(SCE_FIOS_ERROR_BAD_FH);
+    if (!iov || (iovcnt < 0))
+        return fios_error(SCE_FIOS_ERROR_BAD_IOVCNT);
+
+    const std::vector<SceFiosIOVec> vecs(iov, iov + iovcnt);
+    return run_sync(emuenv, state, thread_id, pAttr, [&]() {
+        return read_at_position(*file, [&](SceFiosOffset offset) { return readv_fios_file(emuenv, state, *file, vecs, offset); });
+    });
 }
 
-EXPORT(int, sceFiosFHSeek) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOffset, sceFiosFHSeek, SceFiosFH fh, SceFiosOffset offset, SceFiosWhence whence) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosFilePtr file = find_file(state, fh);
+    if (!file)
+        return fios_error(SCE_FIOS_ERROR_BAD_FH);
+
+    const std::lock_guard<std::mutex> guard(file->mutex);
+    SceFiosOffset position;
+    switch (whence) {
+    case SCE_FIOS_SEEK_SET: position = offset; break;
+    case SCE_FIOS_SEEK_CUR: position = file->position + offset; break;
+    case SCE_FIOS_SEEK_END: position = file->size + offset; break;
+    default: return fios_error(SCE_FIOS_ERROR_BAD_OFFSET);
+    }
+
+    if (position < 0)
+        return fios_error(SCE_FIOS_ERROR_BAD_OFFSET);
+
+    file->position = position;
+    return position;
 }
 
-EXPORT(int, sceFiosFHStat) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosFHStat, const SceFiosOpAttr *pAttr, SceFiosFH fh, SceFiosStat *pOutStatus) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosFilePtr file = find_file(state, fh);
+    if (!file)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_FH); })->id;
+    if (!pOutStatus)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_PTR); })->id;
+
+    return submit_op(state, thread_id, pAttr, [&emuenv, &state, file, pOutStatus]() { return stat_fios_path(emuenv, state, file->path, *pOutStatus); })->id;
 }
 
-EXPORT(int, sceFiosFHStatSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosFHStatSync, const SceFiosOpAttr *pAttr, SceFiosFH fh, SceFiosStat *pOutStatus) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosFilePtr file = find_file(state, fh);
+    if (!file)
+        return SCE_FIOS_ERROR_BAD_FH;
+    if (!pOutStatus)
+        return SCE_FIOS_ERROR_BAD_PTR;
+
+    return static_cast<int>(run_sync(emuenv, state, thread_id, pAttr, [&]() { return stat_fios_path(emuenv, state, file->path, *pOutStatus); }));
 }
 
 EXPORT(int, sceFiosFHSync) {
@@ -349,8 +1466,14 @@ EXPORT(int, sceFiosFHSyncSync) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosFHTell) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOffset, sceFiosFHTell, SceFiosFH fh) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosFilePtr file = find_file(state, fh);
+    if (!file)
+        return fios_error(SCE_FIOS_ERROR_BAD_FH);
+
+    const std::lock_guard<std::mutex> guard(file->mutex);
+    return file->position;
 }
 
 EXPORT(int, sceFiosFHToFileno) {
@@ -389,28 +1512,79 @@ EXPORT(int, sceFiosFileDeleteSync) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosFileExists) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosFileExists, const SceFiosOpAttr *pAttr, const char *pPath, bool *pOutExists) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    if (!pPath)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_PATH); })->id;
+    if (!pOutExists)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_PTR); })->id;
+
+    return submit_op(state, thread_id, pAttr, [&emuenv, &state, path = std::string(pPath), pOutExists]() {
+        return fios_path_exists(emuenv, state, path, FIOS_EXISTS_FILE, pOutExists);
+    })->id;
 }
 
-EXPORT(int, sceFiosFileExistsSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosFileExistsSync, const SceFiosOpAttr *pAttr, const char *pPath, bool *pOutExists) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    if (!pPath)
+        return SCE_FIOS_ERROR_BAD_PATH;
+    if (!pOutExists)
+        return SCE_FIOS_ERROR_BAD_PTR;
+
+    return static_cast<int>(run_sync(emuenv, state, thread_id, pAttr, [&]() { return fios_path_exists(emuenv, state, pPath, FIOS_EXISTS_FILE, pOutExists); }));
 }
 
-EXPORT(int, sceFiosFileGetSize) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosFileGetSize, const SceFiosOpAttr *pAttr, const char *pPath, SceFiosSize *pOutSize) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    if (!pPath)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_PATH); })->id;
+    if (!pOutSize)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_PTR); })->id;
+
+    return submit_op(state, thread_id, pAttr, [&emuenv, &state, path = std::string(pPath), pOutSize]() {
+        FiosFilePtr file;
+        const SceFiosSize res = open_fios_file(emuenv, state, path.c_str(), file);
+        if (res < 0)
+            return res;
+
+        *pOutSize = file->size;
+        return SceFiosSize(SCE_FIOS_OK);
+    })->id;
 }
 
-EXPORT(int, sceFiosFileGetSizeSync) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosFileGetSizeSync, const SceFiosOpAttr *pAttr, const char *pPath) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    return run_sync(emuenv, state, thread_id, pAttr, [&]() {
+        FiosFilePtr file;
+        const SceFiosSize res = open_fios_file(emuenv, state, pPath, file);
+        return res < 0 ? res : file->size;
+    });
 }
 
-EXPORT(int, sceFiosFileRead) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosFileRead, const SceFiosOpAttr *pAttr, const char *pPath, void *pBuf, SceFiosSize length, SceFiosOffset offset) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    FiosFilePtr file;
+    const SceFiosSize res = open_fios_file(emuenv, state, pPath, file);
+    if (res < 0)
+        return submit_op(state, thread_id, pAttr, [res]() { return res; })->id;
+    if (!pBuf)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_PTR); })->id;
+
+    return submit_op(
+        state, thread_id, pAttr, [&state, file, pBuf, length, offset]() { return read_fios_file(state, *file, offset, static_cast<uint8_t *>(pBuf), length); }, offset, length)
+        ->id;
 }
 
-EXPORT(int, sceFiosFileReadSync) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosFileReadSync, const SceFiosOpAttr *pAttr, const char *pPath, void *pBuf, SceFiosSize length, SceFiosOffset offset) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    FiosFilePtr file;
+    const SceFiosSize res = open_fios_file(emuenv, state, pPath, file);
+    if (res < 0)
+        return res;
+    if (!pBuf)
+        return fios_error(SCE_FIOS_ERROR_BAD_PTR);
+
+    return run_sync(emuenv, state, thread_id, pAttr, [&]() { return read_fios_file(state, *file, offset, static_cast<uint8_t *>(pBuf), length); });
 }
 
 EXPORT(int, sceFiosFileTruncate) {
@@ -457,8 +1631,10 @@ EXPORT(int, sceFiosGetSuspendCount) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosIOFilterAdd) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosIOFilterAdd, int index, Ptr<void> pFilterCallback, Ptr<void> pFilterContext) {
+    // Archives are decoded on the host when mounted, guest filters such as the PSARC dearchiver are never called
+    LOG_INFO("FIOS I/O filter {} added at index {}", log_hex(pFilterCallback.address()), index);
+    return SCE_FIOS_OK;
 }
 
 EXPORT(int, sceFiosIOFilterCache) {
@@ -470,43 +1646,92 @@ EXPORT(int, sceFiosIOFilterGetInfo) {
 }
 
 EXPORT(int, sceFiosIOFilterPsarcDearchiver) {
-    return UNIMPLEMENTED();
+    // Only given to sceFiosIOFilterAdd, mounted archives are decoded by the host PSARC reader so there is nothing left to filter
+    return SCE_FIOS_OK;
 }
 
-EXPORT(int, sceFiosIOFilterRemove) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosIOFilterRemove, int index) {
+    return SCE_FIOS_OK;
 }
 
-EXPORT(int, sceFiosInitialize) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosInitialize, const SceFiosParams *pParameters) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const std::lock_guard<std::mutex> guard(state.mutex);
+    if (state.initialized)
+        return SCE_FIOS_OK;
+
+    uint32_t io_thread_count = FIOS_DEFAULT_IO_THREAD_COUNT;
+    uint32_t decompressor_thread_count = 1;
+    if (pParameters) {
+        if (pParameters->ioThreadCount)
+            io_thread_count = std::min(pParameters->ioThreadCount, FIOS_MAX_IO_THREAD_COUNT);
+        if (pParameters->maxDecompressorThreadCount)
+            decompressor_thread_count = pParameters->maxDecompressorThreadCount;
+    }
+
+    state.max_decompressor_thread_count = std::clamp(decompressor_thread_count, 1U, std::max(std::thread::hardware_concurrency(), 1U));
+    state.decompressor_thread_count = state.max_decompressor_thread_count;
+    state.start(io_thread_count);
+    state.initialized = true;
+
+    return SCE_FIOS_OK;
 }
 
-EXPORT(int, sceFiosIsIdle) {
-    return UNIMPLEMENTED();
+EXPORT(bool, sceFiosIsIdle) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    run_callbacks(emuenv, state, thread_id);
+
+    const std::lock_guard<std::mutex> guard(state.queue_mutex);
+    return state.queue.empty() && (state.running == 0);
 }
 
-EXPORT(int, sceFiosIsInitialized) {
-    return UNIMPLEMENTED();
+EXPORT(bool, sceFiosIsInitialized, SceFiosParams *pOutParameters) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const std::lock_guard<std::mutex> guard(state.mutex);
+    return state.initialized;
 }
 
 EXPORT(int, sceFiosIsSuspended) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosIsValidHandle) {
-    return UNIMPLEMENTED();
+EXPORT(bool, sceFiosIsValidHandle, SceFiosFH fh) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    return find_file(state, fh) != nullptr;
 }
 
-EXPORT(int, sceFiosOpCancel) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosOpCancel, SceFiosOp op) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosOpPtr fios_op = find_op(state, op);
+    if (!fios_op)
+        return SCE_FIOS_ERROR_BAD_OP;
+
+    cancel_op(state, fios_op);
+    return SCE_FIOS_OK;
 }
 
-EXPORT(int, sceFiosOpDelete) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosOpDelete, SceFiosOp op) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosOpPtr fios_op = find_op(state, op);
+    if (!fios_op)
+        return SCE_FIOS_ERROR_BAD_OP;
+
+    // An op still in flight writes to guest memory, make sure it is over before forgetting it
+    cancel_op(state, fios_op);
+    wait_op(*fios_op);
+    delete_op(state, *fios_op);
+    run_callbacks(emuenv, state, thread_id);
+    return SCE_FIOS_OK;
 }
 
-EXPORT(int, sceFiosOpGetActualCount) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosOpGetActualCount, SceFiosOp op) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosOpPtr fios_op = find_op(state, op);
+    if (!fios_op)
+        return fios_error(SCE_FIOS_ERROR_BAD_OP);
+
+    const std::lock_guard<std::mutex> guard(fios_op->mutex);
+    return fios_op->actual;
 }
 
 EXPORT(int, sceFiosOpGetAttr) {
@@ -517,52 +1742,113 @@ EXPORT(int, sceFiosOpGetBuffer) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosOpGetError) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosOpGetError, SceFiosOp op) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosOpPtr fios_op = find_op(state, op);
+    if (!fios_op)
+        return SCE_FIOS_ERROR_BAD_OP;
+
+    const std::lock_guard<std::mutex> guard(fios_op->mutex);
+    return fios_op->error;
 }
 
-EXPORT(int, sceFiosOpGetOffset) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOffset, sceFiosOpGetOffset, SceFiosOp op) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosOpPtr fios_op = find_op(state, op);
+    return fios_op ? fios_op->offset : fios_error(SCE_FIOS_ERROR_BAD_OP);
 }
 
 EXPORT(int, sceFiosOpGetPath) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosOpGetRequestCount) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosOpGetRequestCount, SceFiosOp op) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosOpPtr fios_op = find_op(state, op);
+    return fios_op ? fios_op->requested : fios_error(SCE_FIOS_ERROR_BAD_OP);
 }
 
-EXPORT(int, sceFiosOpIsCancelled) {
-    return UNIMPLEMENTED();
+EXPORT(bool, sceFiosOpIsCancelled, SceFiosOp op) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosOpPtr fios_op = find_op(state, op);
+    return fios_op && fios_op->cancelled;
 }
 
-EXPORT(int, sceFiosOpIsDone) {
-    return UNIMPLEMENTED();
+EXPORT(bool, sceFiosOpIsDone, SceFiosOp op) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    run_callbacks(emuenv, state, thread_id);
+    const FiosOpPtr fios_op = find_op(state, op);
+    if (!fios_op)
+        return true;
+
+    const std::lock_guard<std::mutex> guard(fios_op->mutex);
+    return fios_op->done;
 }
 
-EXPORT(int, sceFiosOpReschedule) {
-    return UNIMPLEMENTED();
+EXPORT(void, sceFiosOpRescheduleWithPriority, SceFiosOp op, SceFiosTime newDeadline, int32_t newPriority) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosOpPtr fios_op = find_op(state, op);
+    if (!fios_op)
+        return;
+
+    // The queue is ordered on these fields, take the op out while they change
+    const std::lock_guard<std::mutex> guard(state.queue_mutex);
+    const bool queued = state.queue.erase(fios_op) > 0;
+    fios_op->deadline = newDeadline;
+    fios_op->priority = newPriority;
+    if (queued)
+        state.queue.insert(fios_op);
 }
 
-EXPORT(int, sceFiosOpRescheduleWithPriority) {
-    return UNIMPLEMENTED();
+EXPORT(void, sceFiosOpReschedule, SceFiosOp op, SceFiosTime newDeadline) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosOpPtr fios_op = find_op(state, op);
+    if (fios_op)
+        CALL_EXPORT(sceFiosOpRescheduleWithPriority, op, newDeadline, fios_op->priority);
 }
 
-EXPORT(int, sceFiosOpSyncWait) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosOpSyncWait, SceFiosOp op) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosOpPtr fios_op = find_op(state, op);
+    if (!fios_op)
+        return fios_error(SCE_FIOS_ERROR_BAD_OP);
+
+    wait_op(*fios_op);
+    delete_op(state, *fios_op);
+    run_callbacks(emuenv, state, thread_id);
+    return fios_op->error ? fios_op->error : fios_op->actual;
 }
 
-EXPORT(int, sceFiosOpSyncWaitForIO) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosOpSyncWaitForIO, SceFiosOp op) {
+    return CALL_EXPORT(sceFiosOpSyncWait, op);
 }
 
-EXPORT(int, sceFiosOpWait) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosOpWait, SceFiosOp op) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosOpPtr fios_op = find_op(state, op);
+    if (!fios_op)
+        return SCE_FIOS_ERROR_BAD_OP;
+
+    wait_op(*fios_op);
+    run_callbacks(emuenv, state, thread_id);
+    return fios_op->error;
 }
 
-EXPORT(int, sceFiosOpWaitUntil) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosOpWaitUntil, SceFiosOp op, SceFiosTime deadline) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    const FiosOpPtr fios_op = find_op(state, op);
+    if (!fios_op)
+        return SCE_FIOS_ERROR_BAD_OP;
+
+    {
+        std::unique_lock<std::mutex> lock(fios_op->mutex);
+        const auto timeout = std::chrono::nanoseconds(std::max<SceFiosTime>(deadline - get_current_time(), 0));
+        if (!fios_op->cond.wait_for(lock, timeout, [&]() { return fios_op->done; }))
+            return SCE_FIOS_ERROR_TIMEOUT;
+    }
+
+    run_callbacks(emuenv, state, thread_id);
+    return fios_op->error;
 }
 
 EXPORT(int, sceFiosOverlayAdd) {
@@ -629,16 +1915,49 @@ EXPORT(int, sceFiosSetGlobalDefaultOpAttr) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosShutdownAndCancelOps) {
-    return UNIMPLEMENTED();
+EXPORT(void, sceFiosTerminate) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    {
+        const std::lock_guard<std::mutex> guard(state.mutex);
+        if (!state.initialized)
+            return;
+        state.initialized = false;
+    }
+
+    state.stop();
+
+    const std::lock_guard<std::mutex> guard(state.mutex);
+    state.files.clear();
+    state.archives.clear();
+    state.ops.clear();
+    state.cache.clear();
+
+    const std::lock_guard<std::mutex> callback_guard(state.callback_mutex);
+    state.callbacks.clear();
 }
 
-EXPORT(int, sceFiosStat) {
-    return UNIMPLEMENTED();
+EXPORT(void, sceFiosShutdownAndCancelOps) {
+    CALL_EXPORT(sceFiosTerminate);
 }
 
-EXPORT(int, sceFiosStatSync) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosStat, const SceFiosOpAttr *pAttr, const char *pPath, SceFiosStat *pOutStatus) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    if (!pPath)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_PATH); })->id;
+    if (!pOutStatus)
+        return submit_op(state, thread_id, pAttr, []() { return fios_error(SCE_FIOS_ERROR_BAD_PTR); })->id;
+
+    return submit_op(state, thread_id, pAttr, [&emuenv, &state, path = std::string(pPath), pOutStatus]() { return stat_fios_path(emuenv, state, path, *pOutStatus); })->id;
+}
+
+EXPORT(int, sceFiosStatSync, const SceFiosOpAttr *pAttr, const char *pPath, SceFiosStat *pOutStatus) {
+    auto &state = *emuenv.kernel.obj_store.get<FiosState>();
+    if (!pPath)
+        return SCE_FIOS_ERROR_BAD_PATH;
+    if (!pOutStatus)
+        return SCE_FIOS_ERROR_BAD_PTR;
+
+    return static_cast<int>(run_sync(emuenv, state, thread_id, pAttr, [&]() { return stat_fios_path(emuenv, state, pPath, *pOutStatus); }));
 }
 
 EXPORT(int, sceFiosStatisticsGet) {
@@ -665,20 +1984,16 @@ EXPORT(int, sceFiosSyncSync) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosTerminate) {
-    return UNIMPLEMENTED();
-}
-
-EXPORT(int, sceFiosTimeGetCurrent) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosTime, sceFiosTimeGetCurrent) {
+    return get_current_time();
 }
 
-EXPORT(int, sceFiosTimeIntervalFromNanoseconds) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosTimeInterval, sceFiosTimeIntervalFromNanoseconds, int64_t ns) {
+    return ns;
 }
 
-EXPORT(int, sceFiosTimeIntervalToNanoseconds) {
-    return UNIMPLEMENTED();
+EXPORT(int64_t, sceFiosTimeIntervalToNanoseconds, SceFiosTimeInterval interval) {
+    return interval;
 }
 
 EXPORT(int, sceFiosUpdateParameters) {
@@ -2796,13 +2796,7 @@ EXPORT(int, sceGxmNotificationWait, const SceGxmNotification *notification) {
         return RET_ERROR(SCE_GXM_ERROR_INVALID_POINTER);
     }
 
-    std::uint32_t volatile *value = notification->address.get(emuenv.mem);
-    const std::uint32_t target_value = notification->value;
-
-    std::unique_lock<std::mutex> lock(emuenv.renderer->notification_mutex);
-    if (*value != target_value) {
-        emuenv.renderer->notification_ready.wait(lock, [&]() { return *value == target_value; });
-    }
+    renderer::wait_notification(*emuenv.renderer, emuenv.mem, *notification);
 
     return 0;
 }
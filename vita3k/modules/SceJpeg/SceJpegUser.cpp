@@ -21,14 +21,23 @@
 #include <codec/types.h>
 #include <kernel/state.h>
 
+#include <limits>
+#include <map>
+
 #include <util/tracy.h>
 TRACY_MODULE_NAME(SceJpegUser);
 
 typedef std::shared_ptr<MjpegDecoderState> DecoderPtr;
 
+struct SplitDecoder {
+    std::vector<uint8_t> stream;
+};
+
 struct MJpegState {
     bool initialized = false;
     DecoderPtr decoder;
+    int max_split_decoders = 0;
+    std::map<Address, SplitDecoder> split_decoders;
 };
 
 struct SceJpegMJpegInitInfo {
@@ -77,6 +86,17 @@ enum SceJpegColorConversion : int {
     SCE_JPEG_COLORSPACE_BT601 = 0x10
 };
 
+// There is no public definition of this structure, the layout is inferred from how games drive the split decoder
+// Only these fields are accessed, the ones given by the title are checked by is_valid_split_decode_ctrl
+struct SceJpegSplitDecodeCtrl {
+    Ptr<const uint8_t> pStream;
+    SceSize streamSize;
+    Ptr<uint8_t> pYCbCr;
+    SceSize outputSize;
+    int decodeMode;
+    int isEndOfStream;
+};
+
 struct SceJpegOutputInfo {
     SceJpegColorSpace color_space;
     uint16_t width;
@@ -117,9 +137,92 @@ DecoderColorSpace convert_color_space_jpeg_to_decoder(SceJpegColorSpace color_sp
     }
 }
 
-EXPORT(int, sceJpegCreateSplitDecoder) {
-    TRACY_FUNC(sceJpegCreateSplitDecoder);
-    return UNIMPLEMENTED();
+// The smallest reduction is used when several are allowed
+static uint32_t get_downscale(int decodeMode) {
+    if (decodeMode & SCE_JPEG_MJPEG_DOWNSCALE_1_2)
+        return 1;
+    if (decodeMode & SCE_JPEG_MJPEG_DOWNSCALE_1_4)
+        return 2;
+    if (decodeMode & SCE_JPEG_MJPEG_DOWNSCALE_1_8)
+        return 3;
+    return 0;
+}
+
+// Only parses the headers, the size is the one of the downscaled output
+static int get_image_info(const uint8_t *pJpeg, SceSize isize, int decodeMode, DecoderSize &size, SceJpegColorSpace &color_space) {
+    DecoderColorSpace decoder_color_space = COLORSPACE_UNKNOWN;
+    const int error = parse_jpeg_header(pJpeg, isize, size, decoder_color_space);
+    if (error)
+        return error;
+
+    const uint32_t lowres = get_downscale(decodeMode);
+    size.width = (size.width + (1 << lowres) - 1) >> lowres;
+    size.height = (size.height + (1 << lowres) - 1) >> lowres;
+    color_space = convert_color_space_decoder_to_jpeg(decoder_color_space);
+
+    return 0;
+}
+
+static uint32_t get_ycbcr_size(const DecoderSize &size, SceJpegColorSpace color_space) {
+    switch (color_space) {
+    case SCE_JPEG_COLORSPACE_GRAYSCALE:
+        return size.width * size.height;
+    case SCE_JPEG_COLORSPACE_YUV444:
+        return size.width * size.height * 3;
+    case SCE_JPEG_COLORSPACE_YUV422:
+        return size.width * size.height * 2;
+    case SCE_JPEG_COLORSPACE_YUV420:
+        return size.width * size.height * 3 / 2;
+    default:
+        return 0;
+    }
+}
+
+static bool is_valid_guest_range(const MemState &mem, Address address, SceSize size) {
+    return address && (size <= std::numeric_limits<Address>::max() - address) && is_valid_addr_range(mem, address, address + size);
+}
+
+static int decode_ycbcr(MJpegState &state, const uint8_t *pJpeg, SceSize isize, uint8_t *pYCbCr, SceSize osize, int decodeMode) {
+    DecoderSize size = {};
+    SceJpegColorSpace color_space;
+    const int error = get_image_info(pJpeg, isize, decodeMode, size, color_space);
+    if (error)
+        return error;
+    if (get_ycbcr_size(size, color_space) > osize)
+        return SCE_JPEG_ERROR_INVALID_DATA_SIZE;
+
+    state.decoder->set_downscale(get_downscale(decodeMode));
+    if (!state.decoder->send(pJpeg, isize) || !state.decoder->receive(pYCbCr, &size))
+        return SCE_JPEG_ERROR_DECODE_ERROR;
+
+    // Top 16 bits = width, bottom 16 bits = height.
+    return (size.width << 16u) | size.height;
+}
+
+// decodeMode and isEndOfStream only have a few valid values, anything else means the title uses another layout
+static bool is_valid_split_decode_ctrl(const SceJpegSplitDecodeCtrl &ctrl) {
+    constexpr int valid_decode_mode_bits = static_cast<int>(SCE_JPEG_MJPEG_ANY_SAMPLING) | SCE_JPEG_MJPEG_DOWNSCALE_ANY;
+    if ((ctrl.decodeMode & ~valid_decode_mode_bits) != 0 || (ctrl.isEndOfStream != 0 && ctrl.isEndOfStream != 1)) {
+        LOG_ERROR_ONCE("Unexpected SceJpegSplitDecodeCtrl content (decodeMode: {}, isEndOfStream: {}), the structure layout may not match the one used by the title",
+            log_hex(ctrl.decodeMode), ctrl.isEndOfStream);
+        return false;
+    }
+
+    return true;
+}
+
+EXPORT(int, sceJpegCreateSplitDecoder, Ptr<SceJpegSplitDecodeCtrl> pCtrl) {
+    TRACY_FUNC(sceJpegCreateSplitDecoder, pCtrl);
+    const auto state = emuenv.kernel.obj_store.get<MJpegState>();
+
+    if (!pCtrl)
+        return RET_ERROR(SCE_JPEG_ERROR_INVALID_POINTER);
+    if (state->split_decoders.size() >= static_cast<size_t>(state->max_split_decoders))
+        return RET_ERROR(SCE_JPEG_ERROR_EXCEED_MAX_SPLIT_DECODER);
+
+    state->split_decoders[pCtrl.address()] = {};
+
+    return 0;
 }
 
 EXPORT(int, sceJpegCsc) {
@@ -131,20 +234,23 @@ EXPORT(int, sceJpegDecodeMJpeg, const unsigned char *pJpeg, SceSize isize, uint8
     int decodeMode, void *pTempBuffer, SceSize tempBufferSize, void *pCoefBuffer, SceSize coefBufferSize) {
     TRACY_FUNC(sceJpegDecodeMJpeg, pJpeg, isize, pRGBA, osize, decodeMode, pTempBuffer, tempBufferSize, pCoefBuffer, coefBufferSize);
 
-    if (decodeMode & SCE_JPEG_MJPEG_DOWNSCALE_ANY)
-        return STUBBED("JPEG downscaling is not implemented");
+    if (!pJpeg || !pRGBA)
+        return RET_ERROR(SCE_JPEG_ERROR_INVALID_POINTER);
 
     const auto state = emuenv.kernel.obj_store.get<MJpegState>();
 
     DecoderSize size = {};
+    SceJpegColorSpace color_space;
+    const int error = get_image_info(pJpeg, isize, decodeMode, size, color_space);
+    if (error)
+        return RET_ERROR(error);
+    if (size.width * size.height * 4 > osize)
+        return RET_ERROR(SCE_JPEG_ERROR_INVALID_DATA_SIZE);
 
-    // the yuv data will always be smaller than the rgba data, so osize is an upper bound
-    std::vector<uint8_t> temporary(osize);
-
-    state->decoder->send(pJpeg, isize);
-    state->decoder->receive(temporary.data(), &size);
-
-    convert_yuv_to_rgb(temporary.data(), pRGBA, size.width, size.height, state->decoder->get_color_space());
+    // The frame planes are converted straight into the guest buffer
+    state->decoder->set_downscale(get_downscale(decodeMode));
+    if (!state->decoder->send(pJpeg, isize) || !state->decoder->receive_rgba(pRGBA, &size, false, false))
+        return RET_ERROR(SCE_JPEG_ERROR_DECODE_ERROR);
 
     // Top 16 bits = width, bottom 16 bits = height.
     return (size.width << 16u) | size.height;
@@ -154,23 +260,26 @@ EXPORT(int, sceJpegDecodeMJpegYCbCr, const uint8_t *pJpeg, SceSize isize,
     uint8_t *pYCbCr, SceSize osize, int decodeMode, void *pCoefBuffer, SceSize coefBufferSize) {
     TRACY_FUNC(sceJpegDecodeMJpegYCbCr, pJpeg, isize, pYCbCr, osize, decodeMode, pCoefBuffer, coefBufferSize);
 
-    if (decodeMode & SCE_JPEG_MJPEG_DOWNSCALE_ANY)
-        return STUBBED("JPEG downscaling is not implemented");
+    if (!pJpeg || !pYCbCr)
+        return RET_ERROR(SCE_JPEG_ERROR_INVALID_POINTER);
 
     const auto state = emuenv.kernel.obj_store.get<MJpegState>();
 
-    DecoderSize size = {};
-
-    state->decoder->send(pJpeg, isize);
-    state->decoder->receive(pYCbCr, &size);
+    const int result = decode_ycbcr(*state, pJpeg, isize, pYCbCr, osize, decodeMode);
+    if (result < 0)
+        return RET_ERROR(result);
 
-    // Top 16 bits = width, bottom 16 bits = height.
-    return (size.width << 16u) | size.height;
+    return result;
 }
 
-EXPORT(int, sceJpegDeleteSplitDecoder) {
-    TRACY_FUNC(sceJpegDeleteSplitDecoder);
-    return UNIMPLEMENTED();
+EXPORT(int, sceJpegDeleteSplitDecoder, Ptr<SceJpegSplitDecodeCtrl> pCtrl) {
+    TRACY_FUNC(sceJpegDeleteSplitDecoder, pCtrl);
+    const auto state = emuenv.kernel.obj_store.get<MJpegState>();
+
+    if (!state->split_decoders.erase(pCtrl.address()))
+        return RET_ERROR(SCE_JPEG_ERROR_INVALID_STATE);
+
+    return 0;
 }
 
 EXPORT(int, sceJpegFinishMJpeg) {
@@ -183,7 +292,6 @@ EXPORT(int, sceJpegFinishMJpeg) {
 EXPORT(int, sceJpegGetOutputInfo, const uint8_t *pJpeg, SceSize isize,
     SceJpegFormat format, int decodeMode, SceJpegOutputInfo *output) {
     TRACY_FUNC(sceJpegGetOutputInfo, pJpeg, isize, format, decodeMode, output);
-    const auto state = emuenv.kernel.obj_store.get<MJpegState>();
 
     if (!pJpeg || !output || !isize)
         return RET_ERROR(SCE_JPEG_ERROR_INVALID_POINTER);
@@ -193,17 +301,14 @@ EXPORT(int, sceJpegGetOutputInfo, const uint8_t *pJpeg, SceSize isize,
     if (format != SCE_JPEG_NO_CSC_OUTPUT && format != SCE_JPEG_PIXEL_RGBA8888 && format != SCE_JPEG_PIXEL_BGRA8888)
         return RET_ERROR(SCE_JPEG_ERROR_INVALID_COLOR_FORMAT);
 
-    if (format == SCE_JPEG_PIXEL_BGRA8888)
-        return STUBBED("SCE_JPEG_PIXEL_BGRA8888 is not implemented");
-
+    // Everything needed is in the SOF segment, there is no need to decode the image
     DecoderSize size = {};
-
-    state->decoder->send(pJpeg, isize);
-    state->decoder->receive(nullptr, &size);
+    const int error = get_image_info(pJpeg, isize, decodeMode, size, output->color_space);
+    if (error)
+        return RET_ERROR(error);
 
     output->width = size.width;
     output->height = size.height;
-    output->color_space = convert_color_space_decoder_to_jpeg(state->decoder->get_color_space());
     output->pitch[0] = {
         .x = size.width,
         .y = size.height
@@ -211,22 +316,18 @@ EXPORT(int, sceJpegGetOutputInfo, const uint8_t *pJpeg, SceSize isize,
     // Should be 0 most of the time but I believe it causes more problems
     // for it to be 0 when it shouldn't than the opposite
     output->coef_buffer_size = 0x100;
-    if (format == SCE_JPEG_PIXEL_RGBA8888) {
+    if (format != SCE_JPEG_NO_CSC_OUTPUT) {
         output->output_size = size.width * size.height * 4;
         // put something greater than 0
         output->temp_buffer_size = 0x100;
     } else {
+        output->output_size = get_ycbcr_size(size, output->color_space);
         switch (output->color_space) {
-        case SCE_JPEG_COLORSPACE_GRAYSCALE:
-            output->output_size = size.width * size.height;
-            break;
         case SCE_JPEG_COLORSPACE_YUV444:
-            output->output_size = size.width * size.height * 3;
             output->pitch[1] = output->pitch[0];
             output->pitch[2] = output->pitch[0];
             break;
         case SCE_JPEG_COLORSPACE_YUV422:
-            output->output_size = size.width * size.height * 2;
             output->pitch[1] = {
                 .x = size.width / 2,
                 .y = size.height
@@ -234,30 +335,26 @@ EXPORT(int, sceJpegGetOutputInfo, const uint8_t *pJpeg, SceSize isize,
             output->pitch[2] = output->pitch[1];
             break;
         case SCE_JPEG_COLORSPACE_YUV420:
-            output->output_size = size.width * size.height * 3 / 2;
             output->pitch[1] = {
                 .x = size.width / 2,
                 .y = size.height / 2
             };
             output->pitch[2] = output->pitch[1];
             break;
+        default:
+            break;
         }
     }
 
-    if (decodeMode & SCE_JPEG_MJPEG_DOWNSCALE_ANY)
-        return STUBBED("JPEG downscaling is not implemented");
-
     return 0;
 }
 
 EXPORT(int, sceJpegInitMJpeg, int maxSplitDecoder) {
     TRACY_FUNC(sceJpegInitMJpeg, maxSplitDecoder);
-    if (maxSplitDecoder > 0)
-        STUBBED("Ignoring non-zero maxSplitDecoder parameter");
-
     emuenv.kernel.obj_store.create<MJpegState>();
     const auto state = emuenv.kernel.obj_store.get<MJpegState>();
     state->decoder = std::make_shared<MjpegDecoderState>();
+    state->max_split_decoders = std::max(maxSplitDecoder, 0);
 
     return 0;
 }
@@ -271,29 +368,79 @@ EXPORT(int, sceJpegMJpegCsc, uint8_t *pRGBA, const uint8_t *pYCbCr,
     uint32_t xysize, int iFrameWidth, int colorOption, int sampling) {
     TRACY_FUNC(sceJpegMJpegCsc, pRGBA, pYCbCr, xysize, iFrameWidth, colorOption, sampling);
 
-    if (colorOption & SCE_JPEG_COLORSPACE_BT601) {
-        STUBBED("Unhandled BT601 color conversion");
-        colorOption &= ~SCE_JPEG_COLORSPACE_BT601;
-    }
-
-    if (colorOption != SCE_JPEG_PIXEL_RGBA8888 && colorOption != SCE_JPEG_PIXEL_BGRA8888)
+    const bool bt601 = colorOption & SCE_JPEG_COLORSPACE_BT601;
+    const int format = colorOption & ~SCE_JPEG_COLORSPACE_BT601;
+    if (format != SCE_JPEG_PIXEL_RGBA8888 && format != SCE_JPEG_PIXEL_BGRA8888)
         return RET_ERROR(SCE_JPEG_ERROR_INVALID_COLOR_FORMAT);
 
-    if (colorOption == SCE_JPEG_PIXEL_BGRA8888)
-        return STUBBED("SCE_JPEG_PIXEL_BGRA8888 is not implemented");
+    const DecoderColorSpace color_space = convert_color_space_jpeg_to_decoder(static_cast<SceJpegColorSpace>(SCE_JPEG_COLORSPACE_YUV | sampling));
+    if (color_space == COLORSPACE_UNKNOWN)
+        return RET_ERROR(SCE_JPEG_ERROR_UNSUPPORT_SAMPLING);
 
     uint32_t width = xysize >> 16;
     uint32_t height = xysize & 0xFFFF;
 
-    if (width != iFrameWidth)
-        STUBBED("Mismatch between width and frameWidth, image will look corrupted");
+    if (width > static_cast<uint32_t>(iFrameWidth)) {
+        STUBBED("Frame width is smaller than the image width, using the image width as pitch");
+        iFrameWidth = width;
+    }
+
+    // Planes are stored one after the other, chroma being subsampled according to the sampling
+    const uint32_t chroma_width = color_space == COLORSPACE_YUV444P ? width : (width + 1) / 2;
+    const uint32_t chroma_height = color_space == COLORSPACE_YUV420P ? (height + 1) / 2 : height;
+    const uint8_t *planes[] = {
+        pYCbCr,
+        pYCbCr + width * height,
+        pYCbCr + width * height + chroma_width * chroma_height,
+    };
+    const uint32_t strides[] = { width, chroma_width, chroma_width };
 
-    convert_yuv_to_rgb(pYCbCr, pRGBA, width, height, convert_color_space_jpeg_to_decoder(static_cast<SceJpegColorSpace>(SCE_JPEG_COLORSPACE_YUV | sampling)));
+    convert_ycbcr_to_rgba(planes, strides, pRGBA, iFrameWidth, width, height, color_space, bt601, format == SCE_JPEG_PIXEL_BGRA8888);
 
     return 0;
 }
 
-EXPORT(int, sceJpegSplitDecodeMJpeg) {
-    TRACY_FUNC(sceJpegSplitDecodeMJpeg);
-    return UNIMPLEMENTED();
+EXPORT(int, sceJpegSplitDecodeMJpeg, Ptr<SceJpegSplitDecodeCtrl> pCtrl) {
+    TRACY_FUNC(sceJpegSplitDecodeMJpeg, pCtrl);
+    const auto state = emuenv.kernel.obj_store.get<MJpegState>();
+
+    const auto decoder = state->split_decoders.find(pCtrl.address());
+    if (decoder == state->split_decoders.end())
+        return RET_ERROR(SCE_JPEG_ERROR_INVALID_STATE);
+
+    if (!is_valid_guest_range(emuenv.mem, pCtrl.address(), sizeof(SceJpegSplitDecodeCtrl)))
+        return RET_ERROR(SCE_JPEG_ERROR_INVALID_POINTER);
+
+    // Everything given by the title is checked before any guest memory is accessed
+    const SceJpegSplitDecodeCtrl *ctrl = pCtrl.get(emuenv.mem);
+    if (!is_valid_split_decode_ctrl(*ctrl))
+        return RET_ERROR(SCE_JPEG_ERROR_INVALID_STATE);
+    if (ctrl->streamSize && !is_valid_guest_range(emuenv.mem, ctrl->pStream.address(), ctrl->streamSize))
+        return RET_ERROR(SCE_JPEG_ERROR_INVALID_POINTER);
+    if (ctrl->isEndOfStream) {
+        if (!ctrl->pYCbCr)
+            return RET_ERROR(SCE_JPEG_ERROR_INVALID_POINTER);
+        if (!ctrl->outputSize || (decoder->second.stream.empty() && !ctrl->streamSize))
+            return RET_ERROR(SCE_JPEG_ERROR_INVALID_DATA_SIZE);
+        if (!is_valid_guest_range(emuenv.mem, ctrl->pYCbCr.address(), ctrl->outputSize))
+            return RET_ERROR(SCE_JPEG_ERROR_INVALID_POINTER);
+    }
+
+    if (ctrl->streamSize) {
+        const uint8_t *stream = ctrl->pStream.get(emuenv.mem);
+        decoder->second.stream.insert(decoder->second.stream.end(), stream, stream + ctrl->streamSize);
+    }
+
+    // Stream pieces are gathered until the last one comes in, the image is then decoded at once
+    if (!ctrl->isEndOfStream)
+        return SCE_JPEG_ERROR_INPUT_SUSPENDED;
+
+    std::vector<uint8_t> stream = std::move(decoder->second.stream);
+    decoder->second.stream.clear();
+
+    const int result = decode_ycbcr(*state, stream.data(), static_cast<SceSize>(stream.size()), ctrl->pYCbCr.get(emuenv.mem), ctrl->outputSize, ctrl->decodeMode);
+    if (result < 0)
+        return RET_ERROR(result);
+
+    return result;
 }
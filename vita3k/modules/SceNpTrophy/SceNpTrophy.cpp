@@ -166,6 +166,10 @@ EXPORT(int, sceNpTrophyCreateContext, np::trophy::ContextHandle *context, const
             return SCE_NP_TROPHY_ERROR_TRP_FILE_NOT_FOUND;
         }
 
+        case np::NpTrophyError::TROPHY_CONTEXT_FILE_INVALID: {
+            return SCE_NP_TROPHY_ERROR_INVALID_TRP_FILE_FORMAT;
+        }
+
         default:
             break;
         }
@@ -526,14 +530,9 @@ static int do_trophy_callback(EmuEnvState &emuenv, np::trophy::Context *context,
 
     // Call this async.
     if (emuenv.np.trophy_state.trophy_unlock_callback) {
-        uint32_t buf_size = 0;
-
-        // Make filename
+        // The archive is already in memory, the PNG is only decoded once the gui shows it
         const std::string trophy_icon_filename = fmt::format("TROP{:0>3d}.PNG", trophy_id);
-        context->copy_file_data_from_trophy_file(trophy_icon_filename.c_str(), nullptr, &buf_size);
-
-        callback_data.icon_buf.resize(buf_size);
-        context->copy_file_data_from_trophy_file(trophy_icon_filename.c_str(), &callback_data.icon_buf[0], &buf_size);
+        context->get_trophy_file_data(trophy_icon_filename.c_str(), callback_data.icon_buf);
 
         emuenv.np.trophy_state.trophy_unlock_callback(callback_data);
     }
@@ -17,134 +17,560 @@
 
 #include <module/module.h>
 
-EXPORT(int, sceSasCore) {
-    return UNIMPLEMENTED();
-}
+#include <modules/module_parent.h>
+
+#include <codec/sas.h>
+#include <kernel/state.h>
+#include <util/tracy.h>
+
+#include <cstring>
+#include <mutex>
+
+TRACY_MODULE_NAME(SceSas);
+
+enum SceSasErrorCode : uint32_t {
+    SCE_SAS_ERROR_INVALID_OUTPUT_MODE = 0x80420001,
+    SCE_SAS_ERROR_INVALID_MAX_VOICES = 0x80420002,
+    SCE_SAS_ERROR_INVALID_GRAIN = 0x80420003,
+    SCE_SAS_ERROR_INVALID_SAMPLE_RATE = 0x80420004,
+    SCE_SAS_ERROR_ADDRESS = 0x80420005,
+    SCE_SAS_ERROR_INVALID_VOICE = 0x80420010,
+    SCE_SAS_ERROR_INVALID_NOISE_CLOCK = 0x80420011,
+    SCE_SAS_ERROR_INVALID_PITCH = 0x80420012,
+    SCE_SAS_ERROR_INVALID_ADSR_CURVE_MODE = 0x80420013,
+    SCE_SAS_ERROR_INVALID_PARAMETER = 0x80420014,
+    SCE_SAS_ERROR_INVALID_LOOP_POS = 0x80420015,
+    SCE_SAS_ERROR_VOICE_PAUSED = 0x80420016,
+    SCE_SAS_ERROR_INVALID_VOLUME = 0x80420018,
+    SCE_SAS_ERROR_INVALID_ADSR_RATE = 0x80420019,
+    SCE_SAS_ERROR_INVALID_PCM_SIZE = 0x8042001A,
+    SCE_SAS_ERROR_REV_INVALID_TYPE = 0x80420020,
+    SCE_SAS_ERROR_REV_INVALID_FEEDBACK = 0x80420021,
+    SCE_SAS_ERROR_REV_INVALID_DELAY_TIME = 0x80420022,
+    SCE_SAS_ERROR_REV_INVALID_VOLUME = 0x80420023,
+    SCE_SAS_ERROR_NOT_INIT = 0x80420100,
+    SCE_SAS_ERROR_ALREADY_INIT = 0x80420101,
+};
+
+constexpr uint32_t SCE_SAS_DEFAULT_GRAIN = 256;
+constexpr uint32_t SCE_SAS_SAMPLE_RATE = 48000;
+constexpr uint32_t SCE_SAS_PCM_MIN_SIZE = 0x10;
+constexpr uint32_t SCE_SAS_PCM_MAX_SIZE = 0x10000;
+constexpr uint32_t SCE_SAS_EFFECT_PARAM_MAX = 0x7F;
+
+struct SasState {
+    std::mutex mutex;
+    bool initialized = false;
+    Ptr<void> buffer;
+    SceSize buffer_size = 0;
+    SasCore core;
+};
+
+LIBRARY_INIT(SceSas) {
+    emuenv.kernel.obj_store.create<SasState>();
+}
+
+struct SasConfig {
+    uint32_t voice_count = SAS_MAX_VOICES;
+    uint32_t grain = SCE_SAS_DEFAULT_GRAIN;
+    SasOutputMode output_mode = SAS_OUTPUT_STEREO;
+};
+
+// The configuration is a list of options, "-v 16 -g 512 -o 1" for 16 voices, a grain of 512 and the multichannel output.
+// Unknown options are skipped
+static SasConfig parse_config(const char *config) {
+    SasConfig result;
+    if (!config)
+        return result;
+
+    const char *current = config;
+    while (*current) {
+        if (current[0] != '-' || !current[1]) {
+            current++;
+            continue;
+        }
+
+        const char option = current[1];
+        char *end = nullptr;
+        const unsigned long value = std::strtoul(current + 2, &end, 0);
+        if (end == current + 2) {
+            current += 2;
+            continue;
+        }
+
+        switch (option) {
+        case 'v': result.voice_count = static_cast<uint32_t>(value); break;
+        case 'g': result.grain = static_cast<uint32_t>(value); break;
+        case 'o': result.output_mode = static_cast<SasOutputMode>(value); break;
+        default: break;
+        }
+        current = end;
+    }
+
+    return result;
+}
+
+static SceInt32 check_config(const char *export_name, const SasConfig &config) {
+    if (config.voice_count == 0 || config.voice_count > SAS_MAX_VOICES)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_MAX_VOICES);
+    if (config.grain < SAS_MIN_GRAIN || config.grain > SAS_MAX_GRAIN || (config.grain & 0x1F) != 0)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_GRAIN);
+    if (config.output_mode != SAS_OUTPUT_STEREO && config.output_mode != SAS_OUTPUT_MULTI)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_OUTPUT_MODE);
+
+    return 0;
+}
+
+// Memory the library would need on hardware, nothing is stored in it here
+static SceSize get_needed_memory_size(const SasConfig &config) {
+    return 0x1000 + config.voice_count * 0x400 + config.grain * 4 * sizeof(int32_t);
+}
+
+static SceInt32 init_sas(EmuEnvState &emuenv, const char *export_name, const SasConfig &config, Ptr<void> buffer, SceSize buffer_size) {
+    const SceInt32 res = check_config(export_name, config);
+    if (res < 0)
+        return res;
+
+    if (!buffer)
+        return RET_ERROR(SCE_SAS_ERROR_ADDRESS);
+    if (buffer_size < get_needed_memory_size(config))
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_PARAMETER);
+
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (state->initialized)
+        return RET_ERROR(SCE_SAS_ERROR_ALREADY_INIT);
+
+    state->core.init(config.grain, config.voice_count, config.output_mode, SCE_SAS_SAMPLE_RATE);
+    state->buffer = buffer;
+    state->buffer_size = buffer_size;
+    state->initialized = true;
+
+    return 0;
+}
+
+// Check the library is initialized and the voice exists, then run the function on it with the lock held
+template <typename F>
+static SceInt32 with_voice(EmuEnvState &emuenv, const char *export_name, SceInt32 voice_num, F &&func) {
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->initialized)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+    if (voice_num < 0 || static_cast<uint32_t>(voice_num) >= state->core.voice_count)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_VOICE);
 
-EXPORT(int, sceSasCoreWithMix) {
-    return UNIMPLEMENTED();
+    return func(state->core.voices[voice_num]);
 }
 
-EXPORT(int, sceSasExit) {
-    return UNIMPLEMENTED();
-}
+EXPORT(SceInt32, sceSasCore, Ptr<SceInt16> out) {
+    TRACY_FUNC(sceSasCore, out);
+    if (!out)
+        return RET_ERROR(SCE_SAS_ERROR_ADDRESS);
 
-EXPORT(int, sceSasGetDryPeak) {
-    return UNIMPLEMENTED();
-}
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->initialized)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
 
-EXPORT(int, sceSasGetEndState) {
-    return UNIMPLEMENTED();
+    state->core.process(out.get(emuenv.mem));
+    return 0;
 }
 
-EXPORT(int, sceSasGetEnvelope) {
-    return UNIMPLEMENTED();
-}
+EXPORT(SceInt32, sceSasCoreWithMix, Ptr<SceInt16> in_out, SceInt32 left_volume, SceInt32 right_volume) {
+    TRACY_FUNC(sceSasCoreWithMix, in_out, left_volume, right_volume);
+    if (!in_out)
+        return RET_ERROR(SCE_SAS_ERROR_ADDRESS);
+    if (std::abs(left_volume) > SAS_VOLUME_MAX || std::abs(right_volume) > SAS_VOLUME_MAX)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_VOLUME);
 
-EXPORT(int, sceSasGetGrain) {
-    return UNIMPLEMENTED();
-}
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->initialized)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
 
-EXPORT(int, sceSasGetNeededMemorySize) {
-    return UNIMPLEMENTED();
+    state->core.process(in_out.get(emuenv.mem), true, left_volume, right_volume);
+    return 0;
 }
 
-EXPORT(int, sceSasGetOutputmode) {
-    return UNIMPLEMENTED();
-}
+EXPORT(SceInt32, sceSasExit, Ptr<Ptr<void>> out_buffer, Ptr<SceSize> out_buffer_size) {
+    TRACY_FUNC(sceSasExit, out_buffer, out_buffer_size);
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->initialized)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
 
-EXPORT(int, sceSasGetPauseState) {
-    return UNIMPLEMENTED();
-}
+    if (out_buffer)
+        *out_buffer.get(emuenv.mem) = state->buffer;
+    if (out_buffer_size)
+        *out_buffer_size.get(emuenv.mem) = state->buffer_size;
 
-EXPORT(int, sceSasGetPreMasterPeak) {
-    return UNIMPLEMENTED();
-}
+    state->initialized = false;
+    state->buffer = Ptr<void>();
+    state->buffer_size = 0;
 
-EXPORT(int, sceSasGetWetPeak) {
-    return UNIMPLEMENTED();
+    return 0;
 }
 
-EXPORT(int, sceSasInit) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasGetDryPeak, SceInt32 voice_num) {
+    TRACY_FUNC(sceSasGetDryPeak, voice_num);
+    return with_voice(emuenv, export_name, voice_num, [](SasVoice &voice) {
+        return static_cast<SceInt32>(voice.dry_peak);
+    });
 }
 
-EXPORT(int, sceSasInitWithGrain) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasGetEndState, SceInt32 voice_num) {
+    TRACY_FUNC(sceSasGetEndState, voice_num);
+    return with_voice(emuenv, export_name, voice_num, [](SasVoice &voice) {
+        return static_cast<SceInt32>(voice.ended);
+    });
 }
 
-EXPORT(int, sceSasSetADSR) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasGetEnvelope, SceInt32 voice_num) {
+    TRACY_FUNC(sceSasGetEnvelope, voice_num);
+    return with_voice(emuenv, export_name, voice_num, [](SasVoice &voice) {
+        return voice.envelope.height;
+    });
 }
 
-EXPORT(int, sceSasSetADSRmode) {
-    return UNIMPLEMENTED();
-}
+EXPORT(SceInt32, sceSasGetGrain) {
+    TRACY_FUNC(sceSasGetGrain);
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->initialized)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
 
-EXPORT(int, sceSasSetDistortion) {
-    return UNIMPLEMENTED();
+    return static_cast<SceInt32>(state->core.grain);
 }
 
-EXPORT(int, sceSasSetEffect) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasGetNeededMemorySize, const char *config, Ptr<SceSize> out_size) {
+    TRACY_FUNC(sceSasGetNeededMemorySize, config, out_size);
+    if (!out_size)
+        return RET_ERROR(SCE_SAS_ERROR_ADDRESS);
+
+    const SasConfig sas_config = parse_config(config);
+    const SceInt32 res = check_config(export_name, sas_config);
+    if (res < 0)
+        return res;
+
+    *out_size.get(emuenv.mem) = get_needed_memory_size(sas_config);
+    return 0;
 }
 
-EXPORT(int, sceSasSetEffectParam) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasGetOutputmode) {
+    TRACY_FUNC(sceSasGetOutputmode);
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->initialized)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    return static_cast<SceInt32>(state->core.output_mode);
 }
 
-EXPORT(int, sceSasSetEffectType) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasGetPauseState, SceInt32 voice_num) {
+    TRACY_FUNC(sceSasGetPauseState, voice_num);
+    return with_voice(emuenv, export_name, voice_num, [](SasVoice &voice) {
+        return static_cast<SceInt32>(voice.paused);
+    });
 }
 
-EXPORT(int, sceSasSetEffectVolume) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasGetPreMasterPeak) {
+    TRACY_FUNC(sceSasGetPreMasterPeak);
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->initialized)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    return static_cast<SceInt32>(state->core.premaster_peak);
 }
 
-EXPORT(int, sceSasSetGrain) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasGetWetPeak, SceInt32 voice_num) {
+    TRACY_FUNC(sceSasGetWetPeak, voice_num);
+    return with_voice(emuenv, export_name, voice_num, [](SasVoice &voice) {
+        return static_cast<SceInt32>(voice.wet_peak);
+    });
 }
 
-EXPORT(int, sceSasSetKeyOff) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasInit, const char *config, Ptr<void> buffer, SceSize buffer_size) {
+    TRACY_FUNC(sceSasInit, config, buffer, buffer_size);
+    return init_sas(emuenv, export_name, parse_config(config), buffer, buffer_size);
 }
 
-EXPORT(int, sceSasSetKeyOn) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasInitWithGrain, const char *config, SceUInt32 grain, Ptr<void> buffer, SceSize buffer_size) {
+    TRACY_FUNC(sceSasInitWithGrain, config, grain, buffer, buffer_size);
+    SasConfig sas_config = parse_config(config);
+    sas_config.grain = grain;
+
+    return init_sas(emuenv, export_name, sas_config, buffer, buffer_size);
 }
 
-EXPORT(int, sceSasSetNoise) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetADSR, SceInt32 voice_num, SceUInt32 flag, SceInt32 attack, SceInt32 decay, SceInt32 sustain, SceInt32 release) {
+    TRACY_FUNC(sceSasSetADSR, voice_num, flag, attack, decay, sustain, release);
+    if (((flag & SAS_ENVELOPE_ATTACK) && attack < 0) || ((flag & SAS_ENVELOPE_DECAY) && decay < 0)
+        || ((flag & SAS_ENVELOPE_SUSTAIN) && sustain < 0) || ((flag & SAS_ENVELOPE_RELEASE) && release < 0))
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_ADSR_RATE);
+
+    return with_voice(emuenv, export_name, voice_num, [&](SasVoice &voice) {
+        if (flag & SAS_ENVELOPE_ATTACK)
+            voice.envelope.attack_rate = attack;
+        if (flag & SAS_ENVELOPE_DECAY)
+            voice.envelope.decay_rate = decay;
+        if (flag & SAS_ENVELOPE_SUSTAIN)
+            voice.envelope.sustain_rate = sustain;
+        if (flag & SAS_ENVELOPE_RELEASE)
+            voice.envelope.release_rate = release;
+        return 0;
+    });
 }
 
-EXPORT(int, sceSasSetOutputmode) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetADSRmode, SceInt32 voice_num, SceUInt32 flag, SceUInt32 attack, SceUInt32 decay, SceUInt32 sustain, SceUInt32 release) {
+    TRACY_FUNC(sceSasSetADSRmode, voice_num, flag, attack, decay, sustain, release);
+    // the attack has to go up and the decay and release down
+    const auto is_increase = [](SceUInt32 curve) {
+        return curve == SAS_CURVE_LINEAR_INCREASE || curve == SAS_CURVE_LINEAR_BENT || curve == SAS_CURVE_EXPONENT_INCREASE || curve == SAS_CURVE_DIRECT;
+    };
+    const auto is_decrease = [](SceUInt32 curve) {
+        return curve == SAS_CURVE_LINEAR_DECREASE || curve == SAS_CURVE_EXPONENT_DECREASE || curve == SAS_CURVE_DIRECT;
+    };
+    if (((flag & SAS_ENVELOPE_ATTACK) && !is_increase(attack)) || ((flag & SAS_ENVELOPE_DECAY) && !is_decrease(decay))
+        || ((flag & SAS_ENVELOPE_SUSTAIN) && sustain > SAS_CURVE_DIRECT) || ((flag & SAS_ENVELOPE_RELEASE) && !is_decrease(release)))
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_ADSR_CURVE_MODE);
+
+    return with_voice(emuenv, export_name, voice_num, [&](SasVoice &voice) {
+        if (flag & SAS_ENVELOPE_ATTACK)
+            voice.envelope.attack_curve = static_cast<SasEnvelopeCurve>(attack);
+        if (flag & SAS_ENVELOPE_DECAY)
+            voice.envelope.decay_curve = static_cast<SasEnvelopeCurve>(decay);
+        if (flag & SAS_ENVELOPE_SUSTAIN)
+            voice.envelope.sustain_curve = static_cast<SasEnvelopeCurve>(sustain);
+        if (flag & SAS_ENVELOPE_RELEASE)
+            voice.envelope.release_curve = static_cast<SasEnvelopeCurve>(release);
+        return 0;
+    });
 }
 
-EXPORT(int, sceSasSetPause) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetDistortion, SceInt32 voice_num, SceInt32 distortion) {
+    TRACY_FUNC(sceSasSetDistortion, voice_num, distortion);
+    if (distortion < 0 || distortion > SAS_VOLUME_MAX)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_PARAMETER);
+
+    return with_voice(emuenv, export_name, voice_num, [&](SasVoice &voice) {
+        voice.distortion = distortion;
+        return 0;
+    });
 }
 
-EXPORT(int, sceSasSetPitch) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetEffect, SceInt32 dry_switch, SceInt32 wet_switch) {
+    TRACY_FUNC(sceSasSetEffect, dry_switch, wet_switch);
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->initialized)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    state->core.dry_enabled = dry_switch != 0;
+    state->core.wet_enabled = wet_switch != 0;
+    return 0;
+}
+
+EXPORT(SceInt32, sceSasSetEffectParam, SceUInt32 delay_time, SceUInt32 feedback) {
+    TRACY_FUNC(sceSasSetEffectParam, delay_time, feedback);
+    if (delay_time > SCE_SAS_EFFECT_PARAM_MAX)
+        return RET_ERROR(SCE_SAS_ERROR_REV_INVALID_DELAY_TIME);
+    if (feedback > SCE_SAS_EFFECT_PARAM_MAX)
+        return RET_ERROR(SCE_SAS_ERROR_REV_INVALID_FEEDBACK);
+
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->initialized)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    state->core.effect_delay = delay_time;
+    state->core.effect_feedback = feedback;
+    return 0;
+}
+
+EXPORT(SceInt32, sceSasSetEffectType, SceInt32 type) {
+    TRACY_FUNC(sceSasSetEffectType, type);
+    if (type < static_cast<SceInt32>(SasEffectType::Off) || type > static_cast<SceInt32>(SasEffectType::Pipe))
+        return RET_ERROR(SCE_SAS_ERROR_REV_INVALID_TYPE);
+
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->initialized)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    state->core.set_effect_type(static_cast<SasEffectType>(type));
+    return 0;
+}
+
+EXPORT(SceInt32, sceSasSetEffectVolume, SceInt32 left_volume, SceInt32 right_volume) {
+    TRACY_FUNC(sceSasSetEffectVolume, left_volume, right_volume);
+    if (std::abs(left_volume) > SAS_VOLUME_MAX || std::abs(right_volume) > SAS_VOLUME_MAX)
+        return RET_ERROR(SCE_SAS_ERROR_REV_INVALID_VOLUME);
+
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->initialized)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    state->core.effect_volume_left = left_volume;
+    state->core.effect_volume_right = right_volume;
+    return 0;
+}
+
+EXPORT(SceInt32, sceSasSetGrain, SceUInt32 grain) {
+    TRACY_FUNC(sceSasSetGrain, grain);
+    if (grain < SAS_MIN_GRAIN || grain > SAS_MAX_GRAIN || (grain & 0x1F) != 0)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_GRAIN);
+
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->initialized)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    state->core.grain = grain;
+    return 0;
+}
+
+EXPORT(SceInt32, sceSasSetKeyOff, SceInt32 voice_num) {
+    TRACY_FUNC(sceSasSetKeyOff, voice_num);
+    return with_voice(emuenv, export_name, voice_num, [&](SasVoice &voice) {
+        if (voice.paused)
+            return RET_ERROR(SCE_SAS_ERROR_VOICE_PAUSED);
+
+        voice.key_off();
+        return 0;
+    });
 }
 
-EXPORT(int, sceSasSetSL) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetKeyOn, SceInt32 voice_num) {
+    TRACY_FUNC(sceSasSetKeyOn, voice_num);
+    return with_voice(emuenv, export_name, voice_num, [&](SasVoice &voice) {
+        if (voice.paused)
+            return RET_ERROR(SCE_SAS_ERROR_VOICE_PAUSED);
+
+        voice.key_on();
+        return 0;
+    });
 }
 
-EXPORT(int, sceSasSetSimpleADSR) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetNoise, SceInt32 voice_num, SceUInt32 noise_clock) {
+    TRACY_FUNC(sceSasSetNoise, voice_num, noise_clock);
+    if (noise_clock > SAS_NOISE_CLOCK_MAX)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_NOISE_CLOCK);
+
+    return with_voice(emuenv, export_name, voice_num, [&](SasVoice &voice) {
+        voice.type = SasVoiceType::Noise;
+        voice.noise_clock = noise_clock;
+        voice.data = nullptr;
+        voice.size = 0;
+        return 0;
+    });
 }
 
-EXPORT(int, sceSasSetVoice) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetOutputmode, SceUInt32 output_mode) {
+    TRACY_FUNC(sceSasSetOutputmode, output_mode);
+    if (output_mode != SAS_OUTPUT_STEREO && output_mode != SAS_OUTPUT_MULTI)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_OUTPUT_MODE);
+
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->initialized)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    state->core.output_mode = static_cast<SasOutputMode>(output_mode);
+    return 0;
 }
 
-EXPORT(int, sceSasSetVoicePCM) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetPause, SceInt32 voice_num, SceUInt32 pause_flag) {
+    TRACY_FUNC(sceSasSetPause, voice_num, pause_flag);
+    return with_voice(emuenv, export_name, voice_num, [&](SasVoice &voice) {
+        voice.paused = pause_flag != 0;
+        return 0;
+    });
 }
 
-EXPORT(int, sceSasSetVolume) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetPitch, SceInt32 voice_num, SceInt32 pitch) {
+    TRACY_FUNC(sceSasSetPitch, voice_num, pitch);
+    if (pitch <= 0 || pitch > SAS_PITCH_MAX)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_PITCH);
+
+    return with_voice(emuenv, export_name, voice_num, [&](SasVoice &voice) {
+        voice.pitch = pitch;
+        return 0;
+    });
+}
+
+EXPORT(SceInt32, sceSasSetSL, SceInt32 voice_num, SceInt32 sustain_level) {
+    TRACY_FUNC(sceSasSetSL, voice_num, sustain_level);
+    if (sustain_level < 0 || sustain_level > SAS_ENVELOPE_HEIGHT_MAX)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_PARAMETER);
+
+    return with_voice(emuenv, export_name, voice_num, [&](SasVoice &voice) {
+        voice.envelope.sustain_level = sustain_level;
+        return 0;
+    });
+}
+
+EXPORT(SceInt32, sceSasSetSimpleADSR, SceInt32 voice_num, SceUInt32 adsr1, SceUInt32 adsr2) {
+    TRACY_FUNC(sceSasSetSimpleADSR, voice_num, adsr1, adsr2);
+    return with_voice(emuenv, export_name, voice_num, [&](SasVoice &voice) {
+        voice.envelope.set_simple(adsr1 & 0xFFFF, adsr2 & 0xFFFF);
+        return 0;
+    });
+}
+
+// Point the voice to new data, a playing voice restarts from the beginning of it
+static void set_voice_data(SasVoice &voice, SasVoiceType type, const uint8_t *data, uint32_t size, bool loop, uint32_t loop_start) {
+    voice.type = type;
+    voice.data = data;
+    voice.size = size;
+    voice.loop = loop;
+    voice.loop_start = loop_start;
+
+    voice.position = 0;
+    voice.block_index = 28;
+    voice.source_ended = false;
+}
+
+EXPORT(SceInt32, sceSasSetVoice, SceInt32 voice_num, Ptr<const uint8_t> vag_buffer, SceSize size, SceUInt32 loop_flag) {
+    TRACY_FUNC(sceSasSetVoice, voice_num, vag_buffer, size, loop_flag);
+    if (!vag_buffer)
+        return RET_ERROR(SCE_SAS_ERROR_ADDRESS);
+    if (size == 0 || (size & 0xF) != 0 || loop_flag > 1)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_PARAMETER);
+
+    return with_voice(emuenv, export_name, voice_num, [&](SasVoice &voice) {
+        set_voice_data(voice, SasVoiceType::Vag, vag_buffer.get(emuenv.mem), size, loop_flag != 0, 0);
+        return 0;
+    });
+}
+
+EXPORT(SceInt32, sceSasSetVoicePCM, SceInt32 voice_num, Ptr<const int16_t> pcm_buffer, SceSize size, SceInt32 loop_position) {
+    TRACY_FUNC(sceSasSetVoicePCM, voice_num, pcm_buffer, size, loop_position);
+    if (!pcm_buffer)
+        return RET_ERROR(SCE_SAS_ERROR_ADDRESS);
+    if (size < SCE_SAS_PCM_MIN_SIZE || size > SCE_SAS_PCM_MAX_SIZE)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_PCM_SIZE);
+    if (loop_position < -1 || loop_position >= static_cast<SceInt32>(size))
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_LOOP_POS);
+
+    return with_voice(emuenv, export_name, voice_num, [&](SasVoice &voice) {
+        const auto *data = reinterpret_cast<const uint8_t *>(pcm_buffer.get(emuenv.mem));
+        set_voice_data(voice, SasVoiceType::Pcm, data, size, loop_position != -1, std::max(loop_position, 0));
+        return 0;
+    });
+}
+
+EXPORT(SceInt32, sceSasSetVolume, SceInt32 voice_num, SceInt32 left, SceInt32 right, SceInt32 wet_left, SceInt32 wet_right) {
+    TRACY_FUNC(sceSasSetVolume, voice_num, left, right, wet_left, wet_right);
+    if (std::abs(left) > SAS_VOLUME_MAX || std::abs(right) > SAS_VOLUME_MAX || std::abs(wet_left) > SAS_VOLUME_MAX || std::abs(wet_right) > SAS_VOLUME_MAX)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_VOLUME);
+
+    return with_voice(emuenv, export_name, voice_num, [&](SasVoice &voice) {
+        voice.volume_left = left;
+        voice.volume_right = right;
+        voice.wet_volume_left = wet_left;
+        voice.wet_volume_right = wet_right;
+        return 0;
+    });
 }
@@ -16,93 +16,514 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 #include <module/module.h>
+#include <modules/module_parent.h>
+
+#include <cpu/functions.h>
+#include <kernel/state.h>
+#include <kernel/ult.h>
+
+#include <map>
+#include <set>
+#include <thread>
+#include <vector>
+
+enum SceUltErrorCode : uint32_t {
+    SCE_ULT_OK = 0,
+    SCE_ULT_ERROR_NULL = 0x80570001,
+    SCE_ULT_ERROR_ALIGNMENT = 0x80570002,
+    SCE_ULT_ERROR_RANGE = 0x80570003,
+    SCE_ULT_ERROR_INVALID = 0x80570004,
+    SCE_ULT_ERROR_PERMISSION = 0x80570005,
+    SCE_ULT_ERROR_STATE = 0x80570006,
+    SCE_ULT_ERROR_BUSY = 0x80570007,
+    SCE_ULT_ERROR_AGAIN = 0x80570008,
+    SCE_ULT_ERROR_FATAL = 0x80570009,
+};
+
+// NIDs of sceUltUlthreadYield and sceUltUlthreadExit, called from the stubs below
+constexpr uint32_t ULT_YIELD_NID = 0xCAD57BAD;
+constexpr uint32_t ULT_EXIT_NID = 0x1E401DF8;
+
+// The guest objects are only used as keys, all their state is kept here.
+// Work areas given by the application are not used either.
+struct UltState {
+    std::mutex mutex;
+    // shared by all runtimes and never freed, a worker may still enter it while its runtime is destroyed
+    Address stubs = 0;
+    std::map<Address, std::shared_ptr<ult::Runtime>> runtimes;
+    std::map<SceUID, ult::Worker *> workers;
+    std::map<Address, std::unique_ptr<ult::Ulthread>> ulthreads;
+    std::set<Address> waiting_queue_pools;
+    std::map<Address, std::unique_ptr<ult::Mutex>> mutexes;
+    std::map<Address, std::unique_ptr<ult::ConditionVariable>> condition_variables;
+    std::map<Address, std::unique_ptr<ult::Semaphore>> semaphores;
+    std::map<Address, std::unique_ptr<ult::ReaderWriterLock>> rwlocks;
+    std::map<Address, std::unique_ptr<ult::QueueDataPool>> queue_data_pools;
+    std::map<Address, std::unique_ptr<ult::Queue>> queues;
+
+    ~UltState() {
+        std::vector<std::thread> host_threads;
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            for (auto &[address, runtime] : runtimes) {
+                runtime->shutdown = true;
+                runtime->ready_cond.notify_all();
+                for (const auto &worker : runtime->workers)
+                    host_threads.push_back(std::move(worker->host_thread));
+            }
+        }
+
+        for (std::thread &host_thread : host_threads)
+            host_thread.join();
+    }
+};
+
+LIBRARY_INIT(SceUlt) {
+    emuenv.kernel.obj_store.create<UltState>();
+}
+
+template <typename T>
+static T *find_object(const std::map<Address, std::unique_ptr<T>> &objects, Address address) {
+    const auto it = objects.find(address);
+    if (it == objects.end())
+        return nullptr;
+
+    return it->second.get();
+}
+
+// The thread calling a SceUlt function: a ulthread running on a worker, or a plain kernel thread
+struct UltCaller {
+    ult::Worker *worker = nullptr;
+    ult::Owner owner;
+    ult::Waiter *waiter;
+
+    ult::Waiter kernel_waiter;
+    std::condition_variable kernel_cond;
+
+    UltCaller(UltState &state, SceUID thread_id) {
+        const auto it = state.workers.find(thread_id);
+        if (it != state.workers.end() && it->second->current)
+            worker = it->second;
+
+        if (worker) {
+            ult::Ulthread *ulthread = worker->current;
+            owner = ulthread->address;
+            waiter = &ulthread->waiter;
+            *waiter = ult::Waiter{};
+            waiter->ulthread = ulthread;
+        } else {
+            owner = ult::kernel_thread_owner(thread_id);
+            waiter = &kernel_waiter;
+            waiter->cond = &kernel_cond;
+        }
+        waiter->owner = owner;
+    }
+
+    ult::Ulthread *ulthread() const {
+        return worker ? worker->current : nullptr;
+    }
+};
+
+// Load the next ready ulthread on the worker, or go back to its dispatch context if there is none.
+// The export return value is written to r0, so the r0 of the loaded context is returned.
+static int run_next_ulthread(ult::Worker &worker) {
+    CPUState &cpu = *worker.thread->cpu;
+    ult::Ulthread *next = ult::pop_ready(*worker.runtime);
+    worker.current = next;
+
+    if (!next) {
+        load_context(cpu, worker.dispatch_context);
+        return worker.dispatch_context.cpu_registers[0];
+    }
+
+    if (!next->started) {
+        next->started = true;
+        next->context = worker.dispatch_context;
+        next->context.cpu_registers = {};
+        next->context.cpu_registers[0] = next->arg;
+        next->context.set_sp(next->stack_top);
+        next->context.set_lr(worker.runtime->exit_stub);
+        next->context.set_pc(next->entry);
+    }
+
+    load_context(cpu, next->context);
+    return next->context.cpu_registers[0];
+}
+
+// Park the running ulthread in the guest and switch to the next one, it resumes with SCE_ULT_OK once woken
+static int park_ulthread(ult::Worker &worker) {
+    ult::Ulthread *ulthread = worker.current;
+    ulthread->status = ult::UlthreadStatus::Waiting;
+    ulthread->context = save_context(*worker.thread->cpu);
+    ulthread->context.cpu_registers[0] = SCE_ULT_OK;
+
+    return run_next_ulthread(worker);
+}
+
+// The waiter of the caller was queued, block until it is woken
+static int block_caller(UltCaller &caller, std::unique_lock<std::mutex> &lock) {
+    if (caller.worker)
+        return park_ulthread(*caller.worker);
+
+    // kernel threads have nothing else to run, they sleep on their own waiter
+    caller.kernel_cond.wait(lock, [&]() { return caller.kernel_waiter.woken; });
+    return SCE_ULT_OK;
+}
 
-EXPORT(int, _sceUltConditionVariableCreate) {
-    return UNIMPLEMENTED();
+static void release_ulthread(UltState &state, ult::Ulthread &ulthread) {
+    ulthread.runtime->ulthread_count--;
+    state.ulthreads.erase(ulthread.address);
 }
 
-EXPORT(int, _sceUltConditionVariableOptParamInitialize) {
-    return UNIMPLEMENTED();
+static void run_worker(UltState &state, std::shared_ptr<ult::Runtime> runtime, ult::Worker &worker) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            runtime->ready_cond.wait(lock, [&]() { return runtime->shutdown || !runtime->ready.empty(); });
+            if (runtime->shutdown)
+                break;
+        }
+
+        // returns once no ulthread is left to run on this worker
+        worker.thread->run_guest_function(runtime->dispatch_stub);
+    }
+
+    worker.thread->exit_delete(false);
 }
 
-EXPORT(int, _sceUltMutexCreate) {
-    return UNIMPLEMENTED();
+// The dispatch stub is entered by an idle worker, sceUltUlthreadYield then switches between the ready
+// ulthreads without leaving the guest. The exit stub is the return address of the ulthread entries.
+static Address create_stubs(MemState &mem) {
+    const Address stubs = alloc(mem, 6 * sizeof(uint32_t), "SceUltStubs");
+    uint32_t *code = Ptr<uint32_t>(stubs).get(mem);
+    const uint32_t nids[] = { ULT_YIELD_NID, ULT_EXIT_NID };
+    for (const uint32_t nid : nids) {
+        *code++ = 0xef000000; // svc #0
+        *code++ = 0xe1a0f00e; // mov pc, lr
+        *code++ = nid;
+    }
+
+    return stubs;
 }
 
-EXPORT(int, _sceUltMutexOptParamInitialize) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltConditionVariableCreate, Address conditionVariable, const char *name, Address mutex, const void *optParam) {
+    if (!conditionVariable)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    ult::Mutex *ult_mutex = find_object(state->mutexes, mutex);
+    if (!ult_mutex)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    auto cond = std::make_unique<ult::ConditionVariable>();
+    cond->address = conditionVariable;
+    cond->name = name ? name : "";
+    cond->mutex = ult_mutex;
+    state->condition_variables[conditionVariable] = std::move(cond);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, _sceUltQueueCreate) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltConditionVariableOptParamInitialize, void *optParam) {
+    // options are ignored
+    if (!optParam)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, _sceUltQueueDataResourcePoolCreate) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltMutexCreate, Address mutex, const char *name, Address waitingQueueResourcePool, const void *optParam) {
+    if (!mutex)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    if (!state->waiting_queue_pools.contains(waitingQueueResourcePool))
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    auto ult_mutex = std::make_unique<ult::Mutex>();
+    ult_mutex->address = mutex;
+    ult_mutex->name = name ? name : "";
+    state->mutexes[mutex] = std::move(ult_mutex);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, _sceUltQueueDataResourcePoolOptParamInitialize) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltMutexOptParamInitialize, void *optParam) {
+    if (!optParam)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, _sceUltQueueOptParamInitialize) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltQueueCreate, Address queue, const char *name, uint32_t dataSize, Address waitingQueueResourcePool, Address queueDataResourcePool, const void *optParam) {
+    if (!queue)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    ult::QueueDataPool *pool = find_object(state->queue_data_pools, queueDataResourcePool);
+    if (!pool || !state->waiting_queue_pools.contains(waitingQueueResourcePool))
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    if (dataSize == 0 || dataSize > pool->data_size)
+        return RET_ERROR(SCE_ULT_ERROR_RANGE);
+
+    auto ult_queue = std::make_unique<ult::Queue>();
+    ult_queue->address = queue;
+    ult_queue->name = name ? name : "";
+    ult_queue->data_size = dataSize;
+    ult_queue->pool = pool;
+    pool->queues.push_back(ult_queue.get());
+    state->queues[queue] = std::move(ult_queue);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, _sceUltReaderWriterLockCreate) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltQueueDataResourcePoolCreate, Address pool, const char *name, uint32_t numData, uint32_t dataSize, uint32_t numQueueObject, Address waitingQueueResourcePool, Ptr<void> workArea, const void *optParam) {
+    if (!pool)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    if (numData == 0 || dataSize == 0)
+        return RET_ERROR(SCE_ULT_ERROR_RANGE);
+
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    if (!state->waiting_queue_pools.contains(waitingQueueResourcePool))
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    auto data_pool = std::make_unique<ult::QueueDataPool>();
+    data_pool->address = pool;
+    data_pool->name = name ? name : "";
+    data_pool->capacity = numData;
+    data_pool->data_size = dataSize;
+    state->queue_data_pools[pool] = std::move(data_pool);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, _sceUltReaderWriterLockOptParamInitialize) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltQueueDataResourcePoolOptParamInitialize, void *optParam) {
+    if (!optParam)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, _sceUltSemaphoreCreate) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltQueueOptParamInitialize, void *optParam) {
+    if (!optParam)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, _sceUltSemaphoreOptParamInitialize) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltReaderWriterLockCreate, Address rwlock, const char *name, Address waitingQueueResourcePool, const void *optParam) {
+    if (!rwlock)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    if (!state->waiting_queue_pools.contains(waitingQueueResourcePool))
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    auto ult_rwlock = std::make_unique<ult::ReaderWriterLock>();
+    ult_rwlock->address = rwlock;
+    ult_rwlock->name = name ? name : "";
+    state->rwlocks[rwlock] = std::move(ult_rwlock);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, _sceUltUlthreadCreate) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltReaderWriterLockOptParamInitialize, void *optParam) {
+    if (!optParam)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, _sceUltUlthreadOptParamInitialize) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltSemaphoreCreate, Address semaphore, const char *name, int32_t numInitialResource, Address waitingQueueResourcePool, const void *optParam) {
+    if (!semaphore)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    if (numInitialResource < 0)
+        return RET_ERROR(SCE_ULT_ERROR_RANGE);
+
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    if (!state->waiting_queue_pools.contains(waitingQueueResourcePool))
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    auto ult_semaphore = std::make_unique<ult::Semaphore>();
+    ult_semaphore->address = semaphore;
+    ult_semaphore->name = name ? name : "";
+    ult_semaphore->count = numInitialResource;
+    state->semaphores[semaphore] = std::move(ult_semaphore);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, _sceUltUlthreadRuntimeCreate) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltSemaphoreOptParamInitialize, void *optParam) {
+    if (!optParam)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, _sceUltUlthreadRuntimeOptParamInitialize) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltUlthreadCreate, Address ulthread, const char *name, Ptr<void> entry, uint32_t arg, Ptr<void> context, uint32_t sizeContext, Address runtime, const void *optParam) {
+    if (!ulthread || !entry || !context)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    if (sizeContext == 0)
+        return RET_ERROR(SCE_ULT_ERROR_RANGE);
+
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    const auto runtime_it = state->runtimes.find(runtime);
+    if (runtime_it == state->runtimes.end())
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    ult::Runtime &ult_runtime = *runtime_it->second;
+    if (ult_runtime.ulthread_count >= ult_runtime.max_ulthreads)
+        return RET_ERROR(SCE_ULT_ERROR_AGAIN);
+
+    auto ult_thread = std::make_unique<ult::Ulthread>();
+    ult_thread->address = ulthread;
+    ult_thread->name = name ? name : "";
+    ult_thread->entry = entry.address();
+    ult_thread->arg = arg;
+    // the context is the stack of the ulthread
+    ult_thread->stack_top = (context.address() + sizeContext) & ~7;
+    ult_thread->runtime = &ult_runtime;
+
+    ult_runtime.ulthread_count++;
+    ult::make_ready(*ult_thread);
+    state->ulthreads[ulthread] = std::move(ult_thread);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, _sceUltWaitingQueueResourcePoolCreate) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltUlthreadOptParamInitialize, void *optParam) {
+    if (!optParam)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, _sceUltWaitingQueueResourcePoolOptParamInitialize) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltUlthreadRuntimeCreate, Address runtime, const char *name, uint32_t numMaxUlthread, uint32_t numWorkerThread, Ptr<void> workArea, const void *optParam) {
+    if (!runtime)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    if (numMaxUlthread == 0 || numWorkerThread == 0)
+        return RET_ERROR(SCE_ULT_ERROR_RANGE);
+
+    auto ult_runtime = std::make_shared<ult::Runtime>();
+    ult_runtime->address = runtime;
+    ult_runtime->name = name ? name : "";
+    ult_runtime->max_ulthreads = numMaxUlthread;
+
+    for (uint32_t i = 0; i < numWorkerThread; i++) {
+        const std::string thread_name = fmt::format("SceUltWorker_{}_{}", ult_runtime->name, i);
+        auto worker = std::make_unique<ult::Worker>();
+        worker->runtime = ult_runtime.get();
+        worker->thread = emuenv.kernel.create_thread(emuenv.mem, thread_name.c_str(), Ptr<void>(0), SCE_KERNEL_DEFAULT_PRIORITY_USER, SCE_KERNEL_THREAD_CPU_AFFINITY_MASK_DEFAULT, SCE_KERNEL_STACK_SIZE_USER_DEFAULT, nullptr);
+        if (!worker->thread) {
+            for (const auto &created : ult_runtime->workers)
+                created->thread->exit_delete(false);
+            return RET_ERROR(SCE_ULT_ERROR_FATAL);
+        }
+        ult_runtime->workers.push_back(std::move(worker));
+    }
+
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    if (!state->stubs)
+        state->stubs = create_stubs(emuenv.mem);
+    ult_runtime->dispatch_stub = state->stubs;
+    ult_runtime->exit_stub = state->stubs + 3 * sizeof(uint32_t);
+
+    for (const auto &worker : ult_runtime->workers) {
+        state->workers[worker->thread->id] = worker.get();
+        worker->host_thread = std::thread(run_worker, std::ref(*state), ult_runtime, std::ref(*worker));
+    }
+    state->runtimes[runtime] = std::move(ult_runtime);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltConditionVariableDestroy) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltUlthreadRuntimeOptParamInitialize, void *optParam) {
+    if (!optParam)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltConditionVariableSignal) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltWaitingQueueResourcePoolCreate, Address pool, const char *name, uint32_t numThreads, uint32_t numSyncObjects, Ptr<void> workArea, const void *optParam) {
+    if (!pool)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    state->waiting_queue_pools.insert(pool);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltConditionVariableSignalAll) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltWaitingQueueResourcePoolOptParamInitialize, void *optParam) {
+    if (!optParam)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltConditionVariableWait) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltConditionVariableDestroy, Address conditionVariable) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    ult::ConditionVariable *cond = find_object(state->condition_variables, conditionVariable);
+    if (!cond)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    if (!cond->waiters.empty())
+        return RET_ERROR(SCE_ULT_ERROR_BUSY);
+
+    state->condition_variables.erase(conditionVariable);
+    return SCE_ULT_OK;
+}
+
+EXPORT(int, sceUltConditionVariableSignal, Address conditionVariable) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    ult::ConditionVariable *cond = find_object(state->condition_variables, conditionVariable);
+    if (!cond)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    ult::condition_variable_signal(*cond, false);
+    return SCE_ULT_OK;
+}
+
+EXPORT(int, sceUltConditionVariableSignalAll, Address conditionVariable) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    ult::ConditionVariable *cond = find_object(state->condition_variables, conditionVariable);
+    if (!cond)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    ult::condition_variable_signal(*cond, true);
+    return SCE_ULT_OK;
+}
+
+EXPORT(int, sceUltConditionVariableWait, Address conditionVariable) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    ult::ConditionVariable *cond = find_object(state->condition_variables, conditionVariable);
+    if (!cond)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    UltCaller caller(*state, thread_id);
+    if (cond->mutex->owner != caller.owner)
+        return RET_ERROR(SCE_ULT_ERROR_PERMISSION);
+
+    ult::condition_variable_wait(*cond, *caller.waiter);
+    return block_caller(caller, lock);
 }
 
 EXPORT(int, sceUltGetConditionVariableInfo) {
@@ -141,126 +562,459 @@ EXPORT(int, sceUltGetWaitingQueueResourcePoolInfo) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceUltMutexDestroy) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltMutexDestroy, Address mutex) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    ult::Mutex *ult_mutex = find_object(state->mutexes, mutex);
+    if (!ult_mutex)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    if (ult_mutex->owner || !ult_mutex->waiters.empty())
+        return RET_ERROR(SCE_ULT_ERROR_BUSY);
+
+    state->mutexes.erase(mutex);
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltMutexLock) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltMutexLock, Address mutex) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    ult::Mutex *ult_mutex = find_object(state->mutexes, mutex);
+    if (!ult_mutex)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    UltCaller caller(*state, thread_id);
+    if (ult_mutex->owner == caller.owner)
+        return RET_ERROR(SCE_ULT_ERROR_STATE);
+
+    if (ult::mutex_lock(*ult_mutex, *caller.waiter))
+        return SCE_ULT_OK;
+
+    return block_caller(caller, lock);
 }
 
-EXPORT(int, sceUltMutexTryLock) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltMutexTryLock, Address mutex) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    ult::Mutex *ult_mutex = find_object(state->mutexes, mutex);
+    if (!ult_mutex)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    UltCaller caller(*state, thread_id);
+    if (!ult::mutex_try_lock(*ult_mutex, caller.owner))
+        return SCE_ULT_ERROR_BUSY;
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltMutexUnlock) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltMutexUnlock, Address mutex) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    ult::Mutex *ult_mutex = find_object(state->mutexes, mutex);
+    if (!ult_mutex)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    UltCaller caller(*state, thread_id);
+    if (!ult::mutex_unlock(*ult_mutex, caller.owner))
+        return RET_ERROR(SCE_ULT_ERROR_PERMISSION);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltQueueDataResourcePoolDestroy) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltQueueDataResourcePoolDestroy, Address pool) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    ult::QueueDataPool *data_pool = find_object(state->queue_data_pools, pool);
+    if (!data_pool)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    if (!data_pool->queues.empty())
+        return RET_ERROR(SCE_ULT_ERROR_BUSY);
+
+    state->queue_data_pools.erase(pool);
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltQueueDataResourcePoolGetWorkAreaSize) {
-    return UNIMPLEMENTED();
+EXPORT(uint32_t, sceUltQueueDataResourcePoolGetWorkAreaSize, uint32_t numData, uint32_t dataSize, uint32_t numQueueObject) {
+    return numData * dataSize + numQueueObject * 0x20;
 }
 
-EXPORT(int, sceUltQueueDestroy) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltQueueDestroy, Address queue) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    ult::Queue *ult_queue = find_object(state->queues, queue);
+    if (!ult_queue)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    if (!ult_queue->pushers.empty() || !ult_queue->poppers.empty())
+        return RET_ERROR(SCE_ULT_ERROR_BUSY);
+
+    ult::QueueDataPool &pool = *ult_queue->pool;
+    pool.used -= static_cast<uint32_t>(ult_queue->data.size());
+    std::erase(pool.queues, ult_queue);
+    state->queues.erase(queue);
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltQueuePop) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltQueuePop, Address queue, Ptr<void> data) {
+    if (!data)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    ult::Queue *ult_queue = find_object(state->queues, queue);
+    if (!ult_queue)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    UltCaller caller(*state, thread_id);
+    caller.waiter->data = data.get(emuenv.mem);
+    if (ult::queue_pop(*ult_queue, *caller.waiter))
+        return SCE_ULT_OK;
+
+    return block_caller(caller, lock);
 }
 
-EXPORT(int, sceUltQueuePush) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltQueuePush, Address queue, Ptr<const void> data) {
+    if (!data)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    ult::Queue *ult_queue = find_object(state->queues, queue);
+    if (!ult_queue)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    UltCaller caller(*state, thread_id);
+    caller.waiter->data = const_cast<void *>(data.get(emuenv.mem));
+    if (ult::queue_push(*ult_queue, *caller.waiter))
+        return SCE_ULT_OK;
+
+    return block_caller(caller, lock);
 }
 
-EXPORT(int, sceUltQueueTryPop) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltQueueTryPop, Address queue, Ptr<void> data) {
+    if (!data)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    ult::Queue *ult_queue = find_object(state->queues, queue);
+    if (!ult_queue)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    if (!ult::queue_try_pop(*ult_queue, data.get(emuenv.mem)))
+        return SCE_ULT_ERROR_BUSY;
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltQueueTryPush) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltQueueTryPush, Address queue, Ptr<const void> data) {
+    if (!data)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    ult::Queue *ult_queue = find_object(state->queues, queue);
+    if (!ult_queue)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    if (!ult::queue_try_push(*ult_queue, data.get(emuenv.mem)))
+        return SCE_ULT_ERROR_BUSY;
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltReaderWriterLockDestroy) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltReaderWriterLockDestroy, Address rwlock) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    ult::ReaderWriterLock *ult_rwlock = find_object(state->rwlocks, rwlock);
+    if (!ult_rwlock)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    if (ult_rwlock->writer || ult_rwlock->readers > 0 || !ult_rwlock->waiters.empty())
+        return RET_ERROR(SCE_ULT_ERROR_BUSY);
+
+    state->rwlocks.erase(rwlock);
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltReaderWriterLockLockRead) {
-    return UNIMPLEMENTED();
+static int lock_rwlock(EmuEnvState &emuenv, SceUID thread_id, Address rwlock, bool write) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    ult::ReaderWriterLock *ult_rwlock = find_object(state->rwlocks, rwlock);
+    if (!ult_rwlock)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    UltCaller caller(*state, thread_id);
+    if (ult_rwlock->writer == caller.owner)
+        return RET_ERROR(SCE_ULT_ERROR_STATE);
+
+    caller.waiter->write = write;
+    if (ult::rwlock_lock(*ult_rwlock, *caller.waiter))
+        return SCE_ULT_OK;
+
+    return block_caller(caller, lock);
 }
 
-EXPORT(int, sceUltReaderWriterLockLockWrite) {
-    return UNIMPLEMENTED();
+static int try_lock_rwlock(EmuEnvState &emuenv, SceUID thread_id, Address rwlock, bool write) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    ult::ReaderWriterLock *ult_rwlock = find_object(state->rwlocks, rwlock);
+    if (!ult_rwlock)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    UltCaller caller(*state, thread_id);
+    if (!ult::rwlock_try_lock(*ult_rwlock, caller.owner, write))
+        return SCE_ULT_ERROR_BUSY;
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltReaderWriterLockTryLockRead) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltReaderWriterLockLockRead, Address rwlock) {
+    return lock_rwlock(emuenv, thread_id, rwlock, false);
 }
 
-EXPORT(int, sceUltReaderWriterLockTryLockWrite) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltReaderWriterLockLockWrite, Address rwlock) {
+    return lock_rwlock(emuenv, thread_id, rwlock, true);
 }
 
-EXPORT(int, sceUltReaderWriterLockUnlockRead) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltReaderWriterLockTryLockRead, Address rwlock) {
+    return try_lock_rwlock(emuenv, thread_id, rwlock, false);
 }
 
-EXPORT(int, sceUltReaderWriterLockUnlockWrite) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltReaderWriterLockTryLockWrite, Address rwlock) {
+    return try_lock_rwlock(emuenv, thread_id, rwlock, true);
 }
 
-EXPORT(int, sceUltSemaphoreAcquire) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltReaderWriterLockUnlockRead, Address rwlock) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    ult::ReaderWriterLock *ult_rwlock = find_object(state->rwlocks, rwlock);
+    if (!ult_rwlock)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    if (!ult::rwlock_unlock_read(*ult_rwlock))
+        return RET_ERROR(SCE_ULT_ERROR_PERMISSION);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltSemaphoreDestroy) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltReaderWriterLockUnlockWrite, Address rwlock) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    ult::ReaderWriterLock *ult_rwlock = find_object(state->rwlocks, rwlock);
+    if (!ult_rwlock)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    UltCaller caller(*state, thread_id);
+    if (!ult::rwlock_unlock_write(*ult_rwlock, caller.owner))
+        return RET_ERROR(SCE_ULT_ERROR_PERMISSION);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltSemaphoreRelease) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltSemaphoreAcquire, Address semaphore, int32_t numResource) {
+    if (numResource <= 0)
+        return RET_ERROR(SCE_ULT_ERROR_RANGE);
+
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    ult::Semaphore *ult_semaphore = find_object(state->semaphores, semaphore);
+    if (!ult_semaphore)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    UltCaller caller(*state, thread_id);
+    caller.waiter->count = numResource;
+    if (ult::semaphore_acquire(*ult_semaphore, *caller.waiter))
+        return SCE_ULT_OK;
+
+    return block_caller(caller, lock);
 }
 
-EXPORT(int, sceUltSemaphoreTryAcquire) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltSemaphoreDestroy, Address semaphore) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    ult::Semaphore *ult_semaphore = find_object(state->semaphores, semaphore);
+    if (!ult_semaphore)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    if (!ult_semaphore->waiters.empty())
+        return RET_ERROR(SCE_ULT_ERROR_BUSY);
+
+    state->semaphores.erase(semaphore);
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltUlthreadExit) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltSemaphoreRelease, Address semaphore, int32_t numResource) {
+    if (numResource <= 0)
+        return RET_ERROR(SCE_ULT_ERROR_RANGE);
+
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    ult::Semaphore *ult_semaphore = find_object(state->semaphores, semaphore);
+    if (!ult_semaphore)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    ult::semaphore_release(*ult_semaphore, numResource);
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltUlthreadGetSelf) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltSemaphoreTryAcquire, Address semaphore, int32_t numResource) {
+    if (numResource <= 0)
+        return RET_ERROR(SCE_ULT_ERROR_RANGE);
+
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    ult::Semaphore *ult_semaphore = find_object(state->semaphores, semaphore);
+    if (!ult_semaphore)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    if (!ult::semaphore_try_acquire(*ult_semaphore, numResource))
+        return SCE_ULT_ERROR_BUSY;
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltUlthreadJoin) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltUlthreadExit, int32_t status) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    UltCaller caller(*state, thread_id);
+    ult::Ulthread *ulthread = caller.ulthread();
+    if (!ulthread)
+        return RET_ERROR(SCE_ULT_ERROR_PERMISSION);
+
+    // a joiner already waiting takes the exit status, the ulthread is released right away
+    if (ult::finish(*ulthread, status))
+        release_ulthread(*state, *ulthread);
+
+    return run_next_ulthread(*caller.worker);
 }
 
-EXPORT(int, sceUltUlthreadRuntimeDestroy) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltUlthreadGetSelf, Ptr<Address> ulthread) {
+    if (!ulthread)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    UltCaller caller(*state, thread_id);
+    if (!caller.ulthread())
+        return RET_ERROR(SCE_ULT_ERROR_PERMISSION);
+
+    *ulthread.get(emuenv.mem) = caller.ulthread()->address;
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltUlthreadRuntimeGetWorkAreaSize) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltUlthreadJoin, Address ulthread, Ptr<int32_t> status) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    ult::Ulthread *target = find_object(state->ulthreads, ulthread);
+    if (!target)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    UltCaller caller(*state, thread_id);
+    if (target == caller.ulthread())
+        return RET_ERROR(SCE_ULT_ERROR_STATE);
+
+    if (!target->joiners.empty())
+        return RET_ERROR(SCE_ULT_ERROR_BUSY);
+
+    caller.waiter->data = status ? status.get(emuenv.mem) : nullptr;
+    if (ult::join(*target, *caller.waiter)) {
+        release_ulthread(*state, *target);
+        return SCE_ULT_OK;
+    }
+
+    return block_caller(caller, lock);
 }
 
-EXPORT(int, sceUltUlthreadTryJoin) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltUlthreadRuntimeDestroy, Address runtime) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    const auto runtime_it = state->runtimes.find(runtime);
+    if (runtime_it == state->runtimes.end())
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    ult::Runtime &ult_runtime = *runtime_it->second;
+    if (ult_runtime.ulthread_count > 0)
+        return RET_ERROR(SCE_ULT_ERROR_BUSY);
+
+    LOG_DEBUG("Ulthread runtime {} destroyed after {} ulthread switches", ult_runtime.name, ult_runtime.switch_count);
+
+    // the host threads keep the runtime alive until they saw the shutdown and deleted their worker thread
+    ult_runtime.shutdown = true;
+    ult_runtime.ready_cond.notify_all();
+    std::vector<std::thread> host_threads;
+    for (const auto &worker : ult_runtime.workers) {
+        state->workers.erase(worker->thread->id);
+        host_threads.push_back(std::move(worker->host_thread));
+    }
+
+    state->runtimes.erase(runtime_it);
+    lock.unlock();
+
+    // the workers need the state mutex to see the shutdown
+    for (std::thread &host_thread : host_threads)
+        host_thread.join();
+
+    return SCE_ULT_OK;
+}
+
+EXPORT(uint32_t, sceUltUlthreadRuntimeGetWorkAreaSize, uint32_t numMaxUlthread, uint32_t numWorkerThread) {
+    return numMaxUlthread * 0x40 + numWorkerThread * 0x100;
+}
+
+EXPORT(int, sceUltUlthreadTryJoin, Address ulthread, Ptr<int32_t> status) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    ult::Ulthread *target = find_object(state->ulthreads, ulthread);
+    if (!target)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    if (target->status != ult::UlthreadStatus::Finished)
+        return SCE_ULT_ERROR_BUSY;
+
+    if (status)
+        *status.get(emuenv.mem) = target->exit_status;
+    release_ulthread(*state, *target);
+
+    return SCE_ULT_OK;
 }
 
 EXPORT(int, sceUltUlthreadYield) {
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    const auto worker_it = state->workers.find(thread_id);
+    if (worker_it == state->workers.end())
+        return RET_ERROR(SCE_ULT_ERROR_PERMISSION);
+
+    ult::Worker &worker = *worker_it->second;
+    if (!worker.current) {
+        // called by the dispatch stub, start running ulthreads
+        worker.dispatch_context = save_context(*worker.thread->cpu);
+        worker.dispatch_context.cpu_registers[0] = SCE_ULT_OK;
+        return run_next_ulthread(worker);
+    }
+
+    if (worker.runtime->ready.empty())
+        return SCE_ULT_OK;
+
+    ult::Ulthread *ulthread = worker.current;
+    ulthread->context = save_context(*worker.thread->cpu);
+    ulthread->context.cpu_registers[0] = SCE_ULT_OK;
+    ult::make_ready(*ulthread);
+
+    return run_next_ulthread(worker);
 }
 
-EXPORT(int, sceUltWaitingQueueResourcePoolDestroy) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltWaitingQueueResourcePoolDestroy, Address pool) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    if (!state->waiting_queue_pools.erase(pool))
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltWaitingQueueResourcePoolGetWorkAreaSize) {
-    return UNIMPLEMENTED();
+EXPORT(uint32_t, sceUltWaitingQueueResourcePoolGetWorkAreaSize, uint32_t numThreads, uint32_t numSyncObjects) {
+    return numThreads * 0x20 + numSyncObjects * 0x10;
 }
@@ -19,12 +19,23 @@
 
 #include <motion/motion.h>
 #include <motion/motion_input.h>
+#include <util/seqlock.h>
 
 #include <SDL_gamecontroller.h>
 
 #include <mutex>
 
+// Motion values published after each sensor update
+struct MotionSnapshot {
+    SceFVector3 acceleration;
+    SceFVector3 gyro;
+    Util::Quaternion<SceFloat> orientation;
+    uint64_t timestamp;
+    uint32_t counter;
+};
+
 struct MotionState {
+    // held while the sensor fusion is updated
     std::mutex mutex;
     MotionInput motion_data;
     uint32_t last_counter = 0;
@@ -38,5 +49,8 @@ struct MotionState {
 
     bool is_sampling = false;
 
+    // read by the guest threads without locking
+    SeqLock<MotionSnapshot> snapshot;
+
     void init();
 };
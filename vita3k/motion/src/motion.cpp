@@ -238,4 +238,12 @@ void refresh_motion(MotionState &state, CtrlState &ctrl_state) {
     state.last_gyro_timestamp = gyro_timestamp;
     state.last_accel_timestamp = accel_timestamp;
     state.last_counter++;
+
+    MotionSnapshot snapshot;
+    snapshot.acceleration = get_acceleration(state);
+    snapshot.gyro = get_gyroscope(state);
+    snapshot.orientation = get_orientation(state);
+    snapshot.timestamp = accel_timestamp;
+    snapshot.counter = state.last_counter;
+    state.snapshot.store(snapshot);
 }
@@ -84,9 +84,6 @@ struct SceNgsPlayerParamsBlock {
 namespace ngs {
 
 class PlayerModule : public Module {
-private:
-    std::unique_ptr<PCMDecoderState> decoder;
-
 public:
     bool process(KernelState &kern, const MemState &mem, const SceUID thread_id, ModuleData &data, std::unique_lock<std::recursive_mutex> &scheduler_lock, std::unique_lock<std::mutex> &voice_lock) override;
     uint32_t module_id() const override { return 0x5CE6; }
@@ -20,6 +20,7 @@
 #include <util/types.h>
 
 #include <mem/ptr.h>
+#include <util/worker_pool.h>
 
 #include <thread>
 
@@ -59,6 +60,18 @@ struct OperationPending {
     };
 };
 
+// Data sent to a voice which is not after the source in the update order, like in a feedback loop
+// It is received once every voice was processed, so the destination gets it at the next update
+struct DelayedDelivery {
+    Patch *patch;
+    std::vector<uint8_t> data;
+};
+
+struct DelayedDeliveries {
+    std::mutex mutex;
+    std::vector<DelayedDelivery> deliveries;
+};
+
 struct VoiceScheduler {
     std::vector<Voice *> queue;
     std::queue<OperationPending> operations_pending;
@@ -67,12 +80,33 @@ struct VoiceScheduler {
     std::condition_variable_any condvar;
     bool is_updating = false;
 
+    // Amount of helper threads processing voices, 0 to process everything on the update thread
+    uint32_t worker_count;
+
+    VoiceScheduler();
+
 protected:
+    struct VoiceTask {
+        Voice *voice;
+        bool finished;
+        uint32_t finished_module;
+    };
+
+    // The queue split in levels, a voice only receives data from the voices of the previous levels during an update
+    std::vector<std::vector<Voice *>> levels;
+    bool levels_dirty = false;
+    uint32_t generation = 0;
+
+    std::vector<VoiceTask> parallel_tasks;
+    DelayedDeliveries delayed;
+    // Helper threads processing the independent voices of a level alongside the update thread
+    WorkerPool workers;
+
     void deque_insert(const MemState &mem, Voice *voice);
 
-    bool resort_to_respect_dependencies(const MemState &mem, Voice *source);
+    void build_levels(const MemState &mem);
 
-    std::int32_t get_position(Voice *v);
+    void process_voice(KernelState &kern, const MemState &mem, const SceUID thread_id, VoiceTask &task, std::unique_lock<std::recursive_mutex> &scheduler_lock);
 
 public:
     bool deque_voice(Voice *voice);
@@ -119,6 +119,8 @@ public:
     virtual uint32_t get_buffer_parameter_size() const = 0;
     virtual void on_state_change(const MemState &mem, ModuleData &v, const VoiceState previous) {}
     virtual void on_param_change(const MemState &mem, ModuleData &data) {}
+    // Whether voices using this module can be processed on a worker thread, alongside the other voices of the rack
+    virtual bool can_run_in_parallel() const { return true; }
 };
 
 static constexpr uint32_t MAX_VOICE_OUTPUT = 4;
@@ -168,6 +170,11 @@ struct Voice {
     Ptr<void> finished_callback;
     Ptr<void> finished_callback_user_data;
 
+    // Set by the scheduler when sorting its queue
+    uint32_t scheduler_generation = 0;
+    uint32_t scheduler_level = 0;
+    uint32_t scheduler_pending_sources = 0;
+
     void init(Rack *mama);
 
     ModuleData *module_storage(const uint32_t index);
@@ -215,8 +222,7 @@ struct System : public MempoolObject {
     static uint32_t get_required_memspace_size(SceNgsSystemInitParams *parameters);
 };
 
-bool deliver_data(const MemState &mem, const std::vector<Voice *> &voice_queue, Voice *source, const uint8_t output_port,
-    const VoiceProduct &data_to_deliver);
+bool deliver_data(const MemState &mem, Voice *source, const uint8_t output_port, const VoiceProduct &data_to_deliver, DelayedDeliveries &delayed);
 
 bool init_system(State &ngs, const MemState &mem, SceNgsSystemInitParams *parameters, Ptr<void> memspace, const uint32_t memspace_size);
 void release_system(State &ngs, const MemState &mem, System *system);
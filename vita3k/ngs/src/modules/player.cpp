@@ -27,6 +27,11 @@ extern "C" {
 
 namespace ngs {
 
+// The decoder only holds scratch data between two calls (the adpcm history is saved in the voice state).
+// Having one per thread lets the voices of a rack be processed in parallel
+static thread_local std::unique_ptr<PCMDecoderState> decoder;
+static thread_local int32_t decoder_sample_rate = 0;
+
 void PlayerModule::on_state_change(const MemState &mem, ModuleData &data, const VoiceState previous) {
     SceNgsPlayerStates *state = data.get_state<SceNgsPlayerStates>();
     SceNgsPlayerParams *params = data.get_parameters<SceNgsPlayerParams>(mem);
@@ -89,9 +94,10 @@ bool PlayerModule::process(KernelState &kern, const MemState &mem, const SceUID
         params->channels = 2;
 
     // If decoder hasn't been initialized
-    if (!decoder) {
+    if (!decoder || decoder_sample_rate != sample_rate) {
         // Create decoder specifying the desired destination sample rate
         decoder = std::make_unique<PCMDecoderState>(sample_rate);
+        decoder_sample_rate = sample_rate;
     }
 
     // If the amount of samples already processed and pending to be passed is smaller than the amount of samples of the audio buffer
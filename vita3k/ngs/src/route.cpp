@@ -18,11 +18,9 @@
 #include <ngs/system.h>
 
 #include <util/log.h>
-#include <util/vector_utils.h>
 
 namespace ngs {
-bool deliver_data(const MemState &mem, const std::vector<Voice *> &voice_queue, Voice *source, const uint8_t output_port,
-    const VoiceProduct &data_to_deliver) {
+bool deliver_data(const MemState &mem, Voice *source, const uint8_t output_port, const VoiceProduct &data_to_deliver, DelayedDeliveries &delayed) {
     if (!data_to_deliver.data) {
         return false;
     }
@@ -33,9 +31,17 @@ bool deliver_data(const MemState &mem, const std::vector<Voice *> &voice_queue,
         if (!patch || patch->output_sub_index == -1)
             continue;
 
-        if (!vector_utils::contains(voice_queue, patch->dest))
+        if (patch->dest->scheduler_generation != source->scheduler_generation)
             continue;
 
+        // The voices of the same or of a previous level may already be processed, keep the data for the next update
+        if (patch->dest->scheduler_level <= source->scheduler_level) {
+            const size_t size = source->rack->system->granularity * 2 * sizeof(float);
+            const std::lock_guard<std::mutex> guard(delayed.mutex);
+            delayed.deliveries.push_back({ patch, std::vector<uint8_t>(data_to_deliver.data, data_to_deliver.data + size) });
+            continue;
+        }
+
         const std::lock_guard<std::mutex> guard(*patch->dest->voice_mutex);
         patch->dest->inputs.receive(patch, data_to_deliver);
     }
@@ -26,35 +26,31 @@
 
 namespace ngs {
 
+// Levels with less voices than this are not worth waking the helper threads
+static constexpr size_t MIN_PARALLEL_VOICES = 4;
+
+VoiceScheduler::VoiceScheduler()
+    // the emulated cpu and gpu threads are already busy, leave them some room
+    : worker_count(std::clamp(std::thread::hardware_concurrency(), 1U, 4U) - 1) {}
+
 bool VoiceScheduler::deque_voice(Voice *voice) {
     const std::lock_guard<std::recursive_mutex> guard(mutex);
 
-    return vector_utils::erase_first(queue, voice);
+    if (!vector_utils::erase_first(queue, voice))
+        return false;
+
+    levels_dirty = true;
+    return true;
 }
 
 void VoiceScheduler::deque_insert(const MemState &mem, Voice *voice) {
     const std::lock_guard<std::recursive_mutex> guard(mutex);
-    int32_t lowest_dest_pos = queue.size();
 
-    // Check its dependencies position
-    for (auto &patches : voice->patches) {
-        for (const auto patch : patches) {
-            if (!patch) {
-                continue;
-            }
-
-            Voice *dest = patch.get(mem)->dest;
-            const int32_t pos = get_position(dest);
-
-            if (pos == -1) {
-                continue;
-            }
+    // the inputs are cleared after each processing, they may still hold data from the last time this voice was scheduled
+    voice->inputs.reset_inputs();
 
-            lowest_dest_pos = std::min<int32_t>(lowest_dest_pos, pos);
-        }
-    }
-
-    queue.insert(queue.begin() + lowest_dest_pos, voice);
+    queue.push_back(voice);
+    levels_dirty = true;
 }
 
 bool VoiceScheduler::play(const MemState &mem, Voice *voice) {
@@ -117,56 +113,186 @@ bool VoiceScheduler::off(const MemState &mem, Voice *voice) {
     return true;
 }
 
+void VoiceScheduler::build_levels(const MemState &mem) {
+    // Kahn's algorithm, run only when the queue or the routing changed.
+    // Each voice gets stamped with the generation and its level, deliver_data uses them to know where the data can go
+    generation++;
+    levels.clear();
+
+    for (Voice *voice : queue) {
+        voice->scheduler_generation = generation;
+        voice->scheduler_level = UINT32_MAX;
+        voice->scheduler_pending_sources = 0;
+    }
+
+    const auto for_each_dest = [&](Voice *voice, const auto &func) {
+        for (auto &patches : voice->patches) {
+            for (const auto &patch_ptr : patches) {
+                const Patch *patch = patch_ptr.get(mem);
+                if (!patch || patch->output_sub_index == -1)
+                    continue;
+
+                Voice *dest = patch->dest;
+                if (dest == voice || dest->scheduler_generation != generation || dest->scheduler_level != UINT32_MAX)
+                    continue;
+
+                func(dest);
+            }
+        }
+    };
+
+    for (Voice *voice : queue)
+        for_each_dest(voice, [](Voice *dest) { dest->scheduler_pending_sources++; });
+
+    std::vector<Voice *> current;
+    for (Voice *voice : queue) {
+        if (voice->scheduler_pending_sources == 0)
+            current.push_back(voice);
+    }
+
+    size_t placed = 0;
+    size_t cycle_search = 0;
+    while (placed < queue.size()) {
+        if (current.empty()) {
+            // only cycles are left, break them following the queue order
+            while (queue[cycle_search]->scheduler_level != UINT32_MAX)
+                cycle_search++;
+
+            current.push_back(queue[cycle_search]);
+        }
+
+        const uint32_t level = static_cast<uint32_t>(levels.size());
+        for (Voice *voice : current)
+            voice->scheduler_level = level;
+
+        std::vector<Voice *> next;
+        for (Voice *voice : current) {
+            for_each_dest(voice, [&](Voice *dest) {
+                if (--dest->scheduler_pending_sources == 0)
+                    next.push_back(dest);
+            });
+        }
+
+        placed += current.size();
+        levels.push_back(std::move(current));
+        current = std::move(next);
+    }
+
+    levels_dirty = false;
+}
+
+void VoiceScheduler::process_voice(KernelState &kern, const MemState &mem, const SceUID thread_id, VoiceTask &task, std::unique_lock<std::recursive_mutex> &scheduler_lock) {
+    Voice *voice = task.voice;
+
+    // Modify the state, in peace....
+    std::unique_lock<std::mutex> voice_lock(*voice->voice_mutex);
+    memset(voice->products, 0, sizeof(voice->products));
+
+    task.finished = false;
+    for (size_t i = 0; i < voice->rack->modules.size(); i++) {
+        if (voice->rack->modules[i]) {
+            if (voice->rack->modules[i]->process(kern, mem, thread_id, voice->datas[i], scheduler_lock, voice_lock)) {
+                task.finished = true;
+                task.finished_module = voice->rack->modules[i]->module_id();
+            }
+        }
+    }
+
+    voice_lock.unlock();
+
+    for (size_t i = 0; i < voice->rack->vdef->output_count; i++) {
+        if (voice->products[i].data)
+            deliver_data(mem, voice, static_cast<uint8_t>(i), voice->products[i], delayed);
+    }
+
+    // The inputs are consumed at this point (the input mixer product is the input buffer itself), clear them for the next update
+    voice_lock.lock();
+    voice->inputs.reset_inputs();
+    voice->frame_count++;
+}
+
 void VoiceScheduler::update(KernelState &kern, const MemState &mem, const SceUID thread_id) {
     std::unique_lock<std::recursive_mutex> scheduler_lock(mutex);
     is_updating = true;
 
-    // make a copy of the queue, this way we have no issue if it is modified in a callback
-    std::vector<ngs::Voice *> queue_copy = queue;
+    // the levels are not touched until the next update, this way we have no issue if the queue is modified in a callback
+    if (levels_dirty)
+        build_levels(mem);
 
-    // Do a first routine to clear inputs from previous update session
-    for (ngs::Voice *voice : queue_copy) {
-        voice->inputs.reset_inputs();
-    }
+    const std::function<void(size_t)> run_parallel_task = [&](size_t index) {
+        // the scheduler lock stays with the update thread, modules allowed to run here do not give it back
+        std::recursive_mutex worker_mutex;
+        std::unique_lock<std::recursive_mutex> worker_lock(worker_mutex);
+        process_voice(kern, mem, thread_id, parallel_tasks[index], worker_lock);
+    };
 
-    for (ngs::Voice *voice : queue_copy) {
-        // Modify the state, in peace....
+    const auto finish_voice = [&](VoiceTask &task) {
+        Voice *voice = task.voice;
         std::unique_lock<std::mutex> voice_lock(*voice->voice_mutex);
-        memset(voice->products, 0, sizeof(voice->products));
 
-        bool finished = false;
-        uint32_t finished_module = 0;
+        voice->is_keyed_off = true;
+        voice->transition(mem, VOICE_STATE_FINALIZING);
+        if (voice->finished_callback) {
+            voice_lock.unlock();
+            scheduler_lock.unlock();
+            voice->invoke_callback(kern, mem, thread_id, voice->finished_callback, voice->finished_callback_user_data, task.finished_module);
+            scheduler_lock.lock();
+            voice_lock.lock();
+        }
+        voice->is_keyed_off = false;
 
-        for (size_t i = 0; i < voice->rack->modules.size(); i++) {
-            if (voice->rack->modules[i]) {
-                if (voice->rack->modules[i]->process(kern, mem, thread_id, voice->datas[i], scheduler_lock, voice_lock)) {
-                    finished = true;
-                    finished_module = voice->rack->modules[i]->module_id();
-                }
+        stop(mem, voice);
+    };
+
+    for (const auto &level : levels) {
+        parallel_tasks.clear();
+
+        for (Voice *voice : level) {
+            // Guest callbacks must run on this thread, with the scheduler lock released
+            bool can_run_in_parallel = !voice->finished_callback;
+            for (size_t i = 0; i < voice->rack->modules.size() && can_run_in_parallel; i++) {
+                if (voice->datas[i].callback || (voice->rack->modules[i] && !voice->rack->modules[i]->can_run_in_parallel()))
+                    can_run_in_parallel = false;
             }
-        }
-        if (finished) {
-            voice->is_keyed_off = true;
-            voice->transition(mem, VOICE_STATE_FINALIZING);
-            if (voice->finished_callback) {
-                voice_lock.unlock();
-                scheduler_lock.unlock();
-                voice->invoke_callback(kern, mem, thread_id, voice->finished_callback, voice->finished_callback_user_data, finished_module);
-                scheduler_lock.lock();
-                voice_lock.lock();
+
+            if (can_run_in_parallel) {
+                parallel_tasks.push_back({ voice, false, 0 });
+                continue;
             }
-            voice->is_keyed_off = false;
 
-            stop(mem, voice);
+            VoiceTask task = { voice, false, 0 };
+            process_voice(kern, mem, thread_id, task, scheduler_lock);
+            if (task.finished)
+                finish_voice(task);
         }
 
-        for (size_t i = 0; i < voice->rack->vdef->output_count; i++) {
-            if (voice->products[i].data)
-                deliver_data(mem, queue_copy, voice, static_cast<uint8_t>(i), voice->products[i]);
+        if (parallel_tasks.size() >= MIN_PARALLEL_VOICES) {
+            workers.run(worker_count, parallel_tasks.size(), run_parallel_task);
+        } else {
+            for (size_t i = 0; i < parallel_tasks.size(); i++)
+                run_parallel_task(i);
         }
 
-        voice->frame_count++;
+        for (VoiceTask &task : parallel_tasks) {
+            if (task.finished)
+                finish_voice(task);
+        }
+    }
+
+    // Every voice is processed and its inputs are cleared, what is received now is used by the next update
+    for (DelayedDelivery &delivery : delayed.deliveries) {
+        Patch *patch = delivery.patch;
+        // the patch may have been removed by a callback
+        if (patch->output_sub_index == -1)
+            continue;
+
+        VoiceProduct product = {};
+        product.data = delivery.data.data();
+
+        const std::lock_guard<std::mutex> guard(*patch->dest->voice_mutex);
+        patch->dest->inputs.receive(patch, product);
     }
+    delayed.deliveries.clear();
 
     while (!operations_pending.empty()) {
         OperationPending &op = operations_pending.front();
@@ -186,69 +312,17 @@ void VoiceScheduler::update(KernelState &kern, const MemState &mem, const SceUID
     condvar.notify_all();
 }
 
-int32_t VoiceScheduler::get_position(Voice *v) {
-    // we assume the scheduler lock is being held when calling this function
-    return vector_utils::find_index(queue, v);
-}
-
-bool VoiceScheduler::resort_to_respect_dependencies(const MemState &mem, Voice *source) {
-    // this function is called by patch, which already acquired the scheduler mutex
-
-    // Get my position
-    int32_t position = get_position(source);
-
-    if (position == -1) {
-        return false;
-    }
-
-    // Check all dependencies, could be optimized- @sunho suggested dfs topological sort
-    for (size_t i = 0; i < source->patches.size(); i++) {
-        for (const auto &patch : source->patches[i]) {
-            if (!patch || patch.get(mem)->output_sub_index == -1) {
-                continue;
-            }
-
-            Voice *dest = patch.get(mem)->dest;
-            const int32_t dest_pos = get_position(dest);
-
-            if (dest_pos == -1) {
-                // Maybe not scheduled yet. Continue
-                continue;
-            }
-
-            if (dest_pos < position) {
-                // Switch to the end. Resort dependencies for this one that just got sorted too.
-                std::rotate(queue.begin() + dest_pos, queue.begin() + dest_pos + 1, queue.end());
-                resort_to_respect_dependencies(mem, dest);
-                position = get_position(source);
-            }
-        }
-    }
-
-    return true;
-}
-
 Ptr<Patch> VoiceScheduler::patch(const MemState &mem, SceNgsPatchSetupInfo *info) {
     const std::lock_guard<std::recursive_mutex> guard(mutex);
-    // First, check if these two voices are scheduled yet
     Voice *source = info->source.get(mem);
     Voice *dest = info->dest.get(mem);
 
     Ptr<Patch> patch = source->patch(mem, info->source_output_index, info->source_output_subindex, info->dest_input_index, dest);
 
-    if (!patch) {
-        return patch;
-    }
-
-    const int32_t source_pos = get_position(source);
-    const int32_t dest_pos = get_position(dest);
-
-    if (source_pos == -1 || dest_pos == -1) {
-        // Later
-        return patch;
-    }
+    // The new route may add a dependency between two scheduled voices
+    if (patch)
+        levels_dirty = true;
 
-    resort_to_respect_dependencies(mem, source);
     return patch;
 }
 } // namespace ngs
@@ -0,0 +1,187 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// NGS voice scheduler benchmark
+// Builds a system with player voices decoding a looping PCM buffer, routed through mixer voices into
+// a master voice, like a game playing many sounds at once. Runs the system updates and reports how
+// many voices are processed per millisecond.
+
+#include <kernel/state.h>
+#include <mem/functions.h>
+#include <ngs/modules/player.h>
+#include <ngs/state.h>
+#include <ngs/system.h>
+
+#include <CLI11.hpp>
+#include <fmt/format.h>
+
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+constexpr int32_t SAMPLE_RATE = 48000;
+constexpr int32_t PLAYERS_PER_MIXER = 16;
+
+struct BenchRack {
+    Address memspace = 0;
+    ngs::Rack *rack = nullptr;
+};
+
+BenchRack create_rack(ngs::State &ngs, MemState &mem, ngs::System *system, ngs::BussType type, int32_t voice_count, int32_t max_patches_per_input) {
+    SceNgsRackDescription description{};
+    description.definition = ngs::get_voice_definition(ngs, mem, type);
+    description.voice_count = voice_count;
+    description.channels_per_voice = 2;
+    description.max_patches_per_input = max_patches_per_input;
+    description.patches_per_output = 1;
+
+    BenchRack result;
+    const uint32_t size = ngs::Rack::get_required_memspace_size(mem, &description);
+    result.memspace = alloc(mem, size, "ngs rack");
+
+    SceNgsBufferInfo info{ Ptr<void>(result.memspace), size };
+    if (!ngs::init_rack(ngs, mem, system, &info, &description)) {
+        fmt::print(stderr, "failed to create a rack of {} voices\n", voice_count);
+        std::exit(1);
+    }
+
+    result.rack = Ptr<ngs::Rack>(result.memspace).get(mem);
+    return result;
+}
+
+void route(MemState &mem, ngs::System *system, ngs::Voice *source, ngs::Voice *dest, float volume) {
+    SceNgsPatchSetupInfo info{};
+    info.source = Ptr<ngs::Voice>(source, mem);
+    info.source_output_index = 0;
+    info.source_output_subindex = -1;
+    info.dest = Ptr<ngs::Voice>(dest, mem);
+    info.dest_input_index = 0;
+
+    ngs::Patch *patch = system->voice_scheduler.patch(mem, &info).get(mem);
+    patch->volume_matrix[0][0] = volume;
+    patch->volume_matrix[1][1] = volume;
+}
+
+double run(ngs::State &ngs, MemState &mem, KernelState &kern, Address pcm, uint32_t pcm_size, int32_t voice_count, uint32_t worker_count, int32_t granularity, int32_t update_count) {
+    const int32_t mixer_count = (voice_count + PLAYERS_PER_MIXER - 1) / PLAYERS_PER_MIXER;
+
+    SceNgsSystemInitParams params{};
+    params.max_racks = 3;
+    params.max_voices = voice_count + mixer_count + 1;
+    params.granularity = granularity;
+    params.sample_rate = SAMPLE_RATE;
+
+    const uint32_t system_size = ngs::System::get_required_memspace_size(&params);
+    const Address system_memspace = alloc(mem, system_size, "ngs system");
+    ngs::init_system(ngs, mem, &params, Ptr<void>(system_memspace), system_size);
+    ngs::System *system = Ptr<ngs::System>(system_memspace).get(mem);
+    system->voice_scheduler.worker_count = worker_count;
+
+    const BenchRack players = create_rack(ngs, mem, system, ngs::BussType::BUSS_SIMPLE, voice_count, 1);
+    const BenchRack mixers = create_rack(ngs, mem, system, ngs::BussType::BUSS_MIXER, mixer_count, PLAYERS_PER_MIXER);
+    const BenchRack master = create_rack(ngs, mem, system, ngs::BussType::BUSS_MASTER, 1, mixer_count);
+
+    ngs::Voice *master_voice = master.rack->voices[0].get(mem);
+    for (int32_t i = 0; i < mixer_count; i++)
+        route(mem, system, mixers.rack->voices[i].get(mem), master_voice, 1.0f / mixer_count);
+
+    for (int32_t i = 0; i < voice_count; i++) {
+        ngs::Voice *voice = players.rack->voices[i].get(mem);
+        route(mem, system, voice, mixers.rack->voices[i / PLAYERS_PER_MIXER].get(mem), 1.0f / PLAYERS_PER_MIXER);
+
+        // the buffer descriptions are const, the game fills them in guest memory
+        SceNgsPlayerParams *player_params = new (voice->datas[0].get_parameters<SceNgsPlayerParams>(mem)) SceNgsPlayerParams{};
+        new (&player_params->buffer_params[0]) SceNgsPlayerBufferParams{ Ptr<void>(pcm), static_cast<SceInt32>(pcm_size), -1, -1 };
+        player_params->playback_frequency = SAMPLE_RATE;
+        player_params->playback_scalar = 1.0f;
+        player_params->channels = 2;
+        player_params->type = ParameterAudioTypePCM;
+        // start every voice at a different position of the sound
+        player_params->start_bytes = (i * 4 * 97) % pcm_size;
+    }
+
+    for (int32_t i = 0; i < voice_count; i++)
+        system->voice_scheduler.play(mem, players.rack->voices[i].get(mem));
+    for (int32_t i = 0; i < mixer_count; i++)
+        system->voice_scheduler.play(mem, mixers.rack->voices[i].get(mem));
+    system->voice_scheduler.play(mem, master_voice);
+
+    // warm up, this also sorts the voices and starts the worker threads
+    for (int32_t i = 0; i < 10; i++)
+        system->voice_scheduler.update(kern, mem, 0);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < update_count; i++)
+        system->voice_scheduler.update(kern, mem, 0);
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    ngs::release_system(ngs, mem, system);
+    free(mem, master.memspace);
+    free(mem, mixers.memspace);
+    free(mem, players.memspace);
+    free(mem, system_memspace);
+
+    return elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<int32_t> voice_counts = { 64, 256, 1024 };
+    std::vector<uint32_t> worker_counts = { 0, 3 };
+    int32_t granularity = 512;
+    int32_t update_count = 1000;
+
+    CLI::App app{ "Vita3K NGS voice scheduler benchmark" };
+    app.add_option("--voices,-v", voice_counts, "Number of player voices, one run for each value")->check(CLI::Range(1, 4096));
+    app.add_option("--workers,-w", worker_counts, "Number of helper threads of the scheduler, one run for each value")->check(CLI::Range(0, 64));
+    app.add_option("--granularity,-g", granularity, "Samples produced by a voice on each update")->check(CLI::Range(64, 4096));
+    app.add_option("--updates,-n", update_count, "Number of system updates timed")->check(CLI::Range(1, 1000000));
+    CLI11_PARSE(app, argc, argv);
+
+    MemState mem;
+    if (!init(mem, false)) {
+        fmt::print(stderr, "failed to initialize the guest memory\n");
+        return 1;
+    }
+
+    KernelState kern;
+    ngs::State ngs;
+    ngs::init(ngs, mem);
+
+    // one second of a stereo 440Hz sine wave
+    const uint32_t pcm_size = SAMPLE_RATE * 2 * sizeof(int16_t);
+    const Address pcm = alloc(mem, pcm_size, "ngs bench pcm");
+    int16_t *samples = Ptr<int16_t>(pcm).get(mem);
+    for (int32_t i = 0; i < SAMPLE_RATE; i++) {
+        const auto sample = static_cast<int16_t>(std::sin(i * 440.0 * 2.0 * M_PI / SAMPLE_RATE) * 16384.0);
+        samples[i * 2] = sample;
+        samples[i * 2 + 1] = sample;
+    }
+
+    fmt::print("granularity: {}, updates: {}\n", granularity, update_count);
+    for (const int32_t voice_count : voice_counts) {
+        for (const uint32_t worker_count : worker_counts) {
+            const double ms = run(ngs, mem, kern, pcm, pcm_size, voice_count, worker_count, granularity, update_count);
+            fmt::print("voices: {:5}, workers: {:2}, elapsed: {:9.3f} ms, {:10.1f} voices per ms, {:7.1f} us per update\n",
+                voice_count, worker_count, ms, voice_count * static_cast<double>(update_count) / ms, ms * 1000.0 / update_count);
+        }
+    }
+
+    return 0;
+}
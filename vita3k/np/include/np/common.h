@@ -66,6 +66,7 @@ enum class NpTrophyError {
     TROPHY_ID_INVALID = 3,
     TROPHY_ALREADY_UNLOCKED = 4,
     TROPHY_PLATINUM_IS_UNBREAKABLE = 5, // Platinum is unbreakable
+    TROPHY_CONTEXT_FILE_INVALID = 6,
 };
 
 } // namespace np
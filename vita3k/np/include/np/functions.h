@@ -56,3 +56,6 @@ np::trophy::ContextHandle create_trophy_context(NpState &np, IOState *io, const
 
 np::trophy::Context *get_trophy_context(NpTrophyState &state, const np::trophy::ContextHandle handle);
 bool destroy_trophy_context(NpTrophyState &state, const np::trophy::ContextHandle handle);
+
+// Write the pending trophy progress files and stop the save thread
+void stop_trophy_progress_saves(NpTrophyState &state);
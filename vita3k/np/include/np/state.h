@@ -22,8 +22,11 @@
 
 #include <mem/util.h> // Address.
 
+#include <chrono>
+#include <condition_variable>
 #include <map>
 #include <mutex>
+#include <thread>
 #include <vector>
 
 struct SceNpServiceStateCallback {
@@ -50,6 +53,17 @@ struct NpTrophyState {
 
     std::vector<np::trophy::Context> contexts;
     NpTrophyUnlockCallback trophy_unlock_callback;
+
+    // The progress files are only written by the save thread, once no trophy was unlocked for a while
+    std::mutex save_mutex;
+    std::thread save_thread;
+    std::condition_variable save_cond;
+    std::chrono::steady_clock::time_point last_save;
+    // Latest content of each progress file which was not written yet
+    std::map<fs::path, std::vector<uint8_t>> pending_saves;
+    bool stop_save = false;
+
+    ~NpTrophyState();
 };
 
 enum SceNpServiceState : uint32_t {
@@ -25,6 +25,7 @@
 #include <array>
 
 struct IOState;
+struct NpTrophyState;
 
 namespace np::trophy {
 
@@ -46,6 +47,11 @@ enum class SceNpTrophyGrade : SceInt32 {
     SCE_NP_TROPHY_GRADE_BRONZE = 4
 };
 
+struct TrophyDetail {
+    std::string name;
+    std::string detail;
+};
+
 struct Context {
     bool valid{ true };
     TRPFile trophy_file;
@@ -67,17 +73,28 @@ struct Context {
     int32_t platinum_trophy_id{ SCE_NP_TROPHY_INVALID_TROPHY_ID };
 
     std::string trophy_progress_output_file_path;
-    std::string trophy_detail_xml;
+
+    // Parsed from TROP_xx.SFM the first time they are needed
+    bool trophy_detail_loaded{ false };
+    std::array<TrophyDetail, MAX_TROPHIES> trophy_details;
+    std::string trophy_set_name;
+    std::string trophy_set_detail;
 
     uint32_t lang{ 1 };
 
     IOState *io;
     fs::path pref_path;
+    // Owner of the thread writing the progress file
+    NpTrophyState *trophy_state = nullptr;
 
     void save_trophy_progress_file();
     bool load_trophy_progress_file(const SceUID &progress_input_file);
 
+    bool load_trophy_file();
+    bool load_trophy_details();
+
     int copy_file_data_from_trophy_file(const char *filename, void *buffer, SceSize *size);
+    bool get_trophy_file_data(const char *filename, std::vector<uint8_t> &buffer) const;
     int install_trophy_conf(IOState *io, const fs::path &pref_path, const std::string &np_com_id);
     bool init_info_from_trp();
     bool unlock_trophy(int32_t id, np::NpTrophyError *err, const bool force_unlock = false);
@@ -18,8 +18,8 @@
 #pragma once
 
 #include <cstdint>
-#include <functional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace np::trophy {
@@ -30,22 +30,20 @@ struct TRPEntry {
     uint64_t size;
 };
 
-using TRPSeekFunc = std::function<bool(int amount)>;
-using TRPReadFunc = std::function<bool(void *source, uint32_t amount)>;
-using TRPWriteFunc = std::function<bool(void *dest, uint32_t amount)>;
-
+// The whole archive is read once in memory, entries are then served straight from it
 struct TRPFile {
     std::vector<TRPEntry> entries;
+    std::vector<uint8_t> data;
 
-    TRPSeekFunc seek_func;
-    TRPReadFunc read_func;
+    // Entry filename -> index in entries
+    std::unordered_map<std::string, uint32_t> entry_indices;
 
     bool header_parse();
 
     explicit TRPFile() = default;
 
-    bool get_entry_data(const uint32_t idx, const TRPWriteFunc &write_func);
-    std::int32_t search_file(const char *name);
+    const uint8_t *get_entry_data(const uint32_t idx) const;
+    std::int32_t search_file(const char *name) const;
 };
 
 } // namespace np::trophy
@@ -41,6 +41,7 @@ bool init(NpTrophyState &state) {
 }
 
 bool deinit(NpTrophyState &state) {
+    stop_trophy_progress_saves(state);
     state.inited = false;
     return true;
 }
@@ -22,44 +22,111 @@
 #include <np/state.h>
 #include <np/trophy/context.h>
 
+#include <util/log.h>
+
 #include <pugixml.hpp>
 #include <spdlog/fmt/fmt.h>
 
+static constexpr auto SAVE_DELAY = std::chrono::milliseconds(500);
+
+// Write to a temporary file first so an interrupted write never leaves a truncated progress file
+static void write_trophy_progress_file(const fs::path &path, const std::vector<uint8_t> &data) {
+    const fs::path tmp_path = fs::path(path).concat(".tmp");
+    {
+        fs::ofstream file(tmp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            LOG_ERROR("Failed to open file: {}", tmp_path);
+            return;
+        }
+
+        file.write(reinterpret_cast<const char *>(data.data()), data.size());
+        if (!file) {
+            LOG_ERROR("Failed to write file: {}", tmp_path);
+            return;
+        }
+    }
+
+    boost::system::error_code err;
+    fs::rename(tmp_path, path, err);
+    if (err)
+        LOG_ERROR("Failed to replace {}: {}", path, err.message());
+}
+
+static void save_thread_main(NpTrophyState &state) {
+    std::unique_lock<std::mutex> lock(state.save_mutex);
+    while (true) {
+        state.save_cond.wait(lock, [&] { return !state.pending_saves.empty() || state.stop_save; });
+
+        // Batch the trophies unlocked in a row, like the ones given at the end of a level
+        while (!state.pending_saves.empty() && !state.stop_save) {
+            const auto deadline = state.last_save + SAVE_DELAY;
+            if (std::chrono::steady_clock::now() >= deadline)
+                break;
+            state.save_cond.wait_until(lock, deadline);
+        }
+
+        if (!state.pending_saves.empty()) {
+            const auto saves = std::move(state.pending_saves);
+            state.pending_saves.clear();
+
+            // The guest threads can keep unlocking trophies during the write
+            lock.unlock();
+            for (const auto &[path, data] : saves)
+                write_trophy_progress_file(path, data);
+            lock.lock();
+        }
+
+        if (state.stop_save)
+            return;
+    }
+}
+
+static void queue_trophy_progress_save(NpTrophyState &state, const fs::path &path, std::vector<uint8_t> data) {
+    std::lock_guard<std::mutex> lock(state.save_mutex);
+    state.pending_saves[path] = std::move(data);
+    state.last_save = std::chrono::steady_clock::now();
+    if (!state.save_thread.joinable())
+        state.save_thread = std::thread(save_thread_main, std::ref(state));
+    state.save_cond.notify_one();
+}
+
 namespace np::trophy {
 Context::Context(const CommunicationID &comm_id, IOState *io, const SceUID trophy_stream, const std::string &output_progress_path)
     : comm_id(comm_id)
     , trophy_file_stream(trophy_stream)
     , trophy_progress_output_file_path(output_progress_path)
     , io(io) {
-    trophy_file.read_func = [this](void *dest, std::uint32_t amount) -> bool {
-        return read_file(dest, *this->io, this->trophy_file_stream, amount, "parse_trophy_file");
-    };
+}
 
-    trophy_file.seek_func = [this](std::uint32_t amount) -> bool {
-        return seek_file(this->trophy_file_stream, amount, SCE_SEEK_SET, *this->io, "parse_trophy_file");
-    };
+bool Context::load_trophy_file() {
+    trophy_detail_loaded = false;
+
+    // Read the whole archive in one go, every later access is served from memory
+    const SceOff file_size = seek_file(trophy_file_stream, 0, SCE_SEEK_END, *io, "load_trophy_file");
+    if (file_size <= 0 || seek_file(trophy_file_stream, 0, SCE_SEEK_SET, *io, "load_trophy_file") != 0) {
+        return false;
+    }
+
+    trophy_file.data.resize(static_cast<std::size_t>(file_size));
+    if (read_file(trophy_file.data.data(), *io, trophy_file_stream, static_cast<SceSize>(file_size), "load_trophy_file") != file_size) {
+        trophy_file.data.clear();
+        return false;
+    }
+
+    return trophy_file.header_parse();
 }
 
 #define SET_TROPHY_BIT(arr, bit) arr[(bit) >> 5] |= (1 << ((bit)&31))
 
-static bool read_trophy_entry_to_buffer(TRPFile &trophy_file, const char *fname, std::string &buffer) {
-    // Read the trophy config
+static bool read_trophy_entry_to_buffer(const TRPFile &trophy_file, const char *fname, std::string &buffer) {
     const std::int32_t eidx = trophy_file.search_file(fname);
 
     if (eidx == -1) {
         return false;
     }
 
-    buffer.resize(trophy_file.entries[eidx].size);
-
-    // Read
-    std::uint32_t pointee = 0;
-    trophy_file.get_entry_data(static_cast<std::uint32_t>(eidx), [&](void *source, std::uint32_t amount) {
-        std::memcpy(&buffer[pointee], source, amount);
-        pointee += amount;
-
-        return true;
-    });
+    const auto *data = trophy_file.get_entry_data(static_cast<std::uint32_t>(eidx));
+    buffer.assign(reinterpret_cast<const char *>(data), trophy_file.entries[eidx].size);
 
     return true;
 }
@@ -80,20 +147,21 @@ int Context::copy_file_data_from_trophy_file(const char *filename, void *buffer,
     *size = std::min<SceSize>(static_cast<SceSize>(trophy_file.entries[file_index].size),
         *size);
 
-    std::uint32_t size_left = *size;
+    std::copy_n(trophy_file.get_entry_data(static_cast<std::uint32_t>(file_index)), *size, static_cast<std::uint8_t *>(buffer));
 
-    trophy_file.get_entry_data(static_cast<std::uint32_t>(file_index), [&](void *source, std::uint32_t source_size) -> bool {
-        if (size_left == 0)
-            return false;
+    return 0;
+}
 
-        source_size = std::min<std::uint32_t>(size_left, source_size);
-        std::copy_n(static_cast<std::uint8_t *>(source), source_size, static_cast<std::uint8_t *>(buffer));
+bool Context::get_trophy_file_data(const char *filename, std::vector<std::uint8_t> &buffer) const {
+    const std::int32_t file_index = trophy_file.search_file(filename);
 
-        buffer = static_cast<std::uint8_t *>(buffer) + source_size;
-        return true;
-    });
+    if (file_index == -1)
+        return false;
 
-    return 0;
+    const auto *data = trophy_file.get_entry_data(static_cast<std::uint32_t>(file_index));
+    buffer.assign(data, data + trophy_file.entries[file_index].size);
+
+    return true;
 }
 
 bool Context::init_info_from_trp() {
@@ -161,11 +229,10 @@ bool Context::init_info_from_trp() {
 static constexpr std::uint32_t TROPHY_USR_MAGIC = 0x12D5819A;
 
 void Context::save_trophy_progress_file() {
-    // Open the file
-    const SceUID output = open_file(*io, trophy_progress_output_file_path.c_str(), SCE_O_WRONLY | SCE_O_CREAT, pref_path, "save_trophy_progress");
-
-    auto write_stuff = [&](const void *data, std::uint32_t amount) -> int {
-        return write_file(output, data, amount, *io, "save_trophy_progress_file");
+    std::vector<std::uint8_t> data;
+    auto write_stuff = [&](const void *src, std::uint32_t amount) {
+        const auto *bytes = static_cast<const std::uint8_t *>(src);
+        data.insert(data.end(), bytes, bytes + amount);
     };
 
     write_stuff(&TROPHY_USR_MAGIC, 4);
@@ -179,7 +246,12 @@ void Context::save_trophy_progress_file() {
     write_stuff(unlock_timestamps.data(), (std::uint32_t)unlock_timestamps.size() * 8);
     write_stuff(trophy_kinds.data(), (std::uint32_t)trophy_kinds.size() * 4);
 
-    close_file(*io, output, "save_trophy_progress_file");
+    // Unlocking a trophy does not wait for the file to be written
+    const fs::path output_path = expand_path(*io, trophy_progress_output_file_path.c_str(), pref_path);
+    if (trophy_state)
+        queue_trophy_progress_save(*trophy_state, output_path, std::move(data));
+    else
+        write_trophy_progress_file(output_path, data);
 }
 
 bool Context::load_trophy_progress_file(const SceUID &progress_input_file) {
@@ -292,22 +364,21 @@ int Context::total_trophy_unlocked() {
     return total;
 }
 
-bool Context::get_trophy_details(const int32_t id, std::string &name, std::string &detail) {
-    if (id < 0 || id >= MAX_TROPHIES) {
-        return false;
+bool Context::load_trophy_details() {
+    if (trophy_detail_loaded) {
+        return true;
     }
 
-    if (trophy_detail_xml.empty()) {
-        const std::string fname = fmt::format("TROP_{:0>2d}.SFM", lang);
+    std::string trophy_detail_xml;
+    const std::string fname = fmt::format("TROP_{:0>2d}.SFM", lang);
 
-        if (!read_trophy_entry_to_buffer(trophy_file, fname.c_str(), trophy_detail_xml)) {
-            if (!read_trophy_entry_to_buffer(trophy_file, "TROP.SFM", trophy_detail_xml)) {
-                return false;
-            }
+    if (!read_trophy_entry_to_buffer(trophy_file, fname.c_str(), trophy_detail_xml)) {
+        if (!read_trophy_entry_to_buffer(trophy_file, "TROP.SFM", trophy_detail_xml)) {
+            return false;
         }
     }
 
-    // Parse it
+    // Parse it once, unlocking a trophy then only has to look the strings up
     pugi::xml_document doc;
     const auto result = doc.load_string(trophy_detail_xml.c_str());
 
@@ -315,41 +386,50 @@ bool Context::get_trophy_details(const int32_t id, std::string &name, std::strin
         return false;
     }
 
-    // Try to find the description for the id
-    for (const auto &trop : doc.child("trophyconf")) {
-        if ((trop.name() == std::string("trophy")) && (trop.attribute("id").as_uint() == id)) {
-            name = trop.child("name").text().as_string();
-            detail = trop.child("detail").text().as_string();
+    const auto trophy_conf = doc.child("trophyconf");
+    trophy_set_name = trophy_conf.child("title-name").text().as_string();
+    trophy_set_detail = trophy_conf.child("title-detail").text().as_string();
+
+    for (auto &detail : trophy_details)
+        detail = {};
 
-            break;
+    for (const auto &trop : trophy_conf) {
+        if (trop.name() == std::string("trophy")) {
+            const std::uint32_t id = trop.attribute("id").as_uint();
+            if (id >= MAX_TROPHIES || !trophy_details[id].name.empty())
+                continue;
+
+            trophy_details[id].name = trop.child("name").text().as_string();
+            trophy_details[id].detail = trop.child("detail").text().as_string();
         }
     }
 
-    return !name.empty() && !detail.empty();
+    trophy_detail_loaded = true;
+    return true;
 }
 
-bool Context::get_trophy_set(std::string &name, std::string &detail) {
-    if (trophy_detail_xml.empty()) {
-        const std::string fname = fmt::format("TROP_{:0>2d}.SFM", lang);
+bool Context::get_trophy_details(const int32_t id, std::string &name, std::string &detail) {
+    if (id < 0 || id >= MAX_TROPHIES) {
+        return false;
+    }
 
-        if (!read_trophy_entry_to_buffer(trophy_file, fname.c_str(), trophy_detail_xml)) {
-            if (!read_trophy_entry_to_buffer(trophy_file, "TROP.SFM", trophy_detail_xml)) {
-                return false;
-            }
-        }
+    if (!load_trophy_details()) {
+        return false;
     }
 
-    // Parse it
-    pugi::xml_document doc;
-    const auto result = doc.load_string(trophy_detail_xml.c_str());
+    name = trophy_details[id].name;
+    detail = trophy_details[id].detail;
 
-    if (!result) {
+    return !name.empty() && !detail.empty();
+}
+
+bool Context::get_trophy_set(std::string &name, std::string &detail) {
+    if (!load_trophy_details()) {
         return false;
     }
 
-    const auto trophy_conf = doc.child("trophyconf");
-    name = trophy_conf.child("title-name").text().as_string();
-    detail = trophy_conf.child("title-detail").text().as_string();
+    name = trophy_set_name;
+    detail = trophy_set_detail;
 
     return !name.empty() && !detail.empty();
 }
@@ -359,18 +439,13 @@ int Context::install_trophy_conf(IOState *io, const fs::path &pref_path, const s
 
     create_dir(*io, trophy_conf_path.c_str(), 0, pref_path, "create_trophy_context", true);
 
-    for (const auto &file : trophy_file.entries) {
-        std::vector<uint8_t> buf;
-        uint32_t size = (uint32_t)file.size;
-
-        buf.resize(size);
-
-        copy_file_data_from_trophy_file(file.filename.c_str(), &buf[0], &size);
+    for (std::uint32_t i = 0; i < trophy_file.entries.size(); i++) {
+        const auto &file = trophy_file.entries[i];
 
         auto trophy_conf_file = trophy_conf_path + file.filename;
         const SceUID trophy_conf_id = open_file(*io, trophy_conf_file.c_str(), SCE_O_WRONLY | SCE_O_CREAT, pref_path, "install_trophy_context");
 
-        write_file(trophy_conf_id, buf.data(), size, *io, "install_trophy_context");
+        write_file(trophy_conf_id, trophy_file.get_entry_data(i), static_cast<SceSize>(file.size), *io, "install_trophy_context");
 
         close_file(*io, trophy_conf_id, "install_trophy_context");
     }
@@ -417,6 +492,8 @@ np::trophy::ContextHandle create_trophy_context(NpState &np, IOState *io, const
 
     create_dir(*io, trophy_progress_save_file.c_str(), 0, pref_path, "create_trophy_context", true);
     trophy_progress_save_file += "TROPUSR.DAT";
+    // The progress of a context destroyed just before may not be written yet
+    stop_trophy_progress_saves(np.trophy_state);
     const SceUID trophy_progress_file_inp = open_file(*io, trophy_progress_save_file.c_str(), SCE_O_RDONLY, pref_path, "create_trophy_context");
 
     np::trophy::Context *new_context = nullptr;
@@ -428,6 +505,7 @@ np::trophy::ContextHandle create_trophy_context(NpState &np, IOState *io, const
             context.comm_id = *custom_comm;
             context.trophy_file_stream = trophy_file;
             context.trophy_progress_output_file_path = trophy_progress_save_file;
+            context.trophy_state = &np.trophy_state;
             context.valid = true;
 
             new_context = &context;
@@ -441,10 +519,18 @@ np::trophy::ContextHandle create_trophy_context(NpState &np, IOState *io, const
 
         new_context = &np.trophy_state.contexts.back();
         new_context->pref_path = pref_path;
+        new_context->trophy_state = &np.trophy_state;
     }
 
     new_context->lang = lang;
-    new_context->trophy_file.header_parse();
+    if (!new_context->load_trophy_file()) {
+        LOG_ERROR("Failed to load trophy file: {}", trophy_file_path);
+        if (trophy_progress_file_inp > 0)
+            close_file(*io, trophy_progress_file_inp, "create_trophy_context");
+        close_file(*io, trophy_file, "create_trophy_context");
+        new_context->valid = false;
+        TROPHY_RET_ERROR(TROPHY_CONTEXT_FILE_INVALID);
+    }
 
     new_context->install_trophy_conf(io, pref_path, unique_trophy_folder);
 
@@ -482,3 +568,20 @@ bool destroy_trophy_context(NpTrophyState &state, const np::trophy::ContextHandl
 
     return true;
 }
+
+void stop_trophy_progress_saves(NpTrophyState &state) {
+    if (!state.save_thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(state.save_mutex);
+        state.stop_save = true;
+    }
+    state.save_cond.notify_one();
+    state.save_thread.join();
+    state.stop_save = false;
+}
+
+NpTrophyState::~NpTrophyState() {
+    stop_trophy_progress_saves(*this);
+}
@@ -23,111 +23,78 @@
 namespace np::trophy {
 
 static constexpr std::uint32_t NP_TRP_HEADER_MAGIC = 0x004DA2DC;
+static constexpr std::uint32_t NP_TRP_ENTRY_INFO_SIZE = 0x40;
+
+template <typename T>
+static T read_be(const std::vector<uint8_t> &data, const std::size_t offset) {
+    T value;
+    std::memcpy(&value, &data[offset], sizeof(T));
+    return network_to_host_order(value);
+}
 
 bool TRPFile::header_parse() {
-    std::uint32_t magic = 0;
-    if (!read_func(&magic, 4) || magic != NP_TRP_HEADER_MAGIC) {
-        // Magic not match.... Return
+    entries.clear();
+    entry_indices.clear();
+
+    if (data.size() < 0x18) {
         return false;
     }
 
-    // Seek and read entry count and start of data section
-    seek_func(0x10);
-
-    std::int32_t entry_count = 0;
-    std::int32_t entry_info_off = 0;
-    if (!read_func(&entry_count, 4)) {
+    std::uint32_t magic = 0;
+    std::memcpy(&magic, data.data(), 4);
+    if (magic != NP_TRP_HEADER_MAGIC) {
+        // Magic not match.... Return
         return false;
     }
 
-    entry_count = network_to_host_order(entry_count);
-
-    // Resize to total of entry
-    entries.resize(entry_count);
+    // Read entry count and start of the entry infos
+    const std::uint32_t entry_count = read_be<std::uint32_t>(data, 0x10);
+    const std::uint32_t entry_info_off = read_be<std::uint32_t>(data, 0x14);
 
-    // Read the data area offset
-    if (!read_func(&entry_info_off, 4)) {
+    if (entry_info_off + static_cast<std::uint64_t>(entry_count) * NP_TRP_ENTRY_INFO_SIZE > data.size()) {
         return false;
     }
 
-    entry_info_off = network_to_host_order(entry_info_off);
-
-    seek_func(entry_info_off);
-
-    // Start reading all entry infos
-    for (std::int32_t i = 0; i < entry_count; i++) {
-        // Read null terminated string. That's the filename
-        char temp = 0;
+    entries.resize(entry_count);
 
-        do {
-            if (!read_func(&temp, 1)) {
-                return false;
-            }
+    for (std::uint32_t i = 0; i < entry_count; i++) {
+        const std::size_t info_off = entry_info_off + i * NP_TRP_ENTRY_INFO_SIZE;
 
-            entries[i].filename += temp;
-        } while (temp != '\0');
+        // Null terminated string at the start of the info. That's the filename
+        const char *name = reinterpret_cast<const char *>(&data[info_off]);
+        entries[i].filename.assign(name, strnlen(name, 0x20));
 
-        seek_func(entry_info_off + (i * 0x40) + 0x20);
+        // Read offset from the beginning and size, the other 16 bytes are not known, so ignore
+        entries[i].offset = read_be<std::uint64_t>(data, info_off + 0x20);
+        entries[i].size = read_be<std::uint64_t>(data, info_off + 0x28);
 
-        // Read offset from the beginning and size
-        if (!read_func(&entries[i].offset, 8)) {
+        if (entries[i].offset > data.size() || entries[i].size > data.size() - entries[i].offset) {
             return false;
         }
 
-        if (!read_func(&entries[i].size, 8)) {
-            return false;
-        }
-
-        entries[i].offset = network_to_host_order(entries[i].offset);
-        entries[i].size = network_to_host_order(entries[i].size);
-
-        // Other 16 bytes are not known, so ignore
-        if (!seek_func(entry_info_off + (i * 0x40) + 0x20 + 16 + 0x10)) {
-            return false;
-        }
+        entry_indices.emplace(entries[i].filename, i);
     }
 
     // Reading header done. Bye!
     return true;
 }
 
-bool TRPFile::get_entry_data(const uint32_t idx, const TRPWriteFunc &write_func) {
+const uint8_t *TRPFile::get_entry_data(const uint32_t idx) const {
     // Check if the index is not out of range
     if (idx >= entries.size()) {
-        return false;
-    }
-
-    // Get the target offset
-    if (!seek_func(static_cast<int>(entries[idx].offset))) {
-        return false;
+        return nullptr;
     }
 
-    // Read chunk by chunk and write to out
-    static constexpr std::uint32_t COPY_CHUNK_SIZE = 0x10000;
-    std::uint64_t bytes_left = entries[idx].size;
-
-    std::vector<char> copy_buffer;
-    copy_buffer.resize(COPY_CHUNK_SIZE);
-
-    while (bytes_left != 0) {
-        const std::uint32_t copy_size = std::min<std::uint32_t>(static_cast<std::uint32_t>(bytes_left),
-            COPY_CHUNK_SIZE);
-
-        if (!read_func(&copy_buffer[0], copy_size)) {
-            return false;
-        }
-
-        if (!write_func(&copy_buffer[0], copy_size)) {
-            return false;
-        }
+    return data.data() + entries[idx].offset;
+}
 
-        bytes_left -= copy_size;
+std::int32_t TRPFile::search_file(const char *name) const {
+    const auto it = entry_indices.find(name);
+    if (it != entry_indices.end()) {
+        return static_cast<std::int32_t>(it->second);
     }
 
-    return true;
-}
-
-std::int32_t TRPFile::search_file(const char *name) {
+    // Fall back to a prefix match
     auto name_len = strlen(name);
     for (std::size_t i = 0; i < entries.size(); i++) {
         if (strncmp(entries[i].filename.c_str(), name, name_len) == 0) {
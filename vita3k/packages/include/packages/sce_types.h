@@ -22,8 +22,16 @@
 
 #pragma once
 
+#include <util/fs.h>
 #include <util/log.h>
 
+#include <cstring>
+#include <istream>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
 // Credits to TeamMolecule for their original work on this https://github.com/TeamMolecule/sceutils
 
 #define SCE_MAGIC 0x00454353
@@ -653,7 +661,12 @@ public:
 void register_keys(KeyStore &SCE_KEYS, int type);
 void extract_fat(const fs::path &partition_path, const std::string &partition, const fs::path &pref_path);
 std::string decompress_segments(const std::vector<uint8_t> &decrypted_data, const uint64_t &size);
-std::tuple<uint64_t, SelfType> get_key_type(std::ifstream &file, const SceHeader &sce_hdr);
-std::vector<SceSegment> get_segments(std::ifstream &file, const SceHeader &sce_hdr, KeyStore &SCE_KEYS, uint64_t sysver = -1, SelfType self_type = static_cast<SelfType>(0), int keytype = 0, unsigned char *klictxt = 0);
+std::string decompress_segments(const uint8_t *data, uint64_t size);
+std::tuple<uint64_t, SelfType> get_key_type(std::istream &file, const SceHeader &sce_hdr);
+std::vector<SceSegment> get_segments(std::istream &file, const SceHeader &sce_hdr, KeyStore &SCE_KEYS, uint64_t sysver = -1, SelfType self_type = static_cast<SelfType>(0), int keytype = 0, unsigned char *klictxt = 0);
 void decrypt_fself(const fs::path &file_path, KeyStore &SCE_KEYS, unsigned char *klictxt);
 bool is_self(const fs::path &file_path);
+
+// Decrypts the os0, vs0 and sa0 packages of a PUP into os0.img, vs0.img and sa0.img in output_path,
+// using thread_count workers or one per core when 0
+void decrypt_pup_images(const fs::path &pup_path, const fs::path &output_path, KeyStore &SCE_KEYS, uint32_t thread_count = 0);
@@ -30,8 +30,16 @@
 #include <util/string_utils.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
 #include <fstream>
 #include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <thread>
 
 // Credits to TeamMolecule for their original work on this https://github.com/TeamMolecule/sceutils
 
@@ -77,177 +85,274 @@ static const char *FSTYPE[] = {
     "psp_emulist",
 };
 
-static std::string make_filename(unsigned char *hdr, int64_t filetype) {
+constexpr int SCEUF_HEADER_SIZE = 0x80;
+constexpr int SCEUF_FILEREC_SIZE = 0x20;
+
+// Partitions installed from the firmware, every package of these types is a part of the FAT image of the partition
+static const std::array<const char *, 3> PUP_IMAGES = { "os0", "vs0", "sa0" };
+
+struct PupRecord {
+    uint64_t filetype;
+    uint64_t offset;
+    uint64_t length;
+};
+
+struct PupHeader {
+    uint32_t pup_version;
+    uint32_t firmware_version;
+    uint32_t build_number;
+    std::vector<PupRecord> records;
+};
+
+// The PUP is shared by the decryption workers, reads are serialized on its handle
+struct PupReader {
+    FILE *file = nullptr;
+    std::mutex mutex;
+
+    bool read(uint64_t offset, void *data, uint64_t size) {
+        const std::lock_guard<std::mutex> lock(mutex);
+        return (fseek(file, offset, SEEK_SET) == 0) && (fread(data, 1, size, file) == size);
+    }
+};
+
+// Buffers and cipher kept by a worker from one package to the next
+struct PackageDecryptor {
+    EVP_CIPHER_CTX *cipher_ctx = EVP_CIPHER_CTX_new();
+    EVP_CIPHER *cipher = EVP_CIPHER_fetch(nullptr, "AES-128-CTR", nullptr);
+    std::vector<char> header;
+    std::vector<uint8_t> segment;
+
+    ~PackageDecryptor() {
+        EVP_CIPHER_CTX_free(cipher_ctx);
+        EVP_CIPHER_free(cipher);
+    }
+};
+
+static bool read_pup_header(PupReader &pup, PupHeader &pup_header) {
+    char header[SCEUF_HEADER_SIZE];
+    if (!pup.read(0, header, SCEUF_HEADER_SIZE) || (strncmp(header, "SCEUF", 5) != 0)) {
+        LOG_ERROR("Invalid PUP");
+        return false;
+    }
+
+    uint32_t cnt = 0;
+    memcpy(&cnt, &header[0x18], 4);
+    memcpy(&pup_header.pup_version, &header[8], 4);
+    memcpy(&pup_header.firmware_version, &header[0x10], 4);
+    memcpy(&pup_header.build_number, &header[0x14], 4);
+
+    std::vector<char> recs(static_cast<size_t>(cnt) * SCEUF_FILEREC_SIZE);
+    if (!pup.read(SCEUF_HEADER_SIZE, recs.data(), recs.size())) {
+        LOG_ERROR("Invalid PUP file records");
+        return false;
+    }
+
+    pup_header.records.resize(cnt);
+    for (uint32_t x = 0; x < cnt; x++) {
+        const char *rec = &recs[x * SCEUF_FILEREC_SIZE];
+        memcpy(&pup_header.records[x].filetype, &rec[0], 8);
+        memcpy(&pup_header.records[x].offset, &rec[8], 8);
+        memcpy(&pup_header.records[x].length, &rec[16], 8);
+    }
+
+    return true;
+}
+
+// Index in PUP_IMAGES of the partition the package belongs to, -1 for any other entry
+static int get_image_index(PupReader &pup, const PupRecord &record) {
+    unsigned char hdr[HEADER_LENGTH] = {};
+    if (!pup.read(record.offset, hdr, std::min<uint64_t>(record.length, HEADER_LENGTH)))
+        return -1;
+
     uint32_t magic = 0;
     uint32_t version = 0;
     uint32_t flags = 0;
-    uint32_t moffs = 0;
     uint64_t metaoffs = 0;
     memcpy(&magic, &hdr[0], 4);
     memcpy(&version, &hdr[4], 4);
     memcpy(&flags, &hdr[8], 4);
-    memcpy(&moffs, &hdr[12], 4);
     memcpy(&metaoffs, &hdr[16], 8);
 
-    if (magic == SCE_MAGIC && version == 3 && flags == 0x30040) {
-        std::vector meta = std::vector<unsigned char>(&hdr[0] + metaoffs, &hdr[0] + (HEADER_LENGTH - metaoffs));
-        unsigned char t = 0;
-        memcpy(&t, &meta[4], 1);
+    if (magic != SCE_MAGIC || version != 3 || flags != 0x30040 || metaoffs + 4 >= HEADER_LENGTH)
+        return -1;
 
-        static int typecount = 0;
+    const unsigned char t = hdr[metaoffs + 4];
+    if (t >= std::size(FSTYPE)) // 0x1C is the file separator
+        return -1;
 
-        if (t < 0x1C) { // 0x1C is the file separator
-            std::string name = fmt::format("{}-{:0>2}.pkg", FSTYPE[t], typecount);
-            typecount++;
-            return name;
-        }
+    for (size_t i = 0; i < PUP_IMAGES.size(); i++) {
+        if (strcmp(FSTYPE[t], PUP_IMAGES[i]) == 0)
+            return static_cast<int>(i);
     }
-    return fmt::format("unknown-0x{:X}.pkg", filetype);
-}
 
-static void extract_pup_files(const fs::path &pup, const fs::path &output) {
-    constexpr int SCEUF_HEADER_SIZE = 0x80;
-    constexpr int SCEUF_FILEREC_SIZE = 0x20;
-
-    FILE *infile = host::dialog::filesystem::resolve_host_handle(pup);
-    char header[SCEUF_HEADER_SIZE];
-    fread(header, SCEUF_HEADER_SIZE, 1, infile);
+    return -1;
+}
 
-    if (strncmp(header, "SCEUF", 5) != 0) {
-        LOG_ERROR("Invalid PUP");
-        fclose(infile);
+static void extract_pup_files(const fs::path &pup_path, const fs::path &output) {
+    PupReader pup;
+    pup.file = host::dialog::filesystem::resolve_host_handle(pup_path);
+    PupHeader header;
+    if (!pup.file || !read_pup_header(pup, header)) {
+        if (pup.file)
+            fclose(pup.file);
         return;
     }
 
-    uint32_t cnt = 0;
-    uint32_t pup_version = 0;
-    uint32_t firmware_version = 0;
-    uint32_t build_number = 0;
-    memcpy(&cnt, &header[0x18], 4);
-    memcpy(&pup_version, &header[8], 4);
-    memcpy(&firmware_version, &header[0x10], 4);
-    memcpy(&build_number, &header[0x14], 4);
-
-    LOG_INFO("PUP Version: 0x{:0}", pup_version);
-    LOG_INFO("Firmware Version: 0x{:X}", firmware_version);
-    LOG_INFO("Build Number: {:0}", build_number);
-    LOG_INFO("Number Of Files: {}", cnt);
-
-    for (uint32_t x = 0; x < cnt; x++) {
-        fseek(infile, SCEUF_HEADER_SIZE + x * SCEUF_FILEREC_SIZE, SEEK_SET);
-        char rec[SCEUF_FILEREC_SIZE];
-        fread(rec, SCEUF_FILEREC_SIZE, 1, infile);
-
-        uint64_t filetype = 0;
-        uint64_t offset = 0;
-        uint64_t length = 0;
-        uint64_t flags = 0;
-
-        memcpy(&filetype, &rec[0], 8);
-        memcpy(&offset, &rec[8], 8);
-        memcpy(&length, &rec[16], 8);
-        memcpy(&flags, &rec[24], 8);
-
-        std::string filename = "";
-        if (PUP_TYPES.contains(filetype)) {
-            filename = PUP_TYPES.at(filetype);
-        } else {
-            fseek(infile, offset, SEEK_SET);
-            char hdr[HEADER_LENGTH];
-            fread(hdr, HEADER_LENGTH, 1, infile);
-            filename = make_filename((unsigned char *)hdr, filetype);
+    LOG_INFO("PUP Version: 0x{:0}", header.pup_version);
+    LOG_INFO("Firmware Version: 0x{:X}", header.firmware_version);
+    LOG_INFO("Build Number: {:0}", header.build_number);
+    LOG_INFO("Number Of Files: {}", header.records.size());
+
+    // Packages are decrypted straight from the PUP, only the plain files are written out
+    std::vector<char> buffer;
+    for (const auto &record : header.records) {
+        if (!PUP_TYPES.contains(record.filetype))
+            continue;
+
+        buffer.resize(record.length);
+        if (!pup.read(record.offset, buffer.data(), record.length)) {
+            LOG_ERROR("Failed to read {} from the PUP", PUP_TYPES.at(record.filetype));
+            continue;
         }
 
-        fs::ofstream outfile(output / filename, std::ios::binary);
-        fseek(infile, offset, SEEK_SET);
-        std::vector<char> buffer(length);
-        fread(buffer.data(), length, 1, infile);
-        outfile.write(&buffer[0], length);
-
-        outfile.close();
+        fs::ofstream outfile(output / PUP_TYPES.at(record.filetype), std::ios::binary);
+        outfile.write(buffer.data(), buffer.size());
     }
-    fclose(infile);
+    fclose(pup.file);
 }
 
-static void decrypt_segments(std::ifstream &infile, const fs::path &outdir, const fs::path &filename, KeyStore &SCE_KEYS) {
-    char sceheaderbuffer[SceHeader::Size];
-    infile.read(sceheaderbuffer, SceHeader::Size);
-    const SceHeader sce_hdr = SceHeader(sceheaderbuffer);
+static std::string decrypt_package(PupReader &pup, const PupRecord &record, KeyStore &SCE_KEYS, PackageDecryptor &decryptor) {
+    auto &header = decryptor.header;
+    header.resize(SceHeader::Size);
+    if (!pup.read(record.offset, header.data(), SceHeader::Size))
+        return {};
+    const SceHeader sce_hdr = SceHeader(header.data());
 
-    const auto sysver = std::get<0>(get_key_type(infile, sce_hdr));
-    const SelfType selftype = std::get<1>(get_key_type(infile, sce_hdr));
-
-    EVP_CIPHER_CTX *cipher_ctx = EVP_CIPHER_CTX_new();
-    EVP_CIPHER *cipher = EVP_CIPHER_fetch(nullptr, "AES-128-CTR", nullptr);
-    int dec_len = 0;
+    // The metadata and the SPKG header are all get_segments and get_key_type look at
+    header.resize(std::min<uint64_t>(sce_hdr.header_length + SpkgHeader::Size, record.length));
+    if (!pup.read(record.offset, header.data(), header.size()))
+        return {};
+    std::istringstream infile(std::string(header.data(), header.size()), std::ios::binary);
 
+    const auto [sysver, selftype] = get_key_type(infile, sce_hdr);
     const auto scesegs = get_segments(infile, sce_hdr, SCE_KEYS, sysver, selftype);
-    for (const auto &sceseg : scesegs) {
-        fs::ofstream outfile(outdir / fs_utils::path_concat(filename, ".seg02"), std::ios::binary);
-        infile.seekg(sceseg.offset);
-        std::vector<unsigned char> encrypted_data(sceseg.size);
-        infile.read((char *)&encrypted_data[0], sceseg.size);
-
-        std::vector<unsigned char> decrypted_data(sceseg.size);
-        EVP_DecryptInit_ex(cipher_ctx, cipher, nullptr, reinterpret_cast<const unsigned char *>(sceseg.key.c_str()), reinterpret_cast<const unsigned char *>(sceseg.iv.c_str()));
-        EVP_CIPHER_CTX_set_padding(cipher_ctx, 0);
-        EVP_DecryptUpdate(cipher_ctx, decrypted_data.data(), &dec_len, encrypted_data.data(), sceseg.size);
-        EVP_DecryptFinal_ex(cipher_ctx, decrypted_data.data() + dec_len, &dec_len);
-
-        if (sceseg.compressed) {
-            const std::string decompressed_data = decompress_segments(decrypted_data, sceseg.size);
-            outfile.write(decompressed_data.c_str(), decompressed_data.size());
-        } else {
-            outfile.write((char *)&decrypted_data[0], sceseg.size);
-        }
-        outfile.close();
+    if (scesegs.empty())
+        return {};
+
+    // Every segment of a package went through the same .seg02 file before being joined, so only the last one
+    // has ever been part of the image
+    const SceSegment &sceseg = scesegs.back();
+    if (sceseg.offset + sceseg.size > record.length) {
+        LOG_ERROR("Package segment at 0x{:X} is out of bounds", record.offset + sceseg.offset);
+        return {};
     }
 
-    EVP_CIPHER_CTX_free(cipher_ctx);
-    EVP_CIPHER_free(cipher);
-};
+    std::string plain_data;
+    uint8_t *data = nullptr;
+    if (sceseg.compressed) {
+        decryptor.segment.resize(sceseg.size);
+        data = decryptor.segment.data();
+    } else {
+        plain_data.resize(sceseg.size);
+        data = reinterpret_cast<uint8_t *>(plain_data.data());
+    }
 
-static void join_files(const fs::path &path, const std::string &filename, const fs::path &output) {
-    std::vector<fs::path> files;
+    if (!pup.read(record.offset + sceseg.offset, data, sceseg.size))
+        return {};
 
-    for (auto &p : fs::directory_iterator(path)) {
-        if (p.path().filename().string().substr(0, 4) == filename) {
-            files.push_back(p.path());
-        }
-    }
+    // CTR decryption is done in place
+    int dec_len = 0;
+    EVP_DecryptInit_ex(decryptor.cipher_ctx, decryptor.cipher, nullptr, reinterpret_cast<const unsigned char *>(sceseg.key.c_str()), reinterpret_cast<const unsigned char *>(sceseg.iv.c_str()));
+    EVP_CIPHER_CTX_set_padding(decryptor.cipher_ctx, 0);
+    EVP_DecryptUpdate(decryptor.cipher_ctx, data, &dec_len, data, static_cast<int>(sceseg.size));
+    EVP_DecryptFinal_ex(decryptor.cipher_ctx, data + dec_len, &dec_len);
 
-    std::sort(files.begin(), files.end());
+    if (sceseg.compressed)
+        return decompress_segments(data, sceseg.size);
 
-    fs::ofstream fileout(output, std::ios::binary);
-    for (const auto &file : files) {
-        fs::ifstream filein(file, std::ios::binary);
-        std::vector<char> buffer(fs::file_size(file));
-        filein.read(&buffer[0], fs::file_size(file));
-        fileout.write(&buffer[0], fs::file_size(file));
-        filein.close();
-        fs::remove(file);
-    }
-    fileout.close();
+    return plain_data;
 }
 
-static void decrypt_pup_packages(const fs::path &src, const fs::path &dest, KeyStore &SCE_KEYS) {
-    std::vector<fs::path> pkgfiles;
+void decrypt_pup_images(const fs::path &pup_path, const fs::path &output_path, KeyStore &SCE_KEYS, uint32_t thread_count) {
+    // The images are always created, an empty one means the PUP does not update that partition
+    std::array<fs::ofstream, PUP_IMAGES.size()> images;
+    for (size_t i = 0; i < PUP_IMAGES.size(); i++)
+        images[i].open(output_path / fmt::format("{}.img", PUP_IMAGES[i]), std::ios::binary);
+
+    PupReader pup;
+    pup.file = host::dialog::filesystem::resolve_host_handle(pup_path);
+    PupHeader header;
+    if (!pup.file || !read_pup_header(pup, header)) {
+        if (pup.file)
+            fclose(pup.file);
+        return;
+    }
 
-    for (const auto &p : fs::directory_iterator(src)) {
-        if (p.path().filename().extension().string() == ".pkg")
-            pkgfiles.push_back(p.path().filename());
+    struct ImagePart {
+        PupRecord record;
+        size_t image;
+    };
+    std::vector<ImagePart> parts;
+    for (const auto &record : header.records) {
+        if (PUP_TYPES.contains(record.filetype))
+            continue;
+        const int image = get_image_index(pup, record);
+        if (image >= 0)
+            parts.push_back({ record, static_cast<size_t>(image) });
     }
 
-    for (const auto &filename : pkgfiles) {
-        const fs::path &filepath = src / filename;
-        fs::ifstream infile(filepath, std::ios::binary);
-        decrypt_segments(infile, dest, filename, SCE_KEYS);
-        infile.close();
+    if (thread_count == 0)
+        thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+    thread_count = std::min<uint32_t>(thread_count, parts.size());
+
+    // Workers decrypt the packages in any order while this thread appends them to the images in PUP order,
+    // a worker does not get further than a couple of packages per thread ahead of the writer
+    const size_t max_ahead = thread_count * 2;
+    std::vector<std::optional<std::string>> results(parts.size());
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t next_write = 0;
+    std::atomic<size_t> next_part = 0;
+
+    const auto decrypt_parts = [&]() {
+        PackageDecryptor decryptor;
+        for (size_t index = next_part++; index < parts.size(); index = next_part++) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&]() { return index < next_write + max_ahead; });
+            }
+
+            std::string data = decrypt_package(pup, parts[index].record, SCE_KEYS, decryptor);
+            {
+                const std::lock_guard<std::mutex> lock(mutex);
+                results[index] = std::move(data);
+            }
+            cond.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < thread_count; i++)
+        threads.emplace_back(decrypt_parts);
+
+    for (size_t index = 0; index < parts.size(); index++) {
+        std::string data;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&]() { return results[index].has_value(); });
+            data = std::move(*results[index]);
+            results[index].reset();
+            next_write = index + 1;
+        }
+        cond.notify_all();
+
+        images[parts[index].image].write(data.data(), data.size());
     }
 
-    join_files(dest, "os0-", dest / "os0.img");
-    join_files(dest, "vs0-", dest / "vs0.img");
-    join_files(dest, "sa0-", dest / "sa0.img");
+    for (auto &thread : threads)
+        thread.join();
+
+    fclose(pup.file);
 }
 
 void install_pup(const fs::path &pref_path, const fs::path &pup_path, const std::function<void(uint32_t)> &progress_callback) {
@@ -273,30 +378,39 @@ void install_pup(const fs::path &pref_path, const fs::path &pup_path, const std:
     register_keys(SCE_KEYS, 0);
 
     progress_callback(30);
-    decrypt_pup_packages(pup_dest, pup_dec, SCE_KEYS);
+    decrypt_pup_images(pup_path, pup_dec, SCE_KEYS);
 
     progress_callback(70);
-    if (fs::file_size(pup_dec / "os0.img") > 0) {
-        extract_fat(pup_dec, "os0.img", pref_path);
-        for (const auto &file : fs::recursive_directory_iterator(pref_path / "os0")) {
-            if (fs::is_regular_file(file.path())) {
-                if (is_self(file.path())) {
-                    decrypt_fself(file.path(), SCE_KEYS, 0);
-                }
-            }
-        }
-    }
-    if (fs::file_size(pup_dec / "sa0.img") > 0)
-        extract_fat(pup_dec, "sa0.img", pref_path);
-    if (fs::file_size(pup_dec / "vs0.img") > 0) {
-        extract_fat(pup_dec, "vs0.img", pref_path);
-        for (const auto &file : fs::recursive_directory_iterator(pref_path / "vs0")) {
-            if (fs::is_regular_file(file.path())) {
-                if (is_self(file.path())) {
-                    decrypt_fself(file.path(), SCE_KEYS, nullptr);
-                }
-            }
+    std::vector<fs::path> self_files;
+    for (const auto partition : { "os0", "sa0", "vs0" }) {
+        const auto image = fmt::format("{}.img", partition);
+        if (fs::file_size(pup_dec / image) == 0)
+            continue;
+
+        extract_fat(pup_dec, image, pref_path);
+        if (strcmp(partition, "sa0") == 0)
+            continue;
+
+        for (const auto &file : fs::recursive_directory_iterator(pref_path / partition)) {
+            if (fs::is_regular_file(file.path()) && is_self(file.path()))
+                self_files.push_back(file.path());
         }
     }
+
+    // Modules are independent from each other, decrypt them on every core
+    std::atomic<size_t> next_self = 0;
+    const auto decrypt_selfs = [&]() {
+        for (size_t index = next_self++; index < self_files.size(); index = next_self++)
+            decrypt_fself(self_files[index], SCE_KEYS, nullptr);
+    };
+
+    const size_t thread_count = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1U), self_files.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < thread_count; i++)
+        threads.emplace_back(decrypt_selfs);
+    decrypt_selfs();
+    for (auto &thread : threads)
+        thread.join();
+
     progress_callback(100);
 }
@@ -674,6 +674,10 @@ void extract_fat(const fs::path &partition_path, const std::string &partition, c
 }
 
 std::string decompress_segments(const std::vector<uint8_t> &decrypted_data, const uint64_t &size) {
+    return decompress_segments(decrypted_data.data(), size);
+}
+
+std::string decompress_segments(const uint8_t *data, uint64_t size) {
     mz_stream stream;
     stream.zalloc = Z_NULL;
     stream.zfree = Z_NULL;
@@ -685,25 +689,24 @@ std::string decompress_segments(const std::vector<uint8_t> &decrypted_data, cons
         return "";
     }
 
-    const std::string compressed_data((char *)&decrypted_data[0], size);
-    stream.next_in = (const Bytef *)compressed_data.data();
-    stream.avail_in = compressed_data.size();
+    stream.next_in = data;
+    stream.avail_in = static_cast<unsigned int>(size);
 
+    // Inflate straight into the result, growing it geometrically instead of going through a small bounce buffer
     int ret = 0;
-    char outbuffer[4096];
-    std::string decompressed_data;
+    std::string decompressed_data(std::max<uint64_t>(size * 2, 4096), '\0');
 
     do {
-        stream.next_out = reinterpret_cast<Bytef *>(outbuffer);
-        stream.avail_out = sizeof(outbuffer);
+        if (stream.total_out == decompressed_data.size())
+            decompressed_data.resize(decompressed_data.size() * 2);
 
-        ret = mz_inflate(&stream, 0);
+        stream.next_out = reinterpret_cast<Bytef *>(&decompressed_data[stream.total_out]);
+        stream.avail_out = static_cast<unsigned int>(decompressed_data.size() - stream.total_out);
 
-        if (decompressed_data.size() < stream.total_out) {
-            decompressed_data.append(outbuffer, stream.total_out - decompressed_data.size());
-        }
+        ret = mz_inflate(&stream, 0);
     } while (ret == MZ_OK);
 
+    decompressed_data.resize(stream.total_out);
     mz_inflateEnd(&stream);
 
     if (ret != MZ_STREAM_END) {
@@ -980,7 +983,7 @@ void make_fself(const fs::path &input_file, const fs::path &output_file, uint64_
     fileout.close();
 }
 
-std::vector<SceSegment> get_segments(std::ifstream &file, const SceHeader &sce_hdr, KeyStore &SCE_KEYS, const uint64_t sysver, const SelfType self_type, int keytype, unsigned char *klictxt) {
+std::vector<SceSegment> get_segments(std::istream &file, const SceHeader &sce_hdr, KeyStore &SCE_KEYS, const uint64_t sysver, const SelfType self_type, int keytype, unsigned char *klictxt) {
     file.seekg(sce_hdr.metadata_offset + 48);
     std::vector<char> dat(sce_hdr.header_length - sce_hdr.metadata_offset - 48);
     file.read(&dat[0], sce_hdr.header_length - sce_hdr.metadata_offset - 48);
@@ -1069,7 +1072,7 @@ std::vector<SceSegment> get_segments(std::ifstream &file, const SceHeader &sce_h
     return segs;
 }
 
-std::tuple<uint64_t, SelfType> get_key_type(std::ifstream &file, const SceHeader &sce_hdr) {
+std::tuple<uint64_t, SelfType> get_key_type(std::istream &file, const SceHeader &sce_hdr) {
     if (sce_hdr.sce_type == SceType::SELF) {
         file.seekg(32);
         char selfheaderbuffer[SelfHeader::Size];
@@ -0,0 +1,251 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// Firmware PUP installation benchmark
+// Writes a PUP-like file holding SPKG packages for os0, vs0, sa0 and pd0, encrypted with the retail SPKG
+// metadata key just like the real firmware, then times decrypt_pup_images with each thread count and checks
+// the images match the packages content.
+
+#include <packages/sce_types.h>
+#include <util/fs.h>
+#include <util/string_utils.h>
+
+#include <CLI11.hpp>
+#include <fmt/format.h>
+#include <miniz.h>
+#include <openssl/evp.h>
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t SCEUF_HEADER_SIZE = 0x80;
+constexpr uint32_t SCEUF_FILEREC_SIZE = 0x20;
+constexpr uint32_t METADATA_OFFSET = 0x100;
+constexpr uint32_t METADATA_INFO_OFFSET = METADATA_OFFSET + 48;
+constexpr uint32_t METADATA_OFFSET_END = METADATA_INFO_OFFSET + MetadataInfo::Size + MetadataHeader::Size + MetadataSection::Size + 2 * 16;
+constexpr uint32_t SEGMENT_OFFSET = METADATA_OFFSET_END + SpkgHeader::Size;
+
+struct Partition {
+    const char *name;
+    uint8_t fstype;
+};
+
+// pd0 packages are not part of any image, they are there to be skipped
+constexpr std::array<Partition, 4> PARTITIONS = { { { "os0", 0x01 }, { "vs0", 0x0A }, { "sa0", 0x17 }, { "pd0", 0x18 } } };
+
+template <typename T>
+void put(std::vector<uint8_t> &buffer, size_t offset, T value) {
+    memcpy(&buffer[offset], &value, sizeof(T));
+}
+
+void encrypt(const char *cipher_name, const uint8_t *key, const uint8_t *iv, uint8_t *data, size_t size) {
+    EVP_CIPHER_CTX *cipher_ctx = EVP_CIPHER_CTX_new();
+    EVP_CIPHER *cipher = EVP_CIPHER_fetch(nullptr, cipher_name, nullptr);
+    int enc_len = 0;
+    EVP_EncryptInit_ex(cipher_ctx, cipher, nullptr, key, iv);
+    EVP_CIPHER_CTX_set_padding(cipher_ctx, 0);
+    EVP_EncryptUpdate(cipher_ctx, data, &enc_len, data, static_cast<int>(size));
+    EVP_EncryptFinal_ex(cipher_ctx, data + enc_len, &enc_len);
+    EVP_CIPHER_CTX_free(cipher_ctx);
+    EVP_CIPHER_free(cipher);
+}
+
+// Text-like content, deflate gets roughly the same ratio as on the firmware files
+std::vector<uint8_t> make_content(std::mt19937 &random, size_t size) {
+    static const std::array<const char *, 8> words = { "sce", "module ", "kernel", "\x7F" "ELF", "0000", " sysmem", "\n", "PSP2" };
+    std::vector<uint8_t> content;
+    content.reserve(size + 8);
+    while (content.size() < size) {
+        const char *word = words[random() % words.size()];
+        content.insert(content.end(), word, word + strlen(word));
+        if (random() % 4 == 0)
+            content.push_back(static_cast<uint8_t>(random()));
+    }
+    content.resize(size);
+
+    return content;
+}
+
+std::vector<uint8_t> make_package(KeyStore &SCE_KEYS, std::mt19937 &random, uint8_t fstype, const std::vector<uint8_t> &content, bool compressed) {
+    std::vector<uint8_t> segment = content;
+    if (compressed) {
+        mz_ulong compressed_size = mz_compressBound(static_cast<mz_ulong>(content.size()));
+        segment.resize(compressed_size);
+        mz_compress2(segment.data(), &compressed_size, content.data(), static_cast<mz_ulong>(content.size()), MZ_DEFAULT_COMPRESSION);
+        segment.resize(compressed_size);
+    }
+
+    std::array<uint8_t, 16> segment_key;
+    std::array<uint8_t, 16> segment_iv;
+    std::array<uint8_t, 16> metadata_key;
+    std::array<uint8_t, 16> metadata_iv;
+    for (auto *bytes : { &segment_key, &segment_iv, &metadata_key, &metadata_iv })
+        for (auto &byte : *bytes)
+            byte = static_cast<uint8_t>(random());
+
+    std::vector<uint8_t> package(SEGMENT_OFFSET + segment.size());
+    put<uint32_t>(package, 0, SCE_MAGIC);
+    put<uint32_t>(package, 4, 3);
+    put<uint8_t>(package, 8, 0x40);
+    put<uint16_t>(package, 10, static_cast<uint16_t>(SceType::SPKG));
+    put<uint32_t>(package, 12, METADATA_OFFSET);
+    put<uint64_t>(package, 16, METADATA_OFFSET_END);
+    put<uint64_t>(package, 24, segment.size());
+
+    // Metadata info, the key of the rest of the metadata
+    uint8_t *info = &package[METADATA_INFO_OFFSET];
+    memcpy(info, metadata_key.data(), 16);
+    memcpy(info + 32, metadata_iv.data(), 16);
+    const KeyEntry spkg_key = SCE_KEYS.get(KeyType::METADATA, SceType::SPKG, 0, 0);
+    const auto key = string_utils::string_to_byte_array(spkg_key.key);
+    const auto iv = string_utils::string_to_byte_array(spkg_key.iv);
+    encrypt("AES-256-CBC", key.data(), iv.data(), info, MetadataInfo::Size);
+
+    // Metadata header, a single section and its key and iv
+    const size_t header = METADATA_INFO_OFFSET + MetadataInfo::Size;
+    const size_t section = header + MetadataHeader::Size;
+    const size_t vault = section + MetadataSection::Size;
+    put<uint32_t>(package, header + 12, 1);
+    put<uint32_t>(package, header + 16, 2);
+    put<uint64_t>(package, section, SEGMENT_OFFSET);
+    put<uint64_t>(package, section + 8, segment.size());
+    put<uint32_t>(package, section + 16, 2);
+    put<uint32_t>(package, section + 24, static_cast<uint32_t>(HashType::NONE));
+    put<int32_t>(package, section + 28, -1);
+    put<uint32_t>(package, section + 32, static_cast<uint32_t>(EncryptionType::AES128CTR));
+    put<int32_t>(package, section + 36, 0);
+    put<int32_t>(package, section + 40, 1);
+    put<uint32_t>(package, section + 44, static_cast<uint32_t>(compressed ? CompressionType::DEFLATE : CompressionType::NONE));
+    memcpy(&package[vault], segment_key.data(), 16);
+    memcpy(&package[vault + 16], segment_iv.data(), 16);
+    encrypt("AES-128-CBC", metadata_key.data(), metadata_iv.data(), &package[header], METADATA_OFFSET_END - header);
+
+    put<uint32_t>(package, METADATA_OFFSET_END + 4, fstype);
+
+    encrypt("AES-128-CTR", segment_key.data(), segment_iv.data(), segment.data(), segment.size());
+    memcpy(&package[SEGMENT_OFFSET], segment.data(), segment.size());
+
+    return package;
+}
+
+// Returns the content expected in each image
+std::array<std::string, 3> write_pup(const fs::path &path, KeyStore &SCE_KEYS, uint32_t package_count, size_t package_size) {
+    std::mt19937 random(1234);
+    std::array<std::string, 3> images;
+    std::vector<std::vector<uint8_t>> entries;
+    std::vector<uint64_t> filetypes;
+
+    const std::string version = "release:3.600.011\n";
+    entries.emplace_back(version.begin(), version.end());
+    filetypes.push_back(0x100);
+
+    for (uint32_t i = 0; i < package_count; i++) {
+        const size_t partition = i % PARTITIONS.size();
+        const auto content = make_content(random, package_size);
+        entries.push_back(make_package(SCE_KEYS, random, PARTITIONS[partition].fstype, content, i % 4 != 3));
+        filetypes.push_back(0x10000 + i);
+        if (partition < images.size())
+            images[partition].append(content.begin(), content.end());
+    }
+
+    std::vector<uint8_t> header(SCEUF_HEADER_SIZE + entries.size() * SCEUF_FILEREC_SIZE);
+    memcpy(header.data(), "SCEUF", 5);
+    put<uint32_t>(header, 0x18, static_cast<uint32_t>(entries.size()));
+
+    std::vector<uint64_t> offsets(entries.size());
+    uint64_t offset = (header.size() + 0xFFF) & ~0xFFFULL;
+    for (size_t i = 0; i < entries.size(); i++) {
+        const size_t rec = SCEUF_HEADER_SIZE + i * SCEUF_FILEREC_SIZE;
+        offsets[i] = offset;
+        put<uint64_t>(header, rec, filetypes[i]);
+        put<uint64_t>(header, rec + 8, offset);
+        put<uint64_t>(header, rec + 16, entries[i].size());
+        offset = (offset + entries[i].size() + 0xFFF) & ~0xFFFULL;
+    }
+
+    fs::ofstream pup(path, std::ios::binary);
+    pup.write(reinterpret_cast<const char *>(header.data()), header.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        pup.seekp(static_cast<std::streamoff>(offsets[i]));
+        pup.write(reinterpret_cast<const char *>(entries[i].data()), entries[i].size());
+    }
+
+    return images;
+}
+
+bool check_images(const fs::path &output, const std::array<std::string, 3> &expected) {
+    for (size_t i = 0; i < expected.size(); i++) {
+        const fs::path image = output / fmt::format("{}.img", PARTITIONS[i].name);
+        fs::ifstream file(image, std::ios::binary);
+        const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (data != expected[i]) {
+            fmt::print("{} does not match the packages content ({} bytes instead of {})\n", image.string(), data.size(), expected[i].size());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    uint32_t package_count = 96;
+    uint32_t package_kib = 1024;
+    std::vector<uint32_t> thread_counts = { 1, std::max(std::thread::hardware_concurrency(), 1U) };
+
+    CLI::App app{ "Vita3K firmware PUP installation benchmark" };
+    app.add_option("--packages,-p", package_count, "Number of packages in the PUP")->check(CLI::Range(1, 4096));
+    app.add_option("--size,-s", package_kib, "Size of each package content in KiB")->check(CLI::Range(1, 65536));
+    app.add_option("--threads,-t", thread_counts, "Worker threads, one run for each value")->check(CLI::Range(1, 256));
+    CLI11_PARSE(app, argc, argv);
+
+    KeyStore SCE_KEYS;
+    register_keys(SCE_KEYS, 0);
+
+    const fs::path root = fs::temp_directory_path() / "vita3k-pup-bench";
+    fs::remove_all(root);
+    fs::create_directories(root);
+    const fs::path pup_path = root / "PSP2UPDAT.PUP";
+    const auto expected = write_pup(pup_path, SCE_KEYS, package_count, package_kib * 1024);
+    const double pup_mib = fs::file_size(pup_path) / (1024.0 * 1024.0);
+
+    fmt::print("packages: {}, package size: {} KiB, PUP size: {:.1f} MiB\n", package_count, package_kib, pup_mib);
+    int result = 0;
+    for (const uint32_t thread_count : thread_counts) {
+        const fs::path output = root / fmt::format("out-{}", thread_count);
+        fs::create_directories(output);
+
+        const auto start = std::chrono::steady_clock::now();
+        decrypt_pup_images(pup_path, output, SCE_KEYS, thread_count);
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        const bool valid = check_images(output, expected);
+        fmt::print("threads: {:3}, {:9.2f} ms, {:8.1f} MiB/s{}\n", thread_count, elapsed.count(), pup_mib * 1000.0 / elapsed.count(), valid ? "" : ", images do not match");
+        if (!valid)
+            result = 1;
+    }
+
+    fs::remove_all(root);
+    return result;
+}
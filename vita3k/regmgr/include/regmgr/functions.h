@@ -25,6 +25,8 @@
 namespace regmgr {
 
 void init_regmgr(RegMgrState &regmgr, const fs::path &pref_path);
+// Write the pending modifications to system.dreg and stop the thread writing them
+void stop_regmgr(RegMgrState &regmgr);
 
 // Getters and setters for binary values
 void get_bin_value(RegMgrState &regmgr, const std::string &category, const std::string &name, void *buf, uint32_t bufSize);
@@ -17,15 +17,38 @@
 
 #pragma once
 
-#include <map>
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
+#include <set>
 #include <string>
+#include <thread>
 #include <util/fs.h>
 #include <vector>
 
+struct RegEntry {
+    std::string category;
+    std::string name;
+    std::vector<char> value;
+};
+
 struct RegMgrState {
     std::mutex mutex;
     fs::path system_dreg_path;
 
-    std::map<std::string, std::map<std::string, std::vector<char>>> system_dreg;
+    // Entries in the order of the registry template, which is also the order of system.dreg
+    std::vector<RegEntry> entries;
+    // Open addressing table of entry index + 1 (0 when empty), indexed by the hash of the category and name
+    std::vector<uint32_t> lookup;
+    // Keys missing from the registry which were already reported, so the games polling them do not flood the log
+    std::set<std::string> unknown_keys;
+
+    // The modifications are only written to system.dreg by the flush thread, once no new one was made for a while
+    std::thread flush_thread;
+    std::condition_variable flush_cond;
+    std::chrono::steady_clock::time_point last_write;
+    bool dirty = false;
+    bool stop_flush = false;
+
+    ~RegMgrState();
 };
@@ -18,6 +18,9 @@
 #include <regex>
 #include <regmgr/functions.h>
 
+#include <algorithm>
+#include <string_view>
+
 #include <util/bytes.h>
 #include <util/log.h>
 #include <util/string_utils.h>
@@ -182,137 +185,237 @@ static uint32_t get_space_size(const uint32_t str_size) {
     return spaceSize > str_size ? spaceSize - str_size : ((str_size / line) + 1) * line - str_size;
 }
 
+// Time without new modification to wait before writing system.dreg
+static constexpr auto FLUSH_DELAY = std::chrono::milliseconds(500);
+
+// Hash of the category and name, the category is hashed as if it ended with a slash
+static uint64_t hash_key(const std::string_view category, const std::string_view name) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    const auto add = [&hash](const char c) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001B3ULL;
+    };
+
+    for (const char c : category)
+        add(c);
+    if (category.back() != '/')
+        add('/');
+    for (const char c : name)
+        add(c);
+
+    return hash;
+}
+
+static bool key_matches(const RegEntry &entry, const std::string_view category, const std::string_view name) {
+    if (entry.name != name)
+        return false;
+
+    if (category.back() == '/')
+        return entry.category == category;
+
+    return (entry.category.size() == category.size() + 1) && entry.category.starts_with(category);
+}
+
+static void init_entries(RegMgrState &regmgr) {
+    regmgr.entries.clear();
+    for (const auto &cat : reg_category_template) {
+        for (const auto &entry : reg_template[cat])
+            regmgr.entries.push_back({ cat, entry.name, entry.init_value });
+    }
+
+    // Keep the table at most half full
+    size_t table_size = 16;
+    while (table_size < regmgr.entries.size() * 2)
+        table_size *= 2;
+
+    regmgr.lookup.assign(table_size, 0);
+    const size_t mask = table_size - 1;
+    for (uint32_t i = 0; i < regmgr.entries.size(); i++) {
+        size_t slot = hash_key(regmgr.entries[i].category, regmgr.entries[i].name) & mask;
+        while (regmgr.lookup[slot] != 0)
+            slot = (slot + 1) & mask;
+        regmgr.lookup[slot] = i + 1;
+    }
+}
+
+static RegEntry *find_entry(RegMgrState &regmgr, const std::string &category, const std::string &name) {
+    if (regmgr.lookup.empty())
+        return nullptr;
+
+    const size_t mask = regmgr.lookup.size() - 1;
+    for (size_t slot = hash_key(category, name) & mask; regmgr.lookup[slot] != 0; slot = (slot + 1) & mask) {
+        RegEntry &entry = regmgr.entries[regmgr.lookup[slot] - 1];
+        if (key_matches(entry, category, name))
+            return &entry;
+    }
+
+    if (regmgr.unknown_keys.insert(category + name).second)
+        LOG_WARN("Unknown registry key: {}{}", category, name);
+    return nullptr;
+}
+
 static bool load_system_dreg(RegMgrState &regmgr) {
     fs::ifstream file(regmgr.system_dreg_path, std::ios::in | std::ios::binary);
-    if (file.is_open()) {
-        // Initialize the space buffer
-        std::vector<char> space(spaceSize + 1);
+    if (!file.is_open())
+        return false;
+
+    // Initialize the space buffer
+    std::vector<char> space(spaceSize + 1);
+
+    // Skip the space
+    file.read(space.data(), spaceSize + 1);
+
+    size_t index = 0;
+    for (const auto &cat : reg_category_template) {
+        // Read the category
+        const uint32_t cat_size = static_cast<uint32_t>(cat.size());
+        std::vector<char> category(cat_size);
+        file.read(category.data(), cat_size);
+        const auto category_str = std::string(category.begin(), category.end());
+        if (category_str != cat) {
+            LOG_ERROR("Invalid category: {}, expected: {}", category_str, cat);
+            return false;
+        }
 
         // Skip the space
-        file.read(space.data(), spaceSize + 1);
-
-        for (const auto &cat : reg_category_template) {
-            // Read the category
-            const uint32_t cat_size = static_cast<uint32_t>(cat.size());
-            std::vector<char> category(cat_size);
-            file.read(category.data(), cat_size);
-            const auto category_str = std::string(category.begin(), category.end());
-            if (category_str != cat) {
-                LOG_ERROR("Invalid category: {}, expected: {}", category_str, cat);
+        const auto diff_cat = get_space_size(cat_size);
+        space.resize(diff_cat);
+        file.read(space.data(), diff_cat);
+
+        for (const auto &entry : reg_template[cat]) {
+            // Read the name
+            const uint32_t name_size = static_cast<uint32_t>(entry.name.size());
+            std::vector<char> name(name_size);
+            file.read(name.data(), name_size);
+            const auto name_str = std::string(name.begin(), name.end());
+            if (name_str != entry.name) {
+                LOG_ERROR("Invalid entry name: {}, expected: {}, in category: {}", name_str, entry.name, cat);
                 return false;
             }
 
             // Skip the space
-            const auto diff_cat = get_space_size(cat_size);
-            space.resize(diff_cat);
-            file.read(space.data(), diff_cat);
-
-            for (const auto &entry : reg_template[cat]) {
-                // Read the name
-                const uint32_t name_size = static_cast<uint32_t>(entry.name.size());
-                std::vector<char> name(name_size);
-                file.read(name.data(), name_size);
-                const auto name_str = std::string(name.begin(), name.end());
-                if (name_str != entry.name) {
-                    LOG_ERROR("Invalid entry name: {}, expected: {}, in category: {}", name_str, entry.name, cat);
-                    return false;
-                }
+            const auto diff_name = (entry.type == REG_TYPE_INT ? spaceSize - name_size - entry.size : get_space_size(name_size)) - 1;
+            space.resize(diff_name);
+            file.read(space.data(), diff_name);
 
-                // Skip the space
-                const auto diff_name = (entry.type == REG_TYPE_INT ? spaceSize - name_size - entry.size : get_space_size(name_size)) - 1;
-                space.resize(diff_name);
-                file.read(space.data(), diff_name);
-
-                // Read the value
-                const uint32_t value_size = entry.size;
-                auto &value = regmgr.system_dreg[cat][entry.name];
-                value.resize(value_size);
-                file.read(value.data(), value_size);
-
-                // Skip the space
-                const auto diff_value = (entry.type == REG_TYPE_INT) ? 1 : get_space_size(value_size) + 1;
-                space.resize(diff_value);
-                file.read(space.data(), diff_value);
-            }
+            // Read the value
+            const uint32_t value_size = entry.size;
+            auto &value = regmgr.entries[index++].value;
+            value.resize(value_size);
+            file.read(value.data(), value_size);
+
+            // Skip the space
+            const auto diff_value = (entry.type == REG_TYPE_INT) ? 1 : get_space_size(value_size) + 1;
+            space.resize(diff_value);
+            file.read(space.data(), diff_value);
         }
+    }
+
+    return static_cast<bool>(file);
+}
 
-        file.close();
+// Build the content of system.dreg, the registry mutex must be held
+static std::vector<char> serialize_system_dreg(const RegMgrState &regmgr) {
+    std::vector<char> data;
+    const auto write = [&data](const char *src, const size_t size) {
+        data.insert(data.end(), src, src + size);
+    };
+    const auto write_space = [&data](const size_t size) {
+        data.resize(data.size() + size, 0);
+    };
+
+    write_space(spaceSize + 1);
+
+    size_t index = 0;
+    for (const auto &cat : reg_category_template) {
+        // Write the category
+        const uint32_t cat_size = static_cast<uint32_t>(cat.size());
+        write(cat.c_str(), cat_size);
+        write_space(get_space_size(cat_size));
+
+        for (const auto &entry : reg_template.at(cat)) {
+            // Write the name
+            const uint32_t name_size = static_cast<uint32_t>(entry.name.size());
+            write(entry.name.c_str(), name_size);
+            write_space((entry.type == REG_TYPE_INT ? spaceSize - name_size - entry.size : get_space_size(name_size)) - 1);
+
+            // Write the value, padded or truncated to its size in the template
+            const auto &value = regmgr.entries[index++].value;
+            const size_t value_size = std::min<size_t>(value.size(), entry.size);
+            write(value.data(), value_size);
+            write_space(entry.size - value_size);
+
+            write_space((entry.type == REG_TYPE_INT) ? 1 : get_space_size(entry.size) + 1);
+        }
     }
 
-    return !regmgr.system_dreg.empty();
+    return data;
 }
 
-static void save_system_dreg(RegMgrState &regmgr) {
-    fs::ofstream file(regmgr.system_dreg_path, std::ios::out | std::ios::binary);
-    if (file.is_open()) {
-        // Initialize the space buffer
-        std::vector<char> space(spaceSize + 1);
-
-        // Write the space
-        file.write(space.data(), spaceSize + 1);
-
-        // Write each category
-        for (const auto &cat : reg_category_template) {
-            // Write the category
-            const uint32_t cat_size = static_cast<uint32_t>(cat.size());
-            std::vector<char> category(cat_size);
-            strncpy(category.data(), cat.c_str(), cat_size);
-            file.write(cat.c_str(), cat_size);
-
-            // Write the space
-            const auto diff_cat = get_space_size(cat_size);
-            space.resize(diff_cat);
-            file.write(space.data(), diff_cat);
-
-            // Write each entry
-            for (const auto &entry : reg_template[cat]) {
-                // Write the name
-                const uint32_t name_size = static_cast<uint32_t>(entry.name.size());
-                std::vector<char> name(name_size);
-                strncpy(name.data(), entry.name.c_str(), name_size);
-                file.write(name.data(), name_size);
-
-                // Write the space
-                const auto diff_name = (entry.type == REG_TYPE_INT ? spaceSize - name_size - entry.size : get_space_size(name_size)) - 1;
-                space.resize(diff_name);
-                file.write(space.data(), diff_name);
-
-                // Write the value
-                const uint32_t value_size = entry.size;
-                file.write(regmgr.system_dreg[cat][entry.name].data(), value_size);
-
-                // Write the space
-                const auto diff_value = (entry.type == REG_TYPE_INT) ? 1 : get_space_size(value_size) + 1;
-                space.resize(diff_value);
-                file.write(space.data(), diff_value);
-            }
+// Write to a temporary file first so an interrupted write never leaves a truncated system.dreg
+static void write_system_dreg(const fs::path &path, const std::vector<char> &data) {
+    const fs::path tmp_path = fs::path(path).concat(".tmp");
+    boost::system::error_code err;
+    fs::create_directories(path.parent_path(), err);
+    {
+        fs::ofstream file(tmp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            LOG_ERROR("Failed to open file: {}", tmp_path);
+            return;
         }
 
-        file.close();
+        file.write(data.data(), data.size());
+        if (!file) {
+            LOG_ERROR("Failed to write file: {}", tmp_path);
+            return;
+        }
     }
+
+    fs::rename(tmp_path, path, err);
+    if (err)
+        LOG_ERROR("Failed to replace {}: {}", path, err.message());
 }
 
-static void init_system_dreg(RegMgrState &regmgr) {
-    // Initialize the system.dreg with the default values from the template
-    for (const auto &reg : reg_template) {
-        for (const auto &entry : reg.second) {
-            auto &value = regmgr.system_dreg[reg.first][entry.name];
-            value.resize(entry.size);
-            value = entry.init_value;
+static void flush_thread_main(RegMgrState &regmgr) {
+    std::unique_lock<std::mutex> lock(regmgr.mutex);
+    while (true) {
+        regmgr.flush_cond.wait(lock, [&] { return regmgr.dirty || regmgr.stop_flush; });
+
+        // Batch the modifications coming in a row, like when a title sets its settings at boot
+        while (regmgr.dirty && !regmgr.stop_flush) {
+            const auto deadline = regmgr.last_write + FLUSH_DELAY;
+            if (std::chrono::steady_clock::now() >= deadline)
+                break;
+            regmgr.flush_cond.wait_until(lock, deadline);
+        }
+
+        if (regmgr.dirty) {
+            regmgr.dirty = false;
+            const auto data = serialize_system_dreg(regmgr);
+            const auto path = regmgr.system_dreg_path;
+
+            // The guest threads can keep using the registry during the write
+            lock.unlock();
+            write_system_dreg(path, data);
+            lock.lock();
         }
+
+        if (regmgr.stop_flush)
+            return;
     }
+}
 
-    save_system_dreg(regmgr);
+// The registry mutex must be held
+static void mark_dirty(RegMgrState &regmgr) {
+    regmgr.dirty = true;
+    regmgr.last_write = std::chrono::steady_clock::now();
+    regmgr.flush_cond.notify_one();
 }
 
 static bool reg_category_or_name_is_empty(const std::string &category, const std::string &name) {
     return reg_template.empty() || category.empty() || name.empty();
 }
 
-static std::string fix_category(const std::string &category) {
-    return category.back() == '/' ? category : category + '/';
-}
-
 static std::string set_default_value(RegMgrState &regmgr, const std::string &category, const std::string &name) {
     if (reg_category_or_name_is_empty(category, name))
         return {};
@@ -326,14 +429,16 @@ static std::string set_default_value(RegMgrState &regmgr, const std::string &cat
         return {};
     }
 
-    auto &sys = regmgr.system_dreg[category][name];
-    sys.clear();
-    sys.resize(reg->size);
-    sys = reg->init_value;
+    std::lock_guard<std::mutex> lock(regmgr.mutex);
+    RegEntry *entry = find_entry(regmgr, category, name);
+    if (!entry)
+        return {};
+
+    entry->value = reg->init_value;
 
     LOG_INFO("Successfully set default value for {}{}", category, name);
 
-    save_system_dreg(regmgr);
+    mark_dirty(regmgr);
 
     return std::string(reg->init_value.begin(), reg->init_value.end());
 }
@@ -343,9 +448,11 @@ void get_bin_value(RegMgrState &regmgr, const std::string &category, const std::
         return;
 
     std::lock_guard<std::mutex> lock(regmgr.mutex);
-    const auto &sys = regmgr.system_dreg[fix_category(category)][name];
+    const RegEntry *entry = find_entry(regmgr, category, name);
+    if (!entry)
+        return;
 
-    memcpy(buf, sys.data(), bufSize);
+    memcpy(buf, entry->value.data(), std::min<size_t>(bufSize, entry->value.size()));
 }
 
 void set_bin_value(RegMgrState &regmgr, const std::string &category, const std::string &name, const void *buf, const uint32_t bufSize) {
@@ -353,11 +460,14 @@ void set_bin_value(RegMgrState &regmgr, const std::string &category, const std::
         return;
 
     std::lock_guard<std::mutex> lock(regmgr.mutex);
+    RegEntry *entry = find_entry(regmgr, category, name);
+    if (!entry)
+        return;
 
     const char *data = static_cast<const char *>(buf);
-    regmgr.system_dreg[fix_category(category)][name].assign(data, data + bufSize);
+    entry->value.assign(data, data + bufSize);
 
-    save_system_dreg(regmgr);
+    mark_dirty(regmgr);
 }
 
 int32_t get_int_value(RegMgrState &regmgr, const std::string &category, const std::string &name) {
@@ -365,10 +475,11 @@ int32_t get_int_value(RegMgrState &regmgr, const std::string &category, const st
         return 0;
 
     std::lock_guard<std::mutex> lock(regmgr.mutex);
+    const RegEntry *entry = find_entry(regmgr, category, name);
+    if (!entry || (entry->value.size() < sizeof(int32_t)))
+        return 0;
 
-    const auto cat = fix_category(category);
-
-    return byte_swap(*reinterpret_cast<const uint32_t *>(regmgr.system_dreg[cat][name].data()));
+    return byte_swap(*reinterpret_cast<const int32_t *>(entry->value.data()));
 }
 
 void set_int_value(RegMgrState &regmgr, const std::string &category, const std::string &name, const int32_t value) {
@@ -376,10 +487,14 @@ void set_int_value(RegMgrState &regmgr, const std::string &category, const std::
         return;
 
     std::lock_guard<std::mutex> lock(regmgr.mutex);
+    RegEntry *entry = find_entry(regmgr, category, name);
+    if (!entry)
+        return;
 
-    *reinterpret_cast<int32_t *>(regmgr.system_dreg[fix_category(category)][name].data()) = byte_swap(value);
+    entry->value.resize(std::max(entry->value.size(), sizeof(int32_t)));
+    *reinterpret_cast<int32_t *>(entry->value.data()) = byte_swap(value);
 
-    save_system_dreg(regmgr);
+    mark_dirty(regmgr);
 }
 
 std::string get_str_value(RegMgrState &regmgr, const std::string &category, const std::string &name) {
@@ -387,9 +502,11 @@ std::string get_str_value(RegMgrState &regmgr, const std::string &category, cons
         return {};
 
     std::lock_guard<std::mutex> lock(regmgr.mutex);
-    const auto &sys = regmgr.system_dreg[fix_category(category)][name];
+    const RegEntry *entry = find_entry(regmgr, category, name);
+    if (!entry)
+        return {};
 
-    return std::string(sys.begin(), sys.end());
+    return std::string(entry->value.begin(), entry->value.end());
 }
 
 void set_str_value(RegMgrState &regmgr, const std::string &category, const std::string &name, const char *value, const uint32_t bufSize) {
@@ -397,12 +514,32 @@ void set_str_value(RegMgrState &regmgr, const std::string &category, const std::
         return;
 
     std::lock_guard<std::mutex> lock(regmgr.mutex);
-    regmgr.system_dreg[fix_category(category)][name].assign(value, value + bufSize);
+    RegEntry *entry = find_entry(regmgr, category, name);
+    if (!entry)
+        return;
+
+    entry->value.assign(value, value + bufSize);
+
+    mark_dirty(regmgr);
+}
 
-    save_system_dreg(regmgr);
+void stop_regmgr(RegMgrState &regmgr) {
+    if (!regmgr.flush_thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(regmgr.mutex);
+        regmgr.stop_flush = true;
+    }
+    regmgr.flush_cond.notify_one();
+    regmgr.flush_thread.join();
+    regmgr.stop_flush = false;
 }
 
 void init_regmgr(RegMgrState &regmgr, const fs::path &pref_path) {
+    // Write what is pending from the previous initialization first
+    stop_regmgr(regmgr);
+
     // Load the registry template
     const auto reg = decryptRegistryFile(pref_path / "os0/kd/registry.db0");
     if (reg.empty()) {
@@ -412,13 +549,17 @@ void init_regmgr(RegMgrState &regmgr, const fs::path &pref_path) {
     // Initialize the registry template
     init_reg_template(regmgr, reg);
 
-    // Initialize the system.dreg
+    // Initialize the system.dreg with the default values from the template, then load the saved values
+    init_entries(regmgr);
     regmgr.system_dreg_path = pref_path / "vd0/registry/system.dreg";
-    regmgr.system_dreg.clear();
+    regmgr.dirty = false;
     if (!load_system_dreg(regmgr)) {
         LOG_WARN("Failed to load system.dreg, attempting to create it");
-        init_system_dreg(regmgr);
+        init_entries(regmgr);
+        write_system_dreg(regmgr.system_dreg_path, serialize_system_dreg(regmgr));
     }
+
+    regmgr.flush_thread = std::thread(flush_thread_main, std::ref(regmgr));
 }
 
 std::pair<std::string, std::string> get_category_and_name_by_id(const int id, const std::string &export_name) {
@@ -556,3 +697,7 @@ std::pair<std::string, std::string> get_category_and_name_by_id(const int id, co
 }
 
 } // namespace regmgr
+
+RegMgrState::~RegMgrState() {
+    regmgr::stop_regmgr(*this);
+}
@@ -51,6 +51,16 @@ bool wishlist(SceGxmSyncObject *sync_object, const uint32_t timestamp, const int
  */
 void subject_done(SceGxmSyncObject *sync_object, const uint32_t timestamp);
 
+/**
+ * \brief Block until the given notification holds its target value.
+ */
+void wait_notification(State &state, MemState &mem, const SceGxmNotification &notification);
+
+/**
+ * \brief Write the notification value and wake the waiters on its address that were expecting it.
+ */
+void signal_notification(State &state, const MemState &mem, const SceGxmNotification &notification);
+
 int wait_for_status(State &state, int *status, int signal, bool wake_on_equal);
 void reset_command_list(CommandList &command_list);
 void submit_command_list(State &state, renderer::Context *context, CommandList &command_list);
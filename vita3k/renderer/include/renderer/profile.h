@@ -21,9 +21,11 @@
 
 #include <tracy/Tracy.hpp>
 #define R_PROFILE(name) ZoneNamedNC(___tracy_scoped_zone, name, 0x0055FF, false);
+#define R_PLOT(name, value) TracyPlot(name, static_cast<int64_t>(value));
 
 #else
 
 #define R_PROFILE(name)
+#define R_PLOT(name, value)
 
 #endif // TRACY_ENABLE
@@ -22,9 +22,12 @@
 #include <renderer/types.h>
 #include <threads/queue.h>
 
+#include <array>
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
 #include <string_view>
+#include <vector>
 
 struct SDL_Cursor;
 struct SDL_Window;
@@ -52,6 +55,21 @@ enum struct Filter : int {
     FSR = 1 << 4
 };
 
+// A guest thread blocked in sceGxmNotificationWait
+struct NotificationWaiter {
+    const volatile uint32_t *value;
+    uint32_t target_value;
+    bool signaled = false;
+    std::condition_variable cond;
+};
+
+struct NotificationBucket {
+    std::mutex mutex;
+    std::vector<NotificationWaiter *> waiters;
+};
+
+constexpr size_t NOTIFICATION_BUCKET_COUNT = 64;
+
 struct State {
     fs::path cache_path;
     fs::path log_path;
@@ -74,8 +92,9 @@ struct State {
     std::condition_variable command_finish_one;
     std::mutex command_finish_one_mutex;
 
-    std::condition_variable notification_ready;
-    std::mutex notification_mutex;
+    // notification waiters are hashed by address, a write only wakes the threads waiting for that exact value
+    std::array<NotificationBucket, NOTIFICATION_BUCKET_COUNT> notification_buckets;
+    std::atomic<uint64_t> notification_wake_count = 0;
 
     std::vector<ShadersHash> shaders_cache_hashs;
     std::string shader_version;
@@ -59,6 +59,17 @@ struct SamplerCacheInfo {
     // compact representation of the sampler state
     uint32_t value = 0;
     int index = 0;
+    // frame timestamp of the last time this sampler was bound
+    uint64_t last_used_frame = 0;
+};
+
+// statistics about the sampler cache, reset every frame
+struct SamplerStats {
+    uint32_t hits = 0;
+    // every miss creates a new sampler
+    uint32_t misses = 0;
+    // evicted samplers which could still be used by the GPU and had their destruction deferred
+    uint32_t deferred_destroys = 0;
 };
 
 struct AvailableTexture {
@@ -109,6 +120,10 @@ public:
     unordered_map_fast<uint32_t, SamplerCacheInfo *> sampler_lookup;
     lru::Queue<SamplerCacheInfo> sampler_queue;
     size_t last_bound_sampler_index;
+    SamplerStats sampler_stats;
+    // samplers used during the last frames_in_flight frames may still be referenced by the GPU
+    uint64_t current_frame_timestamp = 0;
+    uint64_t frames_in_flight = 0;
 
     // folder where the replacement textures should be located
     fs::path import_folder;
@@ -135,6 +150,10 @@ public:
     virtual void upload_texture_impl(SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, uint32_t mip_index, const void *pixels, int face, uint32_t pixels_per_stride) = 0;
     virtual void upload_done() {}
 
+    // return a key which is the same for all textures using the same sampler, it can never be 0
+    virtual uint32_t get_sampler_key(const SceGxmTexture &texture, bool no_linear);
+    // the sampler at this index is replaced but the previous one may still be in use, destroy it later
+    virtual void retire_sampler(size_t index) {}
     virtual void configure_sampler(size_t index, const SceGxmTexture &texture, bool no_linear) {}
 
     void upload_texture(const SceGxmTexture &gxm_texture, MemState &mem);
@@ -85,6 +85,8 @@ struct VKState : public renderer::State {
     // vector of descriptor pools used for the frame descriptor, they are not really used anywhere
     // but it's better to keep a reference to them somewhere
     std::deque<vk::DescriptorPool> frame_descriptor_pools;
+    // texture descriptor pools which are not used by any frame, free_descriptor_pools[i] is for (i+1) textures
+    std::vector<vk::DescriptorPool> free_descriptor_pools[16];
 
     // only used when memory mapping is enabled
     std::map<Address, MappedMemory, std::greater<Address>> mapped_memories;
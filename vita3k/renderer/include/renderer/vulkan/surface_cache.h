@@ -141,6 +141,22 @@ struct DepthStencilSurfaceCacheInfo : public SurfaceCacheInfo {
     std::vector<DepthSurfaceView> read_surfaces;
 };
 
+// what a range of the surface index refers to
+enum struct SurfaceKind : uint8_t {
+    Color,
+    // depth part of a depth-stencil surface
+    Depth,
+    // stencil part of a depth-stencil surface
+    Stencil
+};
+
+struct SurfaceIndexValue {
+    SurfaceKind kind;
+    SurfaceCacheInfo *info;
+
+    bool operator==(const SurfaceIndexValue &other) const = default;
+};
+
 // result when looking in the surface cache for a texture
 struct TextureLookupResult {
     vk::ImageView view;
@@ -161,10 +177,8 @@ private:
     // only have 20 color surfaces and 20 depth surfaces allocated at most at a given time
     static constexpr uint32_t max_surfaces_allowed = 20;
 
-    std::map<Address, ColorSurfaceCacheInfo *> color_address_lookup;
-
-    std::map<Address, DepthStencilSurfaceCacheInfo *> depth_address_lookup;
-    std::map<Address, DepthStencilSurfaceCacheInfo *> stencil_address_lookup;
+    // memory ranges of all the color, depth and stencil surfaces, used for all address lookups
+    AddressIntervalIndex<SurfaceIndexValue> surface_index;
 
     // structure allowing to set the lru surface with a good complexity
     lru::Queue<ColorSurfaceCacheInfo> color_surface_queue;
@@ -187,6 +201,10 @@ private:
     void destroy_surface(ColorSurfaceCacheInfo &info);
     void destroy_surface(DepthStencilSurfaceCacheInfo &info);
 
+    // return the closest color surface starting at or below address if it contains address, like a lookup in a map of start addresses
+    // also set surface_address to the start address of this surface
+    ColorSurfaceCacheInfo *find_color_surface(Address address, Address &surface_address);
+
 public:
     // when creating a mutable image, can we pass as an argument
     // the possible format used for an image view to improve performance ?
@@ -31,7 +31,12 @@ struct VKState;
 struct VKRenderTarget;
 
 constexpr int MAX_FRAMES_RENDERING = 3;
+// number of staging buffers created at first, more are added to the ring when all of them are in flight
 constexpr int NB_TEXTURE_STAGING_BUFFERS = 16;
+// the staging ring never grows past this size, a temporary dedicated buffer is used instead
+constexpr int MAX_TEXTURE_STAGING_BUFFERS = 64;
+// a buffer added to the ring is removed once the ring reaches it without it being used for this many frames
+constexpr int TEXTURE_STAGING_IDLE_FRAMES = 120;
 
 struct TextureStagingBuffer {
     vkutil::Buffer buffer;
@@ -51,10 +56,16 @@ struct TextureCacheEntry {
 struct VKTextureCache : public TextureCache {
     VKState &state;
 
-    TextureStagingBuffer staging_buffers[NB_TEXTURE_STAGING_BUFFERS];
+    std::vector<TextureStagingBuffer> staging_buffers;
     uint32_t staging_idx = 0;
     uint64_t last_waited_scene = 0;
     uint64_t current_scene_timestamp;
+    // used when the staging ring is full and all its buffers are in flight
+    // it is destroyed with the current frame objects once the upload is done
+    TextureStagingBuffer overflow_staging_buffer;
+    bool use_overflow_staging_buffer = false;
+    // number of times we would have needed to wait for the GPU to get a staging buffer
+    uint64_t staging_stall_count = 0;
 
     std::array<TextureCacheEntry, TextureCacheSize> textures;
     std::vector<vk::Sampler> samplers;
@@ -65,8 +76,11 @@ struct VKTextureCache : public TextureCache {
     bool is_texture_transfer_ready = false;
 
     VKTextureCache(VKState &state);
-    // get an available staging buffer, wait for one if all are busy
+    // get an available staging buffer, grow the ring or use a temporary buffer if all are busy
     void prepare_staging_buffer(bool is_configure = false);
+    TextureStagingBuffer &current_staging_buffer() {
+        return use_overflow_staging_buffer ? overflow_staging_buffer : staging_buffers[staging_idx];
+    }
 
     bool init(const bool hashless_texture_cache, const fs::path &texture_folder, const std::string_view game_id);
     void select(size_t index, const SceGxmTexture &texture) override;
@@ -74,6 +88,8 @@ struct VKTextureCache : public TextureCache {
     void upload_texture_impl(SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, uint32_t mip_index, const void *pixels, int face, uint32_t pixels_per_stride) override;
     void upload_done() override;
 
+    uint32_t get_sampler_key(const SceGxmTexture &texture, bool no_linear) override;
+    void retire_sampler(size_t index) override;
     void configure_sampler(size_t index, const SceGxmTexture &texture, bool no_linear) override;
 
     void import_configure_impl(SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, bool is_srgb, uint16_t nb_components, uint16_t mipcount, bool swap_rb) override;
@@ -88,6 +104,16 @@ struct FrameDescriptor {
     int descriptors_idx = 0;
 };
 
+// content of a texture descriptor set: [0] = stage and texture count, then one (image view, sampler) pair per binding
+typedef std::array<uint64_t, 1 + 2 * SCE_GXM_MAX_TEXTURE_UNITS> TextureDescriptorKey;
+
+// statistics about the texture descriptor sets, reset every frame
+struct DescriptorStats {
+    uint32_t writes = 0;
+    uint32_t cache_hits = 0;
+    uint32_t cache_misses = 0;
+};
+
 struct FrameObject {
     vk::CommandPool render_pool;
     // we need to have a specific prerender pool because prerender command buffer
@@ -102,6 +128,11 @@ struct FrameObject {
     // stage_descriptor[i] is the descriptor when using (i+1) textures
     FrameDescriptor vert_descriptors[16];
     FrameDescriptor frag_descriptors[16];
+    // pools the texture descriptor sets of this frame were allocated from, textures_descriptor_pools[i] uses (i+1) textures
+    // they are reset and given back to the state free list once the frame fence has been signaled
+    std::vector<vk::DescriptorPool> textures_descriptor_pools[16];
+    // texture descriptor sets already written during this frame, indexed by their content
+    unordered_map_fast<TextureDescriptorKey, vk::DescriptorSet> textures_descriptor_cache;
 
     // descriptor for the color surface
     FrameDescriptor color_descriptor;
@@ -277,6 +308,7 @@ struct VKContext : public renderer::Context {
     vk::DescriptorSet last_vert_texture_descriptor;
     uint16_t last_frag_texture_count = ~0;
     vk::DescriptorSet last_frag_texture_descriptor;
+    DescriptorStats descriptor_stats;
 
     VKRenderTarget *render_target = nullptr;
     vk::Viewport viewport;
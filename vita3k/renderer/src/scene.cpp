@@ -19,6 +19,7 @@
 #include <gxm/types.h>
 #include <renderer/commands.h>
 #include <renderer/driver_functions.h>
+#include <renderer/functions.h>
 #include <renderer/state.h>
 #include <renderer/types.h>
 
@@ -96,16 +97,10 @@ COMMAND(handle_sync_surface_data) {
 
         were_notifications_signaled = true;
         // signal the notification now
-        std::unique_lock<std::mutex> lock(renderer.notification_mutex);
-
         if (vertex_notification.address)
-            *vertex_notification.address.get(mem) = vertex_notification.value;
+            renderer::signal_notification(renderer, mem, vertex_notification);
         if (fragment_notification.address)
-            *fragment_notification.address.get(mem) = fragment_notification.value;
-
-        // unlocking before a notify should be faster
-        lock.unlock();
-        renderer.notification_ready.notify_all();
+            renderer::signal_notification(renderer, mem, fragment_notification);
     };
 
     if (renderer.disable_surface_sync)
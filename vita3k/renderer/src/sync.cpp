@@ -28,6 +28,7 @@
 #include <renderer/vulkan/types.h>
 
 #include <renderer/functions.h>
+#include <renderer/profile.h>
 #include <util/log.h>
 #include <util/tracy.h>
 
@@ -64,13 +65,8 @@ COMMAND(handle_notification) {
     TRACY_FUNC_COMMANDS(handle_notification);
     SceGxmNotification notif = helper.pop<SceGxmNotification>();
 
-    {
-        std::unique_lock<std::mutex> lock(renderer.notification_mutex);
-        uint32_t *val = notif.address.get(mem);
-        if (val) // Ratchet and clank Trilogy request this
-            *val = notif.value;
-    }
-    renderer.notification_ready.notify_all();
+    if (notif.address) // Ratchet and clank Trilogy request this
+        renderer::signal_notification(renderer, mem, notif);
 }
 
 COMMAND(new_frame) {
@@ -137,6 +133,55 @@ void subject_done(SceGxmSyncObject *sync_object, const uint32_t timestamp) {
     sync_object->cond.notify_all();
 }
 
+static NotificationBucket &get_notification_bucket(State &state, const Address address) {
+    // notifications are 4-byte words usually allocated next to each other
+    return state.notification_buckets[(address >> 2) % NOTIFICATION_BUCKET_COUNT];
+}
+
+void wait_notification(State &state, MemState &mem, const SceGxmNotification &notification) {
+    const Address address = notification.address.address();
+    const volatile uint32_t *value = notification.address.get(mem);
+    NotificationBucket &bucket = get_notification_bucket(state, address);
+
+    std::unique_lock<std::mutex> lock(bucket.mutex);
+    if (*value == notification.value)
+        return;
+
+    NotificationWaiter waiter;
+    waiter.value = value;
+    waiter.target_value = notification.value;
+    bucket.waiters.push_back(&waiter);
+    waiter.cond.wait(lock, [&]() { return waiter.signaled; });
+    std::erase(bucket.waiters, &waiter);
+}
+
+void signal_notification(State &state, const MemState &mem, const SceGxmNotification &notification) {
+    const Address address = notification.address.address();
+    NotificationBucket &bucket = get_notification_bucket(state, address);
+
+    uint32_t woken = 0;
+    {
+        std::lock_guard<std::mutex> lock(bucket.mutex);
+        *notification.address.get(mem) = notification.value;
+
+        for (NotificationWaiter *waiter : bucket.waiters) {
+            // also catches waiters on another address of this bucket whose value was written by the guest
+            if (waiter->signaled || *waiter->value != waiter->target_value)
+                continue;
+
+            // the waiter only reads its flag under the bucket lock, so it is safe to notify it from here
+            waiter->signaled = true;
+            waiter->cond.notify_one();
+            woken++;
+        }
+    }
+
+    if (woken > 0) {
+        const uint64_t wake_count = state.notification_wake_count.fetch_add(woken, std::memory_order_relaxed) + woken;
+        R_PLOT("Notification waiters woken", wake_count);
+    }
+}
+
 void submit_command_list(State &state, renderer::Context *context, CommandList &command_list) {
     command_list.context = context;
     state.command_buffer_queue.push(std::move(command_list));
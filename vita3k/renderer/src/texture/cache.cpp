@@ -784,7 +784,7 @@ void TextureCache::cache_and_bind_texture(const SceGxmTexture &gxm_texture, MemS
         cache_and_bind_sampler(gxm_texture);
 }
 
-int TextureCache::cache_and_bind_sampler(const SceGxmTexture &gxm_texture, bool is_depth) {
+uint32_t TextureCache::get_sampler_key(const SceGxmTexture &gxm_texture, bool no_linear) {
     uint32_t compact_repr = 0;
     if (gxm_texture.texture_type() != SCE_GXM_TEXTURE_LINEAR_STRIDED) {
         compact_repr = 0b01
@@ -804,28 +804,43 @@ int TextureCache::cache_and_bind_sampler(const SceGxmTexture &gxm_texture, bool
             | (gxm_texture.mag_filter << 8);
     }
 
+    compact_repr |= (static_cast<uint32_t>(no_linear) << 23);
+    return compact_repr;
+}
+
+int TextureCache::cache_and_bind_sampler(const SceGxmTexture &gxm_texture, bool is_depth) {
     // the depth part only matters if we can't apply linear filtering to it
     is_depth &= !support_depth_linear_filtering;
-    compact_repr |= (static_cast<uint32_t>(is_depth) << 23);
+    const uint32_t compact_repr = get_sampler_key(gxm_texture, is_depth);
 
     auto it = sampler_lookup.find(compact_repr);
     if (it != sampler_lookup.end()) {
+        sampler_stats.hits++;
         sampler_queue.set_as_mru(it->second);
+        it->second->last_used_frame = current_frame_timestamp;
         last_bound_sampler_index = it->second->index;
         return last_bound_sampler_index;
     }
 
     // we didn't find a matching sampler, create a new one
+    sampler_stats.misses++;
     SamplerCacheInfo *info = sampler_queue.get_lru();
     if (info->value != 0) {
         // the compact representation can never be 0, so we can erase the previous value
         sampler_lookup.erase(info->value);
+
+        // a sampler bound during one of the last frames can still be referenced by a descriptor set the GPU has not consumed yet
+        if (info->last_used_frame + frames_in_flight > current_frame_timestamp) {
+            sampler_stats.deferred_destroys++;
+            retire_sampler(info->index);
+        }
     }
 
     sampler_queue.set_as_mru(info);
     sampler_lookup[compact_repr] = info;
 
     info->value = compact_repr;
+    info->last_used_frame = current_frame_timestamp;
     configure_sampler(info->index, gxm_texture, is_depth);
     last_bound_sampler_index = info->index;
     return last_bound_sampler_index;
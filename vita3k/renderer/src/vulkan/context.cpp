@@ -23,6 +23,7 @@
 
 #include <gxm/functions.h>
 #include <renderer/functions.h>
+#include <renderer/profile.h>
 
 #include <util/log.h>
 #include <util/overloaded.h>
@@ -61,17 +62,10 @@ void VKContext::wait_thread_function(const MemState &mem) {
                                wait_for_fences();
 
                                // same as in handle_sync_surface_data
-                               std::unique_lock<std::mutex> lock(state.notification_mutex);
-                               if (request.notifications[0].address)
-                                   *request.notifications[0].address.get(
-                                           mem) = request.notifications[0].value;
-                               if (request.notifications[1].address)
-                                   *request.notifications[1].address.get(
-                                           mem) = request.notifications[1].value;
-
-                               // unlocking before a notify should be faster
-                               lock.unlock();
-                               state.notification_ready.notify_all();
+                               for (const SceGxmNotification &notification : request.notifications) {
+                                   if (notification.address)
+                                       renderer::signal_notification(state, mem, notification);
+                               }
                            }
                        },
                        [&](FrameDoneRequest &request) {
@@ -549,6 +543,7 @@ void new_frame(VKContext &context) {
 
     context.frame_timestamp++;
     context.state.current_frame_idx = context.frame_timestamp % MAX_FRAMES_RENDERING;
+    context.state.texture_cache.current_frame_timestamp = context.frame_timestamp;
 
     vk::Device device = context.state.device;
     FrameObject &frame = context.state.frame();
@@ -584,13 +579,34 @@ void new_frame(VKContext &context) {
     device.resetCommandPool(frame.prerender_pool);
     device.resetCommandPool(frame.render_pool);
 
-    // set the position in the used descriptor queue back to the beginning
+    // the texture descriptor sets of this frame are no longer in use, give their pools back to the free list
     for (int i = 0; i < 16; i++) {
+        for (vk::DescriptorPool pool : frame.textures_descriptor_pools[i]) {
+            device.resetDescriptorPool(pool);
+            context.state.free_descriptor_pools[i].push_back(pool);
+        }
+        frame.textures_descriptor_pools[i].clear();
+        frame.vert_descriptors[i].sets.clear();
         frame.vert_descriptors[i].descriptors_idx = 0;
+        frame.frag_descriptors[i].sets.clear();
         frame.frag_descriptors[i].descriptors_idx = 0;
     }
+    frame.textures_descriptor_cache.clear();
+    // set the position in the used descriptor queue back to the beginning
     frame.color_descriptor.descriptors_idx = 0;
 
+    R_PLOT("Descriptor writes", context.descriptor_stats.writes);
+    R_PLOT("Descriptor cache hits", context.descriptor_stats.cache_hits);
+    R_PLOT("Descriptor cache misses", context.descriptor_stats.cache_misses);
+    R_PLOT("Descriptor cache hit rate (%)", context.descriptor_stats.cache_hits * 100 / std::max(context.descriptor_stats.cache_hits + context.descriptor_stats.cache_misses, 1U));
+    context.descriptor_stats = {};
+
+    auto &sampler_stats = context.state.texture_cache.sampler_stats;
+    R_PLOT("Sampler cache hits", sampler_stats.hits);
+    R_PLOT("Sampler cache misses", sampler_stats.misses);
+    R_PLOT("Sampler deferred destroys", sampler_stats.deferred_destroys);
+    sampler_stats = {};
+
     // deferred destruction of the objects
     frame.destroy_queue.destroy_objects();
 
@@ -369,6 +369,11 @@ void PipelineCache::save_pipeline_cache() {
     LOG_INFO("Pipeline cache saved");
 }
 
+// optimized shaders are cached next to the non-optimized ones
+static std::string get_shader_version(const FeatureState &features) {
+    return fmt::format("vk{}{}", shader::CURRENT_VERSION, features.optimize_spirv ? "o" : "");
+}
+
 // Vulkan structs used to specify a specialization constant
 // Also, booleans in SPIRV are 32bit wide
 static const vk::SpecializationMapEntry srgb_entry = {
@@ -443,7 +448,7 @@ vk::PipelineShaderStageCreateInfo PipelineCache::retrieve_shader(const SceGxmPro
     const std::string hash_text = hex_string(hash);
 
     LOG_INFO("Generating vulkan spv shader {}", hash_text);
-    const std::string shader_version = fmt::format("vk{}", shader::CURRENT_VERSION);
+    const std::string shader_version = get_shader_version(state.features);
 
     shader::usse::SpirvCode source = load_spirv_shader(*program, state.features, true, hints, maskupdate, state.shaders_path, state.shaders_log_path, shader_version, true);
 
@@ -967,7 +972,7 @@ vk::ShaderModule PipelineCache::precompile_shader(const Sha256Hash &hash, bool s
 
     Sha256Hash shader_hash;
     memcpy(shader_hash.data(), hash.data(), sizeof(Sha256Hash));
-    const std::string shader_file_name = fmt::format("vk{}-{}.spv", shader::CURRENT_VERSION, hex_string(shader_hash));
+    const std::string shader_file_name = fmt::format("{}-{}.spv", get_shader_version(state.features), hex_string(shader_hash));
     const std::vector<uint32_t> source = renderer::pre_load_shader_spirv(state.shaders_path / shader_file_name);
 
     if (source.empty())
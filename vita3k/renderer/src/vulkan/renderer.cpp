@@ -839,6 +839,10 @@ void VKState::late_init(const Config &cfg, const std::string_view game_id, MemSt
 
     features.enable_memory_mapping = mapping_method != MappingMethod::Disabled;
 
+    features.optimize_spirv = cfg.spirv_optimization;
+    if (features.optimize_spirv)
+        LOG_INFO("Optimizing the generated SPIR-V shaders");
+
 #ifdef ANDROID
     if (mapping_method == MappingMethod::NativeBuffer) {
         // dynamically load the symbols
@@ -116,52 +116,96 @@ void restride_stream(const uint8_t *&stream, uint32_t &size, uint32_t stride) {
 }
 #endif
 
-// when needed, how many descriptor of the given size we allocate for each frame at once
+// when needed, how many descriptor of the given size we allocate for the current frame at once
 static constexpr uint32_t DESCRIPTOR_PACK_SIZE = 64;
 
 static vk::DescriptorSet retrieve_descriptor(VKContext &context, bool is_vertex, uint16_t textures_count) {
-    if (textures_count == 0)
-        return context.empty_set;
-
     VKState &state = context.state;
-    FrameDescriptor &frame_descriptor = is_vertex ? state.frame().vert_descriptors[textures_count - 1] : state.frame().frag_descriptors[textures_count - 1];
+    FrameObject &frame = state.frame();
+    FrameDescriptor &frame_descriptor = is_vertex ? frame.vert_descriptors[textures_count - 1] : frame.frag_descriptors[textures_count - 1];
     if (frame_descriptor.descriptors_idx < frame_descriptor.sets.size())
         return frame_descriptor.sets[frame_descriptor.descriptors_idx++];
 
-    // we have no more frame descriptor available, create a bunch of new one for this specific layout
-    vk::DescriptorPoolSize pool_size{
-        .type = vk::DescriptorType::eCombinedImageSampler,
-        .descriptorCount = textures_count * DESCRIPTOR_PACK_SIZE * MAX_FRAMES_RENDERING
-    };
+    // we have no more frame descriptor available, take a pool for this specific layout from the free list or create a new one
+    std::vector<vk::DescriptorPool> &free_pools = state.free_descriptor_pools[textures_count - 1];
+    vk::DescriptorPool descriptor_pool;
+    if (free_pools.empty()) {
+        vk::DescriptorPoolSize pool_size{
+            .type = vk::DescriptorType::eCombinedImageSampler,
+            .descriptorCount = textures_count * DESCRIPTOR_PACK_SIZE
+        };
 
-    vk::DescriptorPoolCreateInfo descriptor_pool_info{
-        .maxSets = DESCRIPTOR_PACK_SIZE * MAX_FRAMES_RENDERING
-    };
-    descriptor_pool_info.setPoolSizes(pool_size);
+        vk::DescriptorPoolCreateInfo descriptor_pool_info{
+            .maxSets = DESCRIPTOR_PACK_SIZE
+        };
+        descriptor_pool_info.setPoolSizes(pool_size);
 
-    vk::DescriptorPool descriptor_pool = state.device.createDescriptorPool(descriptor_pool_info);
-    state.frame_descriptor_pools.push_back(descriptor_pool);
+        descriptor_pool = state.device.createDescriptorPool(descriptor_pool_info);
+    } else {
+        descriptor_pool = free_pools.back();
+        free_pools.pop_back();
+    }
+    frame.textures_descriptor_pools[textures_count - 1].push_back(descriptor_pool);
 
     // allocate all the descriptor sets
     const vk::DescriptorSetLayout set_layout = is_vertex ? state.pipeline_cache.vertex_textures_layout[textures_count] : state.pipeline_cache.fragment_textures_layout[textures_count];
-    std::vector<vk::DescriptorSetLayout> layouts(DESCRIPTOR_PACK_SIZE * MAX_FRAMES_RENDERING, set_layout);
+    std::vector<vk::DescriptorSetLayout> layouts(DESCRIPTOR_PACK_SIZE, set_layout);
     vk::DescriptorSetAllocateInfo descr_set_info{
         .descriptorPool = descriptor_pool
     };
     descr_set_info.setSetLayouts(layouts);
     auto descriptor_sets = state.device.allocateDescriptorSets(descr_set_info);
+    frame_descriptor.sets.insert(frame_descriptor.sets.end(), descriptor_sets.begin(), descriptor_sets.end());
+
+    return frame_descriptor.sets[frame_descriptor.descriptors_idx++];
+}
 
-    // distribute them among all frames
-    for (int frame_idx = 0; frame_idx < MAX_FRAMES_RENDERING; frame_idx++) {
-        FrameObject &frame_object = state.frames[frame_idx];
-        FrameDescriptor &frame_descr = is_vertex ? frame_object.vert_descriptors[textures_count - 1] : frame_object.frag_descriptors[textures_count - 1];
+// look for a descriptor set of the current frame with the same bindings, write a new one if there is none
+static vk::DescriptorSet retrieve_textures_descriptor(VKContext &context, bool is_vertex, uint16_t textures_count) {
+    if (textures_count == 0)
+        return context.empty_set;
 
-        // insert DESCRIPTOR_PACK_SIZE in each frame descriptor
-        auto descr_it = descriptor_sets.begin() + frame_idx * DESCRIPTOR_PACK_SIZE;
-        frame_descr.sets.insert(frame_descr.sets.end(), descr_it, descr_it + DESCRIPTOR_PACK_SIZE);
+    const vk::DescriptorImageInfo *textures = is_vertex ? context.vertex_textures : context.fragment_textures;
+    // some default sampler in case a slot has never been set and we read a slot with higher idx
+    const vk::DescriptorImageInfo default_image_info{
+        .sampler = context.state.default_image.sampler,
+        .imageView = context.state.default_image.view,
+        .imageLayout = vk::ImageLayout::eGeneral
+    };
+
+    TextureDescriptorKey key{};
+    key[0] = (static_cast<uint64_t>(is_vertex) << 16) | textures_count;
+    for (uint32_t i = 0; i < textures_count; i++) {
+        const vk::DescriptorImageInfo &image_info = textures[i].sampler ? textures[i] : default_image_info;
+        key[1 + 2 * i] = reinterpret_cast<uint64_t>(static_cast<VkImageView>(image_info.imageView));
+        key[2 + 2 * i] = reinterpret_cast<uint64_t>(static_cast<VkSampler>(image_info.sampler));
     }
 
-    return frame_descriptor.sets[frame_descriptor.descriptors_idx++];
+    auto &descriptor_cache = context.state.frame().textures_descriptor_cache;
+    auto it = descriptor_cache.find(key);
+    if (it != descriptor_cache.end()) {
+        context.descriptor_stats.cache_hits++;
+        return it->second;
+    }
+    context.descriptor_stats.cache_misses++;
+
+    const vk::DescriptorSet descriptor = retrieve_descriptor(context, is_vertex, textures_count);
+
+    std::array<vk::WriteDescriptorSet, 16> write_descrs;
+    for (uint32_t i = 0; i < textures_count; i++) {
+        write_descrs[i] = vk::WriteDescriptorSet{
+            .dstSet = descriptor,
+            .dstBinding = i,
+            .dstArrayElement = 0,
+            .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+        };
+        write_descrs[i].setImageInfo(textures[i].sampler ? textures[i] : default_image_info);
+    }
+    context.state.device.updateDescriptorSets(textures_count, write_descrs.data(), 0, nullptr);
+    context.descriptor_stats.writes += textures_count;
+
+    descriptor_cache[key] = descriptor;
+    return descriptor;
 }
 
 static void draw_bind_descriptors(VKContext &context, MemState &mem) {
@@ -176,61 +220,18 @@ static void draw_bind_descriptors(VKContext &context, MemState &mem) {
 
     vk::PipelineLayout pipeline_layout = state.pipeline_cache.pipeline_layouts[vertex_textures_count][fragment_texture_count];
 
-    // try to use last descriptor if it still matches
-    bool need_vert_descr = (vertex_textures_count != context.last_vert_texture_count);
-    bool need_frag_descr = (fragment_texture_count != context.last_frag_texture_count);
-
-    context.last_vert_texture_count = vertex_textures_count;
-    context.last_frag_texture_count = fragment_texture_count;
-
-    {
-        if (need_vert_descr) {
-            context.last_vert_texture_descriptor = retrieve_descriptor(context, true, vertex_textures_count);
-        }
-        descriptors[2] = context.last_vert_texture_descriptor;
-
-        if (need_frag_descr) {
-            context.last_frag_texture_descriptor = retrieve_descriptor(context, false, fragment_texture_count);
-        }
-        descriptors[3] = context.last_frag_texture_descriptor;
-    }
-
-    // bind textures
-    std::array<vk::WriteDescriptorSet, 16> write_descrs;
-    // some default sampler in case a slot has never been set and we read a slot with higher idx
-    vk::DescriptorImageInfo default_image_info{
-        .sampler = context.state.default_image.sampler,
-        .imageView = context.state.default_image.view,
-        .imageLayout = vk::ImageLayout::eGeneral
-    };
-
-    // vertex
-    if (need_vert_descr) {
-        for (uint32_t i = 0; i < vertex_textures_count; i++) {
-            write_descrs[i] = vk::WriteDescriptorSet{
-                .dstSet = descriptors[2],
-                .dstBinding = i,
-                .dstArrayElement = 0,
-                .descriptorType = vk::DescriptorType::eCombinedImageSampler,
-            };
-            write_descrs[i].setImageInfo(context.vertex_textures[i].sampler ? context.vertex_textures[i] : default_image_info);
-        }
-        state.device.updateDescriptorSets(vertex_textures_count, write_descrs.data(), 0, nullptr);
+    // try to use last descriptor if it still matches, otherwise look it up in the frame descriptor cache
+    if (vertex_textures_count != context.last_vert_texture_count) {
+        context.last_vert_texture_descriptor = retrieve_textures_descriptor(context, true, vertex_textures_count);
+        context.last_vert_texture_count = vertex_textures_count;
     }
+    descriptors[2] = context.last_vert_texture_descriptor;
 
-    // fragment
-    if (need_frag_descr) {
-        for (uint32_t i = 0; i < fragment_texture_count; i++) {
-            write_descrs[i] = vk::WriteDescriptorSet{
-                .dstSet = descriptors[3],
-                .dstBinding = i,
-                .dstArrayElement = 0,
-                .descriptorType = vk::DescriptorType::eCombinedImageSampler,
-            };
-            write_descrs[i].setImageInfo(context.fragment_textures[i].sampler ? context.fragment_textures[i] : default_image_info);
-        }
-        state.device.updateDescriptorSets(fragment_texture_count, write_descrs.data(), 0, nullptr);
+    if (fragment_texture_count != context.last_frag_texture_count) {
+        context.last_frag_texture_descriptor = retrieve_textures_descriptor(context, false, fragment_texture_count);
+        context.last_frag_texture_count = fragment_texture_count;
     }
+    descriptors[3] = context.last_frag_texture_descriptor;
 
     const uint32_t dynamic_offset_count = state.features.enable_memory_mapping ? 2U : 4U;
     const uint32_t dynamic_offsets[] = {
@@ -115,6 +115,25 @@ VKSurfaceCache::VKSurfaceCache(VKState &state)
     ds_surface_queue.init(max_surfaces_allowed);
 }
 
+static bool is_color_surface(const SurfaceIndexValue &value) {
+    return value.kind == SurfaceKind::Color;
+}
+
+ColorSurfaceCacheInfo *VKSurfaceCache::find_color_surface(Address address, Address &surface_address) {
+    // only the closest color surface starting at or below address is considered, a bigger one containing it is ignored
+    auto *entry = surface_index.find_below(address, is_color_surface);
+    if (!entry)
+        return nullptr;
+
+    auto *info = static_cast<ColorSurfaceCacheInfo *>(entry->value.info);
+    if (entry->start + info->total_bytes <= address)
+        // they do not overlap
+        return nullptr;
+
+    surface_address = entry->start;
+    return info;
+}
+
 SurfaceRetrieveResult VKSurfaceCache::retrieve_color_surface_for_framebuffer(MemState &mem, SceGxmColorSurface *color) {
     // Create the key to access the cache struct
     const uint32_t address = color->data.address();
@@ -125,18 +144,9 @@ SurfaceRetrieveResult VKSurfaceCache::retrieve_color_surface_for_framebuffer(Mem
     uint32_t width = static_cast<uint32_t>(original_width * state.res_multiplier);
     uint32_t height = static_cast<uint32_t>(original_height * state.res_multiplier);
 
-    bool overlap = true;
-
-    // Of course, this works under the assumption that range must be unique :D
-    auto ite = color_address_lookup.upper_bound(address);
-    if (ite == color_address_lookup.begin())
-        // no match
-        overlap = false;
-    else
-        --ite;
-    // ite is now the first item with an address lower or equal to key
-
-    overlap = (overlap && (ite->first + ite->second->total_bytes) > address);
+    // get the color surface containing address with the highest start address
+    Address surface_address = 0;
+    ColorSurfaceCacheInfo *found_info = find_color_surface(address, surface_address);
 
     const SceGxmColorBaseFormat base_format = gxm::get_base_format(color->colorFormat);
     vk::Format vk_format = color::translate_format(base_format);
@@ -163,8 +173,8 @@ SurfaceRetrieveResult VKSurfaceCache::retrieve_color_surface_for_framebuffer(Mem
 
     VKContext *context = reinterpret_cast<VKContext *>(state.context);
 
-    if (overlap) {
-        ColorSurfaceCacheInfo &info = *ite->second;
+    if (found_info) {
+        ColorSurfaceCacheInfo &info = *found_info;
 
         // There are four situations I think of:
         // 1. Different base address, lookup for write, in this case, if the cached surface range contains the given address, then
@@ -172,19 +182,19 @@ SurfaceRetrieveResult VKSurfaceCache::retrieve_color_surface_for_framebuffer(Mem
         // 2. Same base address, but width and height change to be larger, or format change if write. Remake a new one for both read and write sitatation.
         // 3. Out of cache range. In write case, create a new one, in read case, lul
         // 4. Read situation with smaller width and height, probably need to extract the needed region out.
-        // 5. the surface is a gbuffer and we are currently trying to read the 2nd component, in this case key == ite->first + 4
-        const bool addr_in_range_of_cache = ((address + total_surface_size) <= (ite->first + info.total_bytes + 4));
-        const bool cache_probably_freed = (ite->first != address) && addr_in_range_of_cache;
+        // 5. the surface is a gbuffer and we are currently trying to read the 2nd component, in this case key == surface_address + 4
+        const bool addr_in_range_of_cache = ((address + total_surface_size) <= (surface_address + info.total_bytes + 4));
+        const bool cache_probably_freed = (surface_address != address) && addr_in_range_of_cache;
         const bool surface_extent_changed = info.height < height || bytes_per_stride != info.stride_bytes || tiling != info.tiling;
         bool surface_stat_changed = false;
 
-        if (ite->first == address)
+        if (surface_address == address)
             surface_stat_changed = surface_extent_changed || info.width < width || base_format != info.format;
 
         const bool invalidated = cache_probably_freed || surface_stat_changed || !addr_in_range_of_cache;
         if (invalidated) {
             destroy_surface(info);
-            color_address_lookup.erase(ite);
+            surface_index.erase(surface_address, { SurfaceKind::Color, &info });
             color_surface_queue.set_as_lru(&info);
         } else {
             color_surface_queue.set_as_mru(&info);
@@ -221,12 +231,12 @@ SurfaceRetrieveResult VKSurfaceCache::retrieve_color_surface_for_framebuffer(Mem
         // deferred destruction of the existing surface
         destroy_surface(info_added);
     if (info_added.data)
-        color_address_lookup.erase(info_added.data.address());
+        surface_index.erase(info_added.data.address(), { SurfaceKind::Color, &info_added });
 
     color_surface_queue.set_as_mru(&info_added);
     info_added.last_frame_rendered = context->frame_timestamp;
 
-    color_address_lookup[address] = &info_added;
+    surface_index.insert(address, total_surface_size, { SurfaceKind::Color, &info_added });
 
     info_added.width = width;
     info_added.height = height;
@@ -313,19 +323,9 @@ std::optional<TextureLookupResult> VKSurfaceCache::retrieve_color_surface_as_tex
     const uint32_t width = static_cast<uint32_t>(original_width * state.res_multiplier);
     const uint32_t height = static_cast<uint32_t>(original_height * state.res_multiplier);
 
-    bool overlap = true;
-    // Of course, this works under the assumption that range must be unique :D
-    auto ite = color_address_lookup.upper_bound(address);
-    if (ite == color_address_lookup.begin())
-        // no match
-        overlap = false;
-    else
-        --ite;
-    // ite is now the first item with an address lower or equal to key
-
-    overlap = (overlap && (ite->first + ite->second->total_bytes) > address);
-
-    if (!overlap)
+    Address surface_address = 0;
+    ColorSurfaceCacheInfo *found_info = find_color_surface(address, surface_address);
+    if (!found_info)
         return std::nullopt;
 
     const vk::ComponentMapping swizzle = texture::translate_swizzle(gxm::get_format(texture));
@@ -368,7 +368,7 @@ std::optional<TextureLookupResult> VKSurfaceCache::retrieve_color_surface_as_tex
     }
     uint32_t total_surface_size = stride_bytes * original_height;
 
-    ColorSurfaceCacheInfo &info = *ite->second;
+    ColorSurfaceCacheInfo &info = *found_info;
 
     if ((base_format == SCE_GXM_COLOR_BASE_FORMAT_U8U8U8 || info.format == SCE_GXM_COLOR_BASE_FORMAT_U8U8U8)
         && base_format != info.format)
@@ -381,9 +381,9 @@ std::optional<TextureLookupResult> VKSurfaceCache::retrieve_color_surface_as_tex
         return std::nullopt;
 
     // Check if we can use this surface
-    bool addr_in_range_of_cache = ((address + total_surface_size) <= (ite->first + info.total_bytes + 4));
+    bool addr_in_range_of_cache = ((address + total_surface_size) <= (surface_address + info.total_bytes + 4));
 
-    if (ite->first != address && !addr_in_range_of_cache)
+    if (surface_address != address && !addr_in_range_of_cache)
         // persona 4 sample from the top of a texture while the bottom wasn't rendered to, the fact that both the surface and
         // the texture start at the same location should be enough
         return std::nullopt;
@@ -396,7 +396,7 @@ std::optional<TextureLookupResult> VKSurfaceCache::retrieve_color_surface_as_tex
 
     // TODO: this is true only for linear textures (and also kind of for tiled textures) (and in this case start_x = 0),
     // for swizzled textures this is different
-    const uint32_t data_delta = address - ite->first;
+    const uint32_t data_delta = address - surface_address;
     uint32_t start_sourced_line = static_cast<uint32_t>((data_delta / stride_bytes) * state.res_multiplier);
     uint32_t start_x = static_cast<uint32_t>((data_delta % stride_bytes) / bytes_per_pixel_requested * state.res_multiplier);
 
@@ -615,15 +615,13 @@ SurfaceRetrieveResult VKSurfaceCache::retrieve_depth_stencil_for_framebuffer(Sce
     const bool is_stencil_only = depth_stencil->depth_data.address() == 0;
     DepthStencilSurfaceCacheInfo *cached_info = nullptr;
 
-    if (!is_stencil_only) {
-        auto it = depth_address_lookup.find(depth_stencil->depth_data.address());
-        if (it != depth_address_lookup.end())
-            cached_info = it->second;
-    } else {
-        auto it = stencil_address_lookup.find(depth_stencil->stencil_data.address());
-        if (it != stencil_address_lookup.end())
-            cached_info = it->second;
-    }
+    const SurfaceKind lookup_kind = is_stencil_only ? SurfaceKind::Stencil : SurfaceKind::Depth;
+    const Address lookup_address = is_stencil_only ? depth_stencil->stencil_data.address() : depth_stencil->depth_data.address();
+    auto *entry = surface_index.find(lookup_address, [lookup_kind](const SurfaceIndexValue &value) {
+        return value.kind == lookup_kind;
+    });
+    if (entry)
+        cached_info = static_cast<DepthStencilSurfaceCacheInfo *>(entry->value.info);
 
     if (cached_info != nullptr) {
         // this the most recently used depth-stencil surface
@@ -646,18 +644,13 @@ SurfaceRetrieveResult VKSurfaceCache::retrieve_depth_stencil_for_framebuffer(Sce
 
     // erase it if it was used previously
     if (cached_info->surface.depth_data)
-        depth_address_lookup.erase(cached_info->surface.depth_data.address());
+        surface_index.erase(cached_info->surface.depth_data.address(), { SurfaceKind::Depth, cached_info });
     if (cached_info->surface.stencil_data)
-        stencil_address_lookup.erase(cached_info->surface.stencil_data.address());
+        surface_index.erase(cached_info->surface.stencil_data.address(), { SurfaceKind::Stencil, cached_info });
     if (cached_info->texture.image)
         destroy_surface(*cached_info);
 
-    // update the lookup info
     ds_surface_queue.set_as_mru(cached_info);
-    if (depth_stencil->depth_data)
-        depth_address_lookup[depth_stencil->depth_data.address()] = cached_info;
-    if (depth_stencil->stencil_data)
-        stencil_address_lookup[depth_stencil->stencil_data.address()] = cached_info;
 
     cached_info->surface = *depth_stencil;
     cached_info->memory_width = memory_width;
@@ -680,6 +673,14 @@ SurfaceRetrieveResult VKSurfaceCache::retrieve_depth_stencil_for_framebuffer(Sce
     }
     cached_info->total_bytes = bytes_per_sample * depth_stencil->get_stride() * memory_height;
 
+    // update the lookup info
+    // note: we don't support sampling the stencil from a D24S8 depth-stencil
+    // so we can assume any stencil uses only 1 byte per sample
+    if (depth_stencil->depth_data)
+        surface_index.insert(depth_stencil->depth_data.address(), cached_info->total_bytes, { SurfaceKind::Depth, cached_info });
+    if (depth_stencil->stencil_data)
+        surface_index.insert(depth_stencil->stencil_data.address(), depth_stencil->get_stride() * memory_height, { SurfaceKind::Stencil, cached_info });
+
     vkutil::Image &image = cached_info->texture;
 
     // use prerender cmd in case we read from the depth buffer (although I really doubt this could happen)
@@ -767,36 +768,21 @@ std::optional<TextureLookupResult> VKSurfaceCache::retrieve_depth_stencil_as_tex
     uint32_t surface_address = 0;
     DepthStencilSurfaceCacheInfo *found_info = nullptr;
 
-    if (can_be_depth) {
-        // get the first depth surface with an address lower or equal to address
-        auto it = depth_address_lookup.upper_bound(address);
-        if (it != depth_address_lookup.begin()) {
-            it--;
-
-            // the texture must be contained entirely in the depth surface
-            if (address + total_bytes <= it->first + it->second->total_bytes) {
-                surface_address = it->first;
-                found_info = it->second;
-            }
-        }
-    }
-    if (!found_info && can_be_stencil) {
-        // get the first stencil surface with an address lower or equal to address
-        auto it = stencil_address_lookup.upper_bound(address);
-        if (it != stencil_address_lookup.begin()) {
-            it--;
-
-            // note: we don't support sampling the stencil from a D24S8 depth-stencil
-            // so we can assume any stencil uses only 1 byte per sample
-            uint32_t surface_bytes = it->second->stride_samples * it->second->memory_height * 1;
-
-            // the texture must be contained entirely in the stencil surface
-            if (address + total_bytes <= it->first + surface_bytes) {
-                surface_address = it->first;
-                found_info = it->second;
-            }
+    // get the closest depth surface, then stencil surface, with an address lower or equal to address
+    // the texture must be contained entirely in it
+    const auto find_surface = [&](SurfaceKind kind) {
+        auto *entry = surface_index.find_below(address, [kind](const SurfaceIndexValue &value) {
+            return value.kind == kind;
+        });
+        if (entry && address + total_bytes <= entry->end) {
+            surface_address = entry->start;
+            found_info = static_cast<DepthStencilSurfaceCacheInfo *>(entry->value.info);
         }
-    }
+    };
+    if (can_be_depth)
+        find_surface(SurfaceKind::Depth);
+    if (!found_info && can_be_stencil)
+        find_surface(SurfaceKind::Stencil);
 
     if (found_info == nullptr)
         return std::nullopt;
@@ -1040,11 +1026,11 @@ bool VKSurfaceCache::check_for_surface(MemState &mem, Address source_address, Ca
     }
 
     // for now, only look if the address matches exactly a color surface
-    auto it = color_address_lookup.find(source_address);
-    if (it == color_address_lookup.end())
+    auto *entry = surface_index.find(source_address, is_color_surface);
+    if (!entry)
         return false;
 
-    auto &surface = *it->second;
+    auto &surface = *static_cast<ColorSurfaceCacheInfo *>(entry->value.info);
     VKContext &context = *static_cast<VKContext *>(state.context);
     // if the frame is already rendered skip
     // Note: that's not the best behavior but it should be fine
@@ -1302,21 +1288,17 @@ void VKSurfaceCache::destroy_associated_framebuffers(const VKRenderTarget *rende
 }
 
 vk::ImageView VKSurfaceCache::sourcing_color_surface_for_presentation(Ptr<const void> address, uint32_t pitch, Viewport &viewport) {
-    // get closest surface with an address below address
-    auto ite = color_address_lookup.upper_bound(address.address());
-    if (ite == color_address_lookup.begin()) {
+    // get the surface containing address
+    Address surface_address = 0;
+    ColorSurfaceCacheInfo *found_info = find_color_surface(address.address(), surface_address);
+    if (!found_info)
         return nullptr;
-    }
-    --ite;
 
-    ColorSurfaceCacheInfo &info = *ite->second;
-    if (info.data.address() + info.total_bytes <= address.address())
-        // they do not overlap
-        return nullptr;
+    ColorSurfaceCacheInfo &info = *found_info;
 
     if (info.stride_bytes == pitch * 4) {
         // In assumption the format is RGBA8
-        const size_t data_delta = address.address() - ite->first;
+        const size_t data_delta = address.address() - surface_address;
         uint32_t limited_height = viewport.height;
         if ((data_delta % (pitch * 4)) == 0) {
             uint32_t start_sourced_line = static_cast<uint32_t>((data_delta / (pitch * 4)) * state.res_multiplier);
@@ -1362,16 +1344,15 @@ vk::ImageView VKSurfaceCache::sourcing_color_surface_for_presentation(Ptr<const
 }
 
 std::vector<uint32_t> VKSurfaceCache::dump_frame(Ptr<const void> address, uint32_t width, uint32_t height, uint32_t pitch) {
-    // get closest surface with an address below address
-    auto ite = color_address_lookup.upper_bound(address.address());
-    if (ite == color_address_lookup.begin()) {
+    // get the surface containing address
+    Address surface_address = 0;
+    const ColorSurfaceCacheInfo *found_info = find_color_surface(address.address(), surface_address);
+    if (!found_info)
         return {};
-    }
-    --ite;
 
-    const ColorSurfaceCacheInfo &info = *ite->second;
+    const ColorSurfaceCacheInfo &info = *found_info;
 
-    const uint32_t data_delta = address.address() - ite->first;
+    const uint32_t data_delta = address.address() - surface_address;
     const uint32_t pitch_byte = pitch * 4;
     if (info.stride_bytes != pitch_byte || data_delta % pitch_byte != 0)
         return {};
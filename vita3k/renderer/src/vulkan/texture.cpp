@@ -24,6 +24,7 @@
 #include <gxm/functions.h>
 #include <gxm/types.h>
 #include <renderer/functions.h>
+#include <renderer/profile.h>
 #include <util/align.h>
 #include <vkutil/vkutil.h>
 
@@ -145,67 +146,65 @@ void VKTextureCache::prepare_staging_buffer(bool is_configure) {
     assert(!is_texture_transfer_ready);
     VKContext *context = reinterpret_cast<VKContext *>(state.context);
 
+    if (staging_buffers.empty())
+        staging_buffers.resize(NB_TEXTURE_STAGING_BUFFERS);
+
     TextureStagingBuffer *staging_buffer = &staging_buffers[staging_idx];
     // some textures must be 16-bytes aligned, and staging_buffer->buffer.size is 16-bytes aligned
     staging_buffer->used_so_far = align(staging_buffer->used_so_far, 16);
     // we can keep using the same buffer as before if we are in the same scene and there is enough memory left
-    bool use_previous_buffer = (current_scene_timestamp == staging_buffer->scene_timestamp) && (staging_buffer->buffer.size - staging_buffer->used_so_far) >= current_texture->memory_needed;
+    // this way small textures are sub-allocated from the same buffer
+    const bool use_previous_buffer = (current_scene_timestamp == staging_buffer->scene_timestamp) && (staging_buffer->buffer.size - staging_buffer->used_so_far) >= current_texture->memory_needed;
+    const vk::Fence current_fence = context->next_fence;
 
+    use_overflow_staging_buffer = false;
     if (!use_previous_buffer) {
-        staging_idx = (staging_idx + 1) % NB_TEXTURE_STAGING_BUFFERS;
-        staging_buffer = &staging_buffers[staging_idx];
-    }
+        uint32_t next_idx = (staging_idx + 1) % staging_buffers.size();
 
-    // if we are not using the previous buffer, we wait if the buffer was used at least once,
-    // less than MAX_FRAMES_RENDERING frames ago and we have not yet waited for its fence
-    const bool need_wait = !use_previous_buffer
-        && staging_buffer->frame_timestamp != ~0
-        && staging_buffer->frame_timestamp > context->frame_timestamp - MAX_FRAMES_RENDERING
-        && staging_buffer->scene_timestamp > last_waited_scene;
-    const vk::Fence current_fence = context->next_fence;
+        // the ring grew for a burst of uploads which is over, shrink it back as it goes through its idle buffers
+        // they are not in flight anymore so they can be destroyed right away
+        const auto is_idle = [&](const TextureStagingBuffer &buffer) {
+            return buffer.frame_timestamp == ~0 || buffer.frame_timestamp + TEXTURE_STAGING_IDLE_FRAMES < context->frame_timestamp;
+        };
+        while (staging_buffers.size() > NB_TEXTURE_STAGING_BUFFERS && is_idle(staging_buffers[next_idx])) {
+            staging_buffers[next_idx].buffer.destroy();
+            staging_buffers.erase(staging_buffers.begin() + next_idx);
+            if (next_idx < staging_idx)
+                staging_idx--;
+            next_idx = (staging_idx + 1) % staging_buffers.size();
+        }
 
-    if (need_wait) {
-        if (staging_buffer->scene_timestamp == current_scene_timestamp) {
-            assert(current_fence == staging_buffer->waiting_fence);
-            // special case, all the staging buffer are occupied by the current scene
-            // submit the command buffer and wait for it
-            context->prerender_cmd.end();
-            context->cmdbuffers_to_submit.push_back(context->prerender_cmd);
-
-            vk::SubmitInfo submit_info{};
-            submit_info.setCommandBuffers(context->cmdbuffers_to_submit);
-            state.general_queue.submit(submit_info, current_fence);
-            context->cmdbuffers_to_submit.clear();
-
-            auto result = state.device.waitForFences(current_fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
-            if (result != vk::Result::eSuccess) {
-                LOG_ERROR("Could not wait for fences.");
-                assert(false);
-                return;
-            }
-            state.device.resetFences(current_fence);
-
-            // also call begin again on the prerender command
-            vk::CommandBufferBeginInfo begin_info{
-                .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit
-            };
-            context->prerender_cmd.begin(begin_info);
-
-            // then set all buffers as unused
-            for (auto &buffer : staging_buffers) {
-                buffer.frame_timestamp = ~0;
-                buffer.scene_timestamp = ~0;
-            }
+        staging_buffer = &staging_buffers[next_idx];
+
+        // the buffer may still be in use if it was used at least once, less than MAX_FRAMES_RENDERING frames ago
+        // and we have not yet seen its fence signaled
+        bool in_flight = staging_buffer->frame_timestamp != ~0
+            && staging_buffer->frame_timestamp > context->frame_timestamp - MAX_FRAMES_RENDERING
+            && staging_buffer->scene_timestamp > last_waited_scene;
+        // poll the fence instead of waiting for it (the fence of the current scene is not submitted yet so it is never signaled)
+        if (in_flight && state.device.getFenceStatus(staging_buffer->waiting_fence) == vk::Result::eSuccess) {
+            last_waited_scene = staging_buffer->scene_timestamp;
+            in_flight = false;
+        }
+
+        if (!in_flight) {
+            staging_idx = next_idx;
         } else {
-            // wait for the fence, but don't reset it
-            auto result = state.device.waitForFences(staging_buffer->waiting_fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
-            if (result != vk::Result::eSuccess) {
-                LOG_ERROR("Could not wait for fences.");
-                assert(false);
-                return;
+            // we would have had to wait for the GPU before, don't
+            staging_stall_count++;
+            R_PLOT("Texture staging stalls avoided", staging_stall_count);
+
+            if (staging_buffers.size() < MAX_TEXTURE_STAGING_BUFFERS) {
+                // grow the ring, the new buffer is inserted just before the in-flight one so the rotation order is kept
+                staging_buffers.insert(staging_buffers.begin() + next_idx, TextureStagingBuffer{});
+                staging_idx = next_idx;
+            } else {
+                // the ring is full, use a temporary dedicated buffer for this texture
+                use_overflow_staging_buffer = true;
             }
-            last_waited_scene = staging_buffer->scene_timestamp;
         }
+
+        staging_buffer = &current_staging_buffer();
     }
 
     // then we can use the buffer
@@ -252,6 +251,7 @@ bool VKTextureCache::init(const bool hashless_texture_cache, const fs::path &tex
     backend = Backend::Vulkan;
 
     samplers.resize(max_sampler_used);
+    frames_in_flight = MAX_FRAMES_RENDERING;
 
     // check for linear filtering on depth support
     const vk::FormatProperties depth_linear = state.physical_device.getFormatProperties(vk::Format::eD32SfloatS8Uint);
@@ -444,7 +444,7 @@ void VKTextureCache::upload_texture_impl(SceGxmTextureBaseFormat base_format, ui
         prepare_staging_buffer();
 
     vkutil::Image &image = current_texture->texture;
-    TextureStagingBuffer &staging_buffer = staging_buffers[staging_idx];
+    TextureStagingBuffer &staging_buffer = current_staging_buffer();
 
     if (face > 0)
         face--;
@@ -512,11 +512,55 @@ void VKTextureCache::upload_done() {
     };
     vkutil::transition_image_layout(cmd_buffer, current_texture->texture.image, vkutil::ImageLayout::TransferDst, vkutil::ImageLayout::SampledImage, range);
     current_texture->texture.layout = vkutil::ImageLayout::SampledImage;
+
+    if (use_overflow_staging_buffer) {
+        // the temporary buffer can be destroyed once the current frame is done
+        state.frame().destroy_queue.add_buffer(overflow_staging_buffer.buffer);
+        overflow_staging_buffer.buffer = vkutil::Buffer();
+        use_overflow_staging_buffer = false;
+    }
+
     // this should not be necessary
     cmd_buffer = nullptr;
     is_texture_transfer_ready = false;
 }
 
+uint32_t VKTextureCache::get_sampler_key(const SceGxmTexture &texture, bool no_linear) {
+    // only keep what ends up in the vk::SamplerCreateInfo built by configure_sampler
+    // so that gxm states which only differ in fields vulkan ignores share the same sampler
+    const auto filter = [&](uint32_t gxm_filter) -> uint32_t {
+        if (no_linear)
+            return 0;
+        return static_cast<uint32_t>(texture::translate_filter(static_cast<SceGxmTextureFilter>(gxm_filter)));
+    };
+    const auto address_mode = [](uint32_t gxm_mode) -> uint32_t {
+        return static_cast<uint32_t>(texture::translate_address_mode(static_cast<SceGxmTextureAddrMode>(gxm_mode)));
+    };
+
+    uint32_t key = 0b1
+        | (address_mode(texture.uaddr_mode) << 2)
+        | (address_mode(texture.vaddr_mode) << 5)
+        | (filter(texture.mag_filter) << 8);
+
+    if (texture.texture_type() == SCE_GXM_TEXTURE_LINEAR_STRIDED) {
+        // linear strided textures use the mag filter as the min filter too and have no mipmaps
+        key |= 0b10;
+    } else {
+        key |= (filter(texture.min_filter) << 9)
+            | (texture.mip_filter << 10)
+            | (texture.lod_bias << 11)
+            | ((texture.lod_min0 | (texture.lod_min1 << 2)) << 17);
+    }
+
+    return key;
+}
+
+void VKTextureCache::retire_sampler(size_t index) {
+    // destroyed once the current frame is done, all the previous frames will be done by then too
+    state.frame().destroy_queue.add(samplers[index]);
+    samplers[index] = nullptr;
+}
+
 void VKTextureCache::configure_sampler(size_t index, const SceGxmTexture &texture, bool no_linear) {
     vk::Sampler &sampler = samplers[index];
     if (sampler) {
@@ -0,0 +1,53 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace shader {
+
+struct SpirvOptimizationStats {
+    uint32_t instructions_before = 0;
+    uint32_t instructions_after = 0;
+    // loads replaced by a value stored or loaded earlier in the same block
+    uint32_t forwarded_loads = 0;
+    // stores overwritten before being read or to variables which are never read
+    uint32_t removed_stores = 0;
+    // composite extracts and vector shuffles folded or merged
+    uint32_t folded_swizzles = 0;
+
+    SpirvOptimizationStats &operator+=(const SpirvOptimizationStats &other) {
+        instructions_before += other.instructions_before;
+        instructions_after += other.instructions_after;
+        forwarded_loads += other.forwarded_loads;
+        removed_stores += other.removed_stores;
+        folded_swizzles += other.folded_swizzles;
+        return *this;
+    }
+};
+
+// Run a few cheap passes on a module generated by the recompiler:
+// - forwarding of stored and loaded values to later loads of the same register within a block
+// - removal of stores which are overwritten before being read or which are never read
+// - folding of composite extracts and vector shuffles
+// - removal of the instructions whose result is never used
+// The passes only rely on the SPIR-V module itself and leave instructions they don't know untouched
+SpirvOptimizationStats optimize_spirv(std::vector<uint32_t> &spirv);
+
+} // namespace shader
@@ -229,6 +229,55 @@ struct AttributeInformation {
 
 using USSEOffset = uint32_t;
 
+static constexpr USSEOffset USSE_INVALID_OFFSET = 0xFFFFFFFF;
+
+// Straight-line run of instructions, only the last one can be a branch and only the first one can be a branch target
+struct USSEBasicBlock {
+    USSEOffset start;
+    USSEOffset end; // inclusive
+
+    // branch ending the block, if any
+    bool has_branch = false;
+    std::uint8_t branch_pred = 0;
+    USSEOffset branch_dest = USSE_INVALID_OFFSET;
+
+    // the start of the block is the target of a backward branch (loop header)
+    bool is_back_branch_target = false;
+    // offset of the farthest unconditional backward branch to this block (end of the loop)
+    USSEOffset loop_end = USSE_INVALID_OFFSET;
+
+    // indices in USSEControlFlowGraph::blocks, -1 if unused
+    std::array<std::int32_t, 2> successors = { -1, -1 };
+    // range in USSEControlFlowGraph::predecessors
+    std::uint32_t first_predecessor = 0;
+    std::uint32_t predecessor_count = 0;
+};
+
+struct USSEControlFlowGraph {
+    std::vector<USSEBasicBlock> blocks;
+    std::vector<std::uint32_t> predecessors;
+    // instruction offset -> index of the block containing it
+    std::vector<std::uint32_t> block_of;
+    // sorted offsets of all the branch instructions
+    std::vector<USSEOffset> branch_offsets;
+
+    // block ending with a branch at this offset, nullptr if the instruction is not a branch
+    const USSEBasicBlock *branch_at(const USSEOffset offset) const {
+        if (offset >= block_of.size())
+            return nullptr;
+        const USSEBasicBlock &block = blocks[block_of[offset]];
+        return (block.has_branch && block.end == offset) ? &block : nullptr;
+    }
+
+    // block starting at this offset, nullptr if no block starts there
+    const USSEBasicBlock *block_starting_at(const USSEOffset offset) const {
+        if (offset >= block_of.size())
+            return nullptr;
+        const USSEBasicBlock &block = blocks[block_of[offset]];
+        return (block.start == offset) ? &block : nullptr;
+    }
+};
+
 using UniformBufferMap = std::map<int, UniformBuffer>;
 using AttributeInformationMap = std::map<int, AttributeInformation>;
 using AnalyzeReadFunction = std::function<std::uint64_t(USSEOffset)>;
@@ -237,5 +286,11 @@ void get_attribute_informations(const SceGxmProgram &program, AttributeInformati
 // return the max used buffer index + 1
 int get_uniform_buffer_sizes(const SceGxmProgram &program, UniformBufferSizes &sizes);
 
+// Single linear pass over the program splitting it into basic blocks linked to their predecessors and successors
+void build_control_flow_graph(USSEControlFlowGraph &cfg, const std::uint64_t *insts, const std::size_t count);
+
 void analyze(USSEBlockNode &root, USSEOffset end_offset, const AnalyzeReadFunction &read_func);
+void analyze(USSEBlockNode &root, const std::uint64_t *insts, const std::size_t count);
+// Same as analyze, the result is shared between all the translations of the same program
+std::shared_ptr<const USSEBlockNode> analyze_cached(const std::uint64_t *insts, const std::size_t count);
 } // namespace shader::usse
@@ -856,7 +856,7 @@ struct USSERecompiler final {
 
     spv::Function *end_hook_func;
 
-    USSEBlockNode tree_block_node;
+    std::shared_ptr<const USSEBlockNode> tree_block_node;
 
     explicit USSERecompiler(spv::Builder &b, const SceGxmProgram &program, const FeatureState &features,
         const SpirvShaderParameters &parameters, utils::SpirvUtilFunctions &utils, spv::Function *end_hook_func,
@@ -21,6 +21,7 @@
 // Decoder/translator usage (exposed API)
 //
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
@@ -43,6 +44,21 @@ struct SpirvUtilFunctions;
 
 using NonDependentTextureQueryCallInfos = std::vector<NonDependentTextureQueryCallInfo>;
 
+// Return the name of the instruction type the instruction is decoded as, or nullptr if it is not a valid instruction
+const char *decode_usse_instruction(uint64_t instruction);
+
+struct USSEInstructionPattern {
+    const char *name;
+    // an instruction is of this type if (instruction & mask) == expected
+    uint64_t mask;
+    uint64_t expected;
+};
+
+// Every instruction type in priority order: an instruction is decoded as the first one matching it
+std::vector<USSEInstructionPattern> get_usse_instruction_patterns();
+// Largest number of instruction types the decoder tests for a single instruction
+size_t get_usse_decode_max_candidates();
+
 void convert_gxp_usse_to_spirv(spv::Builder &b, const SceGxmProgram &program, const FeatureState &features, const SpirvShaderParameters &parameters, utils::SpirvUtilFunctions &utils,
     spv::Function *begin_hook_func, spv::Function *end_hook_func, const NonDependentTextureQueryCallInfos &queries, const uint32_t render_info_id, spv::Function *spv_func_main, std::vector<uint32_t> &interfaces);
 
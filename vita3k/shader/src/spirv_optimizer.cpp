@@ -0,0 +1,831 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <shader/spirv_optimizer.h>
+
+#include <SPIRV/doc.h>
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace shader {
+
+namespace {
+
+constexpr uint32_t GLSL_STD_450_MODF = 35;
+constexpr uint32_t GLSL_STD_450_FREXP = 51;
+constexpr uint32_t UNDEFINED_COMPONENT = 0xFFFFFFFF;
+
+struct Instruction {
+    spv::Op op;
+    // words following the opcode word
+    std::vector<uint32_t> operands;
+    bool removed = false;
+};
+
+struct Module {
+    std::vector<uint32_t> header;
+    std::vector<Instruction> instructions;
+
+    // result id -> index of the instruction defining it
+    std::unordered_map<uint32_t, size_t> definitions;
+    // vector type id -> number of components
+    std::unordered_map<uint32_t, uint32_t> vector_sizes;
+    // new constant composites created by the folding, inserted before the first function
+    // their definition index is counted after the last instruction
+    std::vector<Instruction> new_constants;
+    // type and constituents -> constant composite id
+    std::map<std::vector<uint32_t>, uint32_t> constant_composites;
+
+    // result id -> id it must be replaced with
+    std::unordered_map<uint32_t, uint32_t> replacements;
+    SpirvOptimizationStats stats;
+};
+
+bool has_result_type(spv::Op op) {
+    return spv::InstructionDesc[op].hasType();
+}
+
+bool has_result(spv::Op op) {
+    return spv::InstructionDesc[op].hasResult();
+}
+
+uint32_t get_result_id(const Instruction &inst) {
+    return has_result(inst.op) ? inst.operands[has_result_type(inst.op) ? 1 : 0] : 0;
+}
+
+uint32_t get_result_type(const Instruction &inst) {
+    return has_result_type(inst.op) ? inst.operands[0] : 0;
+}
+
+// Call f on the position of all the id operands of the instruction
+// Return false without calling f if the layout of the instruction is not known, all its words must then be considered as ids
+template <typename F>
+bool for_each_id_operand(const Instruction &inst, F f) {
+    const size_t size = inst.operands.size();
+    const size_t first = (has_result_type(inst.op) ? 1 : 0) + (has_result(inst.op) ? 1 : 0);
+    const auto all_ids_from = [&](size_t start) {
+        for (size_t i = start; i < size; i++)
+            f(i);
+        return true;
+    };
+    // image instructions: fixed id operands, then an optional literal mask followed by ids
+    const auto image_operands = [&](size_t fixed_count) {
+        for (size_t i = first; i < std::min(size, first + fixed_count); i++)
+            f(i);
+        return all_ids_from(first + fixed_count + 1);
+    };
+
+    const uint32_t op = inst.op;
+    if ((op >= spv::OpConvertFToU && op <= spv::OpBitcast)
+        || (op >= spv::OpSNegate && op <= spv::OpSMulExtended)
+        || (op >= spv::OpAny && op <= spv::OpFUnordGreaterThanEqual)
+        || (op >= spv::OpShiftRightLogical && op <= spv::OpBitCount)
+        || (op >= spv::OpDPdx && op <= spv::OpFwidthCoarse))
+        return all_ids_from(first);
+
+    switch (inst.op) {
+    case spv::OpVectorExtractDynamic:
+    case spv::OpVectorInsertDynamic:
+    case spv::OpCompositeConstruct:
+    case spv::OpCopyObject:
+    case spv::OpTranspose:
+    case spv::OpSampledImage:
+    case spv::OpImage:
+    case spv::OpImageQueryFormat:
+    case spv::OpImageQueryOrder:
+    case spv::OpImageQuerySizeLod:
+    case spv::OpImageQuerySize:
+    case spv::OpImageQueryLod:
+    case spv::OpImageQueryLevels:
+    case spv::OpImageQuerySamples:
+    case spv::OpAccessChain:
+    case spv::OpInBoundsAccessChain:
+    case spv::OpFunctionCall:
+    case spv::OpPhi:
+    case spv::OpReturnValue:
+    case spv::OpBranch:
+    case spv::OpConstantComposite:
+        return all_ids_from(first);
+
+    case spv::OpReturn:
+    case spv::OpKill:
+    case spv::OpUnreachable:
+    case spv::OpLabel:
+    case spv::OpFunctionParameter:
+    case spv::OpFunctionEnd:
+    case spv::OpUndef:
+    case spv::OpConstant:
+    case spv::OpConstantTrue:
+    case spv::OpConstantFalse:
+        return true;
+
+    case spv::OpLoad:
+        if (size != 3)
+            return false;
+        f(2);
+        return true;
+
+    case spv::OpStore:
+        if (size != 2)
+            return false;
+        f(0);
+        f(1);
+        return true;
+
+    case spv::OpVariable:
+        return all_ids_from(3);
+
+    case spv::OpVectorShuffle:
+        f(2);
+        f(3);
+        return true;
+
+    case spv::OpCompositeExtract:
+        f(2);
+        return true;
+
+    case spv::OpCompositeInsert:
+        f(2);
+        f(3);
+        return true;
+
+    case spv::OpExtInst:
+        f(2);
+        return all_ids_from(4);
+
+    case spv::OpImageSampleImplicitLod:
+    case spv::OpImageSampleExplicitLod:
+    case spv::OpImageSampleProjImplicitLod:
+    case spv::OpImageSampleProjExplicitLod:
+    case spv::OpImageFetch:
+    case spv::OpImageRead:
+        return image_operands(2);
+
+    case spv::OpImageSampleDrefImplicitLod:
+    case spv::OpImageSampleDrefExplicitLod:
+    case spv::OpImageSampleProjDrefImplicitLod:
+    case spv::OpImageSampleProjDrefExplicitLod:
+    case spv::OpImageGather:
+    case spv::OpImageDrefGather:
+        return image_operands(3);
+
+    case spv::OpImageWrite:
+        // no result, image, coordinate and texel
+        for (size_t i = 0; i < std::min<size_t>(size, 3); i++)
+            f(i);
+        return all_ids_from(4);
+
+    case spv::OpBranchConditional:
+        f(0);
+        f(1);
+        f(2);
+        return true;
+
+    case spv::OpSelectionMerge:
+    case spv::OpLine:
+        f(0);
+        return true;
+
+    case spv::OpNoLine:
+        return true;
+
+    case spv::OpLoopMerge:
+        if (size != 3)
+            return false;
+        f(0);
+        f(1);
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+// Instructions without side effects, which can be removed if their result is not used
+bool is_pure(const Instruction &inst) {
+    switch (inst.op) {
+    case spv::OpLoad:
+        // a memory access operand could make it volatile
+        return inst.operands.size() == 3;
+    case spv::OpExtInst:
+        // these ones write to a pointer operand
+        return inst.operands[3] != GLSL_STD_450_MODF && inst.operands[3] != GLSL_STD_450_FREXP;
+    case spv::OpImageWrite:
+    case spv::OpFunctionCall:
+    case spv::OpStore:
+    case spv::OpReturnValue:
+    case spv::OpBranch:
+    case spv::OpBranchConditional:
+        return false;
+    default:
+        break;
+    }
+
+    return has_result(inst.op) && inst.op != spv::OpLabel && inst.op != spv::OpFunctionParameter
+        && inst.op != spv::OpFunction && inst.op != spv::OpVariable && inst.op != spv::OpPhi
+        && for_each_id_operand(inst, [](size_t) {});
+}
+
+bool is_annotation(spv::Op op) {
+    return op == spv::OpName || op == spv::OpDecorate || op == spv::OpMemberName;
+}
+
+bool parse_module(const std::vector<uint32_t> &spirv, Module &module) {
+    constexpr size_t header_size = 5;
+    if (spirv.size() < header_size || spirv[0] != spv::MagicNumber)
+        return false;
+
+    module.header.assign(spirv.begin(), spirv.begin() + header_size);
+
+    size_t pos = header_size;
+    while (pos < spirv.size()) {
+        const uint32_t word_count = spirv[pos] >> spv::WordCountShift;
+        if (word_count == 0 || pos + word_count > spirv.size())
+            return false;
+
+        Instruction inst;
+        inst.op = static_cast<spv::Op>(spirv[pos] & spv::OpCodeMask);
+        inst.operands.assign(spirv.begin() + pos + 1, spirv.begin() + pos + word_count);
+        if (static_cast<size_t>(has_result_type(inst.op) + has_result(inst.op)) > inst.operands.size())
+            return false;
+
+        module.instructions.push_back(std::move(inst));
+        pos += word_count;
+    }
+
+    for (size_t i = 0; i < module.instructions.size(); i++) {
+        const Instruction &inst = module.instructions[i];
+        const uint32_t result = get_result_id(inst);
+        if (result != 0)
+            module.definitions[result] = i;
+
+        if (inst.op == spv::OpTypeVector)
+            module.vector_sizes[inst.operands[0]] = inst.operands[2];
+        else if (inst.op == spv::OpConstantComposite) {
+            std::vector<uint32_t> key{ inst.operands[0] };
+            key.insert(key.end(), inst.operands.begin() + 2, inst.operands.end());
+            module.constant_composites.emplace(std::move(key), result);
+        }
+    }
+
+    return true;
+}
+
+const Instruction *get_definition(const Module &module, uint32_t id) {
+    const auto it = module.definitions.find(id);
+    if (it == module.definitions.end())
+        return nullptr;
+
+    const size_t count = module.instructions.size();
+    return it->second < count ? &module.instructions[it->second] : &module.new_constants[it->second - count];
+}
+
+uint32_t get_vector_size(const Module &module, uint32_t type) {
+    const auto it = module.vector_sizes.find(type);
+    return it == module.vector_sizes.end() ? 0 : it->second;
+}
+
+uint32_t get_type_of(const Module &module, uint32_t id) {
+    const Instruction *def = get_definition(module, id);
+    return def ? get_result_type(*def) : 0;
+}
+
+// Replace every use of a removed result with the id it was replaced with
+void apply_replacements(Module &module) {
+    auto &replacements = module.replacements;
+    if (replacements.empty())
+        return;
+
+    // the value an id is replaced with may have been replaced itself
+    for (auto &[from, to] : replacements) {
+        auto it = replacements.find(to);
+        while (it != replacements.end()) {
+            to = it->second;
+            it = replacements.find(to);
+        }
+    }
+
+    // ids used by instructions we can't rewrite keep their definition
+    for (const Instruction &inst : module.instructions) {
+        if (inst.removed || is_annotation(inst.op) || for_each_id_operand(inst, [](size_t) {}))
+            continue;
+
+        for (const uint32_t word : inst.operands) {
+            if (replacements.erase(word))
+                module.instructions[module.definitions[word]].removed = false;
+        }
+    }
+
+    for (Instruction &inst : module.instructions) {
+        if (inst.removed)
+            continue;
+
+        if (is_annotation(inst.op)) {
+            // the annotated result does not exist anymore
+            if (replacements.contains(inst.operands[0]))
+                inst.removed = true;
+            continue;
+        }
+
+        for_each_id_operand(inst, [&](size_t index) {
+            const auto it = replacements.find(inst.operands[index]);
+            if (it != replacements.end())
+                inst.operands[index] = it->second;
+        });
+    }
+
+    replacements.clear();
+}
+
+// Memory location of a private or function variable, reached using only constant indices
+struct Location {
+    uint32_t variable = 0;
+    bool constant_indices = true;
+    std::vector<uint32_t> indices;
+
+    // one of them contains the other
+    bool overlaps(const Location &other) const {
+        if (variable != other.variable)
+            return false;
+
+        const size_t common = std::min(indices.size(), other.indices.size());
+        return std::equal(indices.begin(), indices.begin() + common, other.indices.begin());
+    }
+};
+
+std::unordered_map<uint32_t, Location> get_locations(const Module &module) {
+    std::unordered_map<uint32_t, Location> locations;
+    for (const Instruction &inst : module.instructions) {
+        if (inst.op == spv::OpVariable && (inst.operands[2] == spv::StorageClassPrivate || inst.operands[2] == spv::StorageClassFunction)) {
+            locations[inst.operands[1]] = { inst.operands[1], true, {} };
+        } else if (inst.op == spv::OpAccessChain || inst.op == spv::OpInBoundsAccessChain) {
+            const auto base = locations.find(inst.operands[2]);
+            if (base == locations.end())
+                continue;
+
+            Location location = base->second;
+            for (size_t i = 3; i < inst.operands.size(); i++) {
+                const Instruction *index = get_definition(module, inst.operands[i]);
+                // only 32-bit integer constants
+                if (index && index->op == spv::OpConstant && index->operands.size() == 3)
+                    location.indices.push_back(index->operands[2]);
+                else
+                    location.constant_indices = false;
+            }
+            locations[inst.operands[1]] = std::move(location);
+        }
+    }
+
+    return locations;
+}
+
+// Within a block, forward the last value stored to or loaded from a location to the next loads of the same location
+// and remove the stores which are overwritten before anything can read them
+void forward_stores_and_loads(Module &module) {
+    const auto locations = get_locations(module);
+
+    struct KnownValue {
+        Location location;
+        uint32_t value;
+        // store which wrote the value and was not read yet, if any
+        std::optional<size_t> pending_store;
+    };
+    std::vector<KnownValue> known_values;
+
+    const auto forget_overlapping = [&](const Location &location) {
+        std::erase_if(known_values, [&](const KnownValue &known) { return known.location.overlaps(location); });
+    };
+    const auto forget_variable = [&](uint32_t variable) {
+        std::erase_if(known_values, [&](const KnownValue &known) { return known.location.variable == variable; });
+    };
+    const auto mark_read = [&](const Location *location) {
+        for (auto &known : known_values) {
+            if (!location || known.location.overlaps(*location))
+                known.pending_store.reset();
+        }
+    };
+
+    for (size_t i = 0; i < module.instructions.size(); i++) {
+        Instruction &inst = module.instructions[i];
+        switch (inst.op) {
+        case spv::OpLabel:
+        case spv::OpFunction:
+            known_values.clear();
+            break;
+
+        case spv::OpLoad: {
+            const auto it = inst.operands.size() == 3 ? locations.find(inst.operands[2]) : locations.end();
+            if (it == locations.end()) {
+                mark_read(nullptr);
+                break;
+            }
+
+            const Location &location = it->second;
+            if (!location.constant_indices) {
+                for (auto &known : known_values) {
+                    if (known.location.variable == location.variable)
+                        known.pending_store.reset();
+                }
+                break;
+            }
+
+            mark_read(&location);
+            const auto known = std::find_if(known_values.begin(), known_values.end(), [&](const KnownValue &known) {
+                return known.location.variable == location.variable && known.location.indices == location.indices;
+            });
+            if (known != known_values.end()) {
+                module.replacements[inst.operands[1]] = known->value;
+                inst.removed = true;
+                module.stats.forwarded_loads++;
+            } else {
+                known_values.push_back({ location, inst.operands[1], std::nullopt });
+            }
+            break;
+        }
+
+        case spv::OpStore: {
+            const auto it = inst.operands.size() == 2 ? locations.find(inst.operands[0]) : locations.end();
+            if (it == locations.end()) {
+                // could write anywhere
+                known_values.clear();
+                break;
+            }
+
+            const Location &location = it->second;
+            if (!location.constant_indices) {
+                forget_variable(location.variable);
+                break;
+            }
+
+            const auto previous = std::find_if(known_values.begin(), known_values.end(), [&](const KnownValue &known) {
+                return known.location.variable == location.variable && known.location.indices == location.indices;
+            });
+            if (previous != known_values.end() && previous->pending_store) {
+                // nothing read the previous value
+                module.instructions[*previous->pending_store].removed = true;
+                module.stats.removed_stores++;
+            }
+
+            forget_overlapping(location);
+            known_values.push_back({ location, inst.operands[1], i });
+            break;
+        }
+
+        case spv::OpImageWrite:
+        case spv::OpSelectionMerge:
+        case spv::OpLoopMerge:
+        case spv::OpLine:
+        case spv::OpNoLine:
+            break;
+
+        default:
+            // anything else which may touch memory (function calls, barriers...) invalidates what we know
+            if (!is_pure(inst))
+                known_values.clear();
+            break;
+        }
+    }
+}
+
+// Remove the stores to private and function variables which are never read
+void remove_unread_stores(Module &module) {
+    const auto locations = get_locations(module);
+
+    std::unordered_set<uint32_t> read_variables;
+    for (const Instruction &inst : module.instructions) {
+        if (inst.removed || is_annotation(inst.op) || inst.op == spv::OpEntryPoint)
+            continue;
+
+        const auto mark_read = [&](uint32_t id) {
+            const auto it = locations.find(id);
+            if (it != locations.end())
+                read_variables.insert(it->second.variable);
+        };
+
+        if (inst.op == spv::OpStore && inst.operands.size() == 2) {
+            // only the value is read
+            mark_read(inst.operands[1]);
+        } else if (inst.op == spv::OpAccessChain || inst.op == spv::OpInBoundsAccessChain) {
+            // deriving a pointer is not a read, but the indices are
+            for (size_t i = 3; i < inst.operands.size(); i++)
+                mark_read(inst.operands[i]);
+        } else if (inst.op == spv::OpVariable) {
+            if (inst.operands.size() > 3)
+                mark_read(inst.operands[3]);
+        } else {
+            // conservative: any word which could be a pointer to a variable is a read
+            for (const uint32_t word : inst.operands)
+                mark_read(word);
+        }
+    }
+
+    for (Instruction &inst : module.instructions) {
+        if (inst.removed || inst.op != spv::OpStore || inst.operands.size() != 2)
+            continue;
+
+        const auto it = locations.find(inst.operands[0]);
+        if (it != locations.end() && !read_variables.contains(it->second.variable)) {
+            inst.removed = true;
+            module.stats.removed_stores++;
+        }
+    }
+}
+
+uint32_t get_constant_composite(Module &module, uint32_t type, const std::vector<uint32_t> &constituents) {
+    std::vector<uint32_t> key{ type };
+    key.insert(key.end(), constituents.begin(), constituents.end());
+
+    const auto it = module.constant_composites.find(key);
+    if (it != module.constant_composites.end())
+        return it->second;
+
+    const uint32_t id = module.header[3]++;
+    std::vector<uint32_t> operands{ type, id };
+    operands.insert(operands.end(), constituents.begin(), constituents.end());
+
+    module.definitions[id] = module.instructions.size() + module.new_constants.size();
+    module.new_constants.push_back({ spv::OpConstantComposite, std::move(operands) });
+    module.constant_composites.emplace(std::move(key), id);
+    return id;
+}
+
+bool is_constant(const Module &module, uint32_t id) {
+    const Instruction *def = get_definition(module, id);
+    return def && (def->op == spv::OpConstant || def->op == spv::OpConstantTrue || def->op == spv::OpConstantFalse);
+}
+
+// Fold the composite extracts and vector shuffles whose result is known or can be taken from an earlier composite
+void fold_swizzles(Module &module) {
+    for (size_t i = 0; i < module.instructions.size(); i++) {
+        Instruction &inst = module.instructions[i];
+        if (inst.removed)
+            continue;
+
+        if (inst.op == spv::OpCompositeExtract) {
+            // look through the composites the extracted element comes from
+            bool changed = true;
+            while (changed && inst.operands.size() == 4) {
+                changed = false;
+                const Instruction *composite = get_definition(module, inst.operands[2]);
+                if (!composite || composite->removed)
+                    break;
+
+                const uint32_t index = inst.operands[3];
+                if (composite->op == spv::OpConstantComposite || composite->op == spv::OpCompositeConstruct) {
+                    // for vectors, the constituents can be vectors themselves
+                    const uint32_t vector_size = get_vector_size(module, composite->operands[0]);
+                    const size_t constituent_count = composite->operands.size() - 2;
+                    if ((vector_size == 0 || vector_size == constituent_count) && index < constituent_count) {
+                        module.replacements[inst.operands[1]] = composite->operands[2 + index];
+                        inst.removed = true;
+                        module.stats.folded_swizzles++;
+                    }
+                } else if (composite->op == spv::OpCompositeInsert && composite->operands.size() == 5) {
+                    if (composite->operands[4] == index) {
+                        module.replacements[inst.operands[1]] = composite->operands[2];
+                        inst.removed = true;
+                    } else {
+                        inst.operands[2] = composite->operands[3];
+                        changed = true;
+                    }
+                    module.stats.folded_swizzles++;
+                } else if (composite->op == spv::OpVectorShuffle && index + 4 < composite->operands.size()) {
+                    const uint32_t component = composite->operands[4 + index];
+                    const uint32_t first_size = get_vector_size(module, get_type_of(module, composite->operands[2]));
+                    if (component != UNDEFINED_COMPONENT && first_size != 0) {
+                        // take it directly from the shuffled vector
+                        const bool from_first = component < first_size;
+                        inst.operands[2] = composite->operands[from_first ? 2 : 3];
+                        inst.operands[3] = from_first ? component : component - first_size;
+                        module.stats.folded_swizzles++;
+                        changed = true;
+                    }
+                }
+            }
+        } else if (inst.op == spv::OpVectorShuffle) {
+            const uint32_t result_size = static_cast<uint32_t>(inst.operands.size() - 4);
+            const uint32_t first_size = get_vector_size(module, get_type_of(module, inst.operands[2]));
+            const uint32_t second_size = get_vector_size(module, get_type_of(module, inst.operands[3]));
+            if (first_size == 0 || second_size == 0)
+                continue;
+
+            // merge a shuffle of a shuffle, when only one of the vectors is used
+            bool uses_first = false;
+            bool uses_second = false;
+            for (uint32_t c = 0; c < result_size; c++) {
+                const uint32_t component = inst.operands[4 + c];
+                if (component != UNDEFINED_COMPONENT) {
+                    uses_first |= component < first_size;
+                    uses_second |= component >= first_size;
+                }
+            }
+            if (uses_first != uses_second) {
+                const uint32_t source = inst.operands[uses_first ? 2 : 3];
+                const uint32_t offset = uses_first ? 0 : first_size;
+                const Instruction *inner = get_definition(module, source);
+                if (inner && !inner->removed && inner->op == spv::OpVectorShuffle) {
+                    std::vector<uint32_t> operands{ inst.operands[0], inst.operands[1], inner->operands[2], inner->operands[3] };
+                    for (uint32_t c = 0; c < result_size; c++) {
+                        const uint32_t component = inst.operands[4 + c];
+                        operands.push_back(component == UNDEFINED_COMPONENT ? component : inner->operands[4 + component - offset]);
+                    }
+                    inst.operands = std::move(operands);
+                    module.stats.folded_swizzles++;
+                    // the vectors changed, it will be looked at again by the next pass
+                    continue;
+                }
+            }
+
+            // identity shuffle
+            for (const uint32_t vector : { 2, 3 }) {
+                const uint32_t offset = vector == 2 ? 0 : first_size;
+                if (get_type_of(module, inst.operands[vector]) != inst.operands[0])
+                    continue;
+
+                bool identity = true;
+                for (uint32_t c = 0; c < result_size && identity; c++)
+                    identity = inst.operands[4 + c] == c + offset;
+
+                if (identity) {
+                    module.replacements[inst.operands[1]] = inst.operands[vector];
+                    inst.removed = true;
+                    module.stats.folded_swizzles++;
+                    break;
+                }
+            }
+            if (inst.removed)
+                continue;
+
+            // shuffle of constants
+            const Instruction *first = get_definition(module, inst.operands[2]);
+            const Instruction *second = get_definition(module, inst.operands[3]);
+            const auto is_constant_vector = [&](const Instruction *vector, uint32_t size) {
+                return vector && vector->op == spv::OpConstantComposite && vector->operands.size() == size + 2;
+            };
+            if ((!uses_first || is_constant_vector(first, first_size)) && (!uses_second || is_constant_vector(second, second_size))) {
+                std::vector<uint32_t> constituents;
+                for (uint32_t c = 0; c < result_size; c++) {
+                    const uint32_t component = inst.operands[4 + c];
+                    if (component == UNDEFINED_COMPONENT) {
+                        constituents.clear();
+                        break;
+                    }
+                    constituents.push_back(component < first_size ? first->operands[2 + component] : second->operands[2 + component - first_size]);
+                }
+
+                if (!constituents.empty()) {
+                    module.replacements[inst.operands[1]] = get_constant_composite(module, inst.operands[0], constituents);
+                    inst.removed = true;
+                    module.stats.folded_swizzles++;
+                }
+            }
+        } else if (inst.op == spv::OpCompositeConstruct) {
+            // vector made only of scalar constants
+            const uint32_t size = get_vector_size(module, inst.operands[0]);
+            if (size == 0 || size != inst.operands.size() - 2)
+                continue;
+
+            const std::vector<uint32_t> constituents(inst.operands.begin() + 2, inst.operands.end());
+            if (std::all_of(constituents.begin(), constituents.end(), [&](uint32_t id) { return is_constant(module, id); })) {
+                module.replacements[inst.operands[1]] = get_constant_composite(module, inst.operands[0], constituents);
+                inst.removed = true;
+                module.stats.folded_swizzles++;
+            }
+        }
+    }
+}
+
+// Remove the instructions without side effects whose result is not used
+void remove_dead_code(Module &module) {
+    std::unordered_set<uint32_t> live;
+    std::vector<uint32_t> worklist;
+
+    const auto mark_live = [&](uint32_t id) {
+        if (live.insert(id).second)
+            worklist.push_back(id);
+    };
+
+    bool in_function = false;
+    std::vector<bool> removable(module.instructions.size(), false);
+    for (size_t i = 0; i < module.instructions.size(); i++) {
+        const Instruction &inst = module.instructions[i];
+        if (inst.op == spv::OpFunction)
+            in_function = true;
+        else if (inst.op == spv::OpFunctionEnd)
+            in_function = false;
+
+        if (inst.removed || is_annotation(inst.op))
+            continue;
+
+        removable[i] = in_function && is_pure(inst);
+        if (removable[i])
+            continue;
+
+        // every word is a potential id, this is only over-approximating the live set
+        for (const uint32_t word : inst.operands)
+            mark_live(word);
+    }
+
+    while (!worklist.empty()) {
+        const uint32_t id = worklist.back();
+        worklist.pop_back();
+
+        const auto it = module.definitions.find(id);
+        if (it == module.definitions.end() || it->second >= module.instructions.size() || !removable[it->second])
+            continue;
+
+        for (const uint32_t word : module.instructions[it->second].operands)
+            mark_live(word);
+    }
+
+    std::unordered_set<uint32_t> removed_results;
+    for (size_t i = 0; i < module.instructions.size(); i++) {
+        Instruction &inst = module.instructions[i];
+        if (removable[i] && !live.contains(get_result_id(inst))) {
+            inst.removed = true;
+            removed_results.insert(get_result_id(inst));
+        }
+    }
+
+    for (Instruction &inst : module.instructions) {
+        if (!inst.removed && is_annotation(inst.op) && removed_results.contains(inst.operands[0]))
+            inst.removed = true;
+    }
+}
+
+uint32_t count_instructions(const Module &module) {
+    return static_cast<uint32_t>(module.new_constants.size()
+        + std::count_if(module.instructions.begin(), module.instructions.end(), [](const Instruction &inst) { return !inst.removed; }));
+}
+
+void write_module(const Module &module, std::vector<uint32_t> &spirv) {
+    spirv = module.header;
+
+    const auto write = [&](const Instruction &inst) {
+        spirv.push_back((static_cast<uint32_t>(inst.operands.size() + 1) << spv::WordCountShift) | inst.op);
+        spirv.insert(spirv.end(), inst.operands.begin(), inst.operands.end());
+    };
+
+    bool constants_written = false;
+    for (const Instruction &inst : module.instructions) {
+        if (inst.op == spv::OpFunction && !constants_written) {
+            for (const Instruction &constant : module.new_constants)
+                write(constant);
+            constants_written = true;
+        }
+
+        if (!inst.removed)
+            write(inst);
+    }
+}
+
+} // namespace
+
+SpirvOptimizationStats optimize_spirv(std::vector<uint32_t> &spirv) {
+    static std::once_flag parameterize_flag;
+    std::call_once(parameterize_flag, spv::Parameterize);
+
+    Module module;
+    if (!parse_module(spirv, module))
+        return {};
+
+    module.stats.instructions_before = static_cast<uint32_t>(module.instructions.size());
+
+    forward_stores_and_loads(module);
+    apply_replacements(module);
+
+    // a folded swizzle can make another one foldable
+    for (int pass = 0; pass < 2; pass++) {
+        fold_swizzles(module);
+        apply_replacements(module);
+    }
+
+    remove_unread_stores(module);
+    remove_dead_code(module);
+
+    module.stats.instructions_after = count_instructions(module);
+    write_module(module, spirv);
+
+    return module.stats;
+}
+
+} // namespace shader
@@ -25,6 +25,7 @@
 #include <gxm/types.h>
 #include <shader/gxp_parser.h>
 #include <shader/profile.h>
+#include <shader/spirv_optimizer.h>
 #include <shader/usse_translator_entry.h>
 #include <shader/usse_translator_types.h>
 #include <util/fs.h>
@@ -1969,6 +1970,12 @@ static SpirvCode convert_gxp_to_spirv_impl(const SceGxmProgram &program, const s
 
     b.dump(spirv);
 
+    if (features.optimize_spirv) {
+        const SpirvOptimizationStats stats = optimize_spirv(spirv);
+        LOG_DEBUG("Optimized shader {}: {} -> {} instructions ({} forwarded loads, {} removed stores, {} folded swizzles)", shader_hash,
+            stats.instructions_before, stats.instructions_after, stats.forwarded_loads, stats.removed_stores, stats.folded_swizzles);
+    }
+
     if (LOG_SHADER_CODE || force_shader_debug) {
         std::string spirv_dump;
         spirv_disasm_print(spirv, &spirv_dump);
@@ -20,10 +20,16 @@
 #include <shader/gxp_parser.h>
 #include <shader/usse_program_analyzer.h>
 
-#include <cassert>
-
 #include <shader/usse_types.h>
 
+#include <xxhash.h>
+
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 namespace shader::usse {
 bool is_kill(const std::uint64_t inst) {
     return (inst >> 59) == 0b11111 && (((inst >> 32) & ~0xF8FFFFFF) >> 24) == 1 && ((inst >> 32) & ~0xFFCFFFFF) >> 20 == 3;
@@ -300,48 +306,130 @@ void USSELoopNode::set_content_block(USSEBaseNodeInstance &node) {
     children[0] = std::move(node);
 }
 
-void analyze(USSEBlockNode &root, USSEOffset end_offset, const AnalyzeReadFunction &read_func) {
-    struct BlockInvestigateRequest {
-        USSEOffset begin_offset;
-        USSEOffset end_offset;
-
-        USSEBlockNode *block_node;
-    };
-
+void build_control_flow_graph(USSEControlFlowGraph &cfg, const std::uint64_t *insts, const std::size_t count) {
     struct BranchInfo {
-        std::uint32_t offset;
-        std::uint32_t dest;
-
+        USSEOffset offset;
+        USSEOffset dest;
         std::uint8_t pred;
     };
 
-    root.reset();
+    cfg.blocks.clear();
+    cfg.predecessors.clear();
+    cfg.branch_offsets.clear();
+    cfg.block_of.assign(count, 0);
 
-    std::multimap<std::uint32_t, BranchInfo> branches_to_back;
-    std::map<std::uint32_t, BranchInfo> branches_from;
+    if (count == 0)
+        return;
 
-    std::queue<BlockInvestigateRequest> investigate_queue;
-    investigate_queue.push({ 0, end_offset, &root });
-
-    // First off query all branches first
-    // This is for easy tracing of loops and branches later, without complicating the algorithm
-    // For example, loop might be in a loop :(
-    for (usse::USSEOffset baddr = 0; baddr <= end_offset; baddr += 1) {
-        auto inst = read_func(baddr);
+    // Find the branches and the first instruction of each block
+    std::vector<BranchInfo> branches;
+    std::vector<bool> is_block_start(count + 1, false);
+    is_block_start[0] = true;
 
+    for (USSEOffset baddr = 0; baddr < count; baddr++) {
         std::uint8_t pred = 0;
         std::int32_t br_off = 0;
 
-        if (is_branch(inst, pred, br_off)) {
-            const std::uint32_t dest = baddr + br_off;
-            BranchInfo info = { baddr, dest, pred };
+        if (is_branch(insts[baddr], pred, br_off)) {
+            const USSEOffset dest = baddr + br_off;
+            branches.push_back({ baddr, dest, pred });
+            cfg.branch_offsets.push_back(baddr);
 
-            if (br_off < 0)
-                branches_to_back.emplace(dest, info);
+            is_block_start[baddr + 1] = true;
+            if (dest < count)
+                is_block_start[dest] = true;
+        }
+    }
+
+    for (USSEOffset baddr = 0; baddr < count; baddr++) {
+        if (is_block_start[baddr]) {
+            cfg.blocks.emplace_back();
+            cfg.blocks.back().start = baddr;
+        }
+
+        cfg.blocks.back().end = baddr;
+        cfg.block_of[baddr] = static_cast<std::uint32_t>(cfg.blocks.size() - 1);
+    }
+
+    for (const BranchInfo &branch : branches) {
+        USSEBasicBlock &block = cfg.blocks[cfg.block_of[branch.offset]];
+        block.has_branch = true;
+        block.branch_pred = branch.pred;
+        block.branch_dest = branch.dest;
+
+        if (branch.dest < branch.offset) {
+            // The loop continue target should be unconditional and farest
+            USSEBasicBlock &header = cfg.blocks[cfg.block_of[branch.dest]];
+            header.is_back_branch_target = true;
+            if ((branch.pred == 0) && ((header.loop_end == USSE_INVALID_OFFSET) || (header.loop_end < branch.offset)))
+                header.loop_end = branch.offset;
+        }
+    }
 
-            branches_from.emplace(baddr, info);
+    // Link the blocks, the predecessors of a block are stored contiguously
+    for (std::uint32_t i = 0; i < cfg.blocks.size(); i++) {
+        USSEBasicBlock &block = cfg.blocks[i];
+        int successor_count = 0;
+
+        if (block.has_branch && (block.branch_dest < count))
+            block.successors[successor_count++] = cfg.block_of[block.branch_dest];
+
+        // An unconditional branch never falls through
+        if ((!block.has_branch || (block.branch_pred != 0)) && (i + 1 < cfg.blocks.size()))
+            block.successors[successor_count++] = i + 1;
+
+        for (int j = 0; j < successor_count; j++)
+            cfg.blocks[block.successors[j]].predecessor_count++;
+    }
+
+    std::uint32_t predecessor_total = 0;
+    for (USSEBasicBlock &block : cfg.blocks) {
+        block.first_predecessor = predecessor_total;
+        predecessor_total += block.predecessor_count;
+        block.predecessor_count = 0;
+    }
+
+    cfg.predecessors.resize(predecessor_total);
+    for (std::uint32_t i = 0; i < cfg.blocks.size(); i++) {
+        for (const std::int32_t successor : cfg.blocks[i].successors) {
+            if (successor < 0)
+                continue;
+
+            USSEBasicBlock &target = cfg.blocks[successor];
+            cfg.predecessors[target.first_predecessor + target.predecessor_count++] = i;
         }
     }
+}
+
+void analyze(USSEBlockNode &root, USSEOffset end_offset, const AnalyzeReadFunction &read_func) {
+    std::vector<std::uint64_t> insts(static_cast<std::size_t>(end_offset) + 1);
+    for (USSEOffset baddr = 0; baddr <= end_offset; baddr++)
+        insts[baddr] = read_func(baddr);
+
+    analyze(root, insts.data(), insts.size());
+}
+
+void analyze(USSEBlockNode &root, const std::uint64_t *insts, const std::size_t count) {
+    struct BlockInvestigateRequest {
+        USSEOffset begin_offset;
+        USSEOffset end_offset;
+
+        USSEBlockNode *block_node;
+    };
+
+    root.reset();
+
+    if (count == 0)
+        return;
+
+    // First off build the control flow graph
+    // This is for easy tracing of loops and branches later, without complicating the algorithm
+    // For example, loop might be in a loop :(
+    USSEControlFlowGraph cfg;
+    build_control_flow_graph(cfg, insts, count);
+
+    std::queue<BlockInvestigateRequest> investigate_queue;
+    investigate_queue.push({ 0, static_cast<USSEOffset>(count - 1), &root });
 
     while (!investigate_queue.empty()) {
         BlockInvestigateRequest request = std::move(investigate_queue.front());
@@ -354,7 +442,11 @@ void analyze(USSEBlockNode &root, USSEOffset end_offset, const AnalyzeReadFuncti
         current_code->size = 0;
 
         for (auto baddr = request.begin_offset; baddr <= request.end_offset; baddr += 1) {
-            auto inst = read_func(baddr);
+            if (baddr >= count) {
+                break;
+            }
+
+            auto inst = insts[baddr];
 
             if (inst == 0) {
                 break;
@@ -366,10 +458,10 @@ void analyze(USSEBlockNode &root, USSEOffset end_offset, const AnalyzeReadFuncti
                 current_code->condition = pred;
             }
 
-            auto branch_from_result = branches_from.find(baddr);
-            auto branch_to_result = branches_to_back.equal_range(baddr);
+            const USSEBasicBlock *branch_from_result = cfg.branch_at(baddr);
+            const USSEBasicBlock *branch_to_result = cfg.block_starting_at(baddr);
 
-            if (branch_from_result != branches_from.end()) {
+            if (branch_from_result) {
                 bool is_loop_stmt = false;
 
                 // It might be a break to exit a loop
@@ -383,15 +475,15 @@ void analyze(USSEBlockNode &root, USSEOffset end_offset, const AnalyzeReadFuncti
                     USSELoopNode *loop_node = reinterpret_cast<USSELoopNode *>(loop_parent);
                     std::unique_ptr<USSEBaseNode> node_to_add;
 
-                    if (loop_node->get_loop_end_offset() <= branch_from_result->second.dest - 1) {
-                        node_to_add = std::make_unique<USSEBreakNode>(request.block_node, branch_from_result->second.pred);
+                    if (loop_node->get_loop_end_offset() <= branch_from_result->branch_dest - 1) {
+                        node_to_add = std::make_unique<USSEBreakNode>(request.block_node, branch_from_result->branch_pred);
 
                         is_loop_stmt = true;
-                    } else if (loop_node->content_block()->start_offset() == branch_from_result->second.dest) {
-                        assert((branch_from_result->second.pred == 0) && "Continuing and abadon further statement without a condition is crazy");
+                    } else if (loop_node->content_block()->start_offset() == branch_from_result->branch_dest) {
+                        assert((branch_from_result->branch_pred == 0) && "Continuing and abadon further statement without a condition is crazy");
 
                         // The loop is continuing!!!!
-                        node_to_add = std::make_unique<USSEContinueNode>(request.block_node, branch_from_result->second.pred);
+                        node_to_add = std::make_unique<USSEContinueNode>(request.block_node, branch_from_result->branch_pred);
                         is_loop_stmt = true;
                     }
 
@@ -412,12 +504,12 @@ void analyze(USSEBlockNode &root, USSEOffset end_offset, const AnalyzeReadFuncti
                 if (!is_loop_stmt) {
                     // Some ifs may be trying to jump to parent's merge point. It's also means there's no more content
                     // further in this block.
-                    if (branch_from_result->second.pred == 0) {
+                    if (branch_from_result->branch_pred == 0) {
                         // Execution changed direction, follow it
                         current_code->size = baddr - current_code->offset;
                         request.block_node->add_children(current_code_inst);
 
-                        baddr = branch_from_result->second.dest - 1;
+                        baddr = branch_from_result->branch_dest - 1;
 
                         std::unique_ptr<USSEBaseNode> current_code_inst = std::make_unique<USSECodeNode>(request.block_node);
                         USSECodeNode *current_code = reinterpret_cast<USSECodeNode *>(current_code_inst.get());
@@ -425,39 +517,41 @@ void analyze(USSEBlockNode &root, USSEOffset end_offset, const AnalyzeReadFuncti
                         current_code->offset = baddr;
                     } else {
                         bool else_exist = false;
-                        auto branch_from_else_result = branches_from.find(branch_from_result->second.dest - 1);
+                        const USSEBasicBlock *branch_from_else_result = cfg.branch_at(branch_from_result->branch_dest - 1);
 
                         std::uint32_t else_end_offset = 0;
 
                         // Simply a jump to after else
-                        if (branch_from_else_result != branches_from.end()) {
-                            assert((branch_from_else_result->second.pred == 0) && "Unhandled!");
+                        if (branch_from_else_result) {
+                            assert((branch_from_else_result->branch_pred == 0) && "Unhandled!");
 
                             // Note: There might be nastier situation where the if block ends sooner then after that is some block
                             // of other blocks. Hope the compiler is not that nasty.
                             // The solution is to keep track of the statement stack and finally get the final branch, but with loop also available
                             // it is presenting itself as kind of hard
-                            if (branch_from_else_result->second.dest >= branch_from_result->second.dest) {
-                                else_end_offset = branch_from_else_result->second.dest;
+                            if (branch_from_else_result->branch_dest >= branch_from_result->branch_dest) {
+                                else_end_offset = branch_from_else_result->branch_dest;
                                 else_exist = true;
                             } else {
                                 // Some blocks optimized by throwing merge to after else into inner for loop
                                 // This is logical in case the if only contains the loop.
-                                auto begin_ite = branches_from.upper_bound(branch_from_else_result->second.dest + 1);
-                                auto end_ite = branches_from.lower_bound(branch_from_result->second.dest - 1);
-
-                                if ((begin_ite != branches_from.end()) && (end_ite != branches_from.end())) {
-                                    for (; begin_ite != end_ite; ++begin_ite) {
-                                        if (begin_ite->second.dest > branch_from_result->second.dest) {
+                                const auto &branch_offsets = cfg.branch_offsets;
+                                auto begin_ite = std::upper_bound(branch_offsets.begin(), branch_offsets.end(), branch_from_else_result->branch_dest + 1);
+                                auto end_ite = std::lower_bound(branch_offsets.begin(), branch_offsets.end(), branch_from_result->branch_dest - 1);
+
+                                if ((begin_ite != branch_offsets.end()) && (end_ite != branch_offsets.end())) {
+                                    for (; begin_ite < end_ite; ++begin_ite) {
+                                        const USSEOffset dest = cfg.branch_at(*begin_ite)->branch_dest;
+                                        if (dest > branch_from_result->branch_dest) {
                                             else_exist = true;
-                                            else_end_offset = begin_ite->second.dest;
+                                            else_end_offset = dest;
                                         }
                                     }
                                 }
                             }
                         }
 
-                        std::uint32_t merge_point = (else_exist ? else_end_offset : branch_from_result->second.dest);
+                        std::uint32_t merge_point = (else_exist ? else_end_offset : branch_from_result->branch_dest);
 
                         // Create a new if/else tree (there might be no else :D)
                         // The space between the branch and the jump is the content block of the if
@@ -472,14 +566,14 @@ void analyze(USSEBlockNode &root, USSEOffset end_offset, const AnalyzeReadFuncti
                         conditional->set_if_block(if_block);
 
                         // Sometimes it jumps to the merge point of mother, so we limit the range
-                        investigate_queue.push({ baddr + 1, std::min<USSEOffset>(branch_from_result->second.dest - 1, request.end_offset),
+                        investigate_queue.push({ baddr + 1, std::min<USSEOffset>(branch_from_result->branch_dest - 1, request.end_offset),
                             conditional->if_block() });
 
                         if (else_exist) {
-                            std::unique_ptr<USSEBaseNode> else_block = std::make_unique<USSEBlockNode>(conditional_inst.get(), branch_from_result->second.dest);
+                            std::unique_ptr<USSEBaseNode> else_block = std::make_unique<USSEBlockNode>(conditional_inst.get(), branch_from_result->branch_dest);
                             conditional->set_else_block(else_block);
 
-                            investigate_queue.push({ branch_from_result->second.dest, else_end_offset - 1, conditional->else_block() });
+                            investigate_queue.push({ branch_from_result->branch_dest, else_end_offset - 1, conditional->else_block() });
                         }
 
                         // End the current block code, and also add this block in
@@ -494,16 +588,11 @@ void analyze(USSEBlockNode &root, USSEOffset end_offset, const AnalyzeReadFuncti
                         baddr = current_code->offset - 1;
                     }
                 }
-            } else if (branches_to_back.contains(baddr) && (request.block_node->start_offset() != baddr)) {
+            } else if (branch_to_result && branch_to_result->is_back_branch_target && (request.block_node->start_offset() != baddr)) {
                 // The loop continue target should be unconditional and farest
-                std::uint32_t found_offset = 0xFFFFFFFF;
-                for (auto ite = branch_to_result.first; ite != branch_to_result.second; ++ite) {
-                    if ((ite->second.pred == 0) && ((found_offset == 0xFFFFFFFF) || (found_offset < ite->second.offset))) {
-                        found_offset = ite->second.offset;
-                    }
-                }
+                const std::uint32_t found_offset = branch_to_result->loop_end;
 
-                assert((found_offset != 0xFFFFFFFF) && "Offset to end loop not found!");
+                assert((found_offset != USSE_INVALID_OFFSET) && "Offset to end loop not found!");
 
                 // Smell like a loop ! Create a loop node
                 // The outer farest with no conditional jump should be the one we are looking for
@@ -565,4 +654,42 @@ void analyze(USSEBlockNode &root, USSEOffset end_offset, const AnalyzeReadFuncti
     }
 }
 
+std::shared_ptr<const USSEBlockNode> analyze_cached(const std::uint64_t *insts, const std::size_t count) {
+    // A program is usually translated more than once (mask update, different hints, both phases when switching renderer...)
+    // The tree only depends on the instructions, so key it on their hash, the instructions are kept to rule out collisions
+    struct CachedProgram {
+        std::vector<std::uint64_t> insts;
+        std::shared_ptr<const USSEBlockNode> root;
+    };
+
+    static std::mutex cache_mutex;
+    static std::unordered_multimap<std::uint64_t, CachedProgram> cache;
+    constexpr std::size_t max_cached_programs = 1024;
+
+    const auto same_program = [&](const CachedProgram &program) {
+        return program.insts.size() == count && std::equal(program.insts.begin(), program.insts.end(), insts);
+    };
+
+    const std::uint64_t hash = XXH3_64bits_withSeed(insts, count * sizeof(std::uint64_t), count);
+    {
+        const std::lock_guard<std::mutex> guard(cache_mutex);
+        const auto [begin, end] = cache.equal_range(hash);
+        for (auto it = begin; it != end; ++it) {
+            if (same_program(it->second))
+                return it->second.root;
+        }
+    }
+
+    auto root = std::make_shared<USSEBlockNode>(nullptr, 0);
+    analyze(*root, insts, count);
+
+    const std::lock_guard<std::mutex> guard(cache_mutex);
+    // the trees are small, simply start again when there are too many of them
+    if (cache.size() >= max_cached_programs)
+        cache.clear();
+    cache.emplace(hash, CachedProgram{ std::vector<std::uint64_t>(insts, insts + count), root });
+
+    return root;
+}
+
 } // namespace shader::usse
@@ -25,7 +25,9 @@
 #include <shader/usse_translator_types.h>
 #include <util/log.h>
 
-#include <optional>
+#include <algorithm>
+#include <array>
+#include <vector>
 
 namespace shader::usse {
 
@@ -33,8 +35,12 @@ template <typename Visitor>
 using USSEMatcher = shader::decoder::Matcher<Visitor, uint64_t>;
 
 template <typename V>
-static std::optional<const USSEMatcher<V>> DecodeUSSE(uint64_t instruction) {
-    static const std::array<USSEMatcher<V>, 35> table = {
+using USSEMatcherTable = std::array<USSEMatcher<V>, 35>;
+
+// All the instruction types, in priority order: an instruction is decoded by the first one matching it
+template <typename V>
+static const USSEMatcherTable<V> &get_usse_matchers() {
+    static const USSEMatcherTable<V> table = {
 #define INST(fn, name, bitstring) shader::decoder::detail::detail<USSEMatcher<V>>::GetMatcher(fn, name, bitstring)
         // clang-format off
         // Vector multiply-add (Normal version)
@@ -860,10 +866,115 @@ static std::optional<const USSEMatcher<V>> DecodeUSSE(uint64_t instruction) {
     };
 #undef INST
 
-    const auto matches_instruction = [instruction](const auto &matcher) { return matcher.Matches(instruction); };
+    return table;
+}
+
+// Lookup table giving, from the top bits of an instruction, the few matchers which can decode it
+// The 5-bit major opcode is enough for most instruction types, the ones sharing a major opcode
+// (mostly the special 0b11111 one) use a secondary table indexed by the next 8 bits
+template <typename V>
+class USSEDecodeTable {
+    static constexpr int major_shift = 59;
+    static constexpr int minor_shift = 51;
+    static constexpr uint64_t major_mask = 0x1FULL << major_shift;
+    static constexpr uint64_t minor_mask = 0xFFULL << minor_shift;
+
+    // indices in the matcher table, in priority order
+    using Candidates = std::vector<uint8_t>;
+
+    struct MajorEntry {
+        Candidates candidates;
+        // empty if candidates has at most one element
+        std::vector<Candidates> minor;
+    };
+
+    const USSEMatcherTable<V> &matchers;
+    std::array<MajorEntry, 32> major;
+
+    // matchers which can decode an instruction whose bits in known_mask are known_value
+    Candidates get_candidates(uint64_t known_mask, uint64_t known_value) const {
+        Candidates candidates;
+        for (size_t i = 0; i < matchers.size(); i++) {
+            const auto &matcher = matchers[i];
+            const uint64_t common_mask = matcher.GetMask() & known_mask;
+            if ((matcher.GetExpected() & common_mask) != (known_value & common_mask))
+                continue;
+
+            candidates.push_back(static_cast<uint8_t>(i));
+            // this one only checks known bits so it always matches, the next ones can never be reached
+            if ((matcher.GetMask() & ~known_mask) == 0)
+                break;
+        }
+
+        return candidates;
+    }
+
+public:
+    explicit USSEDecodeTable(const USSEMatcherTable<V> &matchers)
+        : matchers(matchers) {
+        for (uint64_t major_op = 0; major_op < major.size(); major_op++) {
+            auto &entry = major[major_op];
+            entry.candidates = get_candidates(major_mask, major_op << major_shift);
+            if (entry.candidates.size() <= 1)
+                continue;
+
+            entry.minor.resize((minor_mask >> minor_shift) + 1);
+            for (uint64_t minor_op = 0; minor_op < entry.minor.size(); minor_op++)
+                entry.minor[minor_op] = get_candidates(major_mask | minor_mask, (major_op << major_shift) | (minor_op << minor_shift));
+        }
+    }
+
+    const USSEMatcher<V> *decode(uint64_t instruction) const {
+        const auto &entry = major[instruction >> major_shift];
+        const auto &candidates = entry.minor.empty() ? entry.candidates : entry.minor[(instruction & minor_mask) >> minor_shift];
+
+        // the list is at most a couple of elements long and the first one usually matches
+        for (const uint8_t index : candidates) {
+            if (matchers[index].Matches(instruction))
+                return &matchers[index];
+        }
+
+        return nullptr;
+    }
+
+    size_t max_candidates() const {
+        size_t result = 0;
+        for (const auto &entry : major) {
+            result = std::max(result, entry.candidates.size());
+            for (const auto &candidates : entry.minor)
+                result = std::max(result, candidates.size());
+        }
+
+        return result;
+    }
+};
+
+template <typename V>
+static const USSEDecodeTable<V> &get_usse_decode_table() {
+    static const USSEDecodeTable<V> decode_table(get_usse_matchers<V>());
+    return decode_table;
+}
+
+template <typename V>
+static const USSEMatcher<V> *DecodeUSSE(uint64_t instruction) {
+    return get_usse_decode_table<V>().decode(instruction);
+}
+
+const char *decode_usse_instruction(uint64_t instruction) {
+    const auto matcher = DecodeUSSE<USSETranslatorVisitor>(instruction);
+    return matcher ? matcher->GetName() : nullptr;
+}
+
+std::vector<USSEInstructionPattern> get_usse_instruction_patterns() {
+    std::vector<USSEInstructionPattern> patterns;
+    for (const auto &matcher : get_usse_matchers<USSETranslatorVisitor>())
+        patterns.push_back({ matcher.GetName(), matcher.GetMask(), matcher.GetExpected() });
+
+    return patterns;
+}
 
-    auto iter = std::find_if(table.begin(), table.end(), matches_instruction);
-    return iter != table.end() ? std::optional<const USSEMatcher<V>>(*iter) : std::nullopt;
+size_t get_usse_decode_max_candidates() {
+    return get_usse_decode_table<USSETranslatorVisitor>().max_candidates();
 }
 
 //
@@ -876,8 +987,7 @@ USSERecompiler::USSERecompiler(spv::Builder &b, const SceGxmProgram &program, co
     , count(0)
     , b(b)
     , visitor(b, *this, program, features, utils, cur_instr, parameters, queries, true)
-    , end_hook_func(end_hook_func)
-    , tree_block_node(nullptr, 0) {
+    , end_hook_func(end_hook_func) {
 }
 
 void USSERecompiler::reset(const std::uint64_t *_inst, const std::size_t _count) {
@@ -885,8 +995,7 @@ void USSERecompiler::reset(const std::uint64_t *_inst, const std::size_t _count)
     count = _count;
     visitor.reset_for_new_session();
 
-    usse::analyze(tree_block_node, static_cast<shader::usse::USSEOffset>(_count - 1),
-        [&](usse::USSEOffset off) -> std::uint64_t { return inst[off]; });
+    tree_block_node = usse::analyze_cached(inst, count);
 }
 
 spv::Id USSERecompiler::get_condition_value(const std::uint8_t pred, const bool neg) {
@@ -939,8 +1048,8 @@ void USSERecompiler::compile_code_node(const usse::USSECodeNode &code) {
         cur_instr = inst[pc];
 
         // Recompile the instruction, to the current block
-        auto decoder = usse::DecodeUSSE<usse::USSETranslatorVisitor>(cur_instr);
-        if (decoder.has_value())
+        const auto decoder = usse::DecodeUSSE<usse::USSETranslatorVisitor>(cur_instr);
+        if (decoder)
             decoder->call(visitor, cur_instr);
         else
             LOG_DISASM("{:016x}: error: instruction unmatched", cur_instr);
@@ -1061,7 +1170,7 @@ spv::Function *USSERecompiler::compile_program_function() {
     spv::Function *ret_func = b.makeFunctionEntry(spv::NoPrecision, b.makeVoidType(), sub_name.c_str(), {}, {}, {},
         &new_sub_block);
 
-    compile_block(tree_block_node);
+    compile_block(*tree_block_node);
 
     b.leaveFunction();
     b.setBuildPoint(last_build_point);
@@ -0,0 +1,112 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <gtest/gtest.h>
+#include <shader/spirv_optimizer.h>
+
+#include <SPIRV/SpvBuilder.h>
+
+#include <vector>
+
+using namespace shader;
+
+static int count_instructions(const std::vector<uint32_t> &spirv, spv::Op op) {
+    int count = 0;
+    for (size_t pos = 5; pos < spirv.size(); pos += spirv[pos] >> spv::WordCountShift)
+        count += (spirv[pos] & spv::OpCodeMask) == op;
+    return count;
+}
+
+struct TestModule {
+    spv::SpvBuildLogger logger;
+    spv::Builder b{ spv::Spv_1_0, 0, &logger };
+    spv::Id f32;
+    spv::Id v4;
+    spv::Id temps;
+    spv::Id out;
+
+    TestModule() {
+        b.setMemoryModel(spv::AddressingModelLogical, spv::MemoryModelGLSL450);
+        b.addCapability(spv::CapabilityShader);
+        b.makeEntryPoint("main");
+
+        f32 = b.makeFloatType(32);
+        v4 = b.makeVectorType(f32, 4);
+        temps = b.createVariable(spv::NoPrecision, spv::StorageClassPrivate, b.makeArrayType(f32, b.makeIntConstant(4), 0), "temps");
+        out = b.createVariable(spv::NoPrecision, spv::StorageClassOutput, v4, "out");
+    }
+
+    spv::Id element(spv::Id index) {
+        return b.createOp(spv::OpAccessChain, b.makePointer(spv::StorageClassPrivate, f32), { temps, index });
+    }
+
+    std::vector<uint32_t> dump() {
+        b.makeReturn(false);
+        b.leaveFunction();
+
+        std::vector<uint32_t> spirv;
+        b.dump(spirv);
+        return spirv;
+    }
+};
+
+TEST(spirv_optimizer, forwards_stores_and_folds_swizzles) {
+    TestModule m;
+    auto &b = m.b;
+
+    // the first store is overwritten, the load gets the second value
+    b.createStore(b.makeFloatConstant(1.0f), m.element(b.makeIntConstant(1)));
+    b.createStore(b.makeFloatConstant(2.0f), m.element(b.makeIntConstant(1)));
+    const spv::Id value = b.createLoad(m.element(b.makeIntConstant(1)), spv::NoPrecision);
+
+    const spv::Id vector = b.createCompositeConstruct(m.v4, { value, value, value, value });
+    const spv::Id identity = b.createOp(spv::OpVectorShuffle, m.v4, std::vector<spv::IdImmediate>{ { true, vector }, { true, vector }, { false, 0 }, { false, 1 }, { false, 2 }, { false, 3 } });
+    b.createStore(identity, m.out);
+
+    std::vector<uint32_t> spirv = m.dump();
+    const SpirvOptimizationStats stats = optimize_spirv(spirv);
+
+    ASSERT_EQ(stats.forwarded_loads, 1U);
+    ASSERT_LT(stats.instructions_after, stats.instructions_before);
+    ASSERT_EQ(count_instructions(spirv, spv::OpLoad), 0);
+    ASSERT_EQ(count_instructions(spirv, spv::OpVectorShuffle), 0);
+    ASSERT_EQ(count_instructions(spirv, spv::OpCompositeConstruct), 0);
+    // temps is never read anymore, only the output store remains
+    ASSERT_EQ(count_instructions(spirv, spv::OpStore), 1);
+    ASSERT_EQ(count_instructions(spirv, spv::OpAccessChain), 0);
+}
+
+TEST(spirv_optimizer, keeps_dynamically_indexed_loads) {
+    TestModule m;
+    auto &b = m.b;
+
+    const spv::Id index_var = b.createVariable(spv::NoPrecision, spv::StorageClassPrivate, b.makeIntType(32), "index");
+    const spv::Id index = b.createLoad(index_var, spv::NoPrecision);
+
+    // the dynamic store may overwrite the element, it must be loaded again
+    b.createStore(b.makeFloatConstant(1.0f), m.element(b.makeIntConstant(1)));
+    b.createStore(b.makeFloatConstant(2.0f), m.element(index));
+    const spv::Id value = b.createLoad(m.element(b.makeIntConstant(1)), spv::NoPrecision);
+    b.createStore(b.createCompositeConstruct(m.v4, { value, value, value, value }), m.out);
+
+    std::vector<uint32_t> spirv = m.dump();
+    const SpirvOptimizationStats stats = optimize_spirv(spirv);
+
+    ASSERT_EQ(stats.forwarded_loads, 0U);
+    ASSERT_EQ(count_instructions(spirv, spv::OpLoad), 2);
+    ASSERT_EQ(count_instructions(spirv, spv::OpStore), 3);
+}
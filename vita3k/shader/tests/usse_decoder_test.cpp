@@ -0,0 +1,56 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <gtest/gtest.h>
+#include <shader/usse_translator_entry.h>
+
+#include <random>
+
+using namespace shader;
+
+// Reference decoder, test all the instruction types one after the other
+static const char *decode_usse_instruction_linear(const std::vector<usse::USSEInstructionPattern> &patterns, uint64_t instruction) {
+    for (const auto &pattern : patterns) {
+        if ((instruction & pattern.mask) == pattern.expected)
+            return pattern.name;
+    }
+
+    return nullptr;
+}
+
+TEST(usse_decoder, matches_linear_decoder) {
+    const auto patterns = usse::get_usse_instruction_patterns();
+    std::mt19937_64 rng(0x5553534555535345ULL);
+
+    for (int i = 0; i < 1'000'000; i++) {
+        const uint64_t instruction = rng();
+        ASSERT_EQ(usse::decode_usse_instruction(instruction), decode_usse_instruction_linear(patterns, instruction)) << std::hex << instruction;
+    }
+
+    // random words mostly hit the big instruction classes, also go through every major and secondary opcode
+    for (uint64_t top_bits = 0; top_bits < (1 << 13); top_bits++) {
+        for (int i = 0; i < 64; i++) {
+            const uint64_t instruction = (top_bits << 51) | (rng() >> 13);
+            ASSERT_EQ(usse::decode_usse_instruction(instruction), decode_usse_instruction_linear(patterns, instruction)) << std::hex << instruction;
+        }
+    }
+}
+
+TEST(usse_decoder, few_candidates_per_instruction) {
+    // the table only leaves a handful of instruction types to test for each opcode
+    ASSERT_LE(usse::get_usse_decode_max_candidates(), 3);
+}
@@ -0,0 +1,295 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// Previous implementation of the program analyzer, looks the branches up in maps while building the tree
+// Only used by the tests and the analyzer benchmark to check and measure the current one
+
+#include "usse_program_analyzer_reference.h"
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <queue>
+
+namespace shader::usse {
+
+void analyze_reference(USSEBlockNode &root, USSEOffset end_offset, const AnalyzeReadFunction &read_func) {
+    struct BlockInvestigateRequest {
+        USSEOffset begin_offset;
+        USSEOffset end_offset;
+
+        USSEBlockNode *block_node;
+    };
+
+    struct BranchInfo {
+        std::uint32_t offset;
+        std::uint32_t dest;
+
+        std::uint8_t pred;
+    };
+
+    root.reset();
+
+    std::multimap<std::uint32_t, BranchInfo> branches_to_back;
+    std::map<std::uint32_t, BranchInfo> branches_from;
+
+    std::queue<BlockInvestigateRequest> investigate_queue;
+    investigate_queue.push({ 0, end_offset, &root });
+
+    // First off query all branches first
+    // This is for easy tracing of loops and branches later, without complicating the algorithm
+    // For example, loop might be in a loop :(
+    for (usse::USSEOffset baddr = 0; baddr <= end_offset; baddr += 1) {
+        auto inst = read_func(baddr);
+
+        std::uint8_t pred = 0;
+        std::int32_t br_off = 0;
+
+        if (is_branch(inst, pred, br_off)) {
+            const std::uint32_t dest = baddr + br_off;
+            BranchInfo info = { baddr, dest, pred };
+
+            if (br_off < 0)
+                branches_to_back.emplace(dest, info);
+
+            branches_from.emplace(baddr, info);
+        }
+    }
+
+    while (!investigate_queue.empty()) {
+        BlockInvestigateRequest request = std::move(investigate_queue.front());
+        investigate_queue.pop();
+
+        std::unique_ptr<USSEBaseNode> current_code_inst = std::make_unique<USSECodeNode>(request.block_node);
+        USSECodeNode *current_code = reinterpret_cast<USSECodeNode *>(current_code_inst.get());
+
+        current_code->offset = request.begin_offset;
+        current_code->size = 0;
+
+        for (auto baddr = request.begin_offset; baddr <= request.end_offset; baddr += 1) {
+            auto inst = read_func(baddr);
+
+            if (inst == 0) {
+                break;
+            }
+
+            std::uint8_t pred = get_predicate(inst);
+
+            if (baddr == current_code->offset) {
+                current_code->condition = pred;
+            }
+
+            auto branch_from_result = branches_from.find(baddr);
+            auto branch_to_result = branches_to_back.equal_range(baddr);
+
+            if (branch_from_result != branches_from.end()) {
+                bool is_loop_stmt = false;
+
+                // It might be a break to exit a loop
+                // Get the nearest parent that is a loop
+                USSEBaseNode *loop_parent = request.block_node;
+                while (loop_parent && (loop_parent->node_type() != USSE_LOOP_NODE)) {
+                    loop_parent = loop_parent->get_parent();
+                }
+
+                if (loop_parent) {
+                    USSELoopNode *loop_node = reinterpret_cast<USSELoopNode *>(loop_parent);
+                    std::unique_ptr<USSEBaseNode> node_to_add;
+
+                    if (loop_node->get_loop_end_offset() <= branch_from_result->second.dest - 1) {
+                        node_to_add = std::make_unique<USSEBreakNode>(request.block_node, branch_from_result->second.pred);
+
+                        is_loop_stmt = true;
+                    } else if (loop_node->content_block()->start_offset() == branch_from_result->second.dest) {
+                        assert((branch_from_result->second.pred == 0) && "Continuing and abadon further statement without a condition is crazy");
+
+                        // The loop is continuing!!!!
+                        node_to_add = std::make_unique<USSEContinueNode>(request.block_node, branch_from_result->second.pred);
+                        is_loop_stmt = true;
+                    }
+
+                    if (node_to_add) {
+                        current_code->size = baddr - current_code->offset;
+
+                        request.block_node->add_children(current_code_inst);
+                        request.block_node->add_children(node_to_add);
+
+                        current_code_inst = std::make_unique<USSECodeNode>(request.block_node);
+                        current_code = reinterpret_cast<USSECodeNode *>(current_code_inst.get());
+
+                        current_code->offset = baddr + 1;
+                    }
+                }
+
+                // Likely a normal if
+                if (!is_loop_stmt) {
+                    // Some ifs may be trying to jump to parent's merge point. It's also means there's no more content
+                    // further in this block.
+                    if (branch_from_result->second.pred == 0) {
+                        // Execution changed direction, follow it
+                        current_code->size = baddr - current_code->offset;
+                        request.block_node->add_children(current_code_inst);
+
+                        baddr = branch_from_result->second.dest - 1;
+
+                        std::unique_ptr<USSEBaseNode> current_code_inst = std::make_unique<USSECodeNode>(request.block_node);
+                        USSECodeNode *current_code = reinterpret_cast<USSECodeNode *>(current_code_inst.get());
+
+                        current_code->offset = baddr;
+                    } else {
+                        bool else_exist = false;
+                        auto branch_from_else_result = branches_from.find(branch_from_result->second.dest - 1);
+
+                        std::uint32_t else_end_offset = 0;
+
+                        // Simply a jump to after else
+                        if (branch_from_else_result != branches_from.end()) {
+                            assert((branch_from_else_result->second.pred == 0) && "Unhandled!");
+
+                            // Note: There might be nastier situation where the if block ends sooner then after that is some block
+                            // of other blocks. Hope the compiler is not that nasty.
+                            // The solution is to keep track of the statement stack and finally get the final branch, but with loop also available
+                            // it is presenting itself as kind of hard
+                            if (branch_from_else_result->second.dest >= branch_from_result->second.dest) {
+                                else_end_offset = branch_from_else_result->second.dest;
+                                else_exist = true;
+                            } else {
+                                // Some blocks optimized by throwing merge to after else into inner for loop
+                                // This is logical in case the if only contains the loop.
+                                auto begin_ite = branches_from.upper_bound(branch_from_else_result->second.dest + 1);
+                                auto end_ite = branches_from.lower_bound(branch_from_result->second.dest - 1);
+
+                                if ((begin_ite != branches_from.end()) && (end_ite != branches_from.end())) {
+                                    for (; begin_ite != end_ite; ++begin_ite) {
+                                        if (begin_ite->second.dest > branch_from_result->second.dest) {
+                                            else_exist = true;
+                                            else_end_offset = begin_ite->second.dest;
+                                        }
+                                    }
+                                }
+                            }
+                        }
+
+                        std::uint32_t merge_point = (else_exist ? else_end_offset : branch_from_result->second.dest);
+
+                        // Create a new if/else tree (there might be no else :D)
+                        // The space between the branch and the jump is the content block of the if
+                        // If assuming the condition of the jump is p0, then the if will be if (!p0) content
+                        // If the instruction before the destinated jump location is another branch, it is likely the else block
+                        std::unique_ptr<USSEBaseNode> conditional_inst = std::make_unique<USSEConditionalNode>(request.block_node, merge_point);
+                        USSEConditionalNode *conditional = reinterpret_cast<USSEConditionalNode *>(conditional_inst.get());
+
+                        conditional->set_negif_condition(pred);
+
+                        std::unique_ptr<USSEBaseNode> if_block = std::make_unique<USSEBlockNode>(conditional_inst.get(), baddr);
+                        conditional->set_if_block(if_block);
+
+                        // Sometimes it jumps to the merge point of mother, so we limit the range
+                        investigate_queue.push({ baddr + 1, std::min<USSEOffset>(branch_from_result->second.dest - 1, request.end_offset),
+                            conditional->if_block() });
+
+                        if (else_exist) {
+                            std::unique_ptr<USSEBaseNode> else_block = std::make_unique<USSEBlockNode>(conditional_inst.get(), branch_from_result->second.dest);
+                            conditional->set_else_block(else_block);
+
+                            investigate_queue.push({ branch_from_result->second.dest, else_end_offset - 1, conditional->else_block() });
+                        }
+
+                        // End the current block code, and also add this block in
+                        current_code->size = baddr - current_code->offset;
+                        request.block_node->add_children(current_code_inst);
+                        request.block_node->add_children(conditional_inst);
+
+                        current_code_inst = std::make_unique<USSECodeNode>(request.block_node);
+                        current_code = reinterpret_cast<USSECodeNode *>(current_code_inst.get());
+
+                        current_code->offset = merge_point;
+                        baddr = current_code->offset - 1;
+                    }
+                }
+            } else if (branches_to_back.contains(baddr) && (request.block_node->start_offset() != baddr)) {
+                // The loop continue target should be unconditional and farest
+                std::uint32_t found_offset = 0xFFFFFFFF;
+                for (auto ite = branch_to_result.first; ite != branch_to_result.second; ++ite) {
+                    if ((ite->second.pred == 0) && ((found_offset == 0xFFFFFFFF) || (found_offset < ite->second.offset))) {
+                        found_offset = ite->second.offset;
+                    }
+                }
+
+                assert((found_offset != 0xFFFFFFFF) && "Offset to end loop not found!");
+
+                // Smell like a loop ! Create a loop node
+                // The outer farest with no conditional jump should be the one we are looking for
+                std::unique_ptr<USSEBaseNode> loop_node_inst = std::make_unique<USSELoopNode>(request.block_node, found_offset);
+                USSELoopNode *loop_node = reinterpret_cast<USSELoopNode *>(loop_node_inst.get());
+
+                std::unique_ptr<USSEBaseNode> content_block = std::make_unique<USSEBlockNode>(loop_node_inst.get(), baddr);
+                loop_node->set_content_block(content_block);
+
+                investigate_queue.push({ baddr, found_offset - 1, loop_node->content_block() });
+
+                current_code->size = baddr - current_code->offset;
+
+                request.block_node->add_children(current_code_inst);
+                request.block_node->add_children(loop_node_inst);
+
+                current_code_inst = std::make_unique<USSECodeNode>(request.block_node);
+                current_code = reinterpret_cast<USSECodeNode *>(current_code_inst.get());
+
+                current_code->offset = found_offset + 1;
+                baddr = current_code->offset - 1;
+            } else {
+                bool is_predicate_invalidated = false;
+
+                std::uint8_t predicate_writed_to = 0;
+                if (does_write_to_predicate(inst, predicate_writed_to)) {
+                    is_predicate_invalidated = ((predicate_writed_to + 1) == current_code->condition) || ((predicate_writed_to + 5) == current_code->condition);
+                }
+
+                std::uint32_t offset_end = 0;
+
+                // Either if the instruction has different predicate with the block,
+                // or the predicate value is being invalidated (overwritten)
+                // which means continuing is obselete. Stop now
+                if (pred != current_code->condition) {
+                    current_code->size = baddr - current_code->offset;
+                    offset_end = baddr;
+                } else if (is_predicate_invalidated) {
+                    current_code->size = baddr + 1 - current_code->offset;
+                    offset_end = baddr + 1;
+                }
+
+                if (offset_end != 0) {
+                    request.block_node->add_children(current_code_inst);
+
+                    current_code_inst = std::make_unique<USSECodeNode>(request.block_node);
+                    current_code = reinterpret_cast<USSECodeNode *>(current_code_inst.get());
+
+                    current_code->offset = offset_end;
+                    baddr = offset_end - 1;
+                }
+            }
+        }
+
+        if (current_code_inst) {
+            current_code->size = request.end_offset - current_code->offset + 1;
+            request.block_node->add_children(current_code_inst);
+        }
+    }
+}
+
+} // namespace shader::usse
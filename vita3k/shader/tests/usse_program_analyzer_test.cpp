@@ -18,9 +18,205 @@
 #include <gtest/gtest.h>
 #include <shader/usse_program_analyzer.h>
 
-#include <unordered_map>
+#include "usse_program_analyzer_reference.h"
+
+#include <random>
 
 using namespace shader;
 
+// instruction without any predicate which is not a branch
+static constexpr uint64_t NOP = (0b01000ULL << 59) | 1;
+
+static uint64_t make_branch(uint8_t pred, int32_t offset) {
+    uint64_t high = (0b11111U << 27) | (static_cast<uint32_t>(pred) << 24);
+    if (offset < 0)
+        // sign extend the 20-bit offset
+        high |= 1 << 6;
+    return (high << 32) | (static_cast<uint32_t>(offset) & ((1 << 20) - 1));
+}
+
+static const usse::USSECodeNode &as_code(const usse::USSEBaseNode *node) {
+    EXPECT_EQ(node->node_type(), usse::USSE_CODE_NODE);
+    return *static_cast<const usse::USSECodeNode *>(node);
+}
+
 TEST(program_analyzer, simple_branching) {
+    const std::vector<uint64_t> program = {
+        NOP,
+        make_branch(1, 3), // if (!p0)
+        NOP,
+        make_branch(0, 2), // else
+        NOP,
+        NOP,
+    };
+
+    usse::USSEControlFlowGraph cfg;
+    usse::build_control_flow_graph(cfg, program.data(), program.size());
+    ASSERT_EQ(cfg.blocks.size(), 4);
+    ASSERT_EQ(cfg.branch_offsets, (std::vector<usse::USSEOffset>{ 1, 3 }));
+    ASSERT_EQ(cfg.blocks[0].successors, (std::array<int32_t, 2>{ 2, 1 }));
+    ASSERT_EQ(cfg.blocks[1].successors, (std::array<int32_t, 2>{ 3, -1 }));
+    ASSERT_EQ(cfg.blocks[3].predecessor_count, 2);
+    ASSERT_EQ(cfg.block_of[4], 2);
+
+    usse::USSEBlockNode root(nullptr, 0);
+    usse::analyze(root, program.data(), program.size());
+    ASSERT_EQ(root.children_count(), 3);
+    ASSERT_EQ(as_code(root.children_at(0)).size, 1);
+    ASSERT_EQ(root.children_at(1)->node_type(), usse::USSE_CONDITIONAL_NODE);
+    ASSERT_EQ(as_code(root.children_at(2)).offset, 5);
+
+    const auto &conditional = *static_cast<const usse::USSEConditionalNode *>(root.children_at(1));
+    ASSERT_EQ(conditional.get_merge_point(), 5);
+    ASSERT_EQ(as_code(conditional.if_block()->children_at(0)).offset, 2);
+    ASSERT_EQ(as_code(conditional.else_block()->children_at(0)).offset, 4);
+}
+
+TEST(program_analyzer, loop_with_break) {
+    const std::vector<uint64_t> program = {
+        NOP,
+        NOP,
+        make_branch(1, 3), // break
+        NOP,
+        make_branch(0, -3), // back to the start of the loop
+        NOP,
+    };
+
+    usse::USSEControlFlowGraph cfg;
+    usse::build_control_flow_graph(cfg, program.data(), program.size());
+    const usse::USSEBasicBlock *header = cfg.block_starting_at(1);
+    ASSERT_NE(header, nullptr);
+    ASSERT_TRUE(header->is_back_branch_target);
+    ASSERT_EQ(header->loop_end, 4);
+
+    usse::USSEBlockNode root(nullptr, 0);
+    usse::analyze(root, program.data(), program.size());
+    ASSERT_EQ(root.children_count(), 3);
+    ASSERT_EQ(root.children_at(1)->node_type(), usse::USSE_LOOP_NODE);
+
+    const auto &loop = *static_cast<const usse::USSELoopNode *>(root.children_at(1));
+    ASSERT_EQ(loop.get_loop_end_offset(), 4);
+    const usse::USSEBlockNode &content = *loop.content_block();
+    ASSERT_EQ(content.children_count(), 3);
+    ASSERT_EQ(content.children_at(1)->node_type(), usse::USSE_BREAK_NODE);
+
+    // the same program gets the same tree
+    ASSERT_EQ(usse::analyze_cached(program.data(), program.size()), usse::analyze_cached(program.data(), program.size()));
+}
+
+// random program made of nested if/else and loops, the way the compiler lays them out
+static void make_structured_program(std::mt19937 &rng, std::vector<uint64_t> &program, int depth) {
+    const int nb_statements = rng() % 4 + 1;
+    for (int i = 0; i < nb_statements; i++) {
+        switch (depth > 3 ? 0 : rng() % 4) {
+        case 0: {
+            // some instructions, a few of them predicated
+            const int nb_instructions = rng() % 3 + 1;
+            for (int j = 0; j < nb_instructions; j++)
+                program.push_back(rng() % 5 == 0 ? ((NOP & ~(7ULL << 56)) | (static_cast<uint64_t>(rng() % 3) << 56)) : NOP);
+            break;
+        }
+        case 1: {
+            // if
+            const size_t branch = program.size();
+            program.push_back(0);
+            make_structured_program(rng, program, depth + 1);
+            program[branch] = make_branch(1 + rng() % 2, static_cast<int32_t>(program.size() - branch));
+            break;
+        }
+        case 2: {
+            // if/else
+            const size_t branch = program.size();
+            program.push_back(0);
+            make_structured_program(rng, program, depth + 1);
+            const size_t jump = program.size();
+            program.push_back(0);
+            program[branch] = make_branch(1, static_cast<int32_t>(program.size() - branch));
+            make_structured_program(rng, program, depth + 1);
+            program[jump] = make_branch(0, static_cast<int32_t>(program.size() - jump));
+            break;
+        }
+        default: {
+            // loop
+            program.push_back(NOP);
+            const size_t header = program.size();
+            program.push_back(NOP);
+            make_structured_program(rng, program, depth + 1);
+            program.push_back(make_branch(0, static_cast<int32_t>(header) - static_cast<int32_t>(program.size())));
+            break;
+        }
+        }
+    }
+}
+
+static bool same_tree(const usse::USSEBaseNode *lhs, const usse::USSEBaseNode *rhs) {
+    if (!lhs || !rhs)
+        return lhs == rhs;
+    if ((lhs->node_type() != rhs->node_type()) || (lhs->children_count() != rhs->children_count()))
+        return false;
+
+    switch (lhs->node_type()) {
+    case usse::USSE_BLOCK_NODE:
+        if (static_cast<const usse::USSEBlockNode *>(lhs)->start_offset() != static_cast<const usse::USSEBlockNode *>(rhs)->start_offset())
+            return false;
+        break;
+    case usse::USSE_CODE_NODE: {
+        const auto &lhs_code = *static_cast<const usse::USSECodeNode *>(lhs);
+        const auto &rhs_code = *static_cast<const usse::USSECodeNode *>(rhs);
+        if ((lhs_code.offset != rhs_code.offset) || (lhs_code.size != rhs_code.size) || (lhs_code.condition != rhs_code.condition))
+            return false;
+        break;
+    }
+    case usse::USSE_CONDITIONAL_NODE:
+        if (static_cast<const usse::USSEConditionalNode *>(lhs)->get_merge_point() != static_cast<const usse::USSEConditionalNode *>(rhs)->get_merge_point())
+            return false;
+        break;
+    case usse::USSE_LOOP_NODE:
+        if (static_cast<const usse::USSELoopNode *>(lhs)->get_loop_end_offset() != static_cast<const usse::USSELoopNode *>(rhs)->get_loop_end_offset())
+            return false;
+        break;
+    case usse::USSE_BREAK_NODE:
+        if (static_cast<const usse::USSEBreakNode *>(lhs)->get_condition() != static_cast<const usse::USSEBreakNode *>(rhs)->get_condition())
+            return false;
+        break;
+    case usse::USSE_CONTINUE_NODE:
+        if (static_cast<const usse::USSEContinueNode *>(lhs)->get_condition() != static_cast<const usse::USSEContinueNode *>(rhs)->get_condition())
+            return false;
+        break;
+    default:
+        break;
+    }
+
+    for (size_t i = 0; i < lhs->children_count(); i++) {
+        if (!same_tree(lhs->children_at(i), rhs->children_at(i)))
+            return false;
+    }
+
+    return true;
+}
+
+TEST(program_analyzer, matches_reference_analyzer) {
+    for (int seed = 0; seed < 3000; seed++) {
+        std::mt19937 rng(seed);
+        std::vector<uint64_t> program;
+        make_structured_program(rng, program, 0);
+        program.push_back(NOP);
+
+        usse::USSEBlockNode root(nullptr, 0);
+        usse::analyze(root, program.data(), program.size());
+        usse::USSEBlockNode reference_root(nullptr, 0);
+        usse::analyze_reference(reference_root, static_cast<usse::USSEOffset>(program.size() - 1), [&](usse::USSEOffset offset) { return program[offset]; });
+
+        ASSERT_TRUE(same_tree(&root, &reference_root)) << "seed " << seed;
+    }
+}
+
+TEST(program_analyzer, cache_compares_instructions) {
+    const std::vector<uint64_t> program = { NOP, make_branch(1, 2), NOP, NOP };
+    std::vector<uint64_t> other_program = program;
+    other_program[1] = make_branch(2, 2);
+
+    const auto root = usse::analyze_cached(program.data(), program.size());
+    ASSERT_EQ(usse::analyze_cached(std::vector<uint64_t>(program).data(), program.size()), root);
+    ASSERT_NE(usse::analyze_cached(other_program.data(), other_program.size()), root);
 }
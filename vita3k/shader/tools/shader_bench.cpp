@@ -0,0 +1,330 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// Headless shader translation benchmark
+// Translate every dumped gxp program of a directory for each target and report, as JSON,
+// the translation time, the size of the generated code and the programs which failed to translate
+
+#include <shader/spirv_optimizer.h>
+#include <shader/spirv_recompiler.h>
+
+#include <features/state.h>
+#include <gxm/types.h>
+#include <util/fs.h>
+#include <util/log.h>
+
+#include <CLI11.hpp>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct TargetInfo {
+    const char *name;
+    shader::Target target;
+    FeatureState features;
+};
+
+struct TargetResult {
+    bool success = false;
+    std::string error;
+    double min_ms = 0.0;
+    double mean_ms = 0.0;
+    // size of the SPIR-V module or of the GLSL source
+    size_t spirv_bytes = 0;
+    size_t glsl_bytes = 0;
+    // only when the SPIR-V optimizer is run
+    double optimize_ms = 0.0;
+    shader::SpirvOptimizationStats optimization;
+};
+
+struct ProgramResult {
+    std::string path;
+    bool is_fragment = false;
+    std::string error;
+    std::vector<TargetResult> targets;
+};
+
+std::vector<TargetInfo> get_targets() {
+    // features of a Vulkan renderer without high accuracy
+    FeatureState vulkan_features;
+    vulkan_features.direct_fragcolor = true;
+    vulkan_features.support_unknown_format = true;
+
+    // same features as convert_gxp_to_glsl_from_filepath
+    FeatureState glsl_features;
+    glsl_features.direct_fragcolor = false;
+    glsl_features.support_shader_interlock = true;
+
+    return {
+        { "spirv-vulkan", shader::Target::SpirVVulkan, vulkan_features },
+        { "glsl", shader::Target::GLSLOpenGL, glsl_features },
+    };
+}
+
+shader::Hints get_default_hints() {
+    // the hints are only known at draw time, use the most common formats
+    shader::Hints hints{
+        .attributes = nullptr,
+        .color_format = SCE_GXM_COLOR_FORMAT_U8U8U8U8_ABGR,
+    };
+    std::fill_n(hints.vertex_textures, SCE_GXM_MAX_TEXTURE_UNITS, SCE_GXM_TEXTURE_FORMAT_U8U8U8U8_ABGR);
+    std::fill_n(hints.fragment_textures, SCE_GXM_MAX_TEXTURE_UNITS, SCE_GXM_TEXTURE_FORMAT_U8U8U8U8_ABGR);
+    return hints;
+}
+
+bool load_program(const fs::path &path, std::vector<uint8_t> &data, std::string &error) {
+    boost::system::error_code ec;
+    const auto size = fs::file_size(path, ec);
+    if (ec || size < sizeof(SceGxmProgram)) {
+        error = "file too small to be a gxp program";
+        return false;
+    }
+
+    std::ifstream file(path.native(), std::ios::binary);
+    data.resize(size);
+    if (!file.read(reinterpret_cast<char *>(data.data()), size)) {
+        error = "could not read the file";
+        return false;
+    }
+
+    const SceGxmProgram &program = *reinterpret_cast<const SceGxmProgram *>(data.data());
+    if (memcmp(&program.magic, "GXP", 4) != 0) {
+        error = "invalid gxp magic";
+        return false;
+    }
+    if (program.size > size) {
+        error = "truncated gxp program";
+        return false;
+    }
+
+    return true;
+}
+
+TargetResult translate(const SceGxmProgram &program, const std::string &name, const TargetInfo &target, const shader::Hints &hints, int iterations, bool optimize) {
+    TargetResult result;
+    result.min_ms = std::numeric_limits<double>::max();
+
+    shader::GeneratedShader shader;
+    double total_ms = 0.0;
+    try {
+        for (int i = 0; i < iterations; i++) {
+            const auto start = std::chrono::steady_clock::now();
+            shader = shader::convert_gxp(program, name, target.features, target.target, hints);
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+            total_ms += elapsed.count();
+            result.min_ms = std::min(result.min_ms, elapsed.count());
+        }
+    } catch (const std::exception &e) {
+        result.error = e.what();
+        result.min_ms = 0.0;
+        return result;
+    }
+
+    result.mean_ms = total_ms / iterations;
+    result.spirv_bytes = shader.spirv.size() * sizeof(uint32_t);
+    result.glsl_bytes = shader.glsl.size();
+    result.success = result.spirv_bytes != 0 || result.glsl_bytes != 0;
+    if (!result.success)
+        result.error = "empty output";
+
+    if (optimize && !shader.spirv.empty()) {
+        const auto start = std::chrono::steady_clock::now();
+        result.optimization = shader::optimize_spirv(shader.spirv);
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        result.optimize_ms = elapsed.count();
+    }
+
+    return result;
+}
+
+std::string json_escape(const std::string &str) {
+    std::string escaped;
+    escaped.reserve(str.size());
+    for (const char c : str) {
+        switch (c) {
+        case '"': escaped += "\\\""; break;
+        case '\\': escaped += "\\\\"; break;
+        case '\n': escaped += "\\n"; break;
+        case '\t': escaped += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+                escaped += fmt::format("\\u{:04x}", static_cast<int>(c));
+            else
+                escaped += c;
+            break;
+        }
+    }
+    return escaped;
+}
+
+void write_json(std::ostream &out, const std::vector<TargetInfo> &targets, const std::vector<ProgramResult> &results, bool optimize, double wall_ms) {
+    out << "{\n";
+    out << fmt::format("  \"shader_version\": {},\n", shader::CURRENT_VERSION);
+    out << fmt::format("  \"program_count\": {},\n", results.size());
+    out << fmt::format("  \"wall_ms\": {:.3f},\n", wall_ms);
+
+    // totals per target
+    out << "  \"summary\": {\n";
+    for (size_t t = 0; t < targets.size(); t++) {
+        size_t failures = 0;
+        size_t bytes = 0;
+        double time_ms = 0.0;
+        shader::SpirvOptimizationStats optimization;
+        for (const ProgramResult &program : results) {
+            if (program.targets.empty() || !program.targets[t].success) {
+                failures++;
+                continue;
+            }
+            const TargetResult &result = program.targets[t];
+            bytes += result.spirv_bytes + result.glsl_bytes;
+            time_ms += result.mean_ms;
+            optimization += result.optimization;
+        }
+
+        out << fmt::format("    \"{}\": {{ \"failures\": {}, \"total_ms\": {:.3f}, \"total_bytes\": {}", targets[t].name, failures, time_ms, bytes);
+        if (optimize && optimization.instructions_before != 0)
+            out << fmt::format(", \"instructions_before\": {}, \"instructions_after\": {}", optimization.instructions_before, optimization.instructions_after);
+        out << (t + 1 < targets.size() ? " },\n" : " }\n");
+    }
+    out << "  },\n";
+
+    out << "  \"programs\": [\n";
+    for (size_t p = 0; p < results.size(); p++) {
+        const ProgramResult &program = results[p];
+        out << fmt::format("    {{ \"path\": \"{}\", \"type\": \"{}\"", json_escape(program.path), program.is_fragment ? "fragment" : "vertex");
+        if (!program.error.empty())
+            out << fmt::format(", \"error\": \"{}\"", json_escape(program.error));
+
+        out << ", \"targets\": {";
+        for (size_t t = 0; t < program.targets.size(); t++) {
+            const TargetResult &result = program.targets[t];
+            out << fmt::format("{}\"{}\": {{ \"success\": {}", t == 0 ? " " : ", ", targets[t].name, result.success);
+            if (!result.error.empty())
+                out << fmt::format(", \"error\": \"{}\"", json_escape(result.error));
+            out << fmt::format(", \"min_ms\": {:.3f}, \"mean_ms\": {:.3f}", result.min_ms, result.mean_ms);
+            if (result.spirv_bytes != 0)
+                out << fmt::format(", \"spirv_bytes\": {}", result.spirv_bytes);
+            if (result.glsl_bytes != 0)
+                out << fmt::format(", \"glsl_bytes\": {}", result.glsl_bytes);
+            if (optimize && result.optimization.instructions_before != 0)
+                out << fmt::format(", \"optimize_ms\": {:.3f}, \"instructions_before\": {}, \"instructions_after\": {}",
+                    result.optimize_ms, result.optimization.instructions_before, result.optimization.instructions_after);
+            out << " }";
+        }
+        out << (program.targets.empty() ? "}" : " }");
+        out << (p + 1 < results.size() ? " },\n" : " }\n");
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    std::string input_path;
+    std::string output_path;
+    int iterations = 1;
+    int thread_count = std::clamp<int>(std::thread::hardware_concurrency(), 1, 16);
+    bool optimize = false;
+    bool verbose = false;
+
+    CLI::App app{ "Vita3K shader translation benchmark" };
+    app.add_option("gxp-path", input_path, "Directory containing the dumped .gxp programs (searched recursively)")->required();
+    app.add_option("--output,-o", output_path, "Write the JSON report to this file instead of stdout");
+    app.add_option("--iterations,-i", iterations, "Number of times each program is translated for each target")->check(CLI::Range(1, 1000));
+    app.add_option("--threads,-j", thread_count, "Number of programs translated in parallel")->check(CLI::Range(1, 256));
+    app.add_flag("--optimize", optimize, "Also run the SPIR-V optimizer on the generated modules and report its gains");
+    app.add_flag("--verbose,-v", verbose, "Keep the translator logs");
+    CLI11_PARSE(app, argc, argv);
+
+    // the translator logs go to stdout, which may also receive the report
+    logging::set_level(verbose ? spdlog::level::info : spdlog::level::off);
+
+    std::vector<fs::path> paths;
+    boost::system::error_code ec;
+    for (fs::recursive_directory_iterator it(fs::path(input_path), ec), end; !ec && it != end; it.increment(ec)) {
+        if (fs::is_regular_file(it->path()) && it->path().extension() == ".gxp")
+            paths.push_back(it->path());
+    }
+    if (ec) {
+        fmt::print(stderr, "Could not read the directory {}: {}\n", input_path, ec.message());
+        return 1;
+    }
+    // keep the report stable from one run to the next
+    std::sort(paths.begin(), paths.end());
+
+    const std::vector<TargetInfo> targets = get_targets();
+    const shader::Hints hints = get_default_hints();
+    std::vector<ProgramResult> results(paths.size());
+
+    std::atomic<size_t> next_program = 0;
+    const auto worker = [&]() {
+        for (size_t i = next_program++; i < paths.size(); i = next_program++) {
+            ProgramResult &result = results[i];
+            result.path = fs::relative(paths[i], fs::path(input_path)).generic_string();
+
+            std::vector<uint8_t> data;
+            if (!load_program(paths[i], data, result.error))
+                continue;
+
+            const SceGxmProgram &program = *reinterpret_cast<const SceGxmProgram *>(data.data());
+            result.is_fragment = program.is_fragment();
+            const std::string name = paths[i].stem().string();
+            for (const TargetInfo &target : targets)
+                result.targets.push_back(translate(program, name, target, hints, iterations, optimize));
+        }
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 1; i < std::min<int>(thread_count, paths.size()); i++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &thread : threads)
+        thread.join();
+    const std::chrono::duration<double, std::milli> wall_time = std::chrono::steady_clock::now() - start;
+
+    if (output_path.empty()) {
+        write_json(std::cout, targets, results, optimize, wall_time.count());
+    } else {
+        std::ofstream out(output_path);
+        if (!out) {
+            fmt::print(stderr, "Could not create {}\n", output_path);
+            return 1;
+        }
+        write_json(out, targets, results, optimize, wall_time.count());
+    }
+
+    const size_t failures = std::count_if(results.begin(), results.end(), [](const ProgramResult &result) {
+        return result.targets.empty() || std::any_of(result.targets.begin(), result.targets.end(), [](const TargetResult &target) { return !target.success; });
+    });
+    fmt::print(stderr, "{} programs translated in {:.1f} ms, {} failed\n", paths.size(), wall_time.count(), failures);
+
+    // a non-zero exit code lets scripts catch regressions
+    return failures == 0 ? 0 : 2;
+}
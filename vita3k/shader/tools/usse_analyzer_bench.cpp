@@ -0,0 +1,88 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// USSE program analyzer benchmark
+// Analyzes big generated programs made of if/else and loops, like big fragment programs, and reports the time
+// taken by the analyzer, by the previous map based analyzer and by a cached analysis.
+
+#include <shader/usse_program_analyzer.h>
+
+#include "usse_program_analyzer_reference.h"
+
+#include <CLI11.hpp>
+#include <fmt/format.h>
+
+#include <chrono>
+#include <vector>
+
+namespace {
+
+// instruction without any predicate which is not a branch
+constexpr uint64_t NOP = (0b01000ULL << 59) | 1;
+
+uint64_t make_branch(uint8_t pred, int32_t offset) {
+    uint64_t high = (0b11111U << 27) | (static_cast<uint32_t>(pred) << 24);
+    if (offset < 0)
+        // sign extend the 20-bit offset
+        high |= 1 << 6;
+    return (high << 32) | (static_cast<uint32_t>(offset) & ((1 << 20) - 1));
+}
+
+template <typename F>
+double run(int32_t run_count, F analyze) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < run_count; i++)
+        analyze();
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count() / run_count;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<int32_t> pattern_counts = { 100, 1000, 10000 };
+    int32_t run_count = 10;
+
+    CLI::App app{ "Vita3K USSE program analyzer benchmark" };
+    app.add_option("--patterns,-p", pattern_counts, "Number of if/else and loop patterns in the program, one run for each value")->check(CLI::Range(1, 100000));
+    app.add_option("--runs,-n", run_count, "Number of analyses timed")->check(CLI::Range(1, 100000));
+    CLI11_PARSE(app, argc, argv);
+
+    for (const int32_t pattern_count : pattern_counts) {
+        std::vector<uint64_t> program;
+        for (int32_t i = 0; i < pattern_count; i++) {
+            program.insert(program.end(), { NOP, make_branch(1, 3), NOP, make_branch(0, 2), NOP, NOP });
+            program.insert(program.end(), { NOP, NOP, make_branch(2, 3), NOP, make_branch(0, -3), NOP });
+        }
+        const auto end_offset = static_cast<shader::usse::USSEOffset>(program.size() - 1);
+
+        shader::usse::USSEBlockNode root(nullptr, 0);
+        const double ms = run(run_count, [&] { shader::usse::analyze(root, program.data(), program.size()); });
+        const double reference_ms = run(run_count, [&] {
+            shader::usse::analyze_reference(root, end_offset, [&](shader::usse::USSEOffset offset) { return program[offset]; });
+        });
+
+        shader::usse::analyze_cached(program.data(), program.size());
+        const double cached_ms = run(run_count, [&] { shader::usse::analyze_cached(program.data(), program.size()); });
+
+        fmt::print("instructions: {:6}, analyzer: {:8.3f} ms, previous analyzer: {:8.3f} ms, cached: {:8.3f} ms\n",
+            program.size(), ms, reference_ms, cached_ms);
+    }
+
+    return 0;
+}
@@ -0,0 +1,81 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// USSE decoder benchmark
+// There is no shader corpus in the tree, decode random valid instructions with the table decoder and with the
+// linear reference decoder and report how many instructions each one decodes per second.
+
+#include <shader/usse_translator_entry.h>
+
+#include <CLI11.hpp>
+#include <fmt/format.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Reference decoder, test all the instruction types one after the other
+const char *decode_usse_instruction_linear(uint64_t instruction) {
+    static const auto patterns = shader::usse::get_usse_instruction_patterns();
+    for (const auto &pattern : patterns) {
+        if ((instruction & pattern.mask) == pattern.expected)
+            return pattern.name;
+    }
+
+    return nullptr;
+}
+
+template <typename F>
+double run(const std::vector<uint64_t> &instructions, F decode, size_t &decoded) {
+    decoded = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const uint64_t instruction : instructions)
+        decoded += decode(instruction) != nullptr;
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    int32_t instruction_count = 1'000'000;
+
+    CLI::App app{ "Vita3K USSE decoder benchmark" };
+    app.add_option("--instructions,-n", instruction_count, "Number of instructions decoded")->check(CLI::Range(1, 100000000));
+    CLI11_PARSE(app, argc, argv);
+
+    std::mt19937_64 rng(instruction_count);
+    std::vector<uint64_t> instructions;
+    instructions.reserve(instruction_count);
+    while (instructions.size() < static_cast<size_t>(instruction_count)) {
+        const uint64_t instruction = rng();
+        if (decode_usse_instruction_linear(instruction))
+            instructions.push_back(instruction);
+    }
+
+    size_t decoded = 0;
+    const double table_seconds = run(instructions, shader::usse::decode_usse_instruction, decoded);
+    fmt::print("table decoder:  {:6.1f} million instructions per second, {} decoded\n", instructions.size() / table_seconds / 1e6, decoded);
+    const double linear_seconds = run(instructions, decode_usse_instruction_linear, decoded);
+    fmt::print("linear decoder: {:6.1f} million instructions per second, {} decoded\n", instructions.size() / linear_seconds / 1e6, decoded);
+    fmt::print("max candidates per instruction: {}\n", shader::usse::get_usse_decode_max_candidates());
+
+    return 0;
+}
@@ -22,9 +22,12 @@
 #include <touch/functions.h>
 #include <touch/state.h>
 #include <touch/touch.h>
+#include <util/seqlock.h>
 
 #include <SDL_events.h>
 
+#include <array>
+#include <atomic>
 #include <cstring>
 
 // are the touch events about the front or back touchscreen
@@ -41,8 +44,14 @@ Java_org_vita3k_emulator_overlay_InputOverlay_setTouchState(JNIEnv *env, jobject
 
 constexpr int MAX_TOUCH_BUFFER_SAVED = 64;
 
-static SceTouchData touch_buffers[MAX_TOUCH_BUFFER_SAVED][2];
-static int touch_buffer_idx = 0;
+// touch data of the front and back touchscreen for one vsync
+struct TouchFrame {
+    SceTouchData ports[2];
+};
+
+// Written on the vblank thread, the guest threads read them without locking
+static std::array<SeqLock<TouchFrame>, MAX_TOUCH_BUFFER_SAVED> touch_buffers;
+static std::atomic<int> touch_buffer_idx = 0;
 static bool is_touchpad = false;
 static SDL_TouchFingerEvent finger_buffer[8];
 static SDL_ControllerTouchpadEvent touchpad_buffer[8];
@@ -112,17 +121,16 @@ void touch_vsync_update(const EmuEnvState &emuenv) {
     constexpr bool on_android = false;
 #endif
 
+    TouchFrame frame;
+    memset(&frame, 0, sizeof(frame));
+
     if (finger_count > 0 || touchpad_finger_count > 0 || on_android) {
         SceTouchData touch_data = is_touchpad ? recover_touchpad_events(emuenv) : recover_touch_events(emuenv);
         touch_data.timeStamp = timestamp;
 
-        SceTouchData *buffers = touch_buffers[(touch_buffer_idx + 1) % MAX_TOUCH_BUFFER_SAVED];
-        for (int port = 0; port < 2; port++) {
-            buffers[port].status = 0;
-            buffers[port].reportNum = 0;
-            buffers[port].timeStamp = timestamp;
-        }
-        buffers[touchscreen_port] = touch_data;
+        for (int port = 0; port < 2; port++)
+            frame.ports[port].timeStamp = timestamp;
+        frame.ports[touchscreen_port] = touch_data;
 
     } else {
         SceIVector2 touch_pos_window = { 0, 0 };
@@ -130,8 +138,7 @@ void touch_vsync_update(const EmuEnvState &emuenv) {
 
         for (int port = 0; port < 2; port++) {
             // do it for both the front and the back touchscreen
-            SceTouchData *data = &touch_buffers[(touch_buffer_idx + 1) % MAX_TOUCH_BUFFER_SAVED][port];
-            memset(data, 0, sizeof(SceTouchData));
+            SceTouchData *data = &frame.ports[port];
             data->timeStamp = timestamp;
 
             const uint32_t mask = (port == SCE_TOUCH_PORT_BACK) ? SDL_BUTTON_RMASK : SDL_BUTTON_LMASK;
@@ -183,8 +190,9 @@ void touch_vsync_update(const EmuEnvState &emuenv) {
         }
     }
 
-    touch_buffer_idx++;
-    touch_buffer_idx %= MAX_TOUCH_BUFFER_SAVED;
+    const int next_idx = (touch_buffer_idx.load(std::memory_order_relaxed) + 1) % MAX_TOUCH_BUFFER_SAVED;
+    touch_buffers[next_idx].store(frame);
+    touch_buffer_idx.store(next_idx, std::memory_order_release);
 }
 
 int handle_touch_event(SDL_TouchFingerEvent &finger) {
@@ -312,15 +320,16 @@ int touch_get(const SceUID thread_id, EmuEnvState &emuenv, const SceUInt32 &port
         last_vcount[port_idx] = vblank_count;
     }
 
+    const int last_buffer_idx = touch_buffer_idx.load(std::memory_order_acquire);
     int corr_buffer_idx;
     if (is_peek) {
-        corr_buffer_idx = touch_buffer_idx;
+        corr_buffer_idx = last_buffer_idx;
     } else {
         // give the oldest buffer first
-        corr_buffer_idx = (touch_buffer_idx - nb_returned_data + 1 + MAX_TOUCH_BUFFER_SAVED) % MAX_TOUCH_BUFFER_SAVED;
+        corr_buffer_idx = (last_buffer_idx - nb_returned_data + 1 + MAX_TOUCH_BUFFER_SAVED) % MAX_TOUCH_BUFFER_SAVED;
     }
     for (int32_t i = 0; i < nb_returned_data; i++) {
-        pData[i] = touch_buffers[corr_buffer_idx][port_idx];
+        pData[i] = touch_buffers[corr_buffer_idx].load().ports[port_idx];
 
         // if peek, repeat the last buffer
         if (!is_peek) {
@@ -19,6 +19,8 @@
 
 #include <boost/version.hpp>
 
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 
 #if BOOST_VERSION >= 108200
@@ -109,3 +111,79 @@ struct Queue {
     }
 };
 } // namespace lru
+
+// Flat sorted array of [start, end) address ranges, each associated with a value
+// Several kinds of ranges can be stored together and told apart by the predicates given to the queries
+// This is meant for small to medium sets (a few thousand entries) which are queried much more often than modified
+template <typename T>
+class AddressIntervalIndex {
+public:
+    struct Entry {
+        uint32_t start;
+        uint32_t end;
+        T value;
+    };
+
+private:
+    // sorted by start address
+    std::vector<Entry> entries;
+
+    // first entry with a start address not below start
+    auto lower_bound(uint32_t start) {
+        return std::lower_bound(entries.begin(), entries.end(), start, [](const Entry &entry, uint32_t addr) {
+            return entry.start < addr;
+        });
+    }
+
+public:
+    void insert(uint32_t start, uint32_t size, const T &value) {
+        auto it = std::upper_bound(entries.begin(), entries.end(), start, [](uint32_t addr, const Entry &entry) {
+            return addr < entry.start;
+        });
+        entries.insert(it, Entry{ start, start + size, value });
+    }
+
+    // remove the entry with the given start address and value, return true if it was found
+    bool erase(uint32_t start, const T &value) {
+        for (auto it = lower_bound(start); it != entries.end() && it->start == start; ++it) {
+            if (it->value == value) {
+                entries.erase(it);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // return the entry starting exactly at start for which pred(value) is true, nullptr if there is none
+    template <typename Pred>
+    Entry *find(uint32_t start, Pred pred) {
+        for (auto it = lower_bound(start); it != entries.end() && it->start == start; ++it) {
+            if (pred(it->value))
+                return &*it;
+        }
+        return nullptr;
+    }
+
+    // return the entry with the highest start address not above address for which pred(value) is true, nullptr if there is none
+    // like a lookup in a map of start addresses, the entry may end before address: the caller decides what to do with it
+    template <typename Pred>
+    Entry *find_below(uint32_t address, Pred pred) {
+        auto it = std::upper_bound(entries.begin(), entries.end(), address, [](uint32_t addr, const Entry &entry) {
+            return addr < entry.start;
+        });
+        while (it != entries.begin()) {
+            --it;
+            if (pred(it->value))
+                return &*it;
+        }
+        return nullptr;
+    }
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    void clear() {
+        entries.clear();
+    }
+};
@@ -0,0 +1,80 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Value published by a single writer and read by any number of threads without locking.
+// Readers copy the value and retry if the writer modified it in the meantime, so they never block the writer.
+// The value is stored as atomic words so the concurrent copy is not a data race.
+template <typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable_v<T>, "SeqLock values are copied word by word");
+
+    static constexpr size_t WORD_COUNT = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    // odd while a write is in progress
+    std::atomic<uint32_t> sequence{ 0 };
+    std::array<std::atomic<uint64_t>, WORD_COUNT> words{};
+
+public:
+    SeqLock() {
+        store(T{});
+    }
+
+    // Must only be called by one thread at a time
+    void store(const T &value) {
+        uint64_t buffer[WORD_COUNT] = {};
+        memcpy(buffer, &value, sizeof(T));
+
+        const uint32_t current = sequence.load(std::memory_order_relaxed);
+        sequence.store(current + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < WORD_COUNT; i++)
+            words[i].store(buffer[i], std::memory_order_relaxed);
+
+        sequence.store(current + 2, std::memory_order_release);
+    }
+
+    T load() const {
+        uint64_t buffer[WORD_COUNT];
+        uint32_t before;
+        uint32_t after;
+        do {
+            before = sequence.load(std::memory_order_acquire);
+            for (size_t i = 0; i < WORD_COUNT; i++)
+                buffer[i] = words[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        T value;
+        memcpy(&value, buffer, sizeof(T));
+        return value;
+    }
+
+    // Number of stores done so far, can be used to check if a new value was published
+    uint32_t version() const {
+        return sequence.load(std::memory_order_acquire) / 2;
+    }
+};
@@ -0,0 +1,62 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent helper threads running the items of a job alongside the calling thread
+// The threads are created the first time they are needed and live until the pool is destroyed
+class WorkerPool {
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable start_cond;
+    std::condition_variable done_cond;
+
+    const std::function<void(size_t)> *job = nullptr;
+    size_t job_size = 0;
+    uint32_t job_workers = 0;
+    uint64_t job_id = 0;
+    uint32_t busy_workers = 0;
+    bool exiting = false;
+
+    // items are claimed without taking the mutex
+    std::atomic<size_t> next_index = 0;
+
+    // a single job uses the threads at a time
+    std::mutex run_mutex;
+
+    void worker_loop(uint32_t index);
+    void run_items(const std::function<void(size_t)> &func);
+
+public:
+    ~WorkerPool();
+
+    size_t size() const { return threads.size(); }
+
+    // Call func for every index in [0, count) on the caller and on worker_count threads, return once all of them are done
+    // When another job is using the threads, everything is run by the caller
+    void run(uint32_t worker_count, size_t count, const std::function<void(size_t)> &func);
+};
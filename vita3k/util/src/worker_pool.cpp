@@ -0,0 +1,87 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <util/worker_pool.h>
+
+WorkerPool::~WorkerPool() {
+    {
+        const std::lock_guard<std::mutex> guard(mutex);
+        exiting = true;
+    }
+    start_cond.notify_all();
+
+    for (auto &thread : threads)
+        thread.join();
+}
+
+void WorkerPool::run_items(const std::function<void(size_t)> &func) {
+    for (size_t index = next_index++; index < job_size; index = next_index++)
+        func(index);
+}
+
+void WorkerPool::worker_loop(uint32_t index) {
+    uint64_t last_job = 0;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        start_cond.wait(lock, [&] { return exiting || job_id != last_job; });
+        if (exiting)
+            return;
+
+        last_job = job_id;
+        if (index >= job_workers)
+            continue;
+
+        const std::function<void(size_t)> &func = *job;
+        lock.unlock();
+        run_items(func);
+        lock.lock();
+
+        if (--busy_workers == 0)
+            done_cond.notify_one();
+    }
+}
+
+void WorkerPool::run(uint32_t worker_count, size_t count, const std::function<void(size_t)> &func) {
+    std::unique_lock<std::mutex> run_lock(run_mutex, std::try_to_lock);
+    if (!run_lock.owns_lock() || (worker_count == 0) || (count <= 1)) {
+        for (size_t index = 0; index < count; index++)
+            func(index);
+        return;
+    }
+
+    {
+        const std::lock_guard<std::mutex> guard(mutex);
+        while (threads.size() < worker_count)
+            threads.emplace_back(&WorkerPool::worker_loop, this, static_cast<uint32_t>(threads.size()));
+
+        job = &func;
+        job_size = count;
+        job_workers = worker_count;
+        busy_workers = worker_count;
+        next_index = 0;
+        job_id++;
+    }
+    start_cond.notify_all();
+
+    // the caller takes its share of the work too
+    run_items(func);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cond.wait(lock, [&] { return busy_workers == 0; });
+    job = nullptr;
+}
@@ -0,0 +1,65 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <util/containers.h>
+
+#include <gtest/gtest.h>
+
+static bool accept_all(int) {
+    return true;
+}
+
+TEST(address_interval_index, find_below) {
+    AddressIntervalIndex<int> index;
+    index.insert(0x1000, 0x100, 1);
+    index.insert(0x2000, 0x100, 2);
+
+    ASSERT_EQ(index.find_below(0xFFF, accept_all), nullptr);
+    ASSERT_EQ(index.find_below(0x1000, accept_all)->value, 1);
+    ASSERT_EQ(index.find_below(0x10FF, accept_all)->value, 1);
+    // the entry is returned even if it does not contain the address
+    ASSERT_EQ(index.find_below(0x1100, accept_all)->value, 1);
+    ASSERT_EQ(index.find_below(0x2050, accept_all)->value, 2);
+    ASSERT_EQ(index.find_below(0x2100, accept_all)->end, 0x2100);
+}
+
+TEST(address_interval_index, overlapping_ranges) {
+    AddressIntervalIndex<int> index;
+    // a big range containing two smaller ones
+    index.insert(0x1000, 0x1000, 1);
+    index.insert(0x1200, 0x100, 2);
+    index.insert(0x1800, 0x100, 3);
+
+    ASSERT_EQ(index.find_below(0x1250, accept_all)->value, 2);
+    // only the closest range below is returned, not the big one containing the address
+    ASSERT_EQ(index.find_below(0x1400, accept_all)->value, 2);
+    // the predicate is used to filter the results
+    ASSERT_EQ(index.find_below(0x1250, [](int value) { return value != 2; })->value, 1);
+    ASSERT_EQ(index.find_below(0x1850, [](int value) { return value == 2; })->value, 2);
+}
+
+TEST(address_interval_index, erase) {
+    AddressIntervalIndex<int> index;
+    index.insert(0x1000, 0x100, 1);
+    index.insert(0x1000, 0x200, 2);
+
+    ASSERT_FALSE(index.erase(0x1000, 3));
+    ASSERT_TRUE(index.erase(0x1000, 2));
+    ASSERT_EQ(index.size(), 1);
+    ASSERT_EQ(index.find(0x1000, accept_all)->value, 1);
+    ASSERT_EQ(index.find_below(0x1150, accept_all)->end, 0x1100);
+}
@@ -0,0 +1,85 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <util/seqlock.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+// every field holds the same value, a torn read would mix two of them
+struct Sample {
+    uint32_t values[13];
+    uint8_t tail;
+};
+
+} // namespace
+
+TEST(seqlock, store_and_load) {
+    SeqLock<Sample> lock;
+    ASSERT_EQ(lock.version(), 1u);
+    ASSERT_EQ(lock.load().values[0], 0u);
+
+    Sample sample{};
+    for (auto &value : sample.values)
+        value = 42;
+    sample.tail = 7;
+    lock.store(sample);
+
+    const Sample result = lock.load();
+    ASSERT_EQ(lock.version(), 2u);
+    ASSERT_EQ(result.values[12], 42u);
+    ASSERT_EQ(result.tail, 7);
+}
+
+TEST(seqlock, concurrent_readers_never_see_torn_values) {
+    SeqLock<Sample> lock;
+    std::atomic<bool> done = false;
+
+    std::thread writer([&] {
+        Sample sample{};
+        for (uint32_t i = 1; i <= 200000; i++) {
+            for (auto &value : sample.values)
+                value = i;
+            sample.tail = static_cast<uint8_t>(i);
+            lock.store(sample);
+        }
+        done = true;
+    });
+
+    // the writer must be joined before any assertion can return from the test
+    bool torn = false;
+    bool out_of_order = false;
+    uint32_t last = 0;
+    while (!done && !torn && !out_of_order) {
+        const Sample sample = lock.load();
+        for (const auto value : sample.values)
+            torn |= value != sample.values[0];
+        torn |= sample.tail != static_cast<uint8_t>(sample.values[0]);
+        // values are published in order
+        out_of_order = sample.values[0] < last;
+        last = sample.values[0];
+    }
+
+    writer.join();
+    ASSERT_FALSE(torn);
+    ASSERT_FALSE(out_of_order);
+    ASSERT_EQ(lock.load().values[0], 200000u);
+}
@@ -0,0 +1,55 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <util/worker_pool.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+TEST(worker_pool, runs_every_item_once) {
+    WorkerPool pool;
+    for (const uint32_t worker_count : { 0u, 1u, 3u }) {
+        std::vector<std::atomic<uint32_t>> calls(1000);
+        pool.run(worker_count, calls.size(), [&](size_t index) { calls[index]++; });
+
+        for (const auto &count : calls)
+            ASSERT_EQ(count, 1u);
+    }
+
+    // the threads are only created when needed and kept for the next jobs
+    ASSERT_EQ(pool.size(), 3u);
+}
+
+TEST(worker_pool, concurrent_jobs_run_on_their_caller) {
+    WorkerPool pool;
+    std::atomic<uint32_t> total = 0;
+
+    std::vector<std::thread> callers;
+    for (int i = 0; i < 4; i++) {
+        callers.emplace_back([&] {
+            for (int job = 0; job < 100; job++)
+                pool.run(2, 50, [&](size_t) { total++; });
+        });
+    }
+    for (auto &caller : callers)
+        caller.join();
+
+    ASSERT_EQ(total, 4u * 100u * 50u);
+}
@@ -0,0 +1,76 @@
+// Vita3K emulator project
+// Copyright (C) 2024 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// Address interval index benchmark
+// Fills the index with surfaces covering half of the address space, like the surface cache does, and
+// reports how many lookups per second can be done depending on the number of ranges.
+
+#include <util/containers.h>
+
+#include <CLI11.hpp>
+#include <fmt/format.h>
+
+#include <chrono>
+#include <random>
+
+namespace {
+
+constexpr uint32_t SURFACE_SIZE = 0x10000;
+
+double run(uint32_t surface_count, int32_t lookup_count, uint32_t &found) {
+    AddressIntervalIndex<uint32_t> index;
+    for (uint32_t i = 0; i < surface_count; i++)
+        index.insert(i * SURFACE_SIZE * 2, SURFACE_SIZE, i);
+
+    std::mt19937 rng(surface_count);
+    std::uniform_int_distribution<uint32_t> dist(0, surface_count * SURFACE_SIZE * 2);
+    std::vector<uint32_t> addresses(lookup_count);
+    for (auto &address : addresses)
+        address = dist(rng);
+
+    found = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const uint32_t address : addresses) {
+        const auto *entry = index.find_below(address, [](uint32_t) { return true; });
+        found += entry && entry->end > address;
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<uint32_t> surface_counts = { 100, 1000, 10000 };
+    int32_t lookup_count = 1'000'000;
+
+    CLI::App app{ "Vita3K address interval index benchmark" };
+    app.add_option("--surfaces,-s", surface_counts, "Number of ranges in the index, one run for each value")->check(CLI::Range(1, 30000));
+    app.add_option("--lookups,-n", lookup_count, "Number of lookups timed")->check(CLI::Range(1, 100000000));
+    CLI11_PARSE(app, argc, argv);
+
+    for (const uint32_t surface_count : surface_counts) {
+        uint32_t found = 0;
+        const double seconds = run(surface_count, lookup_count, found);
+        // half of the address space is covered by the surfaces
+        fmt::print("surfaces: {:5}, found: {:5.1f}%, {:6.1f} million lookups per second\n",
+            surface_count, found * 100.0 / lookup_count, lookup_count / seconds / 1e6);
+    }
+
+    return 0;
+}